@@ -0,0 +1,51 @@
+#!/bin/bash
+#
+# Builds and runs the CoinCore, CoinQ and CoinDB benchmarks and writes their
+# results as one JSON document to bench.json, or to the file given by OUT.
+# Run build-all.sh tools_only first so the libraries are installed in sysroot.
+#
+# Arguments are passed to every benchmark, e.g. ./bench-all.sh --repeat=10
+
+if [[ -z "$OUT" ]]
+then
+    OUT=bench.json
+fi
+
+if [[ -z $(git diff --shortstat) ]]
+then
+    COMMIT_HASH=$(git rev-parse HEAD)
+else
+    COMMIT_HASH="N/A"
+fi
+
+CURRENT_DIR=$(pwd)
+RESULTS_DIR=$(mktemp -d)
+
+set -x
+set -e
+
+cd deps/CoinCore
+make bench
+(cd bench/build && ./corebench "$@" --out=$RESULTS_DIR/corebench.json)
+
+cd ../CoinQ
+make bench
+(cd bench/build && ./blocktreebench "$@" --out=$RESULTS_DIR/blocktreebench.json)
+
+cd ../CoinDB
+make bench
+(cd bench/build && ./vaultbench "$@" --out=$RESULTS_DIR/vaultbench.json)
+
+cd $CURRENT_DIR
+set +x
+
+{
+    echo "{\"commit\":\"$COMMIT_HASH\",\"suites\":["
+    echo "$(cat $RESULTS_DIR/corebench.json),"
+    echo "$(cat $RESULTS_DIR/blocktreebench.json),"
+    echo "$(cat $RESULTS_DIR/vaultbench.json)"
+    echo "]}"
+} > $OUT
+
+rm -rf $RESULTS_DIR
+echo "Results written to $OUT."
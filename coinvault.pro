@@ -71,6 +71,8 @@ HEADERS = \
     src/txview.h \
     src/accounthistorydialog.h \
     src/txactions.h \
+    src/vaultrefresher.h \
+    src/latencyoverlay.h \
     src/scriptmodel.h \
     src/scriptview.h \
     src/scriptdialog.h \
@@ -105,6 +107,8 @@ SOURCES = \
     src/txview.cpp \
     src/accounthistorydialog.cpp \
     src/txactions.cpp \
+    src/vaultrefresher.cpp \
+    src/latencyoverlay.cpp \
     src/scriptmodel.cpp \
     src/scriptview.cpp \
     src/scriptdialog.cpp \
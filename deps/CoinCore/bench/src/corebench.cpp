@@ -0,0 +1,145 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// corebench.cpp
+//
+// Copyright (c) 2014 Eric Lombrozo
+//
+// All Rights Reserved.
+//
+// Microbenchmarks for the CoinCore primitives on the header, block and
+// wallet paths. Inputs are synthetic and built from a fixed seed.
+//
+// Usage: corebench [--repeat=n] [--filter=name] [--out=file]
+//                  [--block_txs=n] [--filter_elements=n] [--iterations=n]
+//
+
+#include <hash.h>
+#include <CoinNodeData.h>
+#include <BloomFilter.h>
+#include <hdkeys.h>
+#include <secp256k1.h>
+
+#include <stdutils/benchutils.h>
+
+#include <iostream>
+#include <stdexcept>
+
+using namespace Coin;
+using namespace CoinCrypto;
+using namespace std;
+
+static Transaction syntheticTx(stdutils::bench_random& rng)
+{
+    Transaction tx;
+    for (unsigned int i = 0; i < 2; i++) {
+        // A P2PKH scriptSig: a DER signature and a compressed pubkey
+        uchar_vector scriptSig;
+        scriptSig.push_back(72);
+        scriptSig += rng.bytes<uchar_vector>(72);
+        scriptSig.push_back(33);
+        scriptSig += rng.bytes<uchar_vector>(33);
+        tx.addInput(TxIn(OutPoint(rng.bytes<uchar_vector>(32), i), scriptSig, 0xffffffff));
+    }
+    tx.addOutput(TxOut(100000, uchar_vector("76a914") + rng.bytes<uchar_vector>(20) + uchar_vector("88ac")));
+    tx.addOutput(TxOut(200000, uchar_vector("a914") + rng.bytes<uchar_vector>(20) + uchar_vector("87")));
+    return tx;
+}
+
+int main(int argc, char* argv[])
+{
+    try {
+        stdutils::bench_runner bench("corebench", argc, argv);
+        const uint64_t blockTxs = bench.param("block_txs", 2000);
+        const uint64_t filterElements = bench.param("filter_elements", 20000);
+        const uint64_t iterations = bench.param("iterations", 10000);
+
+        stdutils::bench_random rng;
+
+        // sha256_2 over a block header and over a typical tx
+        for (size_t len: { (size_t)80, (size_t)1024 }) {
+            uchar_vector data = rng.bytes<uchar_vector>(len);
+            bench.run("sha256_2/" + to_string(len), iterations, [&]() {
+                for (uint64_t i = 0; i < iterations; i++) {
+                    data[0] = (unsigned char)i;
+                    uchar_vector hash = sha256_2(data);
+                    stdutils::do_not_optimize(hash);
+                }
+            });
+        }
+
+        // Transaction and block parsing
+        uchar_vector rawTx = syntheticTx(rng).getSerialized();
+        bench.run("Transaction::setSerialized", iterations, [&]() {
+            Transaction tx;
+            for (uint64_t i = 0; i < iterations; i++) {
+                tx.setSerialized(rawTx);
+                stdutils::do_not_optimize(tx);
+            }
+        });
+
+        CoinBlock block(2, 1400000000, 0x1d00ffff);
+        for (uint64_t i = 0; i < blockTxs; i++) { block.txs.push_back(syntheticTx(rng)); }
+        block.updateMerkleRoot();
+        uchar_vector rawBlock = block.getSerialized();
+        const uint64_t blockIterations = max<uint64_t>(1, iterations / blockTxs);
+        bench.run("CoinBlock::setSerialized/tx", blockIterations * blockTxs, [&]() {
+            for (uint64_t i = 0; i < blockIterations; i++) {
+                CoinBlock parsed;
+                parsed.setSerialized(rawBlock);
+                stdutils::do_not_optimize(parsed);
+            }
+        });
+
+        // Bloom filter sized like a vault's, with one element in a hundred present
+        BloomFilter filter((uint32_t)filterElements, 0.001, 0, 0);
+        vector<uchar_vector> elements;
+        for (uint64_t i = 0; i < filterElements; i++) {
+            uchar_vector element = rng.bytes<uchar_vector>(20);
+            filter.insert(element);
+            if (i % 100 == 0) { elements.push_back(element); }
+        }
+        while (elements.size() < 10000) { elements.push_back(rng.bytes<uchar_vector>(20)); }
+        bench.run("BloomFilter::match", elements.size(), [&]() {
+            size_t matches = 0;
+            for (auto& element: elements) {
+                if (filter.match(element.data(), element.size())) matches++;
+            }
+            stdutils::do_not_optimize(matches);
+        });
+
+        // Key derivation and signing
+        HDSeed seed(rng.bytes<bytes_t>(32));
+        HDKeychain privateKeychain(seed.getMasterKey(), seed.getMasterChainCode());
+        HDKeychain publicKeychain = privateKeychain.getPublic();
+        const uint64_t keyIterations = max<uint64_t>(1, iterations / 10);
+        bench.run("HDKeychain::getChild/private", keyIterations, [&]() {
+            for (uint64_t i = 0; i < keyIterations; i++) {
+                HDKeychain child = privateKeychain.getChild((uint32_t)i);
+                stdutils::do_not_optimize(child);
+            }
+        });
+        bench.run("HDKeychain::getChild/public", keyIterations, [&]() {
+            for (uint64_t i = 0; i < keyIterations; i++) {
+                HDKeychain child = publicKeychain.getChild((uint32_t)i);
+                stdutils::do_not_optimize(child);
+            }
+        });
+
+        secp256k1_key signingKey;
+        signingKey.setPrivKey(privateKeychain.getPrivateSigningKey(1));
+        bytes_t digest = rng.bytes<bytes_t>(32);
+        bench.run("secp256k1_sign", keyIterations, [&]() {
+            for (uint64_t i = 0; i < keyIterations; i++) {
+                digest[0] = (unsigned char)i;
+                bytes_t signature = secp256k1_sign(signingKey, digest);
+                stdutils::do_not_optimize(signature);
+            }
+        });
+
+        return bench.finish();
+    }
+    catch (const exception& e) {
+        cerr << "Error: " << e.what() << endl;
+        return -1;
+    }
+}
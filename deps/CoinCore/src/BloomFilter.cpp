@@ -24,7 +24,13 @@
 
 #include "BloomFilter.h"
 #include <cmath>
+#include <cstring>
 #include <algorithm>
+#include <stdexcept>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 #define LN2SQUARED 0.4804530139182014246671025263266649717305529515945455
 #define LN2 0.6931471805599453094172321214581765680755001343602552
@@ -38,22 +44,21 @@ inline uint32_t ROTL32(uint32_t x, int8_t r)
     return (x << r) | (x >> (32 - r));
 }
 
-uint32_t murmurHash3(uint32_t seed, const uchar_vector& data)
+static uint32_t murmurHash3(uint32_t seed, const unsigned char* data, std::size_t len)
 {
     // The following is MurmurHash3 (x86_32), see http://code.google.com/p/smhasher/source/browse/trunk/MurmurHash3.cpp
     uint32_t h1 = seed;
     const uint32_t c1 = 0xcc9e2d51;
     const uint32_t c2 = 0x1b873593;
 
-    const int nblocks = data.size() / 4;
+    const int nblocks = len / 4;
 
     //----------
     // body
-    const uint32_t * blocks = (const uint32_t *)(&data[0] + nblocks*4);
-
-    for(int i = -nblocks; i; i++)
+    for(int i = 0; i < nblocks; i++)
     {
-        uint32_t k1 = blocks[i];
+        uint32_t k1;
+        std::memcpy(&k1, data + i*4, 4); // data need not be aligned
 
         k1 *= c1;
         k1 = ROTL32(k1,15);
@@ -66,11 +71,11 @@ uint32_t murmurHash3(uint32_t seed, const uchar_vector& data)
 
     //----------
     // tail
-    const uint8_t * tail = (const uint8_t*)(&data[0] + nblocks*4);
+    const uint8_t * tail = (const uint8_t*)(data + nblocks*4);
 
     uint32_t k1 = 0;
 
-    switch(data.size() & 3)
+    switch(len & 3)
     {
     case 3: k1 ^= tail[2] << 16;
     case 2: k1 ^= tail[1] << 8;
@@ -80,7 +85,7 @@ uint32_t murmurHash3(uint32_t seed, const uchar_vector& data)
 
     //----------
     // finalization
-    h1 ^= data.size();
+    h1 ^= len;
     h1 ^= h1 >> 16;
     h1 *= 0x85ebca6b;
     h1 ^= h1 >> 13;
@@ -91,9 +96,9 @@ uint32_t murmurHash3(uint32_t seed, const uchar_vector& data)
 }
 
 
-inline uint32_t BloomFilter::hash(uint n, const uchar_vector& data) const
+inline uint32_t BloomFilter::hash(uint n, const unsigned char* data, std::size_t len) const
 {
-    return murmurHash3(n * 0xfba4c795 + nTweak, data) % (filter.size() * 8);
+    return murmurHash3(n * 0xfba4c795 + nTweak, data, len) % (filter.size() * 8);
 }
 
 BloomFilter::BloomFilter(uint32_t nElements, double falsePositiveRate, uint32_t _nTweak, uint8_t _nFlags) :
@@ -118,24 +123,169 @@ void BloomFilter::set(uint32_t nElements, double falsePositiveRate, uint32_t _nT
     bSet = true;
 }
 
-void BloomFilter::insert(const uchar_vector& data)
+void BloomFilter::load(const uchar_vector& _filter, uint32_t _nHashFuncs, uint32_t _nTweak, uint8_t _nFlags)
+{
+    if (_filter.empty() || _filter.size() > MAX_BLOOM_FILTER_SIZE) {
+        throw std::runtime_error("Invalid bloom filter size.");
+    }
+
+    filter = _filter;
+    bFull = std::all_of(filter.begin(), filter.end(), [](unsigned char c) { return c == 0xff; });
+    bEmpty = std::all_of(filter.begin(), filter.end(), [](unsigned char c) { return c == 0; });
+    nHashFuncs = std::min(_nHashFuncs, MAX_BLOOM_FILTER_HASH_FUNCS);
+    nTweak = _nTweak;
+    nFlags = _nFlags;
+    bSet = true;
+}
+
+void BloomFilter::insert(const unsigned char* data, std::size_t len)
 {
     if (bFull) return;
     for (uint i = 0; i < nHashFuncs; i++) {
-        uint index = hash(i, data);
+        uint index = hash(i, data, len);
         filter[index >> 3] |= bit_mask[7 & index];
     }
     bEmpty = false;
 }
 
-bool BloomFilter::match(const uchar_vector& data) const
+bool BloomFilter::match(const unsigned char* data, std::size_t len) const
 {
     if (bFull) return true;
     if (bEmpty) return false;
 
     for (uint i = 0; i < nHashFuncs; i++) {
-        uint index = hash(i, data);
+        uint index = hash(i, data, len);
         if (!(filter[index >> 3] & bit_mask[7 & index])) return false;
     }
     return true;
 }
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// class BlockedBloomFilter implementation
+//
+static inline uint32_t fmix32(uint32_t h)
+{
+    h ^= h >> 16;
+    h *= 0x85ebca6b;
+    h ^= h >> 13;
+    h *= 0xc2b2ae35;
+    h ^= h >> 16;
+    return h;
+}
+
+void BlockedBloomFilter::set(uint32_t nElements, double falsePositiveRate, uint32_t _nTweak)
+{
+    if (nElements == 0) nElements = 1;
+
+    // Probes confined to one block collide more often, so allow half again as many bits as a BIP37
+    // filter would need. There is no upper bound since this filter never leaves the process.
+    double nBits = -1 / LN2SQUARED * nElements * log(falsePositiveRate) * 1.5;
+    nBlocks = std::max((std::size_t)ceil(nBits / (BLOCK_SIZE * 8)), (std::size_t)1);
+    nHashFuncs = std::max(std::min((uint32_t)(-log(falsePositiveRate) / LN2), MAX_BLOOM_FILTER_HASH_FUNCS), (uint32_t)1);
+    nTweak = _nTweak;
+    words.assign(nBlocks * BLOCK_WORDS + BLOCK_WORDS - 1, 0);
+}
+
+BlockedBloomFilter::BlockedBloomFilter(const BlockedBloomFilter& source) : nBlocks(0), nHashFuncs(0), nTweak(0)
+{
+    *this = source;
+}
+
+BlockedBloomFilter& BlockedBloomFilter::operator=(const BlockedBloomFilter& source)
+{
+    if (this == &source) return *this;
+
+    nBlocks = source.nBlocks;
+    nHashFuncs = source.nHashFuncs;
+    nTweak = source.nTweak;
+    words.assign(source.words.size(), 0);
+    if (nBlocks > 0) { std::copy(source.getBlock(0), source.getBlock(nBlocks), getBlock(0)); }
+    return *this;
+}
+
+const uint64_t* BlockedBloomFilter::getBlock(std::size_t i) const
+{
+    uintptr_t base = reinterpret_cast<uintptr_t>(words.data());
+    uintptr_t aligned = (base + BLOCK_SIZE - 1) & ~(uintptr_t)(BLOCK_SIZE - 1);
+    return words.data() + (aligned - base) / sizeof(uint64_t) + i * BLOCK_WORDS;
+}
+
+std::size_t BlockedBloomFilter::getMask(const unsigned char* data, std::size_t len, uint64_t* mask) const
+{
+    uint32_t h1 = murmurHash3(nTweak, data, len);
+    uint32_t h2 = fmix32(h1 ^ 0x9e3779b9);
+    uint32_t step = ROTL32(h2, 16) | 1;
+
+    for (std::size_t w = 0; w < BLOCK_WORDS; w++) { mask[w] = 0; }
+    for (uint32_t i = 0; i < nHashFuncs; i++) {
+        uint32_t bit = (h2 + i * step) & (BLOCK_SIZE * 8 - 1);
+        mask[bit >> 6] |= (uint64_t)1 << (bit & 63);
+    }
+
+    // Multiply and shift maps h1 onto [0, nBlocks) without a division
+    return ((uint64_t)h1 * nBlocks) >> 32;
+}
+
+static inline bool blockContains(const uint64_t* block, const uint64_t* mask)
+{
+#ifdef __SSE2__
+    int eq = 0xffff;
+    for (int i = 0; i < 4; i++) {
+        __m128i b = _mm_load_si128((const __m128i*)block + i);
+        __m128i m = _mm_loadu_si128((const __m128i*)mask + i);
+        eq &= _mm_movemask_epi8(_mm_cmpeq_epi32(_mm_and_si128(b, m), m));
+    }
+    return eq == 0xffff;
+#else
+    for (int w = 0; w < 8; w++) {
+        if ((block[w] & mask[w]) != mask[w]) return false;
+    }
+    return true;
+#endif
+}
+
+void BlockedBloomFilter::insert(const unsigned char* data, std::size_t len)
+{
+    if (!isSet()) return;
+
+    uint64_t mask[BLOCK_WORDS];
+    uint64_t* block = getBlock(getMask(data, len, mask));
+    for (std::size_t w = 0; w < BLOCK_WORDS; w++) { block[w] |= mask[w]; }
+}
+
+bool BlockedBloomFilter::match(const unsigned char* data, std::size_t len) const
+{
+    if (!isSet()) return false;
+
+    uint64_t mask[BLOCK_WORDS];
+    return blockContains(getBlock(getMask(data, len, mask)), mask);
+}
+
+void BlockedBloomFilter::match(std::size_t count, const unsigned char* const* data, const std::size_t* lengths, bool* results) const
+{
+    if (!isSet()) {
+        std::fill(results, results + count, false);
+        return;
+    }
+
+    const std::size_t BATCH_SIZE = 16;
+    uint64_t masks[BATCH_SIZE][BLOCK_WORDS];
+    const uint64_t* blocks[BATCH_SIZE];
+
+    for (std::size_t begin = 0; begin < count; begin += BATCH_SIZE) {
+        std::size_t n = std::min(BATCH_SIZE, count - begin);
+
+        // Hash the whole batch first so the block loads overlap instead of stalling one at a time
+        for (std::size_t i = 0; i < n; i++) {
+            blocks[i] = getBlock(getMask(data[begin + i], lengths[begin + i], masks[i]));
+#if defined(__GNUC__)
+            __builtin_prefetch(blocks[i]);
+#endif
+        }
+
+        for (std::size_t i = 0; i < n; i++) {
+            results[begin + i] = blockContains(blocks[i], masks[i]);
+        }
+    }
+}
@@ -1213,7 +1213,7 @@ void GetHeadersMessage::setSerialized(const uchar_vector& bytes)
         throw runtime_error("Invalid data - GetHeadersMessage too small.");
 
     this->version = vch_to_uint<uint32_t>(bytes, _BIG_ENDIAN); uint pos = 4;
-    VarInt count(uchar_vector(bytes.begin(), bytes.end())); pos += count.getSize();
+    VarInt count(uchar_vector(bytes.begin() + 4, bytes.end())); pos += count.getSize();
     if (bytes.size() < pos + 32*(count.value + 1))
         throw runtime_error("Invalid data - GetHeadersMessage has wrong length.");
     this->blockLocatorHashes.clear();
@@ -1659,6 +1659,7 @@ uchar_vector Transaction::getHashWithAppendedCode(uint32_t code) const
 
 hashfunc_t CoinBlockHeader::hashfunc_ = &sha256_2; // use Hashcash as default. Change with CoinBlockHeader::setHashFunc(<hash function>).
 hashfunc_t CoinBlockHeader::powhashfunc_ = &sha256_2;
+batch_hashfunc_t CoinBlockHeader::powbatchhashfunc_;
 
 CoinBlockHeader::CoinBlockHeader(const string& hex)
 {
@@ -1698,6 +1699,35 @@ void CoinBlockHeader::setSerialized(const uchar_vector& bytes)
     this->nonce = vch_to_uint<uint32_t>(uchar_vector(bytes.begin() + pos, bytes.begin() + pos + 4), _BIG_ENDIAN); pos += 4;
 }
 
+std::vector<uchar_vector> CoinBlockHeader::getPOWHashesLittleEndian(const std::vector<CoinBlockHeader>& headers)
+{
+    std::vector<uchar_vector> hashes;
+    hashes.reserve(headers.size());
+    if (headers.empty()) return hashes;
+
+    if (!powbatchhashfunc_)
+    {
+        for (auto& header: headers) { hashes.push_back(header.getPOWHashLittleEndian()); }
+        return hashes;
+    }
+
+    std::vector<unsigned char> input(headers.size() * BATCH_HASH_INPUT_SIZE);
+    for (size_t i = 0; i < headers.size(); i++)
+    {
+        uchar_vector serialized = headers[i].getSerialized();
+        memcpy(&input[i * BATCH_HASH_INPUT_SIZE], &serialized[0], BATCH_HASH_INPUT_SIZE);
+    }
+
+    std::vector<unsigned char> output(headers.size() * 32);
+    parallel_hash_batch(powbatchhashfunc_, &input[0], &output[0], headers.size());
+
+    for (size_t i = 0; i < headers.size(); i++)
+    {
+        hashes.push_back(uchar_vector(&output[i * 32], &output[i * 32] + 32).getReverse());
+    }
+    return hashes;
+}
+
 const BigInt CoinBlockHeader::getTarget() const
 {
     uint32_t nExp = bits >> 24;
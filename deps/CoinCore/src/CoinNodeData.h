@@ -26,6 +26,7 @@
 #define COIN_NODE_DATA_H__
 
 #include "hash.h"
+#include "hashbatch.h"
 #include "IPv6.h"
 
 #include "BigInt.h"
@@ -750,7 +751,8 @@ public:
     const BigInt getWork() const;
 
     static void setHashFunc(hashfunc_t hashfunc) { hashfunc_ = hashfunc; }
-    static void setPOWHashFunc(hashfunc_t hashfunc) { powhashfunc_ = hashfunc; }
+    // batchhashfunc must compute the same hash as hashfunc. Without one, batches are hashed one header at a time.
+    static void setPOWHashFunc(hashfunc_t hashfunc, batch_hashfunc_t batchhashfunc = batch_hashfunc_t()) { powhashfunc_ = hashfunc; powbatchhashfunc_ = batchhashfunc; }
 
     uchar_vector getHash() const { return hashfunc_(this->getSerialized()); } // big endian
     uchar_vector getHashLittleEndian() const { return uchar_vector(this->getHash()).getReverse(); }
@@ -758,9 +760,13 @@ public:
     uchar_vector getPOWHash() const { return powhashfunc_(this->getSerialized()); } // big endian
     uchar_vector getPOWHashLittleEndian() const { return uchar_vector(this->getPOWHash()).getReverse(); }
 
+    // Same as calling getPOWHashLittleEndian() on each header, but spreads the work across SIMD lanes and threads.
+    static std::vector<uchar_vector> getPOWHashesLittleEndian(const std::vector<CoinBlockHeader>& headers);
+
 private:
     static hashfunc_t hashfunc_;
     static hashfunc_t powhashfunc_;
+    static batch_hashfunc_t powbatchhashfunc_;
 };
 
 class CoinBlock : public CoinNodeStructure
@@ -25,6 +25,7 @@
 #include "MerkleTree.h"
 
 #include <stdexcept>
+#include <cstring>
 
 using namespace Coin;
 
@@ -34,29 +35,117 @@ using namespace Coin;
 //
 uchar_vector MerkleTree::getRoot() const
 {
-    uchar_vector pairedHashes;
     if (hashes_.size() == 0)
-        return pairedHashes; // empty vector
+        return uchar_vector(); // empty vector
 
     if (hashes_.size() == 1)
         return hashes_[0];
 
-    MerkleTree tree;
-    for (unsigned int i = 0; i < hashes_.size(); i += 2) {
-        pairedHashes = hashes_[i];
-        if (i + 1 < hashes_.size()) {
-            // two different nodes
-            pairedHashes += hashes_[i + 1];
+    // Copy the leaves into one contiguous buffer and reduce it in place
+    uchar_vector buffer;
+    buffer.reserve(hashes_.size() * 32);
+    for (auto& hash: hashes_) {
+        if (hash.size() != 32)
+            throw std::runtime_error("MerkleTree::getRoot - Invalid hash size.");
+        buffer += hash;
+    }
+
+    computeRoot(&buffer[0], hashes_.size());
+    buffer.resize(32);
+    return buffer;
+}
+
+void MerkleTree::computeRoot(unsigned char* hashes, std::size_t count)
+{
+    unsigned char pairedHashes[64];
+    while (count > 1) {
+        std::size_t next = 0;
+        for (std::size_t i = 0; i < count; i += 2, next++) {
+            unsigned char* left = hashes + 32 * i;
+            if (i + 1 < count) {
+                // two different nodes - already adjacent in the buffer
+                sha256_2_(left, 64, hashes + 32 * next);
+            }
+            else {
+                // the same node with itself
+                std::memcpy(pairedHashes, left, 32);
+                std::memcpy(pairedHashes + 32, left, 32);
+                sha256_2_(pairedHashes, 64, hashes + 32 * next);
+            }
+        }
+        count = next;
+    }
+}
+
+namespace
+{
+
+// Walks compressed partial merkle tree data in the depth-first order defined by BIP37.
+// Each level only needs a pair of hashes on the stack, so no nodes are allocated.
+class CompressedTreeWalker
+{
+public:
+    CompressedTreeWalker(unsigned int nTxs, const std::vector<uchar_vector>& hashes, const uchar_vector& flags, std::vector<std::size_t>* matches)
+        : nTxs_(nTxs), hashes_(hashes), flags_(flags), matches_(matches), hashPos_(0), bitPos_(0) { }
+
+    // Writes the 32-byte root to root. Returns false if the data is malformed.
+    bool walk(unsigned char* root)
+    {
+        if (nTxs_ == 0 || hashes_.size() > nTxs_) return false;
+
+        unsigned int height = 0;
+        while (width(height) > 1) { height++; }
+
+        if (!traverse(height, 0, root)) return false;
+
+        // All hashes must be consumed and there can be no flag bytes beyond the last one used.
+        return hashPos_ == hashes_.size() && (bitPos_ + 7) / 8 == flags_.size();
+    }
+
+private:
+    unsigned int nTxs_;
+    const std::vector<uchar_vector>& hashes_;
+    const uchar_vector& flags_;
+    std::vector<std::size_t>* matches_;
+    std::size_t hashPos_;
+    std::size_t bitPos_;
+
+    std::size_t width(unsigned int height) const { return ((std::size_t)nTxs_ + ((std::size_t)1 << height) - 1) >> height; }
+
+    bool traverse(unsigned int height, std::size_t pos, unsigned char* hash)
+    {
+        if (bitPos_ >= flags_.size() * 8) return false;
+        bool bit = (flags_[bitPos_ >> 3] >> (bitPos_ & 7)) & 0x01;
+        bitPos_++;
+
+        // We've reached a leaf of the partial merkle tree
+        if (height == 0 || !bit) {
+            if (hashPos_ >= hashes_.size() || hashes_[hashPos_].size() != 32) return false;
+            std::memcpy(hash, &hashes_[hashPos_][0], 32);
+            if (bit && matches_) matches_->push_back(hashPos_);
+            hashPos_++;
+            return true;
+        }
+
+        unsigned char children[64];
+        if (!traverse(height - 1, pos * 2, children)) return false;
+
+        if (pos * 2 + 1 < width(height - 1)) {
+            if (!traverse(height - 1, pos * 2 + 1, children + 32)) return false;
+
+            // Identical siblings would let a different transaction list commit to the same root
+            if (std::memcmp(children, children + 32, 32) == 0) return false;
         }
         else {
-            // the same node with itself
-            pairedHashes += hashes_[i];
+            // There's no right subtree - pair this node's hash with itself
+            std::memcpy(children + 32, children, 32);
         }
-        //pairedHashes.reverse();
-        tree.addHash(sha256_2(pairedHashes));
+
+        sha256_2_(children, 64, hash);
+        return true;
     }
+};
 
-    return tree.getRoot(); // recurse
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -96,67 +185,48 @@ void PartialMerkleTree::setCompressed(unsigned int nTxs, const std::vector<uchar
     unsigned int n = nTxs_ - 1;
     while (n > 0) { depth++; n >>= 1; }
     depth--;
+    depth_ = depth;
 
-    std::queue<uchar_vector> hashQueue;
-    merkleHashes_.clear();
-    for (auto& hash: hashes) { merkleHashes_.push_back(hash); hashQueue.push(hash); }
+    merkleHashes_.assign(hashes.begin(), hashes.end());
     txHashes_.clear();
     bits_.clear();
 
-    std::queue<bool> bitQueue; 
     for (auto& flag: flags) {
         for (unsigned int i = 0; i < 8; i++) {
-            bool bit = ((flag >> i) & (unsigned char)0x01);
-            bits_.push_back(bit);
-            bitQueue.push(bit);
+            bits_.push_back((flag >> i) & (unsigned char)0x01);
         }
     }
 
-    setCompressed(hashQueue, bitQueue, depth);
-    if (!merkleRoot.empty() && merkleRoot != getRootLittleEndian()) {
-        throw std::runtime_error("PartialMerkleTree::setCompressed - Invalid merkle root.");
-    }
-}
-
-void PartialMerkleTree::setCompressed(std::queue<uchar_vector>& hashQueue, std::queue<bool>& bitQueue, unsigned int depth)
-{
-    depth_ = depth;
-
-    if (hashQueue.empty() || bitQueue.empty()) {
+    std::vector<std::size_t> matches;
+    root_.resize(32);
+    CompressedTreeWalker walker(nTxs, hashes, flags, &matches);
+    if (!walker.walk(&root_[0])) {
         throw std::runtime_error("PartialMerkleTree::setCompressed - Invalid compressed partial merkle tree data.");
     }
 
-    bool bit = bitQueue.front();
-    bitQueue.pop();
+    for (auto i: matches) { txHashes_.push_back(hashes[i]); }
 
-    // We've reached a leaf of the partial merkle tree
-    if (depth == 0 || !bit) {
-        root_ = hashQueue.front();
-        if (bit) txHashes_.push_back(hashQueue.front());
-        hashQueue.pop();
-        return;
+    if (!merkleRoot.empty() && merkleRoot != getRootLittleEndian()) {
+        throw std::runtime_error("PartialMerkleTree::setCompressed - Invalid merkle root.");
     }
+}
 
-    depth--;
-
-    // we're not at a leaf and bit is set so recurse
-    PartialMerkleTree leftSubtree;
-    leftSubtree.setCompressed(hashQueue, bitQueue, depth);
+bool PartialMerkleTree::verifyCompressed(unsigned int nTxs, const std::vector<uchar_vector>& hashes, const uchar_vector& flags, const uchar_vector& merkleRoot, std::vector<uchar_vector>* txHashes)
+{
+    if (!merkleRoot.empty() && merkleRoot.size() != 32) return false;
 
-    txHashes_.swap(leftSubtree.txHashes_);
+    std::vector<std::size_t> matches;
+    unsigned char root[32];
+    CompressedTreeWalker walker(nTxs, hashes, flags, txHashes ? &matches : nullptr);
+    if (!walker.walk(root)) return false;
 
-    if (!hashQueue.empty()) {
-        // A right subtree also exists, so find it
-        PartialMerkleTree rightSubtree;
-        rightSubtree.setCompressed(hashQueue, bitQueue, depth);
+    // merkleRoot is little endian
+    if (!merkleRoot.empty() && !std::equal(merkleRoot.rbegin(), merkleRoot.rend(), root)) return false;
 
-        root_ = sha256_2(leftSubtree.root_ + rightSubtree.root_);
-        txHashes_.splice(txHashes_.end(), rightSubtree.txHashes_);
-    }
-    else {
-        // There's no right subtree - copy over this node's hash
-        root_ = sha256_2(leftSubtree.root_ + leftSubtree.root_);
+    if (txHashes) {
+        for (auto i: matches) { txHashes->push_back(hashes[i]); }
     }
+    return true;
 }
 
 void PartialMerkleTree::setUncompressed(const std::vector<MerkleLeaf>& leaves)
@@ -50,6 +50,10 @@ public:
     uchar_vector getRoot() const;
     uchar_vector getRootLittleEndian() const { return getRoot().getReverse(); }
 
+    // Reduces count contiguous 32-byte hashes level by level, overwriting the buffer.
+    // The root is left in the first 32 bytes. count must be nonzero.
+    static void computeRoot(unsigned char* hashes, std::size_t count);
+
 private:
     std::vector<uchar_vector> hashes_;
 };
@@ -66,6 +70,12 @@ public:
     void setCompressed(unsigned int nTxs, const std::vector<uchar_vector>& hashes, const uchar_vector& flags, const uchar_vector& merkleRoot = uchar_vector());
     void setUncompressed(const std::vector<MerkleLeaf>& leaves);
 
+    // Walks the flag bits of compressed tree data directly, without building any subtrees.
+    // Hashes are in the same byte order as for setCompressed and merkleRoot, if not empty, is little endian.
+    // Returns false if the data is malformed or does not hash to merkleRoot. If txHashes is not null,
+    // the hashes of matched transactions are appended to it.
+    static bool verifyCompressed(unsigned int nTxs, const std::vector<uchar_vector>& hashes, const uchar_vector& flags, const uchar_vector& merkleRoot = uchar_vector(), std::vector<uchar_vector>* txHashes = nullptr);
+
     unsigned int getNTxs() const { return nTxs_; }
     unsigned int getDepth() const { return depth_; }
     const std::list<uchar_vector>& getMerkleHashes() const { return merkleHashes_; }
@@ -105,7 +115,6 @@ private:
     std::list<bool> bits_;
     uchar_vector root_;
 
-    void setCompressed(std::queue<uchar_vector>& hashQueue, std::queue<bool>& bitQueue, unsigned int depth);
     void setUncompressed(const std::vector<MerkleLeaf>& leaves, std::size_t begin, std::size_t end, unsigned int depth);
 };
 
@@ -32,6 +32,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <openssl/aes.h>
+#include <openssl/crypto.h>
 #include <openssl/evp.h>
 
 #include <stdexcept>
@@ -57,11 +58,11 @@ int aes_init(const unsigned char *key_data, int key_data_len, unsigned char *sal
         return -1;
     }
 
-    EVP_CIPHER_CTX_init(e_ctx);
     EVP_EncryptInit_ex(e_ctx, EVP_aes_256_cbc(), NULL, key, iv);
-    EVP_CIPHER_CTX_init(d_ctx);
     EVP_DecryptInit_ex(d_ctx, EVP_aes_256_cbc(), NULL, key, iv);
 
+    OPENSSL_cleanse(key, sizeof(key));
+    OPENSSL_cleanse(iv, sizeof(iv));
     return 0;
 }
 
@@ -89,32 +90,38 @@ unsigned char *aes_encrypt(EVP_CIPHER_CTX *e, unsigned char *plaintext, int *len
     return ciphertext;
 }
 
-uchar_vector aes_encrypt(const uchar_vector& key, const uchar_vector& plaintext, uint64_t salt)
+// The key is taken as a plain byte vector so that secure_bytes_t keys are not copied.
+uchar_vector aes_encrypt(const std::vector<unsigned char>& key, const uchar_vector& plaintext, uint64_t salt)
 {
-    EVP_CIPHER_CTX en, de;
+    // Contexts are opaque from OpenSSL 1.1 on, so they are allocated rather than put on the stack.
+    EVP_CIPHER_CTX* en = EVP_CIPHER_CTX_new();
+    EVP_CIPHER_CTX* de = EVP_CIPHER_CTX_new();
 
     int key_len = key.size();
 
     /* gen key and iv. init the cipher ctx object */
     uint64_t salt_[] = { salt };
-    if (aes_init(&key[0], key_len, (unsigned char*)&salt_, &en, &de)) {
+    if (!en || !de || aes_init(&key[0], key_len, (unsigned char*)&salt_, en, de)) {
+        EVP_CIPHER_CTX_free(en);
+        EVP_CIPHER_CTX_free(de);
         throw std::runtime_error("aes_encrypt - aes_init error.");    
     }
 
     int len = plaintext.size();
-    unsigned char* ciphertext_ = aes_encrypt(&en, (unsigned char*)&plaintext[0], &len);
+    unsigned char* ciphertext_ = aes_encrypt(en, (unsigned char*)&plaintext[0], &len);
 
     uchar_vector ciphertext(ciphertext_, len);
 
     free(ciphertext_);
-    EVP_CIPHER_CTX_cleanup(&en);
-    EVP_CIPHER_CTX_cleanup(&de);
+    EVP_CIPHER_CTX_free(en);
+    EVP_CIPHER_CTX_free(de);
 
     return ciphertext;
 }
 
 /*
  * Decrypt *len bytes of ciphertext
+ * Sets *len to -1 if the padding is wrong, which is how a wrong key usually shows.
  */
 unsigned char *aes_decrypt(EVP_CIPHER_CTX *e, unsigned char *ciphertext, int *len)
 {
@@ -124,31 +131,38 @@ unsigned char *aes_decrypt(EVP_CIPHER_CTX *e, unsigned char *ciphertext, int *le
 
     EVP_DecryptInit_ex(e, NULL, NULL, NULL, NULL);
     EVP_DecryptUpdate(e, plaintext, &p_len, ciphertext, *len);
-    EVP_DecryptFinal_ex(e, plaintext+p_len, &f_len);
+    if (!EVP_DecryptFinal_ex(e, plaintext+p_len, &f_len)) {
+        OPENSSL_cleanse(plaintext, *len + AES_BLOCK_SIZE);
+        *len = -1;
+        return plaintext;
+    }
 
     *len = p_len + f_len;
     return plaintext;
 }
 
-uchar_vector aes_decrypt(const uchar_vector& key, const uchar_vector& ciphertext, uint64_t salt)
+uchar_vector aes_decrypt(const std::vector<unsigned char>& key, const uchar_vector& ciphertext, uint64_t salt)
 {
-    EVP_CIPHER_CTX en, de;
+    EVP_CIPHER_CTX* en = EVP_CIPHER_CTX_new();
+    EVP_CIPHER_CTX* de = EVP_CIPHER_CTX_new();
 
     int key_len = key.size();
 
     /* gen key and iv. init the cipher ctx object */
     uint64_t salt_[] = { salt };
-    if (aes_init(&key[0], key_len, (unsigned char *)&salt_, &en, &de)) {
+    if (!en || !de || aes_init(&key[0], key_len, (unsigned char *)&salt_, en, de)) {
+        EVP_CIPHER_CTX_free(en);
+        EVP_CIPHER_CTX_free(de);
         throw std::runtime_error("aes_decrypt - aes_init error.");    
     }
 
     int len = ciphertext.size();
-    unsigned char* plaintext_ = aes_decrypt(&de, (unsigned char*)&ciphertext[0], &len);
+    unsigned char* plaintext_ = aes_decrypt(de, (unsigned char*)&ciphertext[0], &len);
 
     if (len <= 0) {
         free (plaintext_);
-        EVP_CIPHER_CTX_cleanup(&en);
-        EVP_CIPHER_CTX_cleanup(&de);
+        EVP_CIPHER_CTX_free(en);
+        EVP_CIPHER_CTX_free(de);
 
         // TODO: use exception codes
         throw std::runtime_error("aes_decrypt - invalid key, ciphertext, or salt.");
@@ -156,10 +170,10 @@ uchar_vector aes_decrypt(const uchar_vector& key, const uchar_vector& ciphertext
 
     uchar_vector plaintext(plaintext_, len);
 
+    OPENSSL_cleanse(plaintext_, len);
     free(plaintext_);
-    EVP_CIPHER_CTX_cleanup(&en);
-    EVP_CIPHER_CTX_cleanup(&de);
+    EVP_CIPHER_CTX_free(en);
+    EVP_CIPHER_CTX_free(de);
 
     return plaintext;
 }
-
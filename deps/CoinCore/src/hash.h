@@ -61,6 +61,19 @@ inline uchar_vector sha256_2(const uchar_vector& data)
     return rval;
 }
 
+// Writes the double sha256 of len bytes at data to the 32 bytes at hash. The output may alias the input.
+inline void sha256_2_(const unsigned char* data, std::size_t len, unsigned char* hash)
+{
+    unsigned char tmp[SHA256_DIGEST_LENGTH];
+    SHA256_CTX sha256;
+    SHA256_Init(&sha256);
+    SHA256_Update(&sha256, data, len);
+    SHA256_Final(tmp, &sha256);
+    SHA256_Init(&sha256);
+    SHA256_Update(&sha256, tmp, SHA256_DIGEST_LENGTH);
+    SHA256_Final(hash, &sha256);
+}
+
 inline uchar_vector ripemd160(const uchar_vector& data)
 {
     unsigned char hash[RIPEMD160_DIGEST_LENGTH];
@@ -0,0 +1,226 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// hashbatch.cpp
+//
+// Copyright (c) 2014 Eric Lombrozo
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#include "hashbatch.h"
+
+#include "hash.h"
+#include "scrypt/scrypt.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Shares handed to worker threads are multiples of this so that only the last one
+// has a tail that does not fill the SIMD lanes of the scrypt batch.
+static const std::size_t BATCH_SHARE_ALIGNMENT = 8;
+
+// Below this many headers per share, handing shares to workers costs more than it saves.
+// Double SHA-256 takes well under a microsecond per header, so it needs much larger shares
+// than scrypt or hash9, which take tens of microseconds or more.
+static const std::size_t MIN_BATCH_SHARE = 16;
+static const std::size_t MIN_SHA256_2_BATCH_SHARE = 512;
+
+typedef void (*batch_hashfunc_ptr_t)(const unsigned char*, unsigned char*, std::size_t);
+
+namespace {
+
+// Worker threads started on first use and kept for the life of the process, so that
+// each batch only pays for waking them. The calling thread runs shares too.
+class HashBatchPool
+{
+public:
+    static HashBatchPool& instance()
+    {
+        static HashBatchPool pool;
+        return pool;
+    }
+
+    // Not counting the calling thread.
+    unsigned int size() const { return workers_.size(); }
+
+    // Runs every task and returns once all have finished. Tasks must not throw.
+    void run(std::vector<std::function<void()>>& tasks)
+    {
+        if (tasks.empty()) return;
+
+        Job job;
+        job.remaining = tasks.size();
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            for (std::size_t i = 1; i < tasks.size(); i++) { queue_.push_back(Entry(&job, &tasks[i])); }
+        }
+        cond_.notify_all();
+
+        // Take part rather than sit idle, and take back this batch's shares if the workers are busy with others.
+        tasks[0]();
+        finish(job);
+        while (true)
+        {
+            std::function<void()>* pTask = nullptr;
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                auto it = std::find_if(queue_.begin(), queue_.end(), [&](const Entry& entry) { return entry.pJob == &job; });
+                if (it == queue_.end()) break;
+                pTask = it->pTask;
+                queue_.erase(it);
+            }
+            (*pTask)();
+            finish(job);
+        }
+
+        std::unique_lock<std::mutex> lock(mutex_);
+        job.done.wait(lock, [&]() { return job.remaining == 0; });
+    }
+
+private:
+    struct Job
+    {
+        std::size_t remaining;
+        std::condition_variable done;
+    };
+
+    struct Entry
+    {
+        Entry(Job* pJob_, std::function<void()>* pTask_) : pJob(pJob_), pTask(pTask_) { }
+
+        Job* pJob;
+        std::function<void()>* pTask;
+    };
+
+    HashBatchPool() : bStopping_(false)
+    {
+        unsigned int nWorkers = std::max(std::thread::hardware_concurrency(), 1u) - 1;
+        for (unsigned int i = 0; i < nWorkers; i++) { workers_.push_back(std::thread(&HashBatchPool::loop, this)); }
+    }
+
+    ~HashBatchPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            bStopping_ = true;
+        }
+        cond_.notify_all();
+        for (auto& worker: workers_) { worker.join(); }
+    }
+
+    // The job is not touched once its last task is counted, as run() may return right away.
+    void finish(Job& job)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (--job.remaining == 0) job.done.notify_all();
+    }
+
+    void loop()
+    {
+        while (true)
+        {
+            Entry entry(nullptr, nullptr);
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                cond_.wait(lock, [this]() { return bStopping_ || !queue_.empty(); });
+                if (queue_.empty()) return;
+                entry = queue_.front();
+                queue_.pop_front();
+            }
+            (*entry.pTask)();
+            finish(*entry.pJob);
+        }
+    }
+
+    std::mutex mutex_;
+    std::condition_variable cond_;
+    std::deque<Entry> queue_;
+    bool bStopping_;
+    std::vector<std::thread> workers_;
+};
+
+}
+
+void sha256_2_batch(const unsigned char* input, unsigned char* output, std::size_t count)
+{
+    for (std::size_t i = 0; i < count; i++)
+        sha256_2_(&input[i * BATCH_HASH_INPUT_SIZE], BATCH_HASH_INPUT_SIZE, &output[i * 32]);
+}
+
+void scrypt_1024_1_1_256_batch(const unsigned char* input, unsigned char* output, std::size_t count)
+{
+    scrypt_1024_1_1_256_batch_((const char*)input, (char*)output, count);
+}
+
+void hash9_batch(const unsigned char* input, unsigned char* output, std::size_t count)
+{
+    for (std::size_t i = 0; i < count; i++)
+    {
+        const unsigned char* data = &input[i * BATCH_HASH_INPUT_SIZE];
+        uint256 hash = Hash9(data, data + BATCH_HASH_INPUT_SIZE);
+        std::memcpy(&output[i * 32], &hash, 32);
+    }
+}
+
+void parallel_hash_batch(const batch_hashfunc_t& hashfunc, const unsigned char* input, unsigned char* output, std::size_t count, unsigned int nThreads)
+{
+    const batch_hashfunc_ptr_t* pFunction = hashfunc.target<batch_hashfunc_ptr_t>();
+    std::size_t minShare = (pFunction && *pFunction == &sha256_2_batch) ? MIN_SHA256_2_BATCH_SHARE : MIN_BATCH_SHARE;
+
+    HashBatchPool& pool = HashBatchPool::instance();
+    if (nThreads == 0) nThreads = pool.size() + 1;
+    nThreads = std::min<std::size_t>(nThreads, count / minShare);
+    if (nThreads <= 1 || pool.size() == 0)
+    {
+        hashfunc(input, output, count);
+        return;
+    }
+
+    std::size_t share = (count + nThreads - 1) / nThreads;
+    share = (share + BATCH_SHARE_ALIGNMENT - 1) / BATCH_SHARE_ALIGNMENT * BATCH_SHARE_ALIGNMENT;
+
+    std::vector<std::function<void()>> tasks;
+    std::vector<std::exception_ptr> errors(nThreads);
+    for (unsigned int t = 0; t < nThreads; t++)
+    {
+        std::size_t begin = t * share;
+        if (begin >= count) break;
+        std::size_t n = std::min(share, count - begin);
+        std::exception_ptr& error = errors[t];
+        tasks.push_back([&hashfunc, &error, input, output, begin, n]() {
+            try
+            {
+                hashfunc(&input[begin * BATCH_HASH_INPUT_SIZE], &output[begin * 32], n);
+            }
+            catch (...)
+            {
+                error = std::current_exception();
+            }
+        });
+    }
+
+    pool.run(tasks);
+    for (auto& error: errors) { if (error) std::rethrow_exception(error); }
+}
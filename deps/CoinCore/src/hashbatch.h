@@ -0,0 +1,48 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// hashbatch.h
+//
+// Copyright (c) 2014 Eric Lombrozo
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#ifndef __HASHBATCH_H___
+#define __HASHBATCH_H___
+
+#include <cstddef>
+#include <functional>
+
+// Size of the inputs accepted by the batch hash functions: one serialized block header.
+const std::size_t BATCH_HASH_INPUT_SIZE = 80;
+
+// Hashes count consecutive 80-byte block headers at input, writing count consecutive
+// 32-byte hashes (big endian, as returned by the single header hash functions) to output.
+typedef std::function<void(const unsigned char*, unsigned char*, std::size_t)> batch_hashfunc_t;
+
+void sha256_2_batch(const unsigned char* input, unsigned char* output, std::size_t count);
+void scrypt_1024_1_1_256_batch(const unsigned char* input, unsigned char* output, std::size_t count);
+void hash9_batch(const unsigned char* input, unsigned char* output, std::size_t count);
+
+// Splits a batch into contiguous shares and hashes them on nThreads threads: the calling thread
+// and workers from a pool that is started on first use and kept. nThreads = 0 uses the hardware
+// concurrency. Small batches are hashed on the calling thread alone.
+void parallel_hash_batch(const batch_hashfunc_t& hashfunc, const unsigned char* input, unsigned char* output, std::size_t count, unsigned int nThreads = 0);
+
+#endif
@@ -0,0 +1,179 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// keystretch.cpp
+//
+// Copyright (c) 2014 Eric Lombrozo
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#include "keystretch.h"
+
+#include "hash.h"
+#include "random.h"
+#include "scrypt/scrypt.h"
+
+#include <openssl/crypto.h>
+#include <openssl/sha.h>
+
+#include <chrono>
+#include <mutex>
+#include <stdexcept>
+
+using namespace Coin;
+
+static const std::size_t STRETCH_SALT_HEADER_SIZE = 10;
+static const std::size_t STRETCHED_KEY_SIZE = 32;
+
+static std::mutex g_defaultStretchParamsMutex;
+static ScryptParams g_defaultStretchParams;
+
+void Coin::setDefaultStretchParams(const ScryptParams& params)
+{
+    if (params.log2N < MIN_STRETCH_LOG2N || params.log2N > MAX_STRETCH_LOG2N || params.r == 0 || params.p == 0)
+        throw std::runtime_error("setDefaultStretchParams - invalid parameters.");
+
+    std::lock_guard<std::mutex> lock(g_defaultStretchParamsMutex);
+    g_defaultStretchParams = params;
+}
+
+ScryptParams Coin::getDefaultStretchParams()
+{
+    std::lock_guard<std::mutex> lock(g_defaultStretchParamsMutex);
+    return g_defaultStretchParams;
+}
+
+bytes_t Coin::makeStretchSalt(const ScryptParams& params, std::size_t nonceSize)
+{
+    bytes_t salt(STRETCH_SALT_HEADER_SIZE);
+    salt[0] = STRETCH_SALT_VERSION;
+    salt[1] = params.log2N;
+    le32enc(&salt[2], params.r);
+    le32enc(&salt[6], params.p);
+
+    uchar_vector nonce = random_bytes(nonceSize);
+    salt.insert(salt.end(), nonce.begin(), nonce.end());
+    return salt;
+}
+
+bool Coin::isStretchSalt(const bytes_t& salt)
+{
+    return salt.size() > STRETCH_SALT_HEADER_SIZE && salt[0] == STRETCH_SALT_VERSION;
+}
+
+ScryptParams Coin::getStretchParams(const bytes_t& salt)
+{
+    if (!isStretchSalt(salt))
+        throw std::runtime_error("getStretchParams - invalid salt.");
+
+    ScryptParams params(salt[1], le32dec(&salt[2]), le32dec(&salt[6]));
+    if (params.log2N < MIN_STRETCH_LOG2N || params.log2N > MAX_STRETCH_LOG2N || params.r == 0 || params.p == 0)
+        throw std::runtime_error("getStretchParams - invalid parameters.");
+
+    return params;
+}
+
+secure_bytes_t Coin::stretchKey(const secure_bytes_t& key, const bytes_t& salt)
+{
+    ScryptParams params = getStretchParams(salt);
+
+    secure_bytes_t stretched(STRETCHED_KEY_SIZE);
+    if (scrypt(key.data(), key.size(), &salt[0], salt.size(), params.N(), params.r, params.p, &stretched[0], stretched.size()) != 0)
+        throw std::runtime_error("stretchKey - scrypt failed.");
+
+    return stretched;
+}
+
+ScryptParams Coin::calibrateStretchParams(unsigned int targetMilliseconds, uint32_t r, uint32_t p)
+{
+    ScryptParams params(MIN_STRETCH_LOG2N, r, p);
+    secure_bytes_t key(32, 0);
+    bytes_t salt = makeStretchSalt(params);
+
+    // Each step doubles the cost, so stop once the next one would overshoot the target.
+    while (params.log2N < MAX_STRETCH_LOG2N)
+    {
+        salt[1] = params.log2N;
+        auto start = std::chrono::steady_clock::now();
+        stretchKey(key, salt);
+        auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+
+        if ((unsigned int)elapsed.count() > targetMilliseconds)
+        {
+            if (params.log2N > MIN_STRETCH_LOG2N) params.log2N--;
+            break;
+        }
+
+        if ((unsigned int)elapsed.count() * 2 > targetMilliseconds) break;
+        params.log2N++;
+    }
+
+    return params;
+}
+
+void Coin::wipeKey(secure_bytes_t& key)
+{
+    if (!key.empty()) OPENSSL_cleanse(&key[0], key.size());
+    key.clear();
+}
+
+bytes_t StretchedKeyCache::getIndexHash(const secure_bytes_t& key, const bytes_t& salt)
+{
+    // Hashed in two parts so the key is not copied into a buffer that would need wiping.
+    bytes_t hash(SHA256_DIGEST_LENGTH);
+    SHA256_CTX ctx;
+    SHA256_Init(&ctx);
+    SHA256_Update(&ctx, key.data(), key.size());
+    SHA256_Update(&ctx, salt.data(), salt.size());
+    SHA256_Final(&hash[0], &ctx);
+    OPENSSL_cleanse(&ctx, sizeof(ctx));
+    return hash;
+}
+
+bool StretchedKeyCache::find(const secure_bytes_t& key, const bytes_t& salt, secure_bytes_t& stretched) const
+{
+    auto it = keys.find(std::make_pair(salt, getIndexHash(key, salt)));
+    if (it == keys.end()) return false;
+
+    stretched = it->second;
+    return true;
+}
+
+void StretchedKeyCache::insert(const secure_bytes_t& key, const bytes_t& salt, const secure_bytes_t& stretched)
+{
+    secure_bytes_t& entry = keys[std::make_pair(salt, getIndexHash(key, salt))];
+    wipeKey(entry);
+    entry = stretched;
+}
+
+void StretchedKeyCache::erase(const bytes_t& salt)
+{
+    auto it = keys.lower_bound(std::make_pair(salt, bytes_t()));
+    while (it != keys.end() && it->first.first == salt)
+    {
+        wipeKey(it->second);
+        it = keys.erase(it);
+    }
+}
+
+void StretchedKeyCache::clear()
+{
+    for (auto& item: keys) { wipeKey(item.second); }
+    keys.clear();
+}
@@ -0,0 +1,103 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// keystretch.h
+//
+// Copyright (c) 2014 Eric Lombrozo
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#ifndef COIN_KEYSTRETCH_H
+#define COIN_KEYSTRETCH_H
+
+#include "typedefs.h"
+
+#include <stdint.h>
+
+#include <map>
+#include <utility>
+
+namespace Coin {
+
+// Cost parameters for scrypt. N = 2^log2N and memory use is 128 * r * N bytes.
+struct ScryptParams
+{
+    ScryptParams(uint8_t log2N_ = 14, uint32_t r_ = 8, uint32_t p_ = 1) : log2N(log2N_), r(r_), p(p_) { }
+
+    uint64_t N() const { return (uint64_t)1 << log2N; }
+    uint64_t memory() const { return 128 * (uint64_t)r * N(); }
+
+    uint8_t log2N;
+    uint32_t r;
+    uint32_t p;
+};
+
+// Salts produced by makeStretchSalt carry their own cost parameters:
+//
+//   0x02 | log2N (1 byte) | r (4 bytes, little endian) | p (4 bytes, little endian) | random nonce
+//
+// Any other salt is left to the caller. Keychains use the one-byte salt 0x01 for keys stored
+// before stretching was added, which are encrypted with the lock key as is.
+const unsigned char STRETCH_SALT_VERSION = 0x02;
+const uint8_t MIN_STRETCH_LOG2N = 10;
+const uint8_t MAX_STRETCH_LOG2N = 20;
+
+// The defaults for new salts. Safe to call from any thread.
+void setDefaultStretchParams(const ScryptParams& params);
+ScryptParams getDefaultStretchParams();
+
+bytes_t makeStretchSalt(const ScryptParams& params = getDefaultStretchParams(), std::size_t nonceSize = 16);
+bool isStretchSalt(const bytes_t& salt);
+ScryptParams getStretchParams(const bytes_t& salt);
+
+// Derives a 32-byte key from key with the parameters and nonce in salt.
+secure_bytes_t stretchKey(const secure_bytes_t& key, const bytes_t& salt);
+
+// Returns the largest N, for the given r and p, whose derivation takes no longer than
+// targetMilliseconds on this machine, clamped to [2^MIN_STRETCH_LOG2N, 2^MAX_STRETCH_LOG2N].
+ScryptParams calibrateStretchParams(unsigned int targetMilliseconds, uint32_t r = 8, uint32_t p = 1);
+
+// Overwrites key with zeros and empties it. secure_bytes_t does not wipe itself yet.
+void wipeKey(secure_bytes_t& key);
+
+// Remembers stretched keys so that unlocking with the same key and salt only pays for
+// the derivation once. Only keys that have unlocked something should be inserted, so that
+// wrong keys cannot fill it. Not thread safe - the owner must serialize access.
+class StretchedKeyCache
+{
+public:
+    ~StretchedKeyCache() { clear(); }
+
+    // Returns false and leaves stretched alone if there is no entry for key and salt.
+    bool find(const secure_bytes_t& key, const bytes_t& salt, secure_bytes_t& stretched) const;
+    void insert(const secure_bytes_t& key, const bytes_t& salt, const secure_bytes_t& stretched);
+    void erase(const bytes_t& salt); // forgets every key stretched with salt
+    void clear();
+
+    std::size_t size() const { return keys.size(); }
+
+private:
+    static bytes_t getIndexHash(const secure_bytes_t& key, const bytes_t& salt);
+
+    std::map<std::pair<bytes_t, bytes_t>, secure_bytes_t> keys; // indexed by (salt, sha256(key || salt))
+};
+
+}
+
+#endif // COIN_KEYSTRETCH_H
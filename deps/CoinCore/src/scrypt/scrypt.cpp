@@ -32,8 +32,16 @@
 #include <stdlib.h>
 #include <stdint.h>
 #include <string.h>
+#include <errno.h>
 #include <openssl/sha.h>
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
 static inline uint32_t be32dec(const void *pp)
 {
 	const uint8_t *p = (uint8_t const *)pp;
@@ -321,3 +329,385 @@ void scrypt_1024_1_1_256_(const char *input, char *output)
         scrypt_1024_1_1_256_sp_generic(input, output, scratchpad);
 #endif
 }
+
+/*
+ * scrypt with arbitrary cost parameters, used for key stretching.
+ *
+ * Blocks are kept as arrays of 16 words. When SSE2 is available they are stored
+ * with word (i * 5) % 16 of each block at position i so that the columns and rows
+ * of salsa20/8 line up with 128-bit lanes.
+ */
+
+static inline void salsa20_8(uint32_t B[16])
+{
+#if defined(__SSE2__)
+	__m128i *Bv = (__m128i *)B;
+	__m128i X0 = Bv[0], X1 = Bv[1], X2 = Bv[2], X3 = Bv[3];
+	__m128i T;
+	int i;
+
+	for (i = 0; i < 8; i += 2) {
+		/* Operate on columns. */
+		T = _mm_add_epi32(X0, X3);
+		X1 = _mm_xor_si128(X1, _mm_slli_epi32(T, 7));
+		X1 = _mm_xor_si128(X1, _mm_srli_epi32(T, 25));
+		T = _mm_add_epi32(X1, X0);
+		X2 = _mm_xor_si128(X2, _mm_slli_epi32(T, 9));
+		X2 = _mm_xor_si128(X2, _mm_srli_epi32(T, 23));
+		T = _mm_add_epi32(X2, X1);
+		X3 = _mm_xor_si128(X3, _mm_slli_epi32(T, 13));
+		X3 = _mm_xor_si128(X3, _mm_srli_epi32(T, 19));
+		T = _mm_add_epi32(X3, X2);
+		X0 = _mm_xor_si128(X0, _mm_slli_epi32(T, 18));
+		X0 = _mm_xor_si128(X0, _mm_srli_epi32(T, 14));
+
+		/* Rearrange data. */
+		X1 = _mm_shuffle_epi32(X1, 0x93);
+		X2 = _mm_shuffle_epi32(X2, 0x4E);
+		X3 = _mm_shuffle_epi32(X3, 0x39);
+
+		/* Operate on rows. */
+		T = _mm_add_epi32(X0, X1);
+		X3 = _mm_xor_si128(X3, _mm_slli_epi32(T, 7));
+		X3 = _mm_xor_si128(X3, _mm_srli_epi32(T, 25));
+		T = _mm_add_epi32(X3, X0);
+		X2 = _mm_xor_si128(X2, _mm_slli_epi32(T, 9));
+		X2 = _mm_xor_si128(X2, _mm_srli_epi32(T, 23));
+		T = _mm_add_epi32(X2, X3);
+		X1 = _mm_xor_si128(X1, _mm_slli_epi32(T, 13));
+		X1 = _mm_xor_si128(X1, _mm_srli_epi32(T, 19));
+		T = _mm_add_epi32(X1, X2);
+		X0 = _mm_xor_si128(X0, _mm_slli_epi32(T, 18));
+		X0 = _mm_xor_si128(X0, _mm_srli_epi32(T, 14));
+
+		/* Rearrange data. */
+		X1 = _mm_shuffle_epi32(X1, 0x39);
+		X2 = _mm_shuffle_epi32(X2, 0x4E);
+		X3 = _mm_shuffle_epi32(X3, 0x93);
+	}
+
+	Bv[0] = _mm_add_epi32(Bv[0], X0);
+	Bv[1] = _mm_add_epi32(Bv[1], X1);
+	Bv[2] = _mm_add_epi32(Bv[2], X2);
+	Bv[3] = _mm_add_epi32(Bv[3], X3);
+#else
+	static const uint32_t zero[16] = { 0 };
+	xor_salsa8(B, zero);
+#endif
+}
+
+static inline void blkcpy(uint32_t *dest, const uint32_t *src, size_t words)
+{
+	memcpy(dest, src, words * 4);
+}
+
+static inline void blkxor(uint32_t *dest, const uint32_t *src, size_t words)
+{
+#if defined(__SSE2__)
+	__m128i *D = (__m128i *)dest;
+	const __m128i *S = (const __m128i *)src;
+	size_t i;
+
+	for (i = 0; i < words / 4; i++)
+		D[i] = _mm_xor_si128(D[i], S[i]);
+#else
+	size_t i;
+
+	for (i = 0; i < words; i++)
+		dest[i] ^= src[i];
+#endif
+}
+
+/*
+ * Compute Bout = BlockMix_{salsa20/8, r}(Bin). The input Bin must be 128r bytes in
+ * length; the output Bout must also be the same size. X is 64 bytes of scratch.
+ */
+static void blockmix_salsa8(const uint32_t *Bin, uint32_t *Bout, uint32_t *X, size_t r)
+{
+	size_t i;
+
+	/* 1: X <-- B_{2r - 1} */
+	blkcpy(X, &Bin[(2 * r - 1) * 16], 16);
+
+	/* 2: for i = 0 to 2r - 1 do */
+	for (i = 0; i < 2 * r; i += 2) {
+		/* 3: X <-- H(X \xor B_i) */
+		blkxor(X, &Bin[i * 16], 16);
+		salsa20_8(X);
+
+		/* 4: Y_i <-- X */
+		/* 6: B' <-- (Y_0, Y_2 ... Y_{2r-2}, Y_1, Y_3 ... Y_{2r-1}) */
+		blkcpy(&Bout[i * 8], X, 16);
+
+		/* 3: X <-- H(X \xor B_i) */
+		blkxor(X, &Bin[i * 16 + 16], 16);
+		salsa20_8(X);
+
+		/* 4: Y_i <-- X */
+		/* 6: B' <-- (Y_0, Y_2 ... Y_{2r-2}, Y_1, Y_3 ... Y_{2r-1}) */
+		blkcpy(&Bout[i * 8 + r * 16], X, 16);
+	}
+}
+
+static inline size_t block_word_index(size_t i)
+{
+#if defined(__SSE2__)
+	return (i & ~(size_t)15) + ((i & 15) * 13) % 16;
+#else
+	return i;
+#endif
+}
+
+/*
+ * Compute B = SMix_r(B, N). The input B must be 128r bytes in length; the
+ * temporary storage V must be 128rN bytes in length; the temporary storage
+ * XY must be 256r + 64 bytes in length. All storage must be 64-byte aligned.
+ */
+static void smix(uint8_t *B, size_t r, uint64_t N, uint32_t *V, uint32_t *XY)
+{
+	uint32_t *X = XY;
+	uint32_t *Y = &XY[32 * r];
+	uint32_t *Z = &XY[64 * r];
+	uint32_t *T;
+	uint64_t i, j;
+	size_t k;
+
+	/* 1: X <-- B */
+	for (k = 0; k < 32 * r; k++)
+		X[block_word_index(k)] = le32dec(&B[4 * k]);
+
+	/* 2: for i = 0 to N - 1 do */
+	for (i = 0; i < N; i++) {
+		/* 3: V_i <-- X */
+		blkcpy(&V[i * (32 * r)], X, 32 * r);
+
+		/* 4: X <-- H(X) */
+		blockmix_salsa8(X, Y, Z, r);
+		T = X; X = Y; Y = T;
+	}
+
+	/* 6: for i = 0 to N - 1 do */
+	for (i = 0; i < N; i++) {
+		/* 7: j <-- Integerify(X) mod N */
+		j = X[(2 * r - 1) * 16] & (N - 1);
+
+		/* 8: X <-- H(X \xor V_j) */
+		blkxor(X, &V[j * (32 * r)], 32 * r);
+		blockmix_salsa8(X, Y, Z, r);
+		T = X; X = Y; Y = T;
+	}
+
+	/* 10: B' <-- X */
+	for (k = 0; k < 32 * r; k++)
+		le32enc(&B[4 * k], X[block_word_index(k)]);
+}
+
+int scrypt(const uint8_t *passwd, size_t passwdlen, const uint8_t *salt, size_t saltlen,
+    uint64_t N, uint32_t r, uint32_t p, uint8_t *buf, size_t buflen)
+{
+	void *B0, *V0, *XY0;
+	uint8_t *B;
+	uint32_t *V, *XY;
+	uint32_t i;
+
+	/* Sanity-check parameters. */
+	if ((uint64_t)(r) * (uint64_t)(p) >= (1 << 30) || r == 0 || p == 0 ||
+	    N < 2 || (N & (N - 1)) != 0 || N > 0xffffffffu ||
+	    N > SIZE_MAX / 128 / r) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	/* Allocate memory with room to align each buffer on a cache line. */
+	if ((B0 = malloc(128 * r * p + 63)) == NULL)
+		return -1;
+	B = (uint8_t *)(((uintptr_t)(B0) + 63) & ~(uintptr_t)(63));
+	if ((XY0 = malloc(256 * r + 64 + 63)) == NULL) {
+		free(B0);
+		return -1;
+	}
+	XY = (uint32_t *)(((uintptr_t)(XY0) + 63) & ~(uintptr_t)(63));
+	if ((V0 = malloc(128 * r * N + 63)) == NULL) {
+		free(XY0);
+		free(B0);
+		return -1;
+	}
+	V = (uint32_t *)(((uintptr_t)(V0) + 63) & ~(uintptr_t)(63));
+
+	/* 1: (B_0 ... B_{p-1}) <-- PBKDF2(P, S, 1, p * MFLen) */
+	PBKDF2_SHA256(passwd, passwdlen, salt, saltlen, 1, B, p * 128 * r);
+
+	/* 2: for i = 0 to p - 1 do */
+	for (i = 0; i < p; i++) {
+		/* 3: B_i <-- MF(B_i, N) */
+		smix(&B[i * 128 * r], r, N, V, XY);
+	}
+
+	/* 5: DK <-- PBKDF2(P, B, 1, dkLen) */
+	PBKDF2_SHA256(passwd, passwdlen, B, p * 128 * r, 1, buf, buflen);
+
+	/* Wipe the intermediate state. */
+	memset(B, 0, 128 * r * p);
+	memset(XY, 0, 256 * r + 64);
+	memset(V, 0, 128 * r * N);
+
+	free(V0);
+	free(XY0);
+	free(B0);
+
+	return 0;
+}
+
+/*
+ * Lane-parallel scrypt(1024, 1, 1) for hashing batches of block headers.
+ *
+ * Each vector lane carries a different header, so word k of every header's
+ * state lives in X[k]. Salsa20/8 needs no shuffles in this layout and the
+ * only scalar work left is the data-dependent read from V.
+ */
+
+#if defined(__SSE2__)
+struct sse2_lanes
+{
+	typedef __m128i vec;
+	enum { N = 4 };
+
+	static inline vec add(vec a, vec b) { return _mm_add_epi32(a, b); }
+	static inline vec xorv(vec a, vec b) { return _mm_xor_si128(a, b); }
+	static inline vec rotl(vec a, int n) { return _mm_or_si128(_mm_slli_epi32(a, n), _mm_srli_epi32(a, 32 - n)); }
+
+	/* X[k] ^= V[j_l][k] for every lane l, where V is stored with the same interleaving as X. */
+	static inline void xor_v(vec *X, const vec *V)
+	{
+		uint32_t *x = (uint32_t *)X;
+		const uint32_t *v = (const uint32_t *)V;
+		for (int l = 0; l < N; l++) {
+			const uint32_t *vl = &v[32 * N * (x[16 * N + l] & 1023) + l];
+			for (int k = 0; k < 32; k++)
+				x[k * N + l] ^= vl[k * N];
+		}
+	}
+};
+#endif
+
+#if defined(__AVX2__)
+struct avx2_lanes
+{
+	typedef __m256i vec;
+	enum { N = 8 };
+
+	static inline vec add(vec a, vec b) { return _mm256_add_epi32(a, b); }
+	static inline vec xorv(vec a, vec b) { return _mm256_xor_si256(a, b); }
+	static inline vec rotl(vec a, int n) { return _mm256_or_si256(_mm256_slli_epi32(a, n), _mm256_srli_epi32(a, 32 - n)); }
+
+	static inline void xor_v(vec *X, const vec *V)
+	{
+		const __m256i lane = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+		__m256i j = _mm256_and_si256(X[16], _mm256_set1_epi32(1023));
+		__m256i idx = _mm256_add_epi32(_mm256_slli_epi32(j, 8), lane); /* 32 * N * j + l */
+		const __m256i step = _mm256_set1_epi32(N);
+		for (int k = 0; k < 32; k++) {
+			X[k] = _mm256_xor_si256(X[k], _mm256_i32gather_epi32((const int *)V, idx, 4));
+			idx = _mm256_add_epi32(idx, step);
+		}
+	}
+};
+#endif
+
+#if defined(__SSE2__)
+#define LANE_QR(a, b, c, d) \
+	b = L::xorv(b, L::rotl(L::add(a, d),  7)); \
+	c = L::xorv(c, L::rotl(L::add(b, a),  9)); \
+	d = L::xorv(d, L::rotl(L::add(c, b), 13)); \
+	a = L::xorv(a, L::rotl(L::add(d, c), 18));
+
+template <class L>
+static inline void xor_salsa8_lanes(typename L::vec B[16], const typename L::vec Bx[16])
+{
+	typename L::vec x[16];
+	int i;
+
+	for (i = 0; i < 16; i++)
+		x[i] = B[i] = L::xorv(B[i], Bx[i]);
+	for (i = 0; i < 8; i += 2) {
+		/* Operate on columns. */
+		LANE_QR(x[ 0], x[ 4], x[ 8], x[12]);
+		LANE_QR(x[ 5], x[ 9], x[13], x[ 1]);
+		LANE_QR(x[10], x[14], x[ 2], x[ 6]);
+		LANE_QR(x[15], x[ 3], x[ 7], x[11]);
+
+		/* Operate on rows. */
+		LANE_QR(x[ 0], x[ 1], x[ 2], x[ 3]);
+		LANE_QR(x[ 5], x[ 6], x[ 7], x[ 4]);
+		LANE_QR(x[10], x[11], x[ 8], x[ 9]);
+		LANE_QR(x[15], x[12], x[13], x[14]);
+	}
+	for (i = 0; i < 16; i++)
+		B[i] = L::add(B[i], x[i]);
+}
+
+#undef LANE_QR
+
+/* Hashes L::N consecutive 80 byte inputs. V must hold 1024 * 32 vectors and be suitably aligned. */
+template <class L>
+static void scrypt_1024_1_1_256_lanes(const char *input, char *output, typename L::vec *V)
+{
+	typename L::vec X[32];
+	uint32_t *x = (uint32_t *)X;
+	uint8_t B[128];
+	uint32_t i;
+	int k, l;
+
+	for (l = 0; l < L::N; l++) {
+		PBKDF2_SHA256((const uint8_t *)&input[80 * l], 80, (const uint8_t *)&input[80 * l], 80, 1, B, 128);
+		for (k = 0; k < 32; k++)
+			x[k * L::N + l] = le32dec(&B[4 * k]);
+	}
+
+	for (i = 0; i < 1024; i++) {
+		memcpy(&V[i * 32], X, sizeof(X));
+		xor_salsa8_lanes<L>(&X[0], &X[16]);
+		xor_salsa8_lanes<L>(&X[16], &X[0]);
+	}
+	for (i = 0; i < 1024; i++) {
+		L::xor_v(X, V);
+		xor_salsa8_lanes<L>(&X[0], &X[16]);
+		xor_salsa8_lanes<L>(&X[16], &X[0]);
+	}
+
+	for (l = 0; l < L::N; l++) {
+		for (k = 0; k < 32; k++)
+			le32enc(&B[4 * k], x[k * L::N + l]);
+		PBKDF2_SHA256((const uint8_t *)&input[80 * l], 80, B, 128, 1, (uint8_t *)&output[32 * l], 32);
+	}
+}
+#endif
+
+void scrypt_1024_1_1_256_batch_(const char *input, char *output, size_t count)
+{
+	size_t i = 0;
+
+#if defined(__SSE2__)
+#if defined(__AVX2__)
+	const size_t lanes = avx2_lanes::N;
+#else
+	const size_t lanes = sse2_lanes::N;
+#endif
+	if (count >= sse2_lanes::N) {
+		void *V0 = malloc(128 * 1024 * lanes + 63);
+		if (V0 != NULL) {
+			void *V = (void *)(((uintptr_t)(V0) + 63) & ~(uintptr_t)(63));
+#if defined(__AVX2__)
+			for (; i + avx2_lanes::N <= count; i += avx2_lanes::N)
+				scrypt_1024_1_1_256_lanes<avx2_lanes>(&input[80 * i], &output[32 * i], (avx2_lanes::vec *)V);
+#endif
+			for (; i + sse2_lanes::N <= count; i += sse2_lanes::N)
+				scrypt_1024_1_1_256_lanes<sse2_lanes>(&input[80 * i], &output[32 * i], (sse2_lanes::vec *)V);
+			free(V0);
+		}
+	}
+#endif
+
+	for (; i < count; i++)
+		scrypt_1024_1_1_256_(&input[80 * i], &output[32 * i]);
+}
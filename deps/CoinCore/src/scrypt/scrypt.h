@@ -7,12 +7,21 @@ static const int SCRYPT_SCRATCHPAD_SIZE = 131072 + 63;
 void scrypt_1024_1_1_256_(const char *input, char *output);
 void scrypt_1024_1_1_256_sp_generic(const char *input, char *output, char *scratchpad);
 
+// Hashes count consecutive 80 byte inputs, writing count consecutive 32 byte hashes to output.
+// Inputs are processed several at a time in SIMD lanes when SSE2 or AVX2 is available.
+void scrypt_1024_1_1_256_batch_(const char *input, char *output, size_t count);
+
 #if defined(USE_SSE2)
 extern void scrypt_detect_sse2(unsigned int cpuid_edx);
 void scrypt_1024_1_1_256_sp_sse2(const char *input, char *output, char *scratchpad);
 extern void (*scrypt_1024_1_1_256_sp)(const char *input, char *output, char *scratchpad);
 #endif
 
+// scrypt key derivation with cost parameters N (a power of two), r and p. Writes buflen bytes to buf.
+// Returns 0 on success or -1 if the parameters are invalid or memory cannot be allocated.
+int scrypt(const uint8_t *passwd, size_t passwdlen, const uint8_t *salt, size_t saltlen,
+    uint64_t N, uint32_t r, uint32_t p, uint8_t *buf, size_t buflen);
+
 void
 PBKDF2_SHA256(const uint8_t *passwd, size_t passwdlen, const uint8_t *salt,
     size_t saltlen, uint64_t c, uint8_t *buf, size_t dkLen);
@@ -0,0 +1,253 @@
+// Matches every data push in every output script of the given blocks against a filter
+// of vault-sized script elements and reports the time per element for each match path.
+//
+// Usage: bloomfilter [block file ...]
+//
+// Each block file holds one raw block in hex, e.g. the output of "bitcoin-cli getblock <hash> false".
+// Without arguments a synthetic block of 4000 transactions with two outputs each is used.
+//
+// Before timing, it checks BloomFilter against the BIP37 serialization vectors and checks that
+// neither filter, nor a copy of the blocked one, misses an element that was inserted.
+
+#include <BloomFilter.h>
+#include <CoinNodeData.h>
+
+#include <iostream>
+#include <fstream>
+#include <iomanip>
+#include <chrono>
+#include <random>
+#include <memory>
+
+using namespace Coin;
+using namespace std;
+
+const uint32_t FILTER_ELEMENTS = 20000;
+const double FALSE_POSITIVE_RATE = 0.001;
+
+struct Element
+{
+    const unsigned char* data;
+    size_t len;
+};
+
+// Appends the data pushes of script to elements. The pointers refer into script.
+void getPushes(const uchar_vector& script, vector<Element>& elements)
+{
+    size_t pos = 0;
+    while (pos < script.size()) {
+        unsigned char opcode = script[pos++];
+        size_t len;
+        if (opcode >= 0x01 && opcode <= 0x4b) {
+            len = opcode;
+        }
+        else if (opcode == 0x4c && pos + 1 <= script.size()) {
+            len = script[pos]; pos += 1;
+        }
+        else if (opcode == 0x4d && pos + 2 <= script.size()) {
+            len = script[pos] | (script[pos + 1] << 8); pos += 2;
+        }
+        else if (opcode == 0x4e && pos + 4 <= script.size()) {
+            len = script[pos] | (script[pos + 1] << 8) | (script[pos + 2] << 16) | ((size_t)script[pos + 3] << 24); pos += 4;
+        }
+        else {
+            continue;
+        }
+
+        if (pos + len > script.size()) return;
+        elements.push_back(Element { &script[pos], len });
+        pos += len;
+    }
+}
+
+uchar_vector randomBytes(mt19937& rng, size_t len)
+{
+    uchar_vector bytes(len);
+    for (auto& byte: bytes) { byte = rng(); }
+    return bytes;
+}
+
+vector<CoinBlock> syntheticBlocks(mt19937& rng)
+{
+    CoinBlock block;
+    for (unsigned int i = 0; i < 4000; i++) {
+        Transaction tx;
+        tx.outputs.push_back(TxOut(100000, uchar_vector("76a914") + randomBytes(rng, 20) + uchar_vector("88ac")));
+        tx.outputs.push_back(TxOut(200000, uchar_vector("a914") + randomBytes(rng, 20) + uchar_vector("87")));
+        block.txs.push_back(tx);
+    }
+    return vector<CoinBlock>(1, block);
+}
+
+// The filters from bloom_tests.cpp in Bitcoin Core, which peers must be able to load.
+void checkBip37Vectors()
+{
+    struct Vector { uint32_t nTweak; const char* serialized; };
+    const Vector vectors[] = {
+        { 0, "03614e9b050000000000000001" },
+        { 2147483649UL, "03ce4299050000000100008001" }
+    };
+
+    for (auto& vector: vectors) {
+        BloomFilter filter(3, 0.01, vector.nTweak, 1);
+        filter.insert(uchar_vector("99108ad8ed9bb6274d3980bab5a85c048f0950c8"));
+        if (!filter.match(uchar_vector("99108ad8ed9bb6274d3980bab5a85c048f0950c8"))) throw runtime_error("BloomFilter misses an inserted element.");
+        if (vector.nTweak == 0 && filter.match(uchar_vector("19108ad8ed9bb6274d3980bab5a85c048f0950c8"))) throw runtime_error("BloomFilter matches an element differing in one bit.");
+        filter.insert(uchar_vector("b5a2c786d9ef4658287ced5914b37a1b4aa32eee"));
+        filter.insert(uchar_vector("b9300670b4c5366e95b2699e8b18bc75e5f729c5"));
+
+        FilterLoadMessage filterLoad(filter.getNHashFuncs(), filter.getNTweak(), filter.getNFlags(), filter.getFilter());
+        if (filterLoad.getSerialized().getHex() != vector.serialized) throw runtime_error("BloomFilter serialization differs from BIP37.");
+    }
+}
+
+// Every inserted element must match, in the original filters and in copies of the blocked one.
+void checkNoFalseNegatives(mt19937& rng)
+{
+    vector<uchar_vector> inserted;
+    for (unsigned int i = 0; i < FILTER_ELEMENTS; i++) { inserted.push_back(randomBytes(rng, 1 + i % 40)); }
+
+    BloomFilter bloomFilter(FILTER_ELEMENTS, FALSE_POSITIVE_RATE, 0, 0);
+    BlockedBloomFilter blockedFilter(FILTER_ELEMENTS, FALSE_POSITIVE_RATE, 0);
+    for (auto& element: inserted) {
+        bloomFilter.insert(element);
+        blockedFilter.insert(element);
+    }
+
+    // Copies are made while other allocations shift the heap, so some start at another offset from a cache line.
+    vector<BlockedBloomFilter> copies;
+    vector<unique_ptr<char[]>> padding;
+    for (unsigned int i = 0; i < 8; i++) {
+        padding.push_back(unique_ptr<char[]>(new char[8 * i + 8]));
+        copies.push_back(blockedFilter);
+    }
+    BlockedBloomFilter assigned;
+    assigned = copies.back();
+    copies.push_back(assigned);
+
+    vector<const unsigned char*> data;
+    vector<size_t> lengths;
+    for (auto& element: inserted) {
+        data.push_back(element.data());
+        lengths.push_back(element.size());
+    }
+    unique_ptr<bool[]> results(new bool[inserted.size()]);
+
+    for (size_t i = 0; i < inserted.size(); i++) {
+        if (!bloomFilter.match(inserted[i])) throw runtime_error("BloomFilter misses an inserted element.");
+        if (!blockedFilter.match(inserted[i])) throw runtime_error("BlockedBloomFilter misses an inserted element.");
+    }
+    for (auto& copy: copies) {
+        copy.match(inserted.size(), &data[0], &lengths[0], results.get());
+        for (size_t i = 0; i < inserted.size(); i++) {
+            if (!copy.match(inserted[i]) || !results[i]) throw runtime_error("Copied BlockedBloomFilter misses an inserted element.");
+        }
+    }
+}
+
+template<typename Function>
+double nsPerElement(size_t nElements, unsigned int iterations, Function f)
+{
+    auto start = chrono::high_resolution_clock::now();
+    for (unsigned int i = 0; i < iterations; i++) { f(); }
+    auto end = chrono::high_resolution_clock::now();
+    return chrono::duration<double, nano>(end - start).count() / (iterations * nElements);
+}
+
+int main(int argc, char* argv[])
+{
+    try {
+        mt19937 rng(0);
+
+        checkBip37Vectors();
+        checkNoFalseNegatives(rng);
+
+        vector<CoinBlock> blocks;
+        if (argc > 1) {
+            for (int i = 1; i < argc; i++) {
+                ifstream fs(argv[i]);
+                string hex;
+                fs >> hex;
+                if (!fs) throw runtime_error(string("Could not read ") + argv[i]);
+                blocks.push_back(CoinBlock(hex));
+            }
+        }
+        else {
+            blocks = syntheticBlocks(rng);
+        }
+
+        vector<Element> elements;
+        for (auto& block: blocks) {
+            for (auto& tx: block.txs) {
+                for (auto& txOut: tx.outputs) { getPushes(txOut.scriptPubKey, elements); }
+            }
+        }
+        if (elements.empty()) throw runtime_error("No script elements found.");
+
+        BloomFilter bloomFilter(FILTER_ELEMENTS, FALSE_POSITIVE_RATE, 0, 0);
+        BlockedBloomFilter blockedFilter(FILTER_ELEMENTS, FALSE_POSITIVE_RATE, 0);
+
+        // Fill the filters like a vault would, with a few elements that appear in the blocks
+        for (unsigned int i = 0; i < FILTER_ELEMENTS; i++) {
+            uchar_vector element = (i % 1000 == 0) ? uchar_vector(elements[i % elements.size()].data, elements[i % elements.size()].len) : randomBytes(rng, 20);
+            bloomFilter.insert(element);
+            blockedFilter.insert(element);
+        }
+
+        vector<uchar_vector> copies;
+        vector<const unsigned char*> data;
+        vector<size_t> lengths;
+        for (auto& element: elements) {
+            copies.push_back(uchar_vector(element.data, element.len));
+            data.push_back(element.data);
+            lengths.push_back(element.len);
+        }
+
+        // The blocked filter may only give different answers on false positives
+        unsigned long bloomMatches = 0, blockedMatches = 0;
+        unique_ptr<bool[]> results(new bool[elements.size()]);
+        blockedFilter.match(elements.size(), &data[0], &lengths[0], results.get());
+        for (size_t i = 0; i < elements.size(); i++) {
+            bool bloomMatch = bloomFilter.match(copies[i]);
+            if (bloomMatch != bloomFilter.match(data[i], lengths[i])) throw runtime_error("BloomFilter pointer match differs.");
+            if (results[i] != blockedFilter.match(data[i], lengths[i])) throw runtime_error("BlockedBloomFilter batch match differs.");
+            bloomMatches += bloomMatch;
+            blockedMatches += blockedFilter.match(data[i], lengths[i]);
+        }
+
+        unsigned int iterations = 20;
+        size_t n = elements.size();
+        volatile bool sink = false;
+
+        double copyTime = nsPerElement(n, iterations, [&]() {
+            for (size_t i = 0; i < n; i++) { sink ^= bloomFilter.match(uchar_vector(data[i], lengths[i])); }
+        });
+        double pointerTime = nsPerElement(n, iterations, [&]() {
+            for (size_t i = 0; i < n; i++) { sink ^= bloomFilter.match(data[i], lengths[i]); }
+        });
+        double blockedTime = nsPerElement(n, iterations, [&]() {
+            for (size_t i = 0; i < n; i++) { sink ^= blockedFilter.match(data[i], lengths[i]); }
+        });
+        double batchTime = nsPerElement(n, iterations, [&]() {
+            blockedFilter.match(n, &data[0], &lengths[0], results.get());
+            sink ^= results[0];
+        });
+
+        cout << "blocks:   " << blocks.size() << endl
+             << "elements: " << n << endl
+             << "BloomFilter:        " << bloomFilter.getFilter().size() << " bytes, " << bloomFilter.getNHashFuncs() << " hash funcs, " << bloomMatches << " matches" << endl
+             << "BlockedBloomFilter: " << blockedFilter.getSize() << " bytes, " << blockedFilter.getNHashFuncs() << " hash funcs, " << blockedMatches << " matches" << endl
+             << endl
+             << fixed << setprecision(1)
+             << setw(40) << left << "BloomFilter::match(uchar_vector copy)" << setw(8) << right << copyTime << " ns/element" << endl
+             << setw(40) << left << "BloomFilter::match(pointer)" << setw(8) << right << pointerTime << " ns/element" << endl
+             << setw(40) << left << "BlockedBloomFilter::match(pointer)" << setw(8) << right << blockedTime << " ns/element" << endl
+             << setw(40) << left << "BlockedBloomFilter::match(batch)" << setw(8) << right << batchTime << " ns/element" << endl;
+
+        return 0;
+    }
+    catch (const exception& e) {
+        cout << "Exception: " << e.what() << endl;
+        return 1;
+    }
+}
@@ -0,0 +1,81 @@
+// Checks the batch proof of work hash functions against the single header versions
+// and reports headers per second for each.
+//
+// Usage: hashbatch [header count = 2016] [threads = 0 (all cores)]
+
+#include <hashbatch.h>
+#include <hash.h>
+
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <cstdlib>
+
+using namespace std;
+
+struct PowFunction
+{
+    const char* name;
+    uchar_vector (*single)(const uchar_vector&);
+    batch_hashfunc_t batch;
+};
+
+template<typename Fn>
+double timeIt(Fn fn)
+{
+    auto start = chrono::steady_clock::now();
+    fn();
+    return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, char* argv[])
+{
+    size_t count = argc > 1 ? strtoul(argv[1], NULL, 0) : 2016;
+    unsigned int nThreads = argc > 2 ? strtoul(argv[2], NULL, 0) : 0;
+    if (count == 0) {
+        cerr << "Header count must be positive." << endl;
+        return 1;
+    }
+
+    // Headers that differ only in the nonce, like a miner would produce.
+    uchar_vector header("0100000000000000000000000000000000000000000000000000000000000000000000003ba3edfd7a7b12b27ac72c3e67768f617fc81bc3888a51323a9fb8aa4b1e5e4a29ab5f49ffff001d1dac2b7c");
+    uchar_vector input;
+    for (size_t i = 0; i < count; i++) {
+        header[76] = i & 0xff; header[77] = (i >> 8) & 0xff; header[78] = (i >> 16) & 0xff;
+        input += header;
+    }
+
+    PowFunction functions[] = {
+        { "sha256_2",               &sha256_2,              &sha256_2_batch },
+        { "scrypt_1024_1_1_256",    &scrypt_1024_1_1_256,   &scrypt_1024_1_1_256_batch },
+        { "hash9",                  &hash9,                 &hash9_batch }
+    };
+
+    int rval = 0;
+    for (auto& function: functions) {
+        vector<uchar_vector> expected(count);
+        double tSingle = timeIt([&]() {
+            for (size_t i = 0; i < count; i++) {
+                expected[i] = function.single(uchar_vector(input.begin() + i * 80, input.begin() + (i + 1) * 80));
+            }
+        });
+
+        uchar_vector serial(count * 32), parallel(count * 32);
+        double tBatch = timeIt([&]() { function.batch(&input[0], &serial[0], count); });
+        double tParallel = timeIt([&]() { parallel_hash_batch(function.batch, &input[0], &parallel[0], count, nThreads); });
+
+        bool bMatch = (serial == parallel);
+        for (size_t i = 0; bMatch && i < count; i++) {
+            bMatch = (uchar_vector(serial.begin() + i * 32, serial.begin() + (i + 1) * 32) == expected[i]);
+        }
+        if (!bMatch) rval = 1;
+
+        cout << setw(20) << left << function.name << (bMatch ? " ok  " : " FAIL")
+             << fixed << setprecision(0)
+             << "  single: " << setw(10) << right << count / tSingle << " h/s"
+             << "  batch: " << setw(10) << count / tBatch << " h/s"
+             << "  parallel: " << setw(10) << count / tParallel << " h/s" << endl;
+    }
+
+    return rval;
+}
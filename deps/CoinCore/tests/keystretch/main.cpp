@@ -0,0 +1,112 @@
+// Checks scrypt against the test vectors in RFC 7914, section 12, and the key stretching
+// built on it: salts carrying their parameters, the stretched key cache, and AES keys
+// derived by stretching.
+//
+// Usage: keystretch
+
+#include <keystretch.h>
+#include <aes.h>
+#include <scrypt/scrypt.h>
+
+#include <iostream>
+#include <string>
+
+using namespace Coin;
+using namespace std;
+
+struct ScryptVector
+{
+    const char* password;
+    const char* salt;
+    uint64_t N;
+    uint32_t r;
+    uint32_t p;
+    const char* derived;
+};
+
+// The last vector in the RFC, with N = 2^20, is left out since it needs 1 GiB.
+const ScryptVector SCRYPT_VECTORS[] = {
+    { "", "", 16, 1, 1,
+      "77d6576238657b203b19ca42c18a0497f16b4844e3074ae8dfdffa3fede21442fcd0069ded0948f8326a753a0fc81f17e8d3e0fb2e0d3628cf35e20c38d18906" },
+    { "password", "NaCl", 1024, 8, 16,
+      "fdbabe1c9d3472007856e7190d01e9fe7c6ad7cbc8237830e77376634b3731622eaf30d92e22a3886ff109279d9830dac727afb94a83ee6d8360cbdfa2cc0640" },
+    { "pleaseletmein", "SodiumChloride", 16384, 8, 1,
+      "7023bdcb3afd7348461c06cd81fd38ebfda8fbba904f8e3ea9b543f6545da1f2d5432955613f0fcf62d49705242a9af9e61e85dc0d651e40dfcf017b45575887" }
+};
+
+static bool g_ok = true;
+
+static void check(bool condition, const string& what)
+{
+    if (condition) return;
+    cout << "FAILED: " << what << endl;
+    g_ok = false;
+}
+
+static secure_bytes_t toKey(const string& s)
+{
+    return secure_bytes_t(s.begin(), s.end());
+}
+
+int main()
+{
+    for (auto& v: SCRYPT_VECTORS)
+    {
+        uchar_vector derived(64);
+        string password(v.password);
+        string salt(v.salt);
+        int rval = scrypt((const unsigned char*)password.data(), password.size(), (const unsigned char*)salt.data(), salt.size(), v.N, v.r, v.p, &derived[0], derived.size());
+        check(rval == 0 && derived.getHex() == v.derived, string("scrypt matches RFC 7914 for \"") + v.password + "\"");
+    }
+
+    // Salts carry their parameters.
+    ScryptParams params(MIN_STRETCH_LOG2N, 8, 1);
+    bytes_t salt = makeStretchSalt(params);
+    check(isStretchSalt(salt), "made salt is a stretch salt");
+    check(getStretchParams(salt).log2N == params.log2N && getStretchParams(salt).r == params.r && getStretchParams(salt).p == params.p, "salt parameters round trip");
+    check(!isStretchSalt(bytes_t(1, 0x01)), "legacy salt is not a stretch salt");
+
+    bytes_t badSalt = salt;
+    badSalt[1] = MAX_STRETCH_LOG2N + 1;
+    bool bThrew = false;
+    try { getStretchParams(badSalt); } catch (const exception&) { bThrew = true; }
+    check(bThrew, "salt with too large a cost is rejected");
+
+    secure_bytes_t key = toKey("correct horse battery staple");
+    secure_bytes_t stretched = stretchKey(key, salt);
+    uchar_vector expected(32);
+    scrypt(key.data(), key.size(), salt.data(), salt.size(), params.N(), params.r, params.p, &expected[0], expected.size());
+    check(stretched == expected, "stretchKey is scrypt over the whole salt");
+    check(stretchKey(key, makeStretchSalt(params)) != stretched, "a fresh salt gives a different key");
+
+    // The cache only holds what is inserted and forgets it by salt.
+    StretchedKeyCache cache;
+    secure_bytes_t found;
+    check(!cache.find(key, salt, found) && found.empty(), "empty cache finds nothing");
+    cache.insert(key, salt, stretched);
+    check(cache.find(key, salt, found) && found == stretched, "cache finds an inserted key");
+    check(!cache.find(toKey("wrong"), salt, found), "cache does not match another key");
+    bytes_t otherSalt = makeStretchSalt(params);
+    cache.insert(key, otherSalt, stretchKey(key, otherSalt));
+    check(cache.size() == 2, "cache holds one key per salt");
+    cache.erase(salt);
+    check(cache.size() == 1 && !cache.find(key, salt, found) && cache.find(key, otherSalt, found), "erase forgets only that salt");
+    cache.clear();
+    check(cache.size() == 0, "clear forgets everything");
+
+    // A secret locked with a stretched key only unlocks with the same key.
+    uchar_vector secret("e8f32e723decf4051aefac8e2c93c9c5b214313817cdb01a1494b917c8436b35");
+    uchar_vector ciphertext = aes_encrypt(stretched, secret, 0);
+    check(ciphertext != secret, "secret is encrypted");
+    check(aes_decrypt(stretchKey(key, salt), ciphertext, 0) == secret, "secret decrypts with the stretched key");
+
+    bool bDecrypted;
+    try { bDecrypted = aes_decrypt(stretchKey(toKey("wrong"), salt), ciphertext, 0) == secret; } catch (const exception&) { bDecrypted = false; }
+    check(!bDecrypted, "secret does not decrypt with another key");
+
+    wipeKey(stretched);
+    check(stretched.empty(), "wiped key is empty");
+
+    cout << (g_ok ? "All keystretch checks passed." : "Some keystretch checks failed.") << endl;
+    return g_ok ? 0 : 1;
+}
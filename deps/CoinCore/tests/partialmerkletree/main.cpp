@@ -1,10 +1,69 @@
 #include <MerkleTree.h>
 
 #include <iostream>
+#include <iomanip>
+#include <chrono>
 
 using namespace Coin;
 using namespace std;
 
+// Runs f iterations times and returns the average duration in microseconds
+template<typename Function>
+double timeIt(unsigned int iterations, Function f)
+{
+    auto start = chrono::high_resolution_clock::now();
+    for (unsigned int i = 0; i < iterations; i++) { f(); }
+    auto end = chrono::high_resolution_clock::now();
+    return chrono::duration<double, micro>(end - start).count() / iterations;
+}
+
+// Builds blocks of various sizes with a few matched transactions, checks that all code paths
+// agree on the merkle root and reports timings for each of them.
+void benchmark()
+{
+    const unsigned int sizes[] = { 1, 2, 3, 7, 16, 100, 257, 500, 1000, 2000, 4000 };
+
+    cout << setw(8) << "nTxs" << setw(8) << "hashes"
+         << setw(16) << "getRoot (us)" << setw(20) << "setCompressed (us)" << setw(22) << "verifyCompressed (us)" << endl;
+
+    for (auto nTxs: sizes) {
+        MerkleTree merkleTree;
+        vector<PartialMerkleTree::MerkleLeaf> leaves;
+        for (unsigned int i = 0; i < nTxs; i++) {
+            uchar_vector hash = sha256_2(uchar_vector((unsigned char*)&i, sizeof(i)));
+            merkleTree.addHash(hash);
+            leaves.push_back(make_pair(hash, i % 97 == 0 || i == nTxs - 1));
+        }
+
+        PartialMerkleTree tree(leaves);
+        vector<uchar_vector> hashes = tree.getMerkleHashesVector();
+        uchar_vector flags = tree.getFlags();
+        uchar_vector root = merkleTree.getRootLittleEndian();
+
+        if (tree.getRootLittleEndian() != root) throw runtime_error("setUncompressed root mismatch.");
+
+        vector<uchar_vector> txHashes;
+        if (!PartialMerkleTree::verifyCompressed(nTxs, hashes, flags, root, &txHashes)) throw runtime_error("verifyCompressed failed.");
+        if (txHashes != tree.getTxHashesVector()) throw runtime_error("verifyCompressed tx hash mismatch.");
+
+        PartialMerkleTree tree2(nTxs, hashes, flags, root);
+        if (tree2.getTxHashesVector() != txHashes) throw runtime_error("setCompressed tx hash mismatch.");
+
+        // A corrupted hash must be rejected
+        hashes.back()[0] ^= 0x01;
+        if (PartialMerkleTree::verifyCompressed(nTxs, hashes, flags, root)) throw runtime_error("verifyCompressed accepted a corrupted hash.");
+        hashes.back()[0] ^= 0x01;
+
+        unsigned int iterations = 200000 / nTxs + 10;
+        double getRootTime = timeIt(iterations, [&]() { merkleTree.getRoot(); });
+        double setCompressedTime = timeIt(iterations, [&]() { PartialMerkleTree(nTxs, hashes, flags, root); });
+        double verifyTime = timeIt(iterations, [&]() { PartialMerkleTree::verifyCompressed(nTxs, hashes, flags, root); });
+
+        cout << setw(8) << nTxs << setw(8) << hashes.size()
+             << setw(16) << fixed << setprecision(2) << getRootTime << setw(20) << setCompressedTime << setw(22) << verifyTime << endl;
+    }
+}
+
 int main()
 {
     try {
@@ -57,6 +116,9 @@ int main()
 
         cout << tree2.toIndentedString() << endl;
 
+        cout << "benchmark..." << endl;
+        benchmark();
+
         return 0;
     }
     catch (const exception& e) {
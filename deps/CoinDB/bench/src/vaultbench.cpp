@@ -0,0 +1,161 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// vaultbench.cpp
+//
+// Copyright (c) 2014 Eric Lombrozo
+//
+// All Rights Reserved.
+//
+// Benchmarks for the vault operations on the sync and wallet paths, over a
+// synthetic vault built from a fixed seed. A 1 of 1 account is funded by
+// txs paying its scripts, which are then confirmed by merkle blocks the way
+// they arrive from a peer. The vault file is replaced on each run.
+//
+// Usage: vaultbench [--repeat=n] [--filter=name] [--out=file]
+//                   [--txs=n] [--scripts=n] [--txs_per_block=n] [--queries=n]
+//
+
+#include <Vault.h>
+
+#include <CoinCore/CoinNodeData.h>
+#include <CoinCore/MerkleTree.h>
+
+#include <stdutils/benchutils.h>
+
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <stdexcept>
+
+using namespace CoinDB;
+using namespace std;
+
+const char* VAULT_FILE = "vaultbench.db";
+const uint32_t FIRST_BLOCK_TIMESTAMP = 1400000000;
+
+static double secondsSince(chrono::steady_clock::time_point start)
+{
+    return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+// Splits count operations into one timed chunk per repeat.
+template<typename Fn>
+static vector<double> timeChunks(uint64_t count, int repeat, Fn fn)
+{
+    vector<double> seconds;
+    uint64_t chunk = max<uint64_t>(1, count / repeat);
+    for (uint64_t begin = 0; begin + chunk <= count; begin += chunk)
+    {
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+        for (uint64_t i = begin; i < begin + chunk; i++) { fn(i); }
+        seconds.push_back(secondsSince(start));
+    }
+    return seconds;
+}
+
+int main(int argc, char* argv[])
+{
+    try
+    {
+        stdutils::bench_runner bench("vaultbench", argc, argv);
+        const uint64_t txCount = bench.param("txs", 2000);
+        const uint64_t scriptCount = bench.param("scripts", 200);
+        const uint64_t txsPerBlock = max<uint64_t>(1, bench.param("txs_per_block", 10));
+        const uint64_t queries = bench.param("queries", 10);
+        const uint64_t chunk = max<uint64_t>(1, txCount / bench.repeat());
+        const uint64_t spendInputs = max<uint64_t>(1, min<uint64_t>(txCount / 2, 100));
+
+        stdutils::bench_random rng;
+
+        remove(VAULT_FILE);
+        Vault vault(VAULT_FILE, true);
+        vault.newKeychain("bench", rng.bytes<secure_bytes_t>(32));
+        vault.unlockChainCodes(secure_bytes_t());
+        vault.newAccount("bench", 1, vector<string>(1, "bench"));
+
+        vector<bytes_t> scripts;
+        for (uint64_t i = 0; i < scriptCount; i++) { scripts.push_back(vault.issueSigningScript("bench")->txoutscript()); }
+
+        // Funding txs, each spending an outpoint from outside the vault
+        vector<Coin::Transaction> coinTxs;
+        for (uint64_t i = 0; i < txCount; i++)
+        {
+            Coin::Transaction coinTx;
+            coinTx.addInput(Coin::TxIn(Coin::OutPoint(rng.bytes<uchar_vector>(32), 0), rng.bytes<uchar_vector>(107), 0xffffffff));
+            coinTx.addOutput(Coin::TxOut(100000 + i, scripts[i % scripts.size()]));
+            coinTx.addOutput(Coin::TxOut(5000000, uchar_vector("76a914") + rng.bytes<uchar_vector>(20) + uchar_vector("88ac")));
+            coinTxs.push_back(coinTx);
+        }
+
+        bench.record("Vault::insertTx", chunk, timeChunks(txCount, bench.repeat(), [&](uint64_t i)
+        {
+            std::shared_ptr<Tx> tx(new Tx());
+            tx->set(coinTxs[i], FIRST_BLOCK_TIMESTAMP + 600 * (1 + i / txsPerBlock));
+            if (!vault.insertTx(tx)) throw runtime_error("Funding tx was not inserted.");
+        }));
+
+        // Merkle blocks confirming txsPerBlock funding txs each, among as many unrelated txs,
+        // after a horizon block that confirms nothing.
+        vector<std::shared_ptr<MerkleBlock>> merkleblocks;
+        uchar_vector prevHash(32, 0);
+        for (uint64_t height = 1; height <= 1 + (txCount + txsPerBlock - 1) / txsPerBlock; height++)
+        {
+            vector<Coin::PartialMerkleTree::MerkleLeaf> leaves;
+            if (height > 1)
+            {
+                for (uint64_t i = (height - 2) * txsPerBlock; i < min(txCount, (height - 1) * txsPerBlock); i++)
+                {
+                    leaves.push_back(make_pair(coinTxs[i].getHash(), true));
+                    leaves.push_back(make_pair(rng.bytes<uchar_vector>(32), false));
+                }
+            }
+            else
+            {
+                leaves.push_back(make_pair(rng.bytes<uchar_vector>(32), false));
+            }
+
+            Coin::PartialMerkleTree tree(leaves);
+            Coin::CoinBlockHeader header(2, prevHash, tree.getRootLittleEndian(), FIRST_BLOCK_TIMESTAMP + 600 * height, 0x1d00ffff, (uint32_t)height);
+            prevHash = header.getHashLittleEndian();
+
+            std::shared_ptr<MerkleBlock> merkleblock(new MerkleBlock());
+            merkleblock->fromCoinCore(Coin::MerkleBlock(header, leaves.size(), tree.getMerkleHashesVector(), tree.getFlags()), (uint32_t)height);
+            merkleblocks.push_back(merkleblock);
+        }
+
+        if (!vault.insertMerkleBlock(merkleblocks[0])) throw runtime_error("Horizon block was not inserted.");
+        const uint64_t blockCount = merkleblocks.size() - 1;
+        bench.record("Vault::insertMerkleBlock", max<uint64_t>(1, blockCount / bench.repeat()), timeChunks(blockCount, bench.repeat(), [&](uint64_t i)
+        {
+            if (!vault.insertMerkleBlock(merkleblocks[i + 1])) throw runtime_error("Merkle block was not inserted.");
+        }));
+
+        bench.run("Vault::getTxOutViews", queries, [&]()
+        {
+            for (uint64_t i = 0; i < queries; i++)
+            {
+                vector<TxOutView> views = vault.getTxOutViews("bench");
+                stdutils::do_not_optimize(views);
+            }
+        });
+
+        // Not inserted, so each call selects about spendInputs of the same unspent outputs.
+        bench.run("Vault::createTx", queries, [&]()
+        {
+            for (uint64_t i = 0; i < queries; i++)
+            {
+                txouts_t txouts;
+                txouts.push_back(std::shared_ptr<TxOut>(new TxOut(100000 * spendInputs, uchar_vector("76a914") + rng.bytes<uchar_vector>(20) + uchar_vector("88ac"))));
+                std::shared_ptr<Tx> tx = vault.createTx("bench", 1, 0, txouts, 10000, 1, false);
+                stdutils::do_not_optimize(tx);
+            }
+        });
+
+        return bench.finish();
+    }
+    catch (const exception& e)
+    {
+        cerr << "Error: " << e.what() << endl;
+        return -1;
+    }
+}
@@ -7,6 +7,8 @@
 // All Rights Reserved.
 //
 
+#define LOGGER_SUBSYSTEM "vault"
+
 #include "Schema.h"
 
 #include <stdutils/stringutils.h>
@@ -20,8 +22,6 @@
 
 #include <logger/logger.h>
 
-//#define ENABLE_CRYPTO
-
 using namespace CoinDB;
 
 /*
@@ -125,12 +125,56 @@ std::shared_ptr<Keychain> Keychain::child(uint32_t i, bool get_private)
     }
 }
 
-bool Keychain::setPrivateKeyUnlockKey(const secure_bytes_t& lock_key, const bytes_t& /*salt*/)
+// Returns the AES key for a lock key and the salt stored with the ciphertext. The one-byte salt
+// 0x01 predates key stretching and means the lock key is used directly.
+static secure_bytes_t getAesKey(const secure_bytes_t& lock_key, const bytes_t& salt)
+{
+    if (!Coin::isStretchSalt(salt)) return lock_key;
+    return Coin::stretchKey(lock_key, salt);
+}
+
+// Decrypts a key locked with lock_key and salt, and checks it with isValid, since a wrong lock key
+// can still yield valid padding. Stretched keys are looked up in cache, and only added to it once
+// they have decrypted a valid key.
+template<typename IsValid>
+static bool decryptKey(const secure_bytes_t& lock_key, const bytes_t& salt, const bytes_t& ciphertext, secure_bytes_t& key, Coin::StretchedKeyCache* cache, IsValid isValid)
+{
+    if (lock_key.empty()) return false;
+
+    secure_bytes_t aes_key;
+    bool bCached = cache && Coin::isStretchSalt(salt) && cache->find(lock_key, salt, aes_key);
+    if (!bCached) { aes_key = getAesKey(lock_key, salt); }
+
+    secure_bytes_t decrypted;
+    try
+    {
+        decrypted = aes_decrypt(aes_key, ciphertext, 0);
+    }
+    catch (const std::exception&)
+    {
+        Coin::wipeKey(aes_key);
+        return false;
+    }
+
+    bool bValid = isValid(decrypted);
+    if (bValid && cache && !bCached && Coin::isStretchSalt(salt)) { cache->insert(lock_key, salt, aes_key); }
+    Coin::wipeKey(aes_key);
+    if (!bValid)
+    {
+        Coin::wipeKey(decrypted);
+        return false;
+    }
+
+    key = decrypted;
+    Coin::wipeKey(decrypted);
+    return true;
+}
+
+bool Keychain::setPrivateKeyUnlockKey(const secure_bytes_t& lock_key, const bytes_t& salt)
 {
     if (!isPrivate()) throw std::runtime_error("Cannot lock the private key of a public keychain.");
     if (privkey_.empty()) throw std::runtime_error("Key is locked.");
 
-#ifdef ENABLE_CRYPTO
     if (lock_key.empty())
     {
         privkey_ciphertext_ = privkey_;
@@ -138,24 +182,19 @@ bool Keychain::setPrivateKeyUnlockKey(const secure_bytes_t& lock_key, const byte
     }
     else
     {
-        // TODO: add real salt, better crypto function
-        privkey_ciphertext_ = aes_encrypt(lock_key, privkey_, 0);
-        privkey_salt_.clear();
-        privkey_salt_.push_back(1);
+        privkey_salt_ = salt.empty() ? Coin::makeStretchSalt() : salt;
+        secure_bytes_t aes_key = getAesKey(lock_key, privkey_salt_);
+        privkey_ciphertext_ = aes_encrypt(aes_key, privkey_, 0);
+        Coin::wipeKey(aes_key);
     }
-#else
-    privkey_ciphertext_ = privkey_;
-    privkey_salt_.clear();
-#endif
 
     return true;
 }
 
-bool Keychain::setChainCodeUnlockKey(const secure_bytes_t& lock_key, const bytes_t& /*salt*/)
+bool Keychain::setChainCodeUnlockKey(const secure_bytes_t& lock_key, const bytes_t& salt)
 {
     if (chain_code_.empty()) throw std::runtime_error("Chain code is locked.");
 
-#ifdef ENABLE_CRYPTO
     if (lock_key.empty())
     {
         chain_code_ciphertext_ = chain_code_;
@@ -163,15 +202,11 @@ bool Keychain::setChainCodeUnlockKey(const secure_bytes_t& lock_key, const bytes
     }
     else
     {
-        // TODO: add real salt, better crypto function
-        chain_code_ciphertext_ = aes_encrypt(lock_key, chain_code_, 0);
-        chain_code_salt_.clear();
-        chain_code_salt_.push_back(1);
+        chain_code_salt_ = salt.empty() ? Coin::makeStretchSalt() : salt;
+        secure_bytes_t aes_key = getAesKey(lock_key, chain_code_salt_);
+        chain_code_ciphertext_ = aes_encrypt(aes_key, chain_code_, 0);
+        Coin::wipeKey(aes_key);
     }
-#else
-    chain_code_ciphertext_ = chain_code_;
-    chain_code_salt_.clear();
-#endif
 
     return true;
 }
@@ -203,47 +238,52 @@ bool Keychain::isChainCodeLocked() const
     return chain_code_.empty();
 }
 
-bool Keychain::unlockPrivateKey(const secure_bytes_t& lock_key) const
+bool Keychain::unlockPrivateKey(const secure_bytes_t& lock_key, Coin::StretchedKeyCache* cache) const
 {
     if (!isPrivate()) throw std::runtime_error("Missing private key.");
     if (!privkey_.empty()) return true; // Already unlocked
 
-#ifdef ENABLE_CRYPTO
     if (privkey_salt_.empty())
     {
         privkey_ = privkey_ciphertext_;
+        return true;
     }
-    else
-    {
-        // TODO: add real salt, better crypto function
-        privkey_ = aes_decrypt(lock_key, privkey_ciphertext_, 0);
-    }
-#else
-    privkey_ = privkey_ciphertext_;
-#endif
 
-    return true;
+    // The private key must be the one for the stored public key.
+    return decryptKey(lock_key, privkey_salt_, privkey_ciphertext_, privkey_, cache, [&](const secure_bytes_t& privkey)
+    {
+        secure_bytes_t key = (privkey.size() > 32) ? secure_bytes_t(privkey.begin() + 1, privkey.end()) : privkey;
+        bool bValid;
+        try
+        {
+            bValid = Coin::HDKeychain(key, bytes_t(32, 0)).pubkey() == pubkey_;
+        }
+        catch (const std::exception&)
+        {
+            bValid = false;
+        }
+        Coin::wipeKey(key);
+        return bValid;
+    });
 }
 
-bool Keychain::unlockChainCode(const secure_bytes_t& lock_key) const
+bool Keychain::unlockChainCode(const secure_bytes_t& lock_key, Coin::StretchedKeyCache* cache) const
 {
     if (!chain_code_.empty()) return true; // Already unlocked
 
-#ifdef ENABLE_CRYPTO
     if (chain_code_salt_.empty())
     {
         chain_code_ = chain_code_ciphertext_;
+        return true;
     }
-    else
-    {
-        // TODO: add real salt, better crypto function
-        chain_code_ = aes_decrypt(lock_key, chain_code_ciphertext_, 0);
-    }
-#else
-    chain_code_ = chain_code_ciphertext_;
-#endif
 
-    return true;
+    // The keychain hash covers the chain code.
+    return decryptKey(lock_key, chain_code_salt_, chain_code_ciphertext_, chain_code_, cache, [&](const secure_bytes_t& chain_code)
+    {
+        uchar_vector_secure hashdata = pubkey_;
+        hashdata += chain_code;
+        return chain_code.size() == 32 && ripemd160(sha256(hashdata)) == hash_;
+    });
 }
 
 secure_bytes_t Keychain::getSigningPrivateKey(uint32_t i, const std::vector<uint32_t>& derivation_path) const
@@ -12,6 +12,7 @@
 #define COINDB_SCHEMA_H
 
 #include <CoinCore/CoinNodeData.h>
+#include <CoinCore/keystretch.h>
 
 #include <CoinQ/CoinQ_typedefs.h>
 #include <CoinQ/CoinQ_blocks.h>
@@ -45,7 +46,7 @@ typedef odb::nullable<unsigned long> null_id_t;
 ////////////////////
 
 #define SCHEMA_BASE_VERSION 4
-#define SCHEMA_VERSION      5
+#define SCHEMA_VERSION      6
 
 #ifdef ODB_COMPILER
 #pragma db model version(SCHEMA_BASE_VERSION, SCHEMA_VERSION, open)
@@ -107,7 +108,8 @@ public:
     bool isPrivate() const { return (!privkey_.empty()) || (!privkey_ciphertext_.empty()); }
     bool isEncrypted() const { return !privkey_salt_.empty(); }
 
-    // Lock keys must be set before persisting
+    // Lock keys must be set before persisting. An empty salt gets a fresh one with the default
+    // stretch parameters, and the AES key is then derived from the lock key with scrypt.
     bool setPrivateKeyUnlockKey(const secure_bytes_t& lock_key = secure_bytes_t(), const bytes_t& salt = bytes_t());
     bool setChainCodeUnlockKey(const secure_bytes_t& lock_key = secure_bytes_t(), const bytes_t& salt = bytes_t());
 
@@ -118,8 +120,10 @@ public:
     bool isPrivateKeyLocked() const;
     bool isChainCodeLocked() const;
 
-    bool unlockPrivateKey(const secure_bytes_t& lock_key) const;
-    bool unlockChainCode(const secure_bytes_t& lock_key) const;
+    // Return false if lock_key does not unlock the key. If cache is not null, stretched keys are
+    // looked up in it, and added to it once they have unlocked the key.
+    bool unlockPrivateKey(const secure_bytes_t& lock_key, Coin::StretchedKeyCache* cache = nullptr) const;
+    bool unlockChainCode(const secure_bytes_t& lock_key, Coin::StretchedKeyCache* cache = nullptr) const;
 
     secure_bytes_t getSigningPrivateKey(uint32_t i, const std::vector<uint32_t>& derivation_path = std::vector<uint32_t>()) const;
     bytes_t getSigningPublicKey(uint32_t i, const std::vector<uint32_t>& derivation_path = std::vector<uint32_t>()) const;
@@ -133,6 +137,7 @@ public:
 
     const bytes_t& chain_code_ciphertext() const { return chain_code_ciphertext_; }
     const bytes_t& chain_code_salt() const { return chain_code_salt_; }
+    const bytes_t& privkey_salt() const { return privkey_salt_; }
 
     void importPrivateKey(const Keychain& source);
 
@@ -984,7 +989,10 @@ private:
     bool have_fee_;
     uint64_t fee_;
 
+    // Indexed as Tx_blockheader_i since reorgs unconfirm txs by block. Vaults older than version 6 get
+    // the index when they are opened.
     #pragma db null
+    #pragma db index
     std::shared_ptr<BlockHeader> blockheader_;
 
     #pragma db null
@@ -1210,6 +1218,9 @@ struct TxOutView
         return split_views;
     }
 
+    #pragma db column(TxOut::id_)
+    unsigned long id;
+
     #pragma db column(sending_account::id_)
     unsigned long sending_account_id;
 
@@ -1357,6 +1368,25 @@ struct ConfirmedTxView
     uint32_t block_height;
 };
 
+// Enough to record confirmation changes made with set-based statements without loading txs.
+#pragma db view \
+    object(Tx) \
+    object(BlockHeader: Tx::blockheader_)
+struct TxConfirmationView
+{
+    #pragma db column(Tx::id_)
+    unsigned long tx_id;
+
+    #pragma db column(Tx::hash_)
+    bytes_t tx_hash;
+
+    #pragma db column(Tx::status_)
+    Tx::status_t tx_status;
+
+    #pragma db column(BlockHeader::id_)
+    unsigned long blockheader_id; // 0 if unconfirmed
+};
+
 }
 
 BOOST_CLASS_VERSION(CoinDB::TxIn, 1)
@@ -7,6 +7,8 @@
 // All Rights Reserved.
 //
 
+#define LOGGER_SUBSYSTEM "synchedvault"
+
 #include "SynchedVault.h"
 
 #include <logger/logger.h>
@@ -15,15 +17,17 @@ using namespace CoinDB;
 using namespace CoinQ;
 
 // Constructor
-SynchedVault::SynchedVault(const std::string& blockTreeFile) :
+SynchedVault::SynchedVault(const std::string& blockTreeFile, const CoinQ::CoinParams& coinParams) :
     m_vault(nullptr),
+    m_networkSync(coinParams),
     m_blockTreeFile(blockTreeFile),
     m_bConnected(false),
     m_bSynching(false),
     m_bBlockTreeSynched(false),
     m_bVaultSynched(false),
     m_bestHeight(0),
-    m_syncHeight(0)
+    m_syncHeight(0),
+    m_bForwardingTxStatusChanged(false)
 {
     LOGGER(trace) << "SynchedVault::SynchedVault()" << std::endl;
 
@@ -181,9 +185,11 @@ void SynchedVault::openVault(const std::string& filename, bool bCreate)
     if (m_vault) delete m_vault;
     m_vault = new Vault(filename, bCreate);
     m_networkSync.setBloomFilter(m_vault->getBloomFilter(0.001, 0, 0));
-    m_vault->subscribeTxInserted([this](std::shared_ptr<Tx> tx) { m_notifyTxInserted(tx); });
-    m_vault->subscribeTxStatusChanged([this](std::shared_ptr<Tx> tx) { m_notifyTxStatusChanged(tx); });
-    m_vault->subscribeMerkleBlockInserted([this](std::shared_ptr<MerkleBlock> merkleblock)
+    m_vault->subscribeTxInserted([this](const std::shared_ptr<Tx>& tx) { m_notifyTxInserted(tx); });
+    m_vault->subscribeTxBatch([this](const TxBatch& batch) { m_notifyTxBatch(batch); });
+    m_bForwardingTxStatusChanged = false;
+    if (!m_notifyTxStatusChanged.empty()) forwardTxStatusChanged_unwrapped();
+    m_vault->subscribeMerkleBlockInserted([this](const std::shared_ptr<MerkleBlock>& merkleblock)
     {
         m_syncHeight = merkleblock->blockheader()->height();
         m_notifyMerkleBlockInserted(merkleblock);
@@ -230,11 +236,26 @@ void SynchedVault::resyncVault()
 }
 
 // Event subscriptions
+Signals::Connection SynchedVault::subscribeTxStatusChanged(TxSignal::Slot slot)
+{
+    std::lock_guard<std::mutex> lock(m_vaultMutex);
+    Signals::Connection connection = m_notifyTxStatusChanged.connect(slot);
+    if (m_vault && !m_bForwardingTxStatusChanged) forwardTxStatusChanged_unwrapped();
+    return connection;
+}
+
+void SynchedVault::forwardTxStatusChanged_unwrapped()
+{
+    m_vault->subscribeTxStatusChanged([this](const std::shared_ptr<Tx>& tx) { m_notifyTxStatusChanged(tx); });
+    m_bForwardingTxStatusChanged = true;
+}
+
 void SynchedVault::clearAllSlots()
 {
     LOGGER(trace) << "SynchedVault::clearAllSlots()" << std::endl;
     m_notifyTxInserted.clear();
     m_notifyTxStatusChanged.clear();
     m_notifyMerkleBlockInserted.clear();
+    m_notifyTxBatch.clear();
 }
 
@@ -23,7 +23,7 @@ namespace CoinDB
 class SynchedVault
 {
 public:
-    SynchedVault(const std::string& blockTreeFile = "blocktree.dat");
+    SynchedVault(const std::string& blockTreeFile = "blocktree.dat", const CoinQ::CoinParams& coinParams = CoinQ::getBitcoinParams());
     ~SynchedVault();
 
     void openVault(const std::string& filename, bool bCreate = false);
@@ -35,11 +35,17 @@ public:
 
     // P2P network state events
     Signals::Connection subscribeTxInserted(TxSignal::Slot slot) { return m_notifyTxInserted.connect(slot); }
-    Signals::Connection subscribeTxStatusChanged(TxSignal::Slot slot) { return m_notifyTxStatusChanged.connect(slot); }
     Signals::Connection subscribeMerkleBlockInserted(MerkleBlockSignal::Slot slot) { return m_notifyMerkleBlockInserted.connect(slot); }
+    Signals::Connection subscribeTxBatch(TxBatchSignal::Slot slot) { return m_notifyTxBatch.connect(slot); }
+
+    // The vault copies each confirmed or unconfirmed tx for this signal, so it is only forwarded
+    // once something subscribes. Must not be called from a slot.
+    Signals::Connection subscribeTxStatusChanged(TxSignal::Slot slot);
     void clearAllSlots();
 
 private:
+    void forwardTxStatusChanged_unwrapped();
+
     Vault* m_vault;
 
     CoinQ::Network::NetworkSync m_networkSync;
@@ -56,6 +62,8 @@ private:
     TxSignal m_notifyTxInserted;
     TxSignal m_notifyTxStatusChanged;
     MerkleBlockSignal m_notifyMerkleBlockInserted;
+    TxBatchSignal m_notifyTxBatch;
+    bool m_bForwardingTxStatusChanged;
 };
 
 }
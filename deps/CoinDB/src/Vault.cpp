@@ -7,11 +7,14 @@
 // All Rights Reserved.
 //
 
+#define LOGGER_SUBSYSTEM "vault"
+
 #include "Vault.h"
 #include "Database.h"
 
 #include <CoinQ/CoinQ_script.h>
 #include <CoinQ/CoinQ_blocks.h>
+#include <CoinQ/CoinQ_metrics.h>
 
 
 #include "../odb/Schema-odb.hxx"
@@ -38,6 +41,29 @@
 
 using namespace CoinDB;
 
+static CoinQ::Metrics::Histogram& g_insertTxLatency = CoinQ::Metrics::registry().histogram("coindb_insert_tx_seconds", "Vault::insertTx duration, including the commit.");
+static CoinQ::Metrics::Histogram& g_insertMerkleBlockLatency = CoinQ::Metrics::registry().histogram("coindb_insert_merkle_block_seconds", "Vault::insertMerkleBlock duration, including the commit.");
+static CoinQ::Metrics::Histogram& g_signTxLatency = CoinQ::Metrics::registry().histogram("coindb_sign_tx_seconds", "Vault::signTx duration, including the commit.");
+static CoinQ::Metrics::Histogram& g_createTxLatency = CoinQ::Metrics::registry().histogram("coindb_create_tx_seconds", "Vault::createTx duration, including the commit.");
+static CoinQ::Metrics::Histogram& g_commitLatency = CoinQ::Metrics::registry().histogram("coindb_commit_seconds", "Database transaction commit duration.");
+
+// Every write goes through here so commit time, mostly spent syncing the database file, is measured separately.
+static void commitTransaction(odb::core::transaction& t)
+{
+    CoinQ::Metrics::Timer timer(g_commitLatency);
+    t.commit();
+}
+
+// "(1, 2, 3)", for the set-based statements that confirm and unconfirm txs.
+static std::string getSqlIdList(const std::vector<unsigned long>& ids)
+{
+    std::stringstream ss;
+    ss << "(";
+    for (std::size_t i = 0; i < ids.size(); i++) { ss << (i > 0 ? ", " : "") << ids[i]; }
+    ss << ")";
+    return ss.str();
+}
+
 /*
  * class Vault implementation
 */
@@ -47,6 +73,7 @@ Vault::Vault(int argc, char** argv, bool create, uint32_t version)
     LOGGER(trace) << "Vault::Vault(..., " << (create ? "true" : "false") << ", " << version << ")" << std::endl;
 
     if (create) setSchemaVersion(version);
+    else        migrateSchema();
 }
 
 #if defined(DATABASE_SQLITE)
@@ -56,6 +83,7 @@ Vault::Vault(const std::string& filename, bool create, uint32_t version)
     LOGGER(trace) << "Vault::Vault(" << filename << ", " << (create ? "true" : "false") << ", " << version << ")" << std::endl;
 
     if (create) setSchemaVersion(version);
+    else        migrateSchema();
 }
 #endif
 
@@ -84,7 +112,7 @@ void Vault::setSchemaVersion(uint32_t version)
     boost::lock_guard<boost::mutex> lock(mutex);
     odb::core::transaction t(db_->begin());
     setSchemaVersion_unwrapped(version);
-    t.commit();
+    commitTransaction(t);
 }
 
 void Vault::setSchemaVersion_unwrapped(uint32_t version)
@@ -103,6 +131,21 @@ void Vault::setSchemaVersion_unwrapped(uint32_t version)
     }
 }
 
+void Vault::migrateSchema()
+{
+    boost::lock_guard<boost::mutex> lock(mutex);
+    odb::core::transaction t(db_->begin());
+    uint32_t version = getSchemaVersion_unwrapped();
+    if (version < SCHEMA_BASE_VERSION || version >= SCHEMA_VERSION) return;
+
+    // Version 6 indexes Tx.blockheader. Vaults created since have it already.
+    if (version < 6) { db_->execute("CREATE INDEX IF NOT EXISTS \"Tx_blockheader_i\" ON \"Tx\" (\"blockheader\")"); }
+
+    LOGGER(debug) << "Vault::migrateSchema() - migrated from version " << version << " to " << SCHEMA_VERSION << "." << std::endl;
+    setSchemaVersion_unwrapped(SCHEMA_VERSION);
+    commitTransaction(t);
+}
+
 uint32_t Vault::getHorizonTimestamp() const
 {
     LOGGER(trace) << "Vault::getHorizonTimestamp()" << std::endl;
@@ -224,8 +267,15 @@ bool Vault::areChainCodesLocked() const
 
 void Vault::lockChainCodes() const
 {
-    LOGGER(trace) << "Vault::unlockChainCodes()" << std::endl;
-    chainCodeUnlockKey.clear();
+    LOGGER(trace) << "Vault::lockChainCodes()" << std::endl;
+
+    boost::lock_guard<boost::mutex> lock(mutex);
+    Coin::wipeKey(chainCodeUnlockKey);
+
+    // Otherwise the chain codes could still be decrypted with the cached stretched keys.
+    odb::core::transaction t(db_->begin());
+    odb::result<Keychain> r(db_->query<Keychain>());
+    for (auto& keychain: r) { stretchedKeyCache.erase(keychain.chain_code_salt()); }
 }
 
 void Vault::unlockChainCodes(const secure_bytes_t& unlockKey) const
@@ -242,7 +292,7 @@ void Vault::verifyChainCodeUnlockKey_unwrapped(const secure_bytes_t& unlockKey)
 {
     odb::result<Keychain> r(db_->query<Keychain>());
     for (auto& keychain: r)
-        if (!keychain.unlockChainCode(unlockKey))
+        if (!keychain.unlockChainCode(unlockKey, &stretchedKeyCache))
             throw KeychainChainCodeUnlockFailedException(keychain.name());
 }
 
@@ -262,7 +312,7 @@ void Vault::setChainCodeUnlockKey_unwrapped(const secure_bytes_t& newUnlockKey)
     odb::result<Keychain> r(db_->query<Keychain>());
     for (auto& keychain: r)
     {
-        if (!keychain.unlockChainCode(chainCodeUnlockKey))
+        if (!keychain.unlockChainCode(chainCodeUnlockKey, &stretchedKeyCache))
             throw KeychainChainCodeUnlockFailedException(keychain.name());
 
         keychain.setChainCodeUnlockKey(newUnlockKey);
@@ -306,7 +356,7 @@ std::shared_ptr<Keychain> Vault::importKeychain(const std::string& filepath, boo
     odb::core::session s;
     odb::core::transaction t(db_->begin());
     std::shared_ptr<Keychain> keychain = importKeychain_unwrapped(filepath, importprivkeys, importChainCodeUnlockKey);
-    t.commit();
+    commitTransaction(t);
     return keychain;
 }
 
@@ -407,9 +457,11 @@ std::shared_ptr<Keychain> Vault::newKeychain(const std::string& keychain_name, c
     odb::result<Keychain> r(db_->query<Keychain>(odb::query<Keychain>::name == keychain_name));
     if (!r.empty()) throw KeychainAlreadyExistsException(keychain_name);
 
+    // Chain codes are all locked with the vault's chain code unlock key, as on import.
     std::shared_ptr<Keychain> keychain(new Keychain(keychain_name, entropy, lockKey, salt));
+    keychain->setChainCodeUnlockKey(chainCodeUnlockKey);
     persistKeychain_unwrapped(keychain);
-    t.commit();
+    commitTransaction(t);
 
     return keychain;
 }
@@ -434,7 +486,7 @@ void Vault::renameKeychain(const std::string& old_name, const std::string& new_n
     keychain->name(new_name);
 
     db_->update(keychain);
-    t.commit();
+    commitTransaction(t);
 }
 
 void Vault::persistKeychain_unwrapped(std::shared_ptr<Keychain> keychain)
@@ -504,7 +556,7 @@ std::shared_ptr<Keychain> Vault::importKeychainExtendedKey(const std::string& ke
     keychain->extkey(extkey, try_private, lockKey, salt);
     keychain->setChainCodeUnlockKey(chainCodeUnlockKey);
     persistKeychain_unwrapped(keychain);
-    t.commit();
+    commitTransaction(t);
 
     return keychain;
 }
@@ -513,7 +565,7 @@ void Vault::unlockAccountChainCodes_unwrapped(std::shared_ptr<Account> account,
 {
     for (auto& keychain: account->keychains())
     {
-        if (!keychain->unlockChainCode(overrideChainCodeUnlockKey.empty() ? chainCodeUnlockKey : overrideChainCodeUnlockKey))
+        if (!keychain->unlockChainCode(overrideChainCodeUnlockKey.empty() ? chainCodeUnlockKey : overrideChainCodeUnlockKey, &stretchedKeyCache))
             throw KeychainChainCodeUnlockFailedException(keychain->name());
     }
 }
@@ -527,7 +579,7 @@ void Vault::refillAccountPool(const std::string& account_name)
     odb::core::transaction t(db_->begin());
     std::shared_ptr<Account> account = getAccount_unwrapped(account_name);
     refillAccountPool_unwrapped(account);
-    t.commit();
+    commitTransaction(t);
 }
 
 void Vault::refillAccountPool_unwrapped(std::shared_ptr<Account> account)
@@ -576,6 +628,7 @@ void Vault::lockAllKeychains()
 
     boost::lock_guard<boost::mutex> lock(mutex);
     mapPrivateKeyUnlock.clear();
+    stretchedKeyCache.clear();
 }
 
 void Vault::lockKeychain(const std::string& keychain_name)
@@ -584,6 +637,11 @@ void Vault::lockKeychain(const std::string& keychain_name)
 
     boost::lock_guard<boost::mutex> lock(mutex);
     mapPrivateKeyUnlock.erase(keychain_name);
+
+    // Otherwise the private key could still be decrypted with the cached stretched key.
+    odb::core::transaction t(db_->begin());
+    odb::result<Keychain> r(db_->query<Keychain>(odb::query<Keychain>::name == keychain_name));
+    if (!r.empty()) { stretchedKeyCache.erase(r.begin()->privkey_salt()); }
 }
 
 void Vault::unlockKeychain(const std::string& keychain_name, const secure_bytes_t& unlock_key)
@@ -597,7 +655,7 @@ void Vault::unlockKeychain(const std::string& keychain_name, const secure_bytes_
     if (!keychain->isPrivate())
         throw KeychainIsNotPrivateException(keychain->name());
 
-    if (!keychain->unlockPrivateKey(unlock_key))
+    if (!keychain->unlockPrivateKey(unlock_key, &stretchedKeyCache))
         throw KeychainPrivateKeyLockedException(keychain->name());
 
     mapPrivateKeyUnlock[keychain_name] = unlock_key;
@@ -607,12 +665,12 @@ void Vault::unlockKeychainChainCode_unwrapped(std::shared_ptr<Keychain> keychain
 {
     if (overrideChainCodeUnlockKey.empty())
     {
-        if (!keychain->unlockChainCode(chainCodeUnlockKey))
+        if (!keychain->unlockChainCode(chainCodeUnlockKey, &stretchedKeyCache))
             throw KeychainChainCodeUnlockFailedException(keychain->name());
     }
     else
     {
-        if (!keychain->unlockChainCode(overrideChainCodeUnlockKey))
+        if (!keychain->unlockChainCode(overrideChainCodeUnlockKey, &stretchedKeyCache))
             throw KeychainChainCodeUnlockFailedException(keychain->name());
     }
 }
@@ -628,12 +686,12 @@ void Vault::unlockKeychainPrivateKey_unwrapped(std::shared_ptr<Keychain> keychai
         if (it == mapPrivateKeyUnlock.end())
             throw KeychainPrivateKeyLockedException(keychain->name());
 
-        if (!keychain->unlockPrivateKey(it->second))
+        if (!keychain->unlockPrivateKey(it->second, &stretchedKeyCache))
             throw KeychainPrivateKeyUnlockFailedException(keychain->name());
     }
     else
     {
-        if (!keychain->unlockPrivateKey(overridePrivateKeyUnlockKey))
+        if (!keychain->unlockPrivateKey(overridePrivateKeyUnlockKey, &stretchedKeyCache))
             throw KeychainPrivateKeyUnlockFailedException(keychain->name());
     }
 }
@@ -643,11 +701,11 @@ bool Vault::tryUnlockKeychainChainCode_unwrapped(std::shared_ptr<Keychain> keych
     if (overrideChainCodeUnlockKey.empty())
     {
         if (chainCodeUnlockKey.empty()) return false;
-        return keychain->unlockChainCode(chainCodeUnlockKey);
+        return keychain->unlockChainCode(chainCodeUnlockKey, &stretchedKeyCache);
     }
     else
     {
-        return keychain->unlockChainCode(overrideChainCodeUnlockKey);
+        return keychain->unlockChainCode(overrideChainCodeUnlockKey, &stretchedKeyCache);
     }
 }
 
@@ -657,11 +715,11 @@ bool Vault::tryUnlockKeychainPrivateKey_unwrapped(std::shared_ptr<Keychain> keyc
     {
         const auto& it = mapPrivateKeyUnlock.find(keychain->name());
         if (it == mapPrivateKeyUnlock.end()) return false;
-        return keychain->unlockPrivateKey(it->second);
+        return keychain->unlockPrivateKey(it->second, &stretchedKeyCache);
     }
     else
     {
-        return keychain->unlockPrivateKey(overridePrivateKeyUnlockKey);
+        return keychain->unlockPrivateKey(overridePrivateKeyUnlockKey, &stretchedKeyCache);
     }
 }
 
@@ -709,7 +767,7 @@ std::shared_ptr<Account> Vault::importAccount(const std::string& filepath, unsig
     odb::core::session s;
     odb::core::transaction t(db_->begin());
     std::shared_ptr<Account> account = importAccount_unwrapped(filepath, privkeysimported, importChainCodeUnlockKey);
-    t.commit();
+    commitTransaction(t);
     return account; 
 }
 
@@ -878,7 +936,7 @@ void Vault::newAccount(const std::string& account_name, unsigned int minsigs, co
     db_->update(changeAccountBin);
     db_->update(defaultAccountBin);
     db_->update(account);
-    t.commit();
+    commitTransaction(t);
 }
 
 void Vault::renameAccount(const std::string& old_name, const std::string& new_name)
@@ -901,7 +959,7 @@ void Vault::renameAccount(const std::string& old_name, const std::string& new_na
     account->name(new_name);
 
     db_->update(account);
-    t.commit();
+    commitTransaction(t);
 }
 
 std::shared_ptr<Account> Vault::getAccount(const std::string& account_name) const
@@ -1002,7 +1060,7 @@ std::shared_ptr<AccountBin> Vault::addAccountBin(const std::string& account_name
     }
     db_->update(bin);
     db_->update(account);
-    t.commit();
+    commitTransaction(t);
 
     return bin;
 }
@@ -1017,7 +1075,7 @@ std::shared_ptr<SigningScript> Vault::issueSigningScript(const std::string& acco
     std::shared_ptr<AccountBin> bin = getAccountBin_unwrapped(account_name, bin_name);
     if (bin->isChange()) throw AccountCannotIssueChangeScriptException(account_name);
     std::shared_ptr<SigningScript> script = issueAccountBinSigningScript_unwrapped(bin, label);
-    t.commit();
+    commitTransaction(t);
     return script;
 }
 
@@ -1065,7 +1123,7 @@ void Vault::unlockAccountBinChainCodes_unwrapped(std::shared_ptr<AccountBin> bin
     {
         for (auto& keychain: bin->keychains())
         {
-            if (!keychain->unlockChainCode(overrideChainCodeUnlockKey.empty() ? chainCodeUnlockKey : overrideChainCodeUnlockKey))
+            if (!keychain->unlockChainCode(overrideChainCodeUnlockKey.empty() ? chainCodeUnlockKey : overrideChainCodeUnlockKey, &stretchedKeyCache))
                 throw KeychainChainCodeUnlockFailedException(keychain->name());
         }
     }
@@ -1112,28 +1170,203 @@ std::vector<SigningScriptView> Vault::getSigningScriptViews(const std::string& a
 {
     LOGGER(trace) << "Vault::getSigningScriptViews(" << account_name << ", " << bin_name << ", " << SigningScript::getStatusString(flags) << ")" << std::endl;
 
+    boost::lock_guard<boost::mutex> lock(mutex);
+    odb::core::session s;
+    odb::core::transaction t(db_->begin());
+
+    std::vector<SigningScriptView> views;
+    visitSigningScriptViews_unwrapped([&](const SigningScriptView& view) { views.push_back(view); return true; }, account_name, bin_name, flags, SigningScriptViewCursor());
+    return views;
+}
+
+std::vector<TxOutView> Vault::getTxOutViews(const std::string& account_name, const std::string& bin_name, int role_flags, int txout_status_flags, int tx_status_flags, bool hide_change) const
+{
+    LOGGER(trace) << "Vault::getTxOutViews(" << account_name << ", " << bin_name << ", " << TxOut::getRoleString(role_flags) << ", " << TxOut::getStatusString(txout_status_flags) << ", " << ", " << Tx::getStatusString(tx_status_flags) << ")" << std::endl;
+
+    boost::lock_guard<boost::mutex> lock(mutex);
+    odb::core::transaction t(db_->begin());
+
+    std::vector<TxOutView> views;
+    visitTxOutViews_unwrapped([&](const TxOutView& view) { views.push_back(view); return true; }, account_name, bin_name, role_flags, txout_status_flags, tx_status_flags, hide_change, TxOutViewCursor());
+    return views;
+}
+
+std::vector<TxOutView> Vault::getTxOutViewsForTx(unsigned long tx_id, const std::string& account_name, int role_flags, bool hide_change) const
+{
+    LOGGER(trace) << "Vault::getTxOutViewsForTx(" << tx_id << ", " << account_name << ", " << TxOut::getRoleString(role_flags) << ")" << std::endl;
+
+    boost::lock_guard<boost::mutex> lock(mutex);
+    odb::core::transaction t(db_->begin());
+
+    std::vector<TxOutView> views;
+    visitTxOutViews_unwrapped([&](const TxOutView& view) { views.push_back(view); return true; }, account_name, "", role_flags, TxOut::BOTH, Tx::ALL, hide_change, TxOutViewCursor(), tx_id);
+    return views;
+}
+
+std::vector<SigningScriptView> Vault::getSigningScriptViewsPage(const SigningScriptViewCursor& after, std::size_t limit, SigningScriptViewCursor& next, const std::string& account_name, const std::string& bin_name, int flags) const
+{
+    return getSigningScriptViewsPage(after, limit, next, account_name, bin_name, flags, SCRIPT_SORT_DEFAULT, false, "");
+}
+
+std::vector<SigningScriptView> Vault::getSigningScriptViewsPage(const SigningScriptViewCursor& after, std::size_t limit, SigningScriptViewCursor& next, const std::string& account_name, const std::string& bin_name, int flags, SigningScriptViewSort sort, bool descending, const std::string& label_filter) const
+{
+    LOGGER(trace) << "Vault::getSigningScriptViewsPage(" << after.id << ", " << limit << ", " << account_name << ", " << bin_name << ", " << SigningScript::getStatusString(flags) << ", " << sort << ", " << descending << ", " << label_filter << ")" << std::endl;
+
+    boost::lock_guard<boost::mutex> lock(mutex);
+    odb::core::session s;
+    odb::core::transaction t(db_->begin());
+
+    // Fetch one row past the limit to learn whether another page follows. The next page then starts
+    // after the last row scanned into this one.
+    std::vector<SigningScriptView> views;
+    SigningScriptViewCursor last = after;
+    next = SigningScriptViewCursor();
+    visitSigningScriptViews_unwrapped([&](const SigningScriptView& view)
+    {
+        if (views.size() == limit)
+        {
+            next = last;
+            return false;
+        }
+        views.push_back(view);
+        last = SigningScriptViewCursor(view);
+        return true;
+    }, account_name, bin_name, flags, after, sort, descending, label_filter);
+    return views;
+}
+
+std::vector<TxOutView> Vault::getTxOutViewsPage(const TxOutViewCursor& after, std::size_t limit, TxOutViewCursor& next, const std::string& account_name, const std::string& bin_name, int role_flags, int txout_status_flags, int tx_status_flags, bool hide_change) const
+{
+    LOGGER(trace) << "Vault::getTxOutViewsPage(" << after.id << ", " << limit << ", " << account_name << ", " << bin_name << ", " << TxOut::getRoleString(role_flags) << ", " << TxOut::getStatusString(txout_status_flags) << ", " << Tx::getStatusString(tx_status_flags) << ")" << std::endl;
+
+    boost::lock_guard<boost::mutex> lock(mutex);
+    odb::core::transaction t(db_->begin());
+
+    // The limit applies to txout rows so that a split row never straddles two pages. Rows whose roles
+    // are all filtered out yield no views, so the next page starts after the last row scanned rather
+    // than after the last view returned, and those rows are not scanned again.
+    std::vector<TxOutView> views;
+    std::size_t rows = 0;
+    unsigned long last_id = 0;
+    TxOutViewCursor last = after;
+    next = TxOutViewCursor();
+    visitTxOutViews_unwrapped([&](const TxOutView& view)
+    {
+        if (view.id != last_id)
+        {
+            if (rows == limit)
+            {
+                next = last;
+                return false;
+            }
+            last_id = view.id;
+            rows++;
+        }
+        views.push_back(view);
+        return true;
+    }, account_name, bin_name, role_flags, txout_status_flags, tx_status_flags, hide_change, after, 0, &last);
+    return views;
+}
+
+unsigned int Vault::visitSigningScriptViews(SigningScriptViewVisitor visitor, const std::string& account_name, const std::string& bin_name, int flags, const SigningScriptViewCursor& after) const
+{
+    LOGGER(trace) << "Vault::visitSigningScriptViews(" << account_name << ", " << bin_name << ", " << SigningScript::getStatusString(flags) << ", " << after.id << ")" << std::endl;
+
+    boost::lock_guard<boost::mutex> lock(mutex);
+    odb::core::session s;
+    odb::core::transaction t(db_->begin());
+    return visitSigningScriptViews_unwrapped(visitor, account_name, bin_name, flags, after);
+}
+
+// Sort key: column, id, both ASC or both DESC
+template<typename Column, typename Value>
+static void addSingleColumnOrder(odb::query<SigningScriptView>& query, const Column& column, const Value& value, const SigningScriptViewCursor& after, bool descending)
+{
+    typedef odb::query<SigningScriptView> query_t;
+    std::string cmp = descending ? "<" : ">";
+    std::string dir = descending ? "DESC" : "ASC";
+    if (!after.isNull())
+    {
+        query = query && ("(" + column + cmp + query_t::_val(value) +
+            "OR (" + column + "=" + query_t::_val(value) + "AND" + query_t::SigningScript::id + cmp + query_t::_val(after.id) + "))");
+    }
+    query += "ORDER BY" + column + dir + "," + query_t::SigningScript::id + dir;
+}
+
+unsigned int Vault::visitSigningScriptViews_unwrapped(SigningScriptViewVisitor visitor, const std::string& account_name, const std::string& bin_name, int flags, const SigningScriptViewCursor& after, SigningScriptViewSort sort, bool descending, const std::string& label_filter) const
+{
     std::vector<SigningScript::status_t> statusRange = SigningScript::getStatusFlags(flags);
 
     typedef odb::query<SigningScriptView> query_t;
     query_t query(query_t::SigningScript::status.in_range(statusRange.begin(), statusRange.end()));
     if (!account_name.empty()) query = (query && query_t::Account::name == account_name);
     if (!bin_name.empty())     query = (query && query_t::AccountBin::name == bin_name);
-    query += "ORDER BY" + query_t::Account::name + "ASC," + query_t::AccountBin::name + "ASC," + query_t::SigningScript::status + "DESC," + query_t::SigningScript::index + "ASC";
 
-    boost::lock_guard<boost::mutex> lock(mutex);
-    odb::core::session s;
-    odb::core::transaction t(db_->begin());
+    if (!label_filter.empty())
+    {
+        // Match the filter literally inside LIKE. LIKE folds the case of ASCII letters only.
+        std::string pattern = "%";
+        for (auto c: label_filter)
+        {
+            if (c == '%' || c == '_' || c == '\\') pattern += '\\';
+            pattern += c;
+        }
+        pattern += "%";
+        query = query && query_t::SigningScript::label.like(pattern, "\\");
+    }
 
-    std::vector<SigningScriptView> views;
+    if (sort == SCRIPT_SORT_DEFAULT)
+    {
+        // Sort key: account name ASC, bin name ASC, status DESC, index ASC, id ASC
+        query_t account_key("COALESCE(" + query_t::Account::name + ",'')");
+        query_t bin_key("COALESCE(" + query_t::AccountBin::name + ",'')");
+        if (!after.isNull())
+        {
+            query = query && ("(" + account_key + ">" + query_t::_val(after.account_name) +
+                "OR (" + account_key + "=" + query_t::_val(after.account_name) + "AND (" + bin_key + ">" + query_t::_val(after.bin_name) +
+                "OR (" + bin_key + "=" + query_t::_val(after.bin_name) + "AND (" + query_t::SigningScript::status + "<" + query_t::_val(after.status) +
+                "OR (" + query_t::SigningScript::status + "=" + query_t::_val(after.status) + "AND (" + query_t::SigningScript::index + ">" + query_t::_val(after.index) +
+                "OR (" + query_t::SigningScript::index + "=" + query_t::_val(after.index) + "AND" + query_t::SigningScript::id + ">" + query_t::_val(after.id) + "))))))))");
+        }
+        query += "ORDER BY" + account_key + "ASC," + bin_key + "ASC," + query_t::SigningScript::status + "DESC," + query_t::SigningScript::index + "ASC," + query_t::SigningScript::id + "ASC";
+    }
+    else
+    {
+        switch (sort)
+        {
+        case SCRIPT_SORT_INDEX:
+            addSingleColumnOrder(query, query_t::SigningScript::index, after.index, after, descending);
+            break;
+        case SCRIPT_SORT_STATUS:
+            addSingleColumnOrder(query, query_t::SigningScript::status, after.status, after, descending);
+            break;
+        default:
+            addSingleColumnOrder(query, query_t::SigningScript::label, after.label, after, descending);
+            break;
+        }
+    }
+
+    unsigned int count = 0;
     odb::result<SigningScriptView> r(db_->query<SigningScriptView>(query));
-    for (auto& view: r) { views.push_back(view); }
-    return views;
+    for (auto& view: r)
+    {
+        count++;
+        if (!visitor(view)) break;
+    }
+    return count;
 }
 
-std::vector<TxOutView> Vault::getTxOutViews(const std::string& account_name, const std::string& bin_name, int role_flags, int txout_status_flags, int tx_status_flags, bool hide_change) const
+unsigned int Vault::visitTxOutViews(TxOutViewVisitor visitor, const std::string& account_name, const std::string& bin_name, int role_flags, int txout_status_flags, int tx_status_flags, bool hide_change, const TxOutViewCursor& after) const
 {
-    LOGGER(trace) << "Vault::getTxOutViews(" << account_name << ", " << bin_name << ", " << TxOut::getRoleString(role_flags) << ", " << TxOut::getStatusString(txout_status_flags) << ", " << ", " << Tx::getStatusString(tx_status_flags) << ")" << std::endl;
+    LOGGER(trace) << "Vault::visitTxOutViews(" << account_name << ", " << bin_name << ", " << TxOut::getRoleString(role_flags) << ", " << TxOut::getStatusString(txout_status_flags) << ", " << Tx::getStatusString(tx_status_flags) << ", " << after.id << ")" << std::endl;
 
+    boost::lock_guard<boost::mutex> lock(mutex);
+    odb::core::transaction t(db_->begin());
+    return visitTxOutViews_unwrapped(visitor, account_name, bin_name, role_flags, txout_status_flags, tx_status_flags, hide_change, after);
+}
+
+unsigned int Vault::visitTxOutViews_unwrapped(TxOutViewVisitor visitor, const std::string& account_name, const std::string& bin_name, int role_flags, int txout_status_flags, int tx_status_flags, bool hide_change, const TxOutViewCursor& after, unsigned long tx_id, TxOutViewCursor* last_scanned) const
+{
     typedef odb::query<TxOutView> query_t;
     query_t query(query_t::receiving_account::id != 0 || query_t::sending_account::id != 0);
     if (!account_name.empty())
@@ -1155,19 +1388,33 @@ std::vector<TxOutView> Vault::getTxOutViews(const std::string& account_name, con
         query = (query && query_t::Tx::status.in_range(tx_statuses.begin(), tx_statuses.end()));
     }
 
-    query += "ORDER BY" + query_t::BlockHeader::height + "DESC," + query_t::Tx::timestamp + "DESC," + query_t::Tx::id + "DESC";
+    if (tx_id)                                  query = (query && query_t::Tx::id == tx_id);
 
-    boost::lock_guard<boost::mutex> lock(mutex);
-    odb::core::transaction t(db_->begin());
-    std::vector<TxOutView> views;
+    // Sort key: height DESC, timestamp DESC, tx id DESC, txout id ASC. Unconfirmed transactions have height 0.
+    query_t height_key("COALESCE(" + query_t::BlockHeader::height + ",0)");
+    if (!after.isNull())
+    {
+        query = query && ("(" + height_key + "<" + query_t::_val(after.height) +
+            "OR (" + height_key + "=" + query_t::_val(after.height) + "AND (" + query_t::Tx::timestamp + "<" + query_t::_val(after.timestamp) +
+            "OR (" + query_t::Tx::timestamp + "=" + query_t::_val(after.timestamp) + "AND (" + query_t::Tx::id + "<" + query_t::_val(after.tx_id) +
+            "OR (" + query_t::Tx::id + "=" + query_t::_val(after.tx_id) + "AND" + query_t::TxOut::id + ">" + query_t::_val(after.id) + "))))))");
+    }
+    query += "ORDER BY" + height_key + "DESC," + query_t::Tx::timestamp + "DESC," + query_t::Tx::id + "DESC," + query_t::TxOut::id + "ASC";
+
+    unsigned int count = 0;
     odb::result<TxOutView> r(db_->query<TxOutView>(query));
     for (auto& view: r)
     {
+        count++;
         view.updateRole(role_flags);
         std::vector<TxOutView> split_views = view.getSplitRoles(TxOut::ROLE_RECEIVER, account_name);
-        for (auto& split_view: split_views) { views.push_back(split_view); }
+        for (auto& split_view: split_views)
+        {
+            if (!visitor(split_view)) return count;
+        }
+        if (last_scanned) { *last_scanned = TxOutViewCursor(view); }
     }
-    return views;
+    return count;
 }
 
 
@@ -1244,7 +1491,7 @@ std::shared_ptr<AccountBin> Vault::importAccountBin(const std::string& filepath,
     odb::core::session s;
     odb::core::transaction t(db_->begin());
     std::shared_ptr<AccountBin> bin = importAccountBin_unwrapped(filepath, importChainCodeUnlockKey);
-    t.commit();
+    commitTransaction(t);
     return bin;
 }
 
@@ -1392,11 +1639,18 @@ std::shared_ptr<Tx> Vault::insertTx(std::shared_ptr<Tx> tx)
 {
     LOGGER(trace) << "Vault::insertTx(...) - hash: " << uchar_vector(tx->hash()).getHex() << ", unsigned hash: " << uchar_vector(tx->unsigned_hash()).getHex() << std::endl;
 
+    CoinQ::Metrics::Timer timer(g_insertTxLatency);
+
     boost::lock_guard<boost::mutex> lock(mutex);
     odb::core::session s;
     odb::core::transaction t(db_->begin());
+    pendingTxBatch.clear();
     tx = insertTx_unwrapped(tx);
-    if (tx) t.commit();
+    if (tx)
+    {
+        commitTransaction(t);
+        notifyTxBatch_unwrapped();
+    }
     return tx;
 }
 
@@ -1429,7 +1683,7 @@ std::shared_ptr<Tx> Vault::insertTx_unwrapped(std::shared_ptr<Tx> tx)
                 }
                 stored_tx->updateStatus(tx->status());
                 db_->update(stored_tx);
-                notifyTxStatusChanged(stored_tx);
+                notifyTxStatusChanged_unwrapped(stored_tx);
                 return stored_tx;
             }
             else
@@ -1453,7 +1707,7 @@ std::shared_ptr<Tx> Vault::insertTx_unwrapped(std::shared_ptr<Tx> tx)
                     }
                     i++;
                 }
-                if (updated) notifyTxStatusChanged(stored_tx);
+                if (updated) notifyTxStatusChanged_unwrapped(stored_tx);
                 return updated ? stored_tx : nullptr;
             }
         }
@@ -1467,7 +1721,7 @@ std::shared_ptr<Tx> Vault::insertTx_unwrapped(std::shared_ptr<Tx> tx)
                     LOGGER(debug) << "Vault::insertTx_unwrapped - UPDATING TRANSACTION STATUS FROM " << stored_tx->status() << " TO " << tx->status() << ". hash: " << uchar_vector(stored_tx->hash()).getHex() << std::endl;
                     stored_tx->updateStatus(tx->status());
                     db_->update(stored_tx);
-                    notifyTxStatusChanged(stored_tx);
+                    notifyTxStatusChanged_unwrapped(stored_tx);
                     return stored_tx;
                 }
                 else
@@ -1611,7 +1865,7 @@ std::shared_ptr<Tx> Vault::insertTx_unwrapped(std::shared_ptr<Tx> tx)
             {
                 conflicting_tx->updateStatus(Tx::CONFLICTING);
                 db_->update(conflicting_tx);
-                notifyTxStatusChanged(conflicting_tx);
+                notifyTxStatusChanged_unwrapped(conflicting_tx);
             }
         }
     }
@@ -1630,7 +1884,7 @@ std::shared_ptr<Tx> Vault::insertTx_unwrapped(std::shared_ptr<Tx> tx)
         for (auto& txout:       updated_txouts) { db_->update(txout);       }
 
         if (tx->status() >= Tx::SENT) updateConfirmations_unwrapped(tx);
-        notifyTxInserted(tx);
+        notifyTxInserted_unwrapped(tx);
         return tx;
     }
 
@@ -1642,14 +1896,21 @@ std::shared_ptr<Tx> Vault::createTx(const std::string& account_name, uint32_t tx
 {
     LOGGER(trace) << "Vault::createTx(" << account_name << ", " << tx_version << ", " << tx_locktime << ", " << txouts.size() << " txout(s), " << fee << ", " << maxchangeouts << ", " << (insert ? "insert" : "no insert") << ")" << std::endl;
 
+    CoinQ::Metrics::Timer timer(g_createTxLatency);
+
     boost::lock_guard<boost::mutex> lock(mutex);
     odb::core::session s;
     odb::core::transaction t(db_->begin());
+    pendingTxBatch.clear();
     std::shared_ptr<Tx> tx = createTx_unwrapped(account_name, tx_version, tx_locktime, txouts, fee, maxchangeouts);
     if (insert)
     {
         tx = insertTx_unwrapped(tx);
-        if (tx) t.commit();
+        if (tx)
+        {
+            commitTransaction(t);
+            notifyTxBatch_unwrapped();
+        }
     } 
     return tx;
 }
@@ -1724,7 +1985,7 @@ void Vault::deleteTx(const bytes_t& tx_hash)
 
     std::shared_ptr<Tx> tx(r.begin().load());
     deleteTx_unwrapped(tx);
-    t.commit();
+    commitTransaction(t);
 }
 
 void Vault::deleteTx_unwrapped(std::shared_ptr<Tx> tx)
@@ -1792,6 +2053,8 @@ std::shared_ptr<Tx> Vault::signTx(const bytes_t& unsigned_hash, std::vector<std:
 {
     LOGGER(trace) << "Vault::signTx(" << uchar_vector(unsigned_hash).getHex() << ", [" << stdutils::delimited_list(keychain_names, ", ") << "], " << (update ? "update" : "no update") << ")" << std::endl;
 
+    CoinQ::Metrics::Timer timer(g_signTxLatency);
+
     boost::lock_guard<boost::mutex> lock(mutex);
     odb::core::session s;
     odb::core::transaction t(db_->begin());
@@ -1804,7 +2067,7 @@ std::shared_ptr<Tx> Vault::signTx(const bytes_t& unsigned_hash, std::vector<std:
     if (sigcount && update)
     {
         updateTx_unwrapped(tx);
-        t.commit();
+        commitTransaction(t);
     }
     return sigcount ? tx : nullptr;
 }
@@ -1813,6 +2076,8 @@ std::shared_ptr<Tx> Vault::signTx(unsigned long tx_id, std::vector<std::string>&
 {
     LOGGER(trace) << "Vault::signTx(" << tx_id << ", [" << stdutils::delimited_list(keychain_names, ", ") << "], " << (update ? "update" : "no update") << ")" << std::endl;
 
+    CoinQ::Metrics::Timer timer(g_signTxLatency);
+
     boost::lock_guard<boost::mutex> lock(mutex);
     odb::core::session s;
     odb::core::transaction t(db_->begin());
@@ -1825,7 +2090,7 @@ std::shared_ptr<Tx> Vault::signTx(unsigned long tx_id, std::vector<std::string>&
     if (sigcount && update)
     {
         updateTx_unwrapped(tx);
-        t.commit();
+        commitTransaction(t);
     }
     return sigcount ? tx : nullptr;
 }
@@ -1984,11 +2249,15 @@ std::shared_ptr<MerkleBlock> Vault::insertMerkleBlock(std::shared_ptr<MerkleBloc
 {
     LOGGER(trace) << "Vault::insertMerkleBlock(" << uchar_vector(merkleblock->blockheader()->hash()).getHex() << ")" << std::endl;
 
+    CoinQ::Metrics::Timer timer(g_insertMerkleBlockLatency);
+
     boost::lock_guard<boost::mutex> lock(mutex);
     odb::core::session s;
     odb::core::transaction t(db_->begin());
+    pendingTxBatch.clear();
     merkleblock = insertMerkleBlock_unwrapped(merkleblock);
-    t.commit();
+    commitTransaction(t);
+    notifyTxBatch_unwrapped();
     return merkleblock;
 }
 
@@ -2063,20 +2332,28 @@ std::shared_ptr<MerkleBlock> Vault::insertMerkleBlock_unwrapped(std::shared_ptr<
     db_->persist(merkleblock);
     notifyMerkleBlockInserted(merkleblock);
 
-    // Confirm transactions
+    // Confirm transactions with one statement. Only the view rows are loaded.
+    typedef odb::query<TxConfirmationView> tx_query_t;
     const auto& hashes = merkleblock->hashes();
-    odb::result<Tx> tx_r(db_->query<Tx>(odb::query<Tx>::hash.in_range(hashes.begin(), hashes.end())));
-    for (auto& tx: tx_r)
+    odb::result<TxConfirmationView> tx_r(db_->query<TxConfirmationView>(tx_query_t::Tx::hash.in_range(hashes.begin(), hashes.end())));
+    std::vector<unsigned long> tx_ids;
+    for (auto& view: tx_r)
     {
-        if (tx.blockheader())
+        if (view.blockheader_id != 0)
         {
-            LOGGER(error) << "Vault::insertMerkleBlock_unwrapped - transaction appears in more than one block. hash: " << uchar_vector(tx.hash()).getHex() << std::endl;
+            LOGGER(error) << "Vault::insertMerkleBlock_unwrapped - transaction appears in more than one block. hash: " << uchar_vector(view.tx_hash).getHex() << std::endl;
             throw MerkleBlockInvalidException(new_blockheader->hash(), new_blockheader->height());
         } 
-        LOGGER(debug) << "Vault::insertMerkleBlock_unwrapped - confirming transaction. hash: " << uchar_vector(tx.hash()).getHex() << std::endl;
-        tx.blockheader(new_blockheader);
-        db_->update(tx);
-        notifyTxStatusChanged(std::make_shared<Tx>(tx));
+        LOGGER(debug) << "Vault::insertMerkleBlock_unwrapped - confirming transaction. hash: " << uchar_vector(view.tx_hash).getHex() << std::endl;
+        tx_ids.push_back(view.tx_id);
+    }
+
+    if (!tx_ids.empty())
+    {
+        std::stringstream ss;
+        ss << "UPDATE \"Tx\" SET \"blockheader\" = " << new_blockheader->id() << ", \"status\" = " << Tx::CONFIRMED << " WHERE \"id\" IN " << getSqlIdList(tx_ids);
+        db_->execute(ss.str());
+        for (auto tx_id: tx_ids) { notifyTxConfirmationChanged_unwrapped(tx_id, Tx::CONFIRMED, new_blockheader); }
     }
 
     return merkleblock;     
@@ -2094,61 +2371,193 @@ unsigned int Vault::deleteMerkleBlock(uint32_t height)
     boost::lock_guard<boost::mutex> lock(mutex);
     odb::core::session s;
     odb::core::transaction t(db_->begin());
+    pendingTxBatch.clear();
     unsigned int count = deleteMerkleBlock_unwrapped(height);
-    t.commit();
+    commitTransaction(t);
+    notifyTxBatch_unwrapped();
     return count;
 }
 
 unsigned int Vault::deleteMerkleBlock_unwrapped(uint32_t height)
 {
-    typedef odb::query<BlockHeader> query_t;
-    odb::result<BlockHeader> r(db_->query<BlockHeader>((query_t::height >= height) + "ORDER BY" + query_t::height + "DESC"));
-    unsigned int count = 0;
-    for (auto& blockheader: r)
-    {
-        LOGGER(debug) << "Vault::deleteMerkleBlock_unwrapped - deleting block. hash: " << uchar_vector(blockheader.hash()).getHex() << ", height: " << blockheader.height() << std::endl;
+    // A reorg touches only the blocks at and above height, with the same few statements however
+    // deep it is. Nothing here loads the block headers, so none are left in the session.
+    typedef odb::query<TxConfirmationView> tx_query_t;
+    odb::result<TxConfirmationView> tx_r(db_->query<TxConfirmationView>(tx_query_t::BlockHeader::height >= height));
+    std::vector<TxConfirmationView> views;
+    for (auto& view: tx_r) { views.push_back(view); }
+
+    std::stringstream blockheader_ids;
+    blockheader_ids << "(SELECT \"id\" FROM \"BlockHeader\" WHERE \"height\" >= " << height << ")";
 
-        // Remove tx confirmations
-        odb::result<Tx> tx_r(db_->query<Tx>(odb::query<Tx>::blockheader == blockheader.id()));
-        for (auto& tx: tx_r)
+    // Remove tx confirmations
+    if (!views.empty())
+    {
+        std::stringstream ss;
+        ss << "UPDATE \"Tx\" SET \"blockheader\" = NULL, \"status\" = CASE WHEN \"status\" = " << Tx::CONFIRMED << " THEN " << Tx::PROPAGATED << " ELSE \"status\" END"
+           << " WHERE \"blockheader\" IN " << blockheader_ids.str();
+        db_->execute(ss.str());
+        for (auto& view: views)
         {
-            LOGGER(debug) << "Vault::deleteMerkleBlock_unwrapped - unconfirming transaction. hash: " << uchar_vector(tx.hash()).getHex() << std::endl;
-            tx.blockheader(nullptr);
-            db_->update(tx);
-            notifyTxStatusChanged(std::make_shared<Tx>(tx));
+            LOGGER(debug) << "Vault::deleteMerkleBlock_unwrapped - unconfirming transaction. hash: " << uchar_vector(view.tx_hash).getHex() << std::endl;
+            notifyTxConfirmationChanged_unwrapped(view.tx_id, view.tx_status == Tx::CONFIRMED ? Tx::PROPAGATED : view.tx_status, nullptr);
         }
+    }
 
-        // Delete merkle block
-        db_->erase_query<MerkleBlock>(odb::query<MerkleBlock>::blockheader == blockheader.id());
-
-        // Delete block header
-        db_->erase(blockheader);
+    // Delete merkle blocks
+    db_->execute("DELETE FROM \"MerkleBlock_hashes\" WHERE \"object_id\" IN (SELECT \"id\" FROM \"MerkleBlock\" WHERE \"blockheader\" IN " + blockheader_ids.str() + ")");
+    db_->execute("DELETE FROM \"MerkleBlock\" WHERE \"blockheader\" IN " + blockheader_ids.str());
 
-        count++;
+    // Delete block headers
+    std::stringstream ss;
+    ss << "DELETE FROM \"BlockHeader\" WHERE \"height\" >= " << height;
+    unsigned int count = db_->execute(ss.str());
+    if (count > 0)
+    {
+        LOGGER(debug) << "Vault::deleteMerkleBlock_unwrapped - deleted " << count << " blocks from height " << height << "." << std::endl;
     }
     return count;
 }
 
+std::vector<BatchInsertResult> Vault::insertBatch(const std::vector<BatchInsertItem>& items)
+{
+    LOGGER(trace) << "Vault::insertBatch(" << items.size() << " items)" << std::endl;
+
+    std::vector<BatchInsertResult> results(items.size());
+
+    boost::lock_guard<boost::mutex> lock(mutex);
+    odb::core::transaction t(db_->begin());
+    pendingTxBatch.clear();
+    for (std::size_t i = 0; i < items.size(); i++)
+    {
+        const BatchInsertItem& item = items[i];
+        BatchInsertResult& result = results[i];
+        std::size_t inserted_count = pendingTxBatch.inserted.size();
+        std::size_t status_changed_count = pendingTxBatch.status_changed.size();
+        db_->execute("SAVEPOINT batch_item");
+        try
+        {
+            // A session per item so a rolled back item leaves no stale objects cached for the next.
+            odb::core::session s;
+            bool inserted;
+            if (item.tx)                { inserted = (bool)insertTx_unwrapped(item.tx); }
+            else if (item.merkleblock)  { inserted = (bool)insertMerkleBlock_unwrapped(item.merkleblock); }
+            else                        { throw std::runtime_error("Empty batch item."); }
+
+            result.status = inserted ? BatchInsertResult::INSERTED : BatchInsertResult::UNCHANGED;
+        }
+        catch (const std::exception& e)
+        {
+            LOGGER(debug) << "Vault::insertBatch - item " << i << " failed: " << e.what() << std::endl;
+            result.status = BatchInsertResult::FAILED;
+            result.error = e.what();
+        }
+
+        // Like insertTx, keep nothing from an item that changed nothing.
+        if (result.status != BatchInsertResult::INSERTED)
+        {
+            db_->execute("ROLLBACK TO SAVEPOINT batch_item");
+            pendingTxBatch.inserted.resize(inserted_count);
+            pendingTxBatch.status_changed.erase(pendingTxBatch.status_changed.begin() + status_changed_count, pendingTxBatch.status_changed.end());
+        }
+        db_->execute("RELEASE SAVEPOINT batch_item");
+    }
+    commitTransaction(t);
+    notifyTxBatch_unwrapped();
+    return results;
+}
+
 unsigned int Vault::updateConfirmations_unwrapped(std::shared_ptr<Tx> tx)
 {
-    unsigned int count = 0;
     typedef odb::query<ConfirmedTxView> query_t;
     query_t query(query_t::Tx::blockheader.is_null());
     if (tx) query = (query && query_t::Tx::hash == tx->hash());
 
-    odb::result<ConfirmedTxView> r(db_->query<ConfirmedTxView>(query));
+    // A tx listed by more than one merkle block takes the lowest one, as the statement below does.
+    odb::result<ConfirmedTxView> r(db_->query<ConfirmedTxView>(query + "ORDER BY" + query_t::BlockHeader::height + "," + query_t::BlockHeader::id));
+    std::vector<ConfirmedTxView> views;
+    std::vector<unsigned long> tx_ids;
+    std::set<unsigned long> seen_tx_ids;
     for (auto& view: r)
     {
-        if (view.blockheader_id == 0) continue;
+        if (view.blockheader_id == 0 || !seen_tx_ids.insert(view.tx_id).second) continue;
+        views.push_back(view);
+        tx_ids.push_back(view.tx_id);
+    }
+    if (views.empty()) return 0;
 
-        std::shared_ptr<Tx> tx(db_->load<Tx>(view.tx_id));
+    // Each tx takes the block of the merkle block that lists it, all in one statement.
+    std::stringstream ss;
+    ss << "UPDATE \"Tx\" SET \"status\" = " << Tx::CONFIRMED << ", \"blockheader\" = "
+       << "(SELECT m.\"blockheader\" FROM \"MerkleBlock_hashes\" t JOIN \"MerkleBlock\" m ON t.\"object_id\" = m.\"id\" JOIN \"BlockHeader\" b ON m.\"blockheader\" = b.\"id\""
+       << " WHERE t.\"value\" = \"Tx\".\"hash\" ORDER BY b.\"height\", b.\"id\" LIMIT 1)"
+       << " WHERE \"id\" IN " << getSqlIdList(tx_ids);
+    db_->execute(ss.str());
+
+    for (auto& view: views)
+    {
         std::shared_ptr<BlockHeader> blockheader(db_->load<BlockHeader>(view.blockheader_id));
-        tx->blockheader(blockheader);
-        db_->update(tx);
-        notifyTxStatusChanged(tx);
-        count++;
-        LOGGER(debug) << "Vault::updateConfirmations_unwrapped - transaction " << uchar_vector(tx->hash()).getHex() << " confirmed in block " << uchar_vector(tx->blockheader()->hash()).getHex() << " height: " << tx->blockheader()->height() << std::endl;
+        if (tx && tx->id() == view.tx_id)
+        {
+            tx->blockheader(blockheader);
+            notifyTxStatusChanged_unwrapped(tx);
+        }
+        else
+        {
+            notifyTxConfirmationChanged_unwrapped(view.tx_id, Tx::CONFIRMED, blockheader);
+        }
+        LOGGER(debug) << "Vault::updateConfirmations_unwrapped - transaction " << uchar_vector(view.tx_hash).getHex() << " confirmed in block " << uchar_vector(view.block_hash).getHex() << " height: " << view.block_height << std::endl;
     }
-    return count;
+    return views.size();
+}
+
+void Vault::notifyTxInserted_unwrapped(std::shared_ptr<Tx> tx)
+{
+    pendingTxBatch.inserted.push_back(tx->id());
+    notifyTxInserted(tx);
+}
+
+static TxStatusDelta getTxStatusDelta(const Tx& tx)
+{
+    return TxStatusDelta(tx.id(), tx.status(), tx.blockheader() ? tx.blockheader()->height() : 0);
+}
+
+void Vault::notifyTxStatusChanged_unwrapped(std::shared_ptr<Tx> tx)
+{
+    pendingTxBatch.status_changed.push_back(getTxStatusDelta(*tx));
+    notifyTxStatusChanged(tx);
+}
+
+void Vault::notifyTxStatusChanged_unwrapped(const Tx& tx)
+{
+    pendingTxBatch.status_changed.push_back(getTxStatusDelta(tx));
+    if (!notifyTxStatusChanged.empty()) notifyTxStatusChanged(std::make_shared<Tx>(tx));
+}
+
+void Vault::notifyTxConfirmationChanged_unwrapped(unsigned long tx_id, Tx::status_t status, std::shared_ptr<BlockHeader> blockheader)
+{
+    pendingTxBatch.status_changed.push_back(TxStatusDelta(tx_id, status, blockheader ? blockheader->height() : 0));
+
+    // The session can hold a copy loaded before the statement ran, so make the same change to it
+    // whether or not anyone is listening. The tx is only loaded from the database for the slots.
+    std::shared_ptr<Tx> tx;
+    if (odb::session::has_current()) { tx = odb::session::current().cache_find<Tx>(*db_, tx_id); }
+    if (!tx)
+    {
+        if (notifyTxStatusChanged.empty()) return;
+        tx = db_->load<Tx>(tx_id);
+    }
+
+    tx->blockheader(blockheader);
+    if (!notifyTxStatusChanged.empty()) notifyTxStatusChanged(tx);
+}
+
+void Vault::notifyTxBatch_unwrapped()
+{
+    if (pendingTxBatch.empty()) return;
+
+    TxBatch batch;
+    std::swap(batch, pendingTxBatch);
+    notifyTxBatch(batch);
 }
 
@@ -21,12 +21,106 @@
 
 #include <boost/thread.hpp>
 
+#include <functional>
+
 namespace CoinDB
 {
 
 typedef Signals::Signal<std::shared_ptr<Tx>> TxSignal;
 typedef Signals::Signal<std::shared_ptr<MerkleBlock>> MerkleBlockSignal;
 
+// A tx's status after a change, with the height of the block confirming it or 0 if unconfirmed.
+struct TxStatusDelta
+{
+    TxStatusDelta(unsigned long tx_id_, Tx::status_t status_, uint32_t height_) : tx_id(tx_id_), status(status_), height(height_) { }
+
+    unsigned long tx_id;
+    Tx::status_t status;
+    uint32_t height;
+};
+
+// The txs inserted and changed by one database transaction, in the order the changes were made.
+// A tx can have several deltas, as when a reorg unconfirms it and a new block confirms it again.
+// The last is its status once committed.
+struct TxBatch
+{
+    std::vector<unsigned long> inserted;
+    std::vector<TxStatusDelta> status_changed;
+
+    bool empty() const { return inserted.empty() && status_changed.empty(); }
+    void clear() { inserted.clear(); status_changed.clear(); }
+};
+
+typedef Signals::Signal<TxBatch> TxBatchSignal;
+
+// Visitors return false to stop the listing.
+typedef std::function<bool(const SigningScriptView&)> SigningScriptViewVisitor;
+typedef std::function<bool(const TxOutView&)> TxOutViewVisitor;
+
+// Keyset cursors hold the sort key of the last row of a page. Listings resume strictly after it,
+// so pages stay consistent while rows are inserted and never rescan the rows already returned.
+// A null cursor starts from the first row.
+struct SigningScriptViewCursor
+{
+    SigningScriptViewCursor() : status(0), index(0), id(0) { }
+    explicit SigningScriptViewCursor(const SigningScriptView& view)
+        : account_name(view.account_name), bin_name(view.account_bin_name), status(view.status), index(view.index), label(view.label), id(view.id) { }
+
+    bool isNull() const { return id == 0; }
+
+    std::string account_name;
+    std::string bin_name;
+    int status;
+    uint32_t index;
+    std::string label;
+    unsigned long id;
+};
+
+// Signing script listing orders. SCRIPT_SORT_DEFAULT is account name, bin name, status descending, index.
+// The others sort on a single column with ties broken by id, all in the direction asked for.
+enum SigningScriptViewSort
+{
+    SCRIPT_SORT_DEFAULT,
+    SCRIPT_SORT_INDEX,
+    SCRIPT_SORT_STATUS,
+    SCRIPT_SORT_LABEL
+};
+
+struct TxOutViewCursor
+{
+    TxOutViewCursor() : height(0), timestamp(0), tx_id(0), id(0) { }
+    explicit TxOutViewCursor(const TxOutView& view)
+        : height(view.height), timestamp(view.tx_timestamp), tx_id(view.tx_id), id(view.id) { }
+
+    bool isNull() const { return id == 0; }
+
+    uint32_t height; // 0 for unconfirmed
+    uint32_t timestamp;
+    unsigned long tx_id;
+    unsigned long id;
+};
+
+// An item for insertBatch. Exactly one of tx and merkleblock is set.
+struct BatchInsertItem
+{
+    BatchInsertItem() { }
+    explicit BatchInsertItem(std::shared_ptr<Tx> tx_) : tx(tx_) { }
+    explicit BatchInsertItem(std::shared_ptr<MerkleBlock> merkleblock_) : merkleblock(merkleblock_) { }
+
+    std::shared_ptr<Tx> tx;
+    std::shared_ptr<MerkleBlock> merkleblock;
+};
+
+struct BatchInsertResult
+{
+    enum status_t { INSERTED, UNCHANGED, FAILED };
+
+    BatchInsertResult() : status(UNCHANGED) { }
+
+    status_t status;
+    std::string error; // set if FAILED
+};
+
 class Vault
 {
 public:
@@ -100,6 +194,24 @@ public:
     std::vector<SigningScriptView>          getSigningScriptViews(const std::string& account_name = "", const std::string& bin_name = "", int flags = SigningScript::ALL) const;
     std::vector<TxOutView>                  getTxOutViews(const std::string& account_name = "", const std::string& bin_name = "", int role_flags = TxOut::ROLE_BOTH, int txout_status_flags = TxOut::BOTH, int tx_status_flags = Tx::ALL, bool hide_change = true) const;
 
+    // Views of a single tx in listing order, for refreshing it in place after it changes.
+    std::vector<TxOutView>                  getTxOutViewsForTx(unsigned long tx_id, const std::string& account_name = "", int role_flags = TxOut::ROLE_BOTH, bool hide_change = true) const;
+
+    // Pages of at most limit rows following the after cursor. next is set to resume from, or to a null cursor after the last page.
+    // A txout that is both sent and received by our accounts is one row but yields a view per role.
+    std::vector<SigningScriptView>          getSigningScriptViewsPage(const SigningScriptViewCursor& after, std::size_t limit, SigningScriptViewCursor& next, const std::string& account_name = "", const std::string& bin_name = "", int flags = SigningScript::ALL) const;
+
+    // As above, in the given order and with only labels containing label_filter if not empty. Only ASCII letters
+    // match regardless of case, since the filter is an SQLite LIKE.
+    // Cursors are only valid for the order and filter they were returned for.
+    std::vector<SigningScriptView>          getSigningScriptViewsPage(const SigningScriptViewCursor& after, std::size_t limit, SigningScriptViewCursor& next, const std::string& account_name, const std::string& bin_name, int flags, SigningScriptViewSort sort, bool descending, const std::string& label_filter) const;
+    std::vector<TxOutView>                  getTxOutViewsPage(const TxOutViewCursor& after, std::size_t limit, TxOutViewCursor& next, const std::string& account_name = "", const std::string& bin_name = "", int role_flags = TxOut::ROLE_BOTH, int txout_status_flags = TxOut::BOTH, int tx_status_flags = Tx::ALL, bool hide_change = true) const;
+
+    // Stream rows to the visitor in listing order without holding the result set. Return the number of rows visited.
+    // The vault stays locked while visiting, so visitors must not call back into it.
+    unsigned int                            visitSigningScriptViews(SigningScriptViewVisitor visitor, const std::string& account_name = "", const std::string& bin_name = "", int flags = SigningScript::ALL, const SigningScriptViewCursor& after = SigningScriptViewCursor()) const;
+    unsigned int                            visitTxOutViews(TxOutViewVisitor visitor, const std::string& account_name = "", const std::string& bin_name = "", int role_flags = TxOut::ROLE_BOTH, int txout_status_flags = TxOut::BOTH, int tx_status_flags = Tx::ALL, bool hide_change = true, const TxOutViewCursor& after = TxOutViewCursor()) const;
+
     ////////////////////////////
     // ACCOUNT BIN OPERATIONS //
     ////////////////////////////
@@ -132,17 +244,30 @@ public:
     unsigned int                            deleteMerkleBlock(const bytes_t& hash);
     unsigned int                            deleteMerkleBlock(uint32_t height);
 
+    // Inserts txs and merkle blocks in order within a single database transaction. Each item gets its own
+    // savepoint, so an item that throws or changes nothing is rolled back alone. Results are in item order.
+    std::vector<BatchInsertResult>          insertBatch(const std::vector<BatchInsertItem>& items);
+
     ////////////////////////
     // SLOT SUBSCRIPTIONS //
     ////////////////////////
     Signals::Connection subscribeTxInserted(TxSignal::Slot slot) { return notifyTxInserted.connect(slot); }
     Signals::Connection subscribeTxStatusChanged(TxSignal::Slot slot) { return notifyTxStatusChanged.connect(slot); }
     Signals::Connection subscribeMerkleBlockInserted(MerkleBlockSignal::Slot slot) { return notifyMerkleBlockInserted.connect(slot); }
+    bool unsubscribeTxInserted(Signals::Connection connection) { return notifyTxInserted.disconnect(connection); }
+    bool unsubscribeTxStatusChanged(Signals::Connection connection) { return notifyTxStatusChanged.disconnect(connection); }
+    bool unsubscribeMerkleBlockInserted(Signals::Connection connection) { return notifyMerkleBlockInserted.disconnect(connection); }
+
+    // Emitted once for each committed database transaction that inserted or changed txs, while the vault is still locked.
+    // The per-tx status signal copies each tx a block confirms or a reorg unconfirms, so subscribers to bulk changes should prefer this.
+    Signals::Connection subscribeTxBatch(TxBatchSignal::Slot slot) { return notifyTxBatch.connect(slot); }
+    bool unsubscribeTxBatch(Signals::Connection connection) { return notifyTxBatch.disconnect(connection); }
     void clearAllSlots()
     {
         notifyTxInserted.clear();
         notifyTxStatusChanged.clear();
         notifyMerkleBlockInserted.clear();
+        notifyTxBatch.clear();
     }
 
 protected:
@@ -151,6 +276,7 @@ protected:
     ///////////////////////
     uint32_t                                getSchemaVersion_unwrapped() const;
     void                                    setSchemaVersion_unwrapped(uint32_t version);
+    void                                    migrateSchema(); // Brings an existing vault up to SCHEMA_VERSION.
 
     uint32_t                                getHorizonTimestamp_unwrapped() const;
     uint32_t                                getMaxFirstBlockTimestamp_unwrapped() const;
@@ -202,6 +328,8 @@ protected:
     // The following method throws KeychainChainCodeLockedException
     void                                    refillAccountPool_unwrapped(std::shared_ptr<Account> account);
 
+    unsigned int                            visitSigningScriptViews_unwrapped(SigningScriptViewVisitor visitor, const std::string& account_name, const std::string& bin_name, int flags, const SigningScriptViewCursor& after, SigningScriptViewSort sort = SCRIPT_SORT_DEFAULT, bool descending = false, const std::string& label_filter = "") const;
+    unsigned int                            visitTxOutViews_unwrapped(TxOutViewVisitor visitor, const std::string& account_name, const std::string& bin_name, int role_flags, int txout_status_flags, int tx_status_flags, bool hide_change, const TxOutViewCursor& after, unsigned long tx_id = 0, TxOutViewCursor* last_scanned = nullptr) const;
     bool                                    accountExists_unwrapped(const std::string& account_name) const;
     std::shared_ptr<Account>                getAccount_unwrapped(const std::string& account_name) const; // throws AccountNotFoundException
 
@@ -246,6 +374,16 @@ protected:
     TxSignal                                notifyTxInserted;
     TxSignal                                notifyTxStatusChanged;
     MerkleBlockSignal                       notifyMerkleBlockInserted;
+    TxBatchSignal                           notifyTxBatch;
+
+    // The following methods also add the change to pendingTxBatch
+    void                                    notifyTxInserted_unwrapped(std::shared_ptr<Tx> tx);
+    void                                    notifyTxStatusChanged_unwrapped(std::shared_ptr<Tx> tx);
+    void                                    notifyTxStatusChanged_unwrapped(const Tx& tx); // Copies tx only if a per-tx slot is connected.
+    void                                    notifyTxConfirmationChanged_unwrapped(unsigned long tx_id, Tx::status_t status, std::shared_ptr<BlockHeader> blockheader); // For set-based updates. Updates the session's copy of the tx, and loads it only if a per-tx slot is connected.
+    void                                    notifyTxBatch_unwrapped(); // Call after committing. Emits pendingTxBatch if it is not empty and clears it.
+
+    TxBatch                                 pendingTxBatch; // Cleared when a write transaction begins.
 
 private:
     mutable boost::mutex mutex;
@@ -253,6 +391,7 @@ private:
 
     mutable secure_bytes_t chainCodeUnlockKey;
     mutable std::map<std::string, secure_bytes_t> mapPrivateKeyUnlock;
+    mutable Coin::StretchedKeyCache stretchedKeyCache; // stretched lock keys for this session
 };
 
 }
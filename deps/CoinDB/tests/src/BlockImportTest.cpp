@@ -0,0 +1,201 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// BlockImportTest.cpp
+//
+// Copyright (c) 2014 Eric Lombrozo
+//
+// All Rights Reserved.
+//
+// Imports a chain from ChainGenerator with BlockFileImporter. Blocks parsed
+// by several workers and applied in batches must leave the vault as a serial
+// import does, holding every tx the chain pays to or spends from it. A block
+// file cut short or holding garbage must fail the import without committing
+// past the last good batch, and the import must resume once it is restored.
+//
+// Usage: BlockImportTest [work directory]
+//
+
+#include <Vault.h>
+
+#include "../../tools/src/blockimport.h"
+#include "../../tools/src/chaingenerator.h"
+
+#include <CoinCore/numericdata.h>
+
+#include <stdutils/benchutils.h>
+
+#include <logger/logger.h>
+
+#include <boost/filesystem.hpp>
+
+#include <fstream>
+#include <iostream>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+
+using namespace CoinDB;
+using namespace std;
+
+namespace fs = boost::filesystem;
+
+const string ACCOUNT_NAME = "test";
+const uint32_t BLOCKS = 60;
+const unsigned int THREADS = 4;
+const unsigned int BATCH_BLOCKS = 7;
+
+static bool g_ok = true;
+
+static void check(bool condition, const string& what)
+{
+    if (condition) return;
+    cout << "FAILED: " << what << endl;
+    g_ok = false;
+}
+
+// What two imports of the same chain must agree on.
+struct VaultState
+{
+    uint32_t height;
+    bytes_t bestHash;
+    set<string> txouts;
+    set<bytes_t> txs;
+
+    bool operator==(const VaultState& other) const { return height == other.height && bestHash == other.bestHash && txouts == other.txouts && txs == other.txs; }
+};
+
+static VaultState getVaultState(const string& filename)
+{
+    Vault vault(filename, false);
+    VaultState state;
+    std::shared_ptr<BlockHeader> best = vault.getBestBlockHeader();
+    state.height = best ? best->height() : 0;
+    if (best) state.bestHash = best->hash();
+
+    for (auto& view: vault.getTxOutViews("", "", TxOut::ROLE_BOTH, TxOut::BOTH, Tx::ALL, false))
+    {
+        stringstream ss;
+        ss << uchar_vector(view.tx_hash).getHex() << ":" << view.tx_index << " " << view.role_flags << " " << view.value << " " << view.tx_status << " " << view.height;
+        state.txouts.insert(ss.str());
+        state.txs.insert(view.tx_hash);
+    }
+    return state;
+}
+
+static BlockFileImporter::Stats importBlocks(const string& filename, const string& blocksDir, unsigned int threads, unsigned int batchBlocks)
+{
+    Vault vault(filename, false);
+    BlockFileImporter importer(vault, blocksDir, uint_to_vch(CoinQ::getBitcoinRegtestParams().magic_bytes(), _BIG_ENDIAN), threads, batchBlocks);
+    return importer.import();
+}
+
+// Returns the error, or an empty string if the import succeeded.
+static string importError(const string& filename, const string& blocksDir)
+{
+    try
+    {
+        importBlocks(filename, blocksDir, THREADS, BATCH_BLOCKS);
+    }
+    catch (const exception& e)
+    {
+        return e.what();
+    }
+    return "";
+}
+
+int main(int argc, char* argv[])
+{
+    fs::path workDir(argc > 1 ? argv[1] : "BlockImportTest");
+    fs::path blocksDir = workDir / "blocks";
+    fs::path templateFile = workDir / "template.db";
+
+    INIT_LOGGER("BlockImportTest.log");
+
+    try
+    {
+        fs::remove_all(workDir);
+        fs::create_directories(blocksDir);
+
+        // A vault with one account, and a chain paying its scripts. The vault files below are copies of it.
+        ChainGenerator::Options options;
+        options.blocks = BLOCKS;
+        options.txsPerBlock = 20;
+        options.vaultTxsPerBlock = 3;
+        options.spendTxsPerBlock = 2;
+        options.scripts = 20;
+
+        ChainGenerator::Stats chainStats;
+        {
+            stdutils::bench_random rng;
+            Vault vault(templateFile.string(), true);
+            vault.newKeychain(ACCOUNT_NAME, rng.bytes<secure_bytes_t>(32));
+            vault.unlockChainCodes(secure_bytes_t());
+            vault.newAccount(ACCOUNT_NAME, 1, vector<string>(1, ACCOUNT_NAME));
+            ChainGenerator generator(vault, ACCOUNT_NAME, options);
+            chainStats = generator.generate(blocksDir.string());
+        }
+
+        auto copyVault = [&](const string& name)
+        {
+            fs::path filename = workDir / name;
+            fs::copy_file(templateFile, filename, fs::copy_option::overwrite_if_exists);
+            return filename.string();
+        };
+
+        // A parallel import with batched, in-order apply against a serial one. Spends of outputs found
+        // during the import are only caught if blocks are applied in order.
+        string serialFile = copyVault("serial.db");
+        BlockFileImporter::Stats serial = importBlocks(serialFile, blocksDir.string(), 1, 1);
+        check(serial.startHeight == 1 && serial.height == BLOCKS && serial.bestHeight == BLOCKS && serial.blocks == BLOCKS, "serial import applies every block");
+        check(serial.txsInserted == chainStats.vaultTxs + chainStats.spendTxs, "serial import inserts every vault tx");
+
+        string parallelFile = copyVault("parallel.db");
+        BlockFileImporter::Stats parallel = importBlocks(parallelFile, blocksDir.string(), THREADS, BATCH_BLOCKS);
+        check(parallel.startHeight == 1 && parallel.height == BLOCKS && parallel.blocks == BLOCKS, "parallel import applies every block");
+        check(parallel.txsScanned == serial.txsScanned && parallel.txsMatched == serial.txsMatched && parallel.txsInserted == serial.txsInserted, "parallel import matches the same txs");
+
+        VaultState expected = getVaultState(serialFile);
+        check(expected.height == BLOCKS && expected.txs.size() == serial.txsInserted, "serial vault holds the chain");
+        check(getVaultState(parallelFile) == expected, "parallel vault equals serial vault");
+
+        BlockFileImporter::Stats again = importBlocks(parallelFile, blocksDir.string(), THREADS, BATCH_BLOCKS);
+        check(again.startHeight == BLOCKS + 1 && again.blocks == 0, "import of an up to date vault applies nothing");
+
+        // The last block is cut short. The batches before its batch stay committed.
+        fs::path truncatedDir = workDir / "truncated";
+        fs::create_directories(truncatedDir);
+        fs::copy_file(blocksDir / "blk00000.dat", truncatedDir / "blk00000.dat");
+        fs::resize_file(truncatedDir / "blk00000.dat", fs::file_size(blocksDir / "blk00000.dat") - 1);
+
+        string truncatedFile = copyVault("truncated.db");
+        check(!importError(truncatedFile, truncatedDir.string()).empty(), "truncated block file fails the import");
+        check(getVaultState(truncatedFile).height == (BLOCKS - 1) / BATCH_BLOCKS * BATCH_BLOCKS, "batches before the truncated block are kept");
+
+        BlockFileImporter::Stats resumed = importBlocks(truncatedFile, blocksDir.string(), THREADS, BATCH_BLOCKS);
+        check(resumed.startHeight == (BLOCKS - 1) / BATCH_BLOCKS * BATCH_BLOCKS + 1 && resumed.height == BLOCKS, "import resumes after the kept batches");
+        check(getVaultState(truncatedFile) == expected, "resumed vault equals serial vault");
+
+        // A file that is not a block file.
+        fs::path garbageDir = workDir / "garbage";
+        fs::create_directories(garbageDir);
+        fs::copy_file(blocksDir / "blk00000.dat", garbageDir / "blk00000.dat");
+        {
+            stdutils::bench_random rng(2);
+            bytes_t garbage = rng.bytes<bytes_t>(4096);
+            garbage[0] = 0xff;
+            ofstream file((garbageDir / "blk00001.dat").string().c_str(), ios::binary);
+            file.write((const char*)garbage.data(), garbage.size());
+        }
+
+        string garbageFile = copyVault("garbage.db");
+        check(importError(garbageFile, garbageDir.string()).find("Invalid network magic") == 0, "garbage block file fails the import");
+        check(getVaultState(garbageFile).height == 0, "garbage block file commits nothing");
+    }
+    catch (const exception& e)
+    {
+        check(false, string("no exception: ") + e.what());
+    }
+
+    cout << (g_ok ? "All block import checks passed." : "Some block import checks failed.") << endl;
+    return g_ok ? 0 : 1;
+}
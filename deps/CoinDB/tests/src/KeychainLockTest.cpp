@@ -0,0 +1,148 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// KeychainLockTest.cpp
+//
+// Copyright (c) 2014 Eric Lombrozo
+//
+// All Rights Reserved.
+//
+// Locks keychain private keys and chain codes with stretched keys and checks
+// that they unlock only with the right key, that a wrong key leaves the right
+// one working, and that locking again forgets the stretched key so the secret
+// cannot be read until it is unlocked anew. Keychains stored unencrypted must
+// still open without a key.
+//
+// Usage: KeychainLockTest [vault file]
+//
+
+#include <Vault.h>
+
+#include <CoinCore/keystretch.h>
+
+#include <stdutils/benchutils.h>
+
+#include <logger/logger.h>
+
+#include <boost/filesystem.hpp>
+
+#include <iostream>
+#include <stdexcept>
+
+using namespace CoinDB;
+using namespace std;
+
+namespace fs = boost::filesystem;
+
+static bool g_ok = true;
+
+static void check(bool condition, const string& what)
+{
+    if (condition) return;
+    cout << "FAILED: " << what << endl;
+    g_ok = false;
+}
+
+static secure_bytes_t toKey(const string& s)
+{
+    return secure_bytes_t(s.begin(), s.end());
+}
+
+// Returns true if the extended key can be read.
+template<class LockedException>
+static bool canRead(Vault& vault, const string& keychain_name, bool get_private, secure_bytes_t& extkey)
+{
+    try
+    {
+        extkey = vault.getKeychainExtendedKey(keychain_name, get_private);
+        return true;
+    }
+    catch (const LockedException&)
+    {
+        return false;
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    fs::path filename(argc > 1 ? argv[1] : "KeychainLockTest.db");
+
+    INIT_LOGGER("KeychainLockTest.log");
+
+    // The cheapest cost keeps the test fast. The cost is read back from the salt.
+    Coin::ScryptParams params(Coin::MIN_STRETCH_LOG2N, 8, 1);
+    secure_bytes_t lockKey = toKey("private key passphrase");
+    secure_bytes_t chainCodeKey = toKey("chain code passphrase");
+    secure_bytes_t wrongKey = toKey("wrong passphrase");
+
+    try
+    {
+        fs::remove(filename);
+        stdutils::bench_random rng;
+
+        secure_bytes_t plainPrivate, plainPublic, lockedPrivate, lockedPublic;
+        {
+            Vault vault(filename.string(), true);
+            vault.newKeychain("plain", rng.bytes<secure_bytes_t>(32));
+            vault.newKeychain("locked", rng.bytes<secure_bytes_t>(32), lockKey, Coin::makeStretchSalt(params));
+
+            check(canRead<KeychainPrivateKeyLockedException>(vault, "plain", true, plainPrivate), "unencrypted private key needs no unlock");
+            check(canRead<KeychainPrivateKeyLockedException>(vault, "plain", false, plainPublic), "unencrypted chain code needs no unlock");
+
+            secure_bytes_t extkey;
+            check(!canRead<KeychainPrivateKeyLockedException>(vault, "locked", true, extkey), "locked private key cannot be read");
+
+            bool bThrew = false;
+            try { vault.unlockKeychain("locked", wrongKey); } catch (const KeychainPrivateKeyLockedException&) { bThrew = true; }
+            check(bThrew, "wrong key does not unlock the private key");
+            check(!canRead<KeychainPrivateKeyLockedException>(vault, "locked", true, extkey), "private key stays locked after a wrong key");
+
+            vault.unlockKeychain("locked", lockKey);
+            check(canRead<KeychainPrivateKeyLockedException>(vault, "locked", true, lockedPrivate), "right key unlocks the private key after a wrong one");
+
+            vault.lockKeychain("locked");
+            check(!canRead<KeychainPrivateKeyLockedException>(vault, "locked", true, extkey), "locking again locks the private key");
+
+            vault.unlockKeychain("locked", lockKey);
+            check(canRead<KeychainPrivateKeyLockedException>(vault, "locked", true, extkey) && extkey == lockedPrivate, "private key unlocks again");
+
+            // Lock every chain code with a stretched key.
+            vault.setChainCodeUnlockKey(chainCodeKey);
+            check(!canRead<KeychainChainCodeUnlockFailedException>(vault, "plain", false, extkey), "locked chain code cannot be read");
+
+            bThrew = false;
+            try { vault.unlockChainCodes(wrongKey); } catch (const KeychainChainCodeUnlockFailedException&) { bThrew = true; }
+            check(bThrew, "wrong key does not unlock the chain codes");
+
+            vault.unlockChainCodes(chainCodeKey);
+            check(canRead<KeychainChainCodeUnlockFailedException>(vault, "plain", false, extkey) && extkey == plainPublic, "right key unlocks the chain codes");
+            check(canRead<KeychainChainCodeUnlockFailedException>(vault, "locked", false, lockedPublic), "right key unlocks every chain code");
+
+            vault.newKeychain("added", rng.bytes<secure_bytes_t>(32));
+            vault.lockChainCodes();
+            check(!canRead<KeychainChainCodeUnlockFailedException>(vault, "plain", false, extkey), "locking again locks the chain codes");
+            check(!canRead<KeychainChainCodeUnlockFailedException>(vault, "added", false, extkey), "a new keychain's chain code is locked with the others");
+        }
+
+        // A new session has no unlock keys and no stretched keys.
+        {
+            Vault vault(filename.string(), false);
+            secure_bytes_t extkey;
+            check(!canRead<KeychainChainCodeUnlockFailedException>(vault, "plain", false, extkey), "chain codes are locked on reopening");
+
+            vault.unlockChainCodes(chainCodeKey);
+            check(canRead<KeychainPrivateKeyLockedException>(vault, "plain", true, extkey) && extkey == plainPrivate, "unencrypted private key survives reopening");
+            check(!canRead<KeychainPrivateKeyLockedException>(vault, "locked", true, extkey), "private key is locked on reopening");
+
+            vault.unlockKeychain("locked", lockKey);
+            check(canRead<KeychainPrivateKeyLockedException>(vault, "locked", true, extkey) && extkey == lockedPrivate, "private key unlocks on reopening");
+            check(canRead<KeychainPrivateKeyLockedException>(vault, "locked", false, extkey) && extkey == lockedPublic, "public key is unchanged");
+        }
+    }
+    catch (const exception& e)
+    {
+        check(false, string("no exception: ") + e.what());
+    }
+
+    cout << (g_ok ? "All keychain lock checks passed." : "Some keychain lock checks failed.") << endl;
+    return g_ok ? 0 : 1;
+}
@@ -0,0 +1,173 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// MerkleBlockTest.cpp
+//
+// Copyright (c) 2014 Eric Lombrozo
+//
+// All Rights Reserved.
+//
+// Inserts merkle blocks confirming vault txs, then reorganizes and deletes
+// them, and checks each tx's status and block after every step. Blocks are
+// confirmed and unconfirmed with hand-written statements over the tables ODB
+// generates, so this catches a schema change they no longer match. Also checks
+// that a vault from an older schema version is migrated when opened.
+//
+// Usage: MerkleBlockTest [vault file]
+//
+
+#include <Vault.h>
+
+#include <CoinCore/CoinNodeData.h>
+#include <CoinCore/MerkleTree.h>
+
+#include <stdutils/benchutils.h>
+
+#include <logger/logger.h>
+
+#include <boost/filesystem.hpp>
+
+#include <iostream>
+#include <stdexcept>
+
+using namespace CoinDB;
+using namespace std;
+
+namespace fs = boost::filesystem;
+
+const string ACCOUNT_NAME = "test";
+const uint32_t BITS = 0x207fffff; // regtest
+const uint32_t BLOCK_INTERVAL = 600;
+
+static bool g_ok = true;
+
+static void check(bool condition, const string& what)
+{
+    if (condition) return;
+    cout << "FAILED: " << what << endl;
+    g_ok = false;
+}
+
+static Coin::Transaction payTo(const bytes_t& txoutscript, stdutils::bench_random& rng)
+{
+    Coin::Transaction tx;
+    tx.addInput(Coin::TxIn(Coin::OutPoint(rng.bytes<uchar_vector>(32), 0), rng.bytes<uchar_vector>(107), 0xffffffff));
+    tx.addOutput(Coin::TxOut(100000 + rng.next() % 100000000, txoutscript));
+    return tx;
+}
+
+static Coin::CoinBlock makeBlock(const Coin::CoinBlock* prev, uint32_t timestamp, const vector<Coin::Transaction>& txs, stdutils::bench_random& rng)
+{
+    Coin::CoinBlock block(2, timestamp, BITS, prev ? prev->blockHeader.getHashLittleEndian() : rng.bytes<uchar_vector>(32));
+    Coin::Transaction coinbase;
+    coinbase.addInput(Coin::TxIn(Coin::OutPoint(g_zero32bytes, 0xffffffff), rng.bytes<uchar_vector>(8), 0xffffffff));
+    coinbase.addOutput(Coin::TxOut(5000000000ull, rng.bytes<uchar_vector>(25)));
+    block.addTransaction(coinbase);
+    for (auto& tx: txs) { block.addTransaction(tx); }
+    block.updateMerkleRoot();
+    return block;
+}
+
+// The merkle block a peer would send for the vault, matching every tx but the coinbase.
+static bool insertMerkleBlock(Vault& vault, const Coin::CoinBlock& block, uint32_t height)
+{
+    vector<Coin::PartialMerkleTree::MerkleLeaf> leaves;
+    for (size_t i = 0; i < block.txs.size(); i++) { leaves.push_back(make_pair(block.txs[i].getHash(), i > 0)); }
+    Coin::PartialMerkleTree tree(leaves);
+
+    std::shared_ptr<MerkleBlock> merkleblock(new MerkleBlock());
+    merkleblock->fromCoinCore(Coin::MerkleBlock(block.blockHeader, leaves.size(), tree.getMerkleHashesVector(), tree.getFlags()), height);
+    return vault.insertMerkleBlock(merkleblock) != nullptr;
+}
+
+static bool isConfirmedIn(Vault& vault, const bytes_t& tx_hash, const Coin::CoinBlock& block, uint32_t height)
+{
+    std::shared_ptr<Tx> tx = vault.getTx(tx_hash);
+    return tx->status() == Tx::CONFIRMED && tx->blockheader() && tx->blockheader()->hash() == block.blockHeader.getHashLittleEndian() && tx->blockheader()->height() == height;
+}
+
+static bool isUnconfirmed(Vault& vault, const bytes_t& tx_hash)
+{
+    std::shared_ptr<Tx> tx = vault.getTx(tx_hash);
+    return tx->status() == Tx::PROPAGATED && !tx->blockheader();
+}
+
+int main(int argc, char* argv[])
+{
+    fs::path filename(argc > 1 ? argv[1] : "MerkleBlockTest.db");
+
+    INIT_LOGGER("MerkleBlockTest.log");
+
+    try
+    {
+        fs::remove(filename);
+        stdutils::bench_random rng;
+
+        // Created at the version before Tx.blockheader was indexed.
+        {
+            Vault vault(filename.string(), true, 5);
+            vault.newKeychain(ACCOUNT_NAME, rng.bytes<secure_bytes_t>(32));
+            vault.unlockChainCodes(secure_bytes_t());
+            vault.newAccount(ACCOUNT_NAME, 1, vector<string>(1, ACCOUNT_NAME));
+        }
+
+        Vault vault(filename.string(), false);
+        check(vault.getSchemaVersion() == SCHEMA_VERSION, "older vault is migrated when opened");
+
+        vector<Coin::Transaction> txs;
+        for (int i = 0; i < 3; i++) { txs.push_back(payTo(vault.issueSigningScript(ACCOUNT_NAME)->txoutscript(), rng)); }
+
+        vector<bytes_t> hashes;
+        for (auto& coin_tx: txs)
+        {
+            std::shared_ptr<Tx> tx(new Tx());
+            tx->set(coin_tx);
+            tx = vault.insertTx(tx);
+            check(tx != nullptr, "tx paying the vault is inserted");
+            if (tx) hashes.push_back(tx->hash());
+        }
+        if (hashes.size() != txs.size()) throw runtime_error("Could not insert txs.");
+        check(isUnconfirmed(vault, hashes[0]), "inserted tx is unconfirmed");
+
+        // Block 1 is the vault's first. Block 2 confirms tx 0 and block 3 confirms txs 1 and 2.
+        uint32_t timestamp = vault.getMaxFirstBlockTimestamp();
+        Coin::CoinBlock block1 = makeBlock(nullptr, timestamp, vector<Coin::Transaction>(), rng);
+        Coin::CoinBlock block2 = makeBlock(&block1, timestamp + BLOCK_INTERVAL, vector<Coin::Transaction>(1, txs[0]), rng);
+        Coin::CoinBlock block3 = makeBlock(&block2, timestamp + 2 * BLOCK_INTERVAL, vector<Coin::Transaction>(txs.begin() + 1, txs.end()), rng);
+
+        check(insertMerkleBlock(vault, block1, 1), "first block is inserted");
+        check(insertMerkleBlock(vault, block2, 2), "block 2 is inserted");
+        check(insertMerkleBlock(vault, block3, 3), "block 3 is inserted");
+        check(isConfirmedIn(vault, hashes[0], block2, 2), "tx 0 is confirmed in block 2");
+        check(isConfirmedIn(vault, hashes[1], block3, 3) && isConfirmedIn(vault, hashes[2], block3, 3), "txs 1 and 2 are confirmed in block 3");
+
+        // A competing block 3 confirms only tx 1, then a block 4 on top of it.
+        Coin::CoinBlock block3b = makeBlock(&block2, timestamp + 2 * BLOCK_INTERVAL + 1, vector<Coin::Transaction>(1, txs[1]), rng);
+        Coin::CoinBlock block4b = makeBlock(&block3b, timestamp + 3 * BLOCK_INTERVAL, vector<Coin::Transaction>(), rng);
+        check(insertMerkleBlock(vault, block3b, 3), "competing block 3 is inserted");
+        check(insertMerkleBlock(vault, block4b, 4), "block 4 is inserted on the competing block");
+
+        std::shared_ptr<BlockHeader> best = vault.getBestBlockHeader();
+        check(best && best->height() == 4 && best->hash() == block4b.blockHeader.getHashLittleEndian(), "best block follows the reorg");
+        check(!vault.getBlockHeader(3) || vault.getBlockHeader(3)->hash() == block3b.blockHeader.getHashLittleEndian(), "replaced block 3 is gone");
+        check(isConfirmedIn(vault, hashes[0], block2, 2), "tx below the reorg stays confirmed");
+        check(isConfirmedIn(vault, hashes[1], block3b, 3), "tx in both blocks 3 is confirmed in the competing one");
+        check(isUnconfirmed(vault, hashes[2]), "tx only in the replaced block is unconfirmed");
+
+        // Deleting from height 2 unconfirms everything above block 1.
+        check(vault.deleteMerkleBlock(2) == 3, "blocks 2 to 4 are deleted");
+        best = vault.getBestBlockHeader();
+        check(best && best->height() == 1, "block 1 is best after the delete");
+        for (auto& hash: hashes) { check(isUnconfirmed(vault, hash), "tx is unconfirmed after its block is deleted"); }
+
+        // Confirmations come back when the blocks do.
+        check(insertMerkleBlock(vault, block2, 2) && insertMerkleBlock(vault, block3, 3), "original blocks are inserted again");
+        check(isConfirmedIn(vault, hashes[0], block2, 2) && isConfirmedIn(vault, hashes[2], block3, 3), "txs are confirmed again");
+    }
+    catch (const exception& e)
+    {
+        check(false, string("no exception: ") + e.what());
+    }
+
+    cout << (g_ok ? "All merkle block checks passed." : "Some merkle block checks failed.") << endl;
+    return g_ok ? 0 : 1;
+}
@@ -0,0 +1,164 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// PagingTest.cpp
+//
+// Copyright (c) 2014 Eric Lombrozo
+//
+// All Rights Reserved.
+//
+// Pages through the txouts and signing scripts of a vault holding a chain from
+// ChainGenerator. For every page size the pages joined must equal the full
+// listing, with no view repeated or left out. Listing receiving txouts only
+// skips the rows where the account just sends, so a page may end on rows
+// that yield no views and the next one must start after them.
+//
+// Usage: PagingTest [work directory]
+//
+
+#include <Vault.h>
+
+#include "../../tools/src/blockimport.h"
+#include "../../tools/src/chaingenerator.h"
+
+#include <CoinCore/numericdata.h>
+
+#include <stdutils/benchutils.h>
+
+#include <logger/logger.h>
+
+#include <boost/filesystem.hpp>
+
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+
+using namespace CoinDB;
+using namespace std;
+
+namespace fs = boost::filesystem;
+
+const string ACCOUNT_NAME = "test";
+const size_t PAGE_SIZES[] = { 1, 2, 3, 7, 50 };
+
+static bool g_ok = true;
+
+static void check(bool condition, const string& what)
+{
+    if (condition) return;
+    cout << "FAILED: " << what << endl;
+    g_ok = false;
+}
+
+static string toString(const TxOutView& view)
+{
+    stringstream ss;
+    ss << view.id << " " << view.role_flags << " " << uchar_vector(view.tx_hash).getHex() << ":" << view.tx_index;
+    return ss.str();
+}
+
+static string toString(const SigningScriptView& view)
+{
+    stringstream ss;
+    ss << view.id << " " << view.account_name << " " << view.account_bin_name << " " << view.index;
+    return ss.str();
+}
+
+static void checkTxOutPages(Vault& vault, int role_flags, const string& what)
+{
+    vector<string> expected;
+    vault.visitTxOutViews([&](const TxOutView& view) { expected.push_back(toString(view)); return true; },
+        ACCOUNT_NAME, "", role_flags, TxOut::BOTH, Tx::ALL, false);
+    check(!expected.empty(), what + " lists some txouts");
+
+    for (size_t limit: PAGE_SIZES)
+    {
+        vector<string> paged;
+        TxOutViewCursor after;
+        unsigned int pages = 0;
+        while (pages++ <= expected.size())
+        {
+            TxOutViewCursor next;
+            for (auto& view: vault.getTxOutViewsPage(after, limit, next, ACCOUNT_NAME, "", role_flags, TxOut::BOTH, Tx::ALL, false)) { paged.push_back(toString(view)); }
+            if (next.isNull()) break;
+            check(next.id != after.id, what + " pages advance");
+            after = next;
+        }
+
+        stringstream ss;
+        ss << what << " pages of " << limit << " equal the full listing";
+        check(paged == expected, ss.str());
+    }
+}
+
+static void checkSigningScriptPages(Vault& vault)
+{
+    vector<string> expected;
+    vault.visitSigningScriptViews([&](const SigningScriptView& view) { expected.push_back(toString(view)); return true; }, ACCOUNT_NAME, "", SigningScript::ALL);
+    check(!expected.empty(), "account lists some scripts");
+
+    for (size_t limit: PAGE_SIZES)
+    {
+        vector<string> paged;
+        SigningScriptViewCursor after;
+        unsigned int pages = 0;
+        while (pages++ <= expected.size())
+        {
+            SigningScriptViewCursor next;
+            for (auto& view: vault.getSigningScriptViewsPage(after, limit, next, ACCOUNT_NAME, "", SigningScript::ALL)) { paged.push_back(toString(view)); }
+            if (next.isNull()) break;
+            after = next;
+        }
+
+        stringstream ss;
+        ss << "script pages of " << limit << " equal the full listing";
+        check(paged == expected, ss.str());
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    fs::path workDir(argc > 1 ? argv[1] : "PagingTest");
+    fs::path blocksDir = workDir / "blocks";
+    fs::path vaultFile = workDir / "paging.db";
+
+    INIT_LOGGER("PagingTest.log");
+
+    try
+    {
+        fs::remove_all(workDir);
+        fs::create_directories(blocksDir);
+
+        // Spends give rows where the account only sends, interleaved with rows where it receives.
+        ChainGenerator::Options options;
+        options.blocks = 20;
+        options.txsPerBlock = 5;
+        options.vaultTxsPerBlock = 2;
+        options.spendTxsPerBlock = 2;
+        options.scripts = 15;
+
+        Vault vault(vaultFile.string(), true);
+        {
+            stdutils::bench_random rng;
+            vault.newKeychain(ACCOUNT_NAME, rng.bytes<secure_bytes_t>(32));
+            vault.unlockChainCodes(secure_bytes_t());
+            vault.newAccount(ACCOUNT_NAME, 1, vector<string>(1, ACCOUNT_NAME));
+            ChainGenerator generator(vault, ACCOUNT_NAME, options);
+            generator.generate(blocksDir.string());
+        }
+
+        BlockFileImporter importer(vault, blocksDir.string(), uint_to_vch(CoinQ::getBitcoinRegtestParams().magic_bytes(), _BIG_ENDIAN));
+        importer.import();
+
+        checkTxOutPages(vault, TxOut::ROLE_BOTH, "sent and received txout");
+        checkTxOutPages(vault, TxOut::ROLE_RECEIVER, "received txout");
+        checkTxOutPages(vault, TxOut::ROLE_SENDER, "sent txout");
+        checkSigningScriptPages(vault);
+    }
+    catch (const exception& e)
+    {
+        check(false, string("no exception: ") + e.what());
+    }
+
+    cout << (g_ok ? "All paging checks passed." : "Some paging checks failed.") << endl;
+    return g_ok ? 0 : 1;
+}
@@ -44,18 +44,22 @@ int main(int argc, char* argv[])
     signal(SIGINT, &finish);
 
     SynchedVault synchedVault;
-    synchedVault.subscribeTxInserted([](std::shared_ptr<Tx> tx)
+    synchedVault.subscribeTxInserted([](const std::shared_ptr<Tx>& tx)
     {
         cout << "Transaction inserted: " << uchar_vector(tx->hash()).getHex() << endl;
     });
-    synchedVault.subscribeTxStatusChanged([](std::shared_ptr<Tx> tx)
+    synchedVault.subscribeTxStatusChanged([](const std::shared_ptr<Tx>& tx)
     {
         cout << "Transaction status changed: " << uchar_vector(tx->hash()).getHex() << " New status: " << Tx::getStatusString(tx->status()) << endl;
     });
-    synchedVault.subscribeMerkleBlockInserted([](std::shared_ptr<MerkleBlock> merkleblock)
+    synchedVault.subscribeMerkleBlockInserted([](const std::shared_ptr<MerkleBlock>& merkleblock)
     {
         cout << "Merkle block inserted: " << uchar_vector(merkleblock->blockheader()->hash()).getHex() << " Height: " << merkleblock->blockheader()->height() << endl;
     });
+    synchedVault.subscribeTxBatch([](const TxBatch& batch)
+    {
+        cout << "Transaction batch: " << batch.inserted.size() << " inserted, " << batch.status_changed.size() << " status changes" << endl;
+    });
 
     try
     {
@@ -0,0 +1,477 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// blockimport.cpp
+//
+// Copyright (c) 2014 Eric Lombrozo
+//
+// All Rights Reserved.
+//
+
+#define LOGGER_SUBSYSTEM "import"
+
+#include "blockimport.h"
+
+#include <CoinCore/CoinNodeData.h>
+#include <CoinCore/MerkleTree.h>
+
+#include <logger/logger.h>
+
+#include <boost/filesystem.hpp>
+#include <boost/regex.hpp>
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstring>
+#include <exception>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+
+using namespace CoinDB;
+
+const uint32_t UNREACHABLE_HEIGHT = 0xffffffff;
+const std::size_t BLOCK_RECORD_HEADER_SIZE = 8; // magic and size
+const std::size_t BLOCK_HEADER_SIZE = 80;
+
+// Blocks parsed ahead of the one being applied, per worker.
+const unsigned int WORKER_LOOKAHEAD = 8;
+
+// Of the scripts and outpoints not in the vault, the share that gets past the match set filters.
+const double MATCH_FILTER_FALSE_POSITIVE_RATE = 0.001;
+
+struct BlockFileImporter::ParsedBlock
+{
+    uint32_t height;
+    Coin::CoinBlock block;
+    std::vector<uchar_vector> txHashes;     // as in the merkle tree
+    std::vector<bool> matched;
+    uint64_t matchSetVersion;
+    std::exception_ptr error;
+};
+
+static std::string toKey(const uchar_vector& bytes)
+{
+    return std::string(bytes.begin(), bytes.end());
+}
+
+static uint32_t readUint32(const unsigned char* data)
+{
+    return data[0] | (data[1] << 8) | (data[2] << 16) | ((uint32_t)data[3] << 24);
+}
+
+BlockFileImporter::BlockFileImporter(Vault& vault, const std::string& blocksDir, const bytes_t& magic, unsigned int threads, unsigned int batchBlocks) :
+    m_vault(vault),
+    m_blocksDir(blocksDir),
+    m_magic(magic),
+    m_threads(threads),
+    m_batchBlocks(batchBlocks)
+{
+    if (m_magic.size() != 4) throw std::runtime_error("Network magic must be 4 bytes.");
+    if (m_threads == 0) m_threads = std::max(1u, std::thread::hardware_concurrency());
+    if (m_batchBlocks == 0) m_batchBlocks = 1;
+}
+
+BlockFileImporter::Stats BlockFileImporter::import()
+{
+    using namespace boost::filesystem;
+
+    m_files.clear();
+    const boost::regex filenameRegex("blk[0-9]{5}\\.dat");
+    for (directory_iterator it(m_blocksDir); it != directory_iterator(); ++it)
+    {
+        std::string filename = it->path().filename().string();
+        if (boost::regex_match(filename, filenameRegex)) { m_files.push_back(it->path().string()); }
+    }
+    if (m_files.empty()) throw std::runtime_error("No block files found.");
+    std::sort(m_files.begin(), m_files.end());
+
+    index_t index;
+    indexFiles(index);
+    computeHeights(index);
+
+    // Follow the tallest tip back to the genesis block.
+    const index_t::value_type* tip = nullptr;
+    for (auto& item: index)
+    {
+        if (item.second.height == UNREACHABLE_HEIGHT) continue;
+        if (!tip || item.second.height > tip->second.height) { tip = &item; }
+    }
+    if (!tip) throw std::runtime_error("The block files do not start at the genesis block.");
+
+    std::vector<const index_t::value_type*> chain(tip->second.height + 1);
+    for (const index_t::value_type* item = tip; ; )
+    {
+        chain[item->second.height] = item;
+        if (item->second.height == 0) break;
+        item = &*index.find(item->second.prevhash);
+    }
+
+    Stats stats;
+    stats.bestHeight = tip->second.height;
+    stats.startHeight = findStartHeight(chain);
+    stats.height = stats.startHeight - 1;
+    LOGGER(debug) << "BlockFileImporter::import() - " << index.size() << " blocks indexed, best height: " << stats.bestHeight << ", starting at: " << stats.startHeight << std::endl;
+    if (stats.startHeight > stats.bestHeight) return stats;
+
+    // Workers parse and match blocks up to a window ahead of the one being applied.
+    std::mutex mutex;
+    std::condition_variable cond;
+    std::map<uint32_t, parsed_block_ptr_t> parsed;
+    uint32_t nextToParse = stats.startHeight;
+    uint32_t nextToApply = stats.startHeight;
+    bool bStop = false;
+    uint64_t matchSetVersion = 1;
+    match_set_ptr_t matchSet = loadMatchSet(matchSetVersion);
+    const uint32_t window = m_threads * WORKER_LOOKAHEAD;
+
+    std::vector<std::thread> workers;
+    auto stopWorkers = [&]()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            bStop = true;
+        }
+        cond.notify_all();
+        for (auto& worker: workers) { worker.join(); }
+        workers.clear();
+    };
+
+    for (unsigned int i = 0; i < m_threads; i++)
+    {
+        workers.push_back(std::thread([&]()
+        {
+            while (true)
+            {
+                uint32_t height;
+                match_set_ptr_t workerMatchSet;
+                {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    cond.wait(lock, [&]() { return bStop || nextToParse > stats.bestHeight || nextToParse < nextToApply + window; });
+                    if (bStop || nextToParse > stats.bestHeight) return;
+                    height = nextToParse++;
+                    workerMatchSet = matchSet;
+                }
+
+                parsed_block_ptr_t block = parseBlock(*chain[height], workerMatchSet);
+                block->height = height;
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    parsed[height] = block;
+                }
+                cond.notify_all();
+            }
+        }));
+    }
+
+    try
+    {
+        // Outputs paying us that were found during the import. Spends of them are found in order here.
+        std::unordered_set<std::string> newOutpoints;
+        std::vector<BatchInsertItem> items;
+        std::vector<uint32_t> itemHeights; // of the merkle block items, 0 for txs
+
+        for (uint32_t height = stats.startHeight; height <= stats.bestHeight; height++)
+        {
+            parsed_block_ptr_t block;
+            match_set_ptr_t currentMatchSet;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                cond.wait(lock, [&]() { return parsed.count(height) > 0; });
+                block = parsed[height];
+                parsed.erase(height);
+                nextToApply = height + 1;
+                currentMatchSet = matchSet;
+            }
+            cond.notify_all();
+
+            if (block->error) std::rethrow_exception(block->error);
+
+            std::vector<Coin::PartialMerkleTree::MerkleLeaf> leaves;
+            for (std::size_t i = 0; i < block->block.txs.size(); i++)
+            {
+                const Coin::Transaction& coin_tx = block->block.txs[i];
+                bool matched = block->matched[i];
+
+                // Scripts were reloaded after the worker took its snapshot.
+                if (!matched && block->matchSetVersion != currentMatchSet->version) { matched = matchesOutputs(coin_tx, *currentMatchSet); }
+
+                if (!matched && !newOutpoints.empty())
+                {
+                    for (auto& txin: coin_tx.inputs)
+                    {
+                        if (newOutpoints.count(outpointKey(txin.getOutpointHash(), txin.getOutpointIndex())))
+                        {
+                            matched = true;
+                            break;
+                        }
+                    }
+                }
+
+                leaves.push_back(std::make_pair(block->txHashes[i], matched));
+                if (!matched) continue;
+
+                uint32_t txindex = 0;
+                bytes_t tx_hash = coin_tx.getHashLittleEndian();
+                for (auto& txout: coin_tx.outputs)
+                {
+                    if (currentMatchSet->scripts.count(toKey(txout.scriptPubKey))) { newOutpoints.insert(outpointKey(tx_hash, txindex)); }
+                    txindex++;
+                }
+
+                std::shared_ptr<Tx> tx(new Tx());
+                tx->set(coin_tx, block->block.blockHeader.timestamp);
+                items.push_back(BatchInsertItem(tx));
+                itemHeights.push_back(0);
+                stats.txsMatched++;
+            }
+            stats.txsScanned += block->block.txs.size();
+
+            // Txs go in first so the merkle block confirms them.
+            Coin::PartialMerkleTree tree(leaves);
+            Coin::MerkleBlock coin_merkleblock(block->block.blockHeader, leaves.size(), tree.getMerkleHashesVector(), tree.getFlags());
+            std::shared_ptr<MerkleBlock> merkleblock(new MerkleBlock());
+            merkleblock->fromCoinCore(coin_merkleblock, height);
+            items.push_back(BatchInsertItem(merkleblock));
+            itemHeights.push_back(height);
+
+            if (height - stats.startHeight + 1 < stats.blocks + m_batchBlocks && height != stats.bestHeight) continue;
+
+            std::vector<BatchInsertResult> results = m_vault.insertBatch(items);
+            uint64_t txsInserted = 0;
+            for (std::size_t i = 0; i < results.size(); i++)
+            {
+                if (itemHeights[i] == 0)
+                {
+                    if (results[i].status == BatchInsertResult::INSERTED) txsInserted++;
+                    continue;
+                }
+
+                if (results[i].status != BatchInsertResult::INSERTED)
+                {
+                    std::stringstream ss;
+                    ss << "Block at height " << itemHeights[i] << " was not inserted";
+                    if (!results[i].error.empty()) ss << ": " << results[i].error;
+                    ss << ".";
+                    throw std::runtime_error(ss.str());
+                }
+                stats.height = itemHeights[i];
+                stats.blocks++;
+            }
+            stats.txsInserted += txsInserted;
+            items.clear();
+            itemHeights.clear();
+
+            // Inserting txs can issue new scripts when account pools are refilled.
+            if (txsInserted > 0)
+            {
+                match_set_ptr_t newMatchSet = loadMatchSet(++matchSetVersion);
+                std::lock_guard<std::mutex> lock(mutex);
+                matchSet = newMatchSet;
+            }
+
+            if (m_progressCallback) m_progressCallback(stats);
+        }
+    }
+    catch (...)
+    {
+        stopWorkers();
+        throw;
+    }
+
+    stopWorkers();
+    return stats;
+}
+
+void BlockFileImporter::indexFiles(index_t& index) const
+{
+    for (unsigned int file = 0; file < m_files.size(); file++)
+    {
+        std::ifstream fs(m_files[file], std::ios::binary);
+        if (!fs) throw std::runtime_error("Could not open " + m_files[file] + ".");
+
+        // Only the headers are read. The rest of each block is skipped.
+        unsigned char record[BLOCK_RECORD_HEADER_SIZE + BLOCK_HEADER_SIZE];
+        uint64_t offset = 0;
+        while (fs.read((char*)record, sizeof(record)))
+        {
+            // Files are preallocated, so zeros mark the end of the written part.
+            if (std::equal(m_magic.begin(), m_magic.end(), record) == false)
+            {
+                if (readUint32(record) == 0) break;
+                throw std::runtime_error("Invalid network magic in " + m_files[file] + ".");
+            }
+
+            uint32_t size = readUint32(record + 4);
+            if (size < BLOCK_HEADER_SIZE) throw std::runtime_error("Invalid block size in " + m_files[file] + ".");
+
+            Coin::CoinBlockHeader header(uchar_vector(record + BLOCK_RECORD_HEADER_SIZE, record + sizeof(record)));
+            IndexEntry& entry = index[toKey(header.getHashLittleEndian())];
+            entry.file = file;
+            entry.offset = offset + BLOCK_RECORD_HEADER_SIZE;
+            entry.size = size;
+            entry.prevhash = toKey(header.prevBlockHash);
+            entry.timestamp = header.timestamp;
+            entry.height = UNREACHABLE_HEIGHT;
+
+            offset += BLOCK_RECORD_HEADER_SIZE + size;
+            fs.seekg(offset);
+        }
+    }
+}
+
+void BlockFileImporter::computeHeights(index_t& index) const
+{
+    const std::string genesisPrevhash(32, '\0');
+    std::unordered_set<std::string> visited;
+    std::vector<index_t::value_type*> path;
+    for (auto& item: index)
+    {
+        // Walk back to a block with a known height, then number the blocks on the way back down.
+        path.clear();
+        index_t::value_type* current = &item;
+        uint32_t height = 0;    // of the block below the path
+        bool bReachable = false;
+        while (true)
+        {
+            if (current->second.height != UNREACHABLE_HEIGHT)
+            {
+                height = current->second.height + 1;
+                bReachable = true;
+                break;
+            }
+            if (!visited.insert(current->first).second) break; // unreachable, already tried
+
+            path.push_back(current);
+            if (current->second.prevhash == genesisPrevhash)
+            {
+                bReachable = true;
+                break;
+            }
+
+            auto prev = index.find(current->second.prevhash);
+            if (prev == index.end()) break; // orphan
+            current = &*prev;
+        }
+
+        if (!bReachable) continue;
+        for (auto it = path.rbegin(); it != path.rend(); ++it) { (*it)->second.height = height++; }
+    }
+}
+
+uint32_t BlockFileImporter::findStartHeight(const std::vector<const index_t::value_type*>& chain) const
+{
+    std::shared_ptr<BlockHeader> best = m_vault.getBestBlockHeader();
+    if (!best)
+    {
+        // The first block must be old enough for the vault's accounts.
+        uint32_t maxFirstBlockTimestamp = m_vault.getMaxFirstBlockTimestamp();
+        if (maxFirstBlockTimestamp == 0) throw std::runtime_error("Vault has no accounts.");
+        for (uint32_t height = chain.size() - 1; height > 0; height--)
+        {
+            if (chain[height]->second.timestamp <= maxFirstBlockTimestamp) return height;
+        }
+        throw std::runtime_error("No block in the files is early enough for the vault's accounts.");
+    }
+
+    // Resume after the last vault block still on the best chain. Any blocks above it are replaced.
+    uint32_t horizonHeight = m_vault.getHorizonHeight();
+    uint32_t height = std::min<uint32_t>(best->height(), chain.size() - 1);
+    while (height >= horizonHeight)
+    {
+        if (toKey(m_vault.getBlockHeader(height)->hash()) == chain[height]->first) return height + 1;
+        if (height == 0) break;
+        height--;
+    }
+    throw std::runtime_error("The vault's blocks are not on the best chain in the block files.");
+}
+
+BlockFileImporter::match_set_ptr_t BlockFileImporter::loadMatchSet(uint64_t version) const
+{
+    std::shared_ptr<MatchSet> matchSet(new MatchSet());
+    matchSet->version = version;
+
+    for (auto& view: m_vault.getSigningScriptViews()) { matchSet->scripts.insert(toKey(view.txoutscript)); }
+
+    m_vault.visitTxOutViews([&](const TxOutView& view)
+    {
+        matchSet->outpoints.insert(outpointKey(view.tx_hash, view.tx_index));
+        return true;
+    }, "", "", TxOut::ROLE_RECEIVER, TxOut::UNSPENT, Tx::ALL, false);
+
+    matchSet->scriptFilter.set(matchSet->scripts.size(), MATCH_FILTER_FALSE_POSITIVE_RATE, 0);
+    for (auto& script: matchSet->scripts) { matchSet->scriptFilter.insert((const unsigned char*)script.data(), script.size()); }
+
+    matchSet->outpointFilter.set(matchSet->outpoints.size(), MATCH_FILTER_FALSE_POSITIVE_RATE, 0);
+    for (auto& outpoint: matchSet->outpoints) { matchSet->outpointFilter.insert((const unsigned char*)outpoint.data(), outpoint.size()); }
+
+    LOGGER(debug) << "BlockFileImporter::loadMatchSet() - " << matchSet->scripts.size() << " scripts, " << matchSet->outpoints.size() << " unspent outputs." << std::endl;
+    return matchSet;
+}
+
+BlockFileImporter::parsed_block_ptr_t BlockFileImporter::parseBlock(const index_t::value_type& entry, match_set_ptr_t matchSet) const
+{
+    parsed_block_ptr_t block(new ParsedBlock());
+    block->matchSetVersion = matchSet->version;
+    try
+    {
+        std::ifstream fs(m_files[entry.second.file], std::ios::binary);
+        uchar_vector data(entry.second.size);
+        if (!fs.seekg(entry.second.offset) || !fs.read((char*)&data[0], data.size())) throw std::runtime_error("Could not read block from " + m_files[entry.second.file] + ".");
+
+        block->block.setSerialized(data);
+        for (auto& tx: block->block.txs)
+        {
+            block->txHashes.push_back(tx.getHash());
+
+            bool matched = matchesOutputs(tx, *matchSet);
+            if (!matched)
+            {
+                for (auto& txin: tx.inputs)
+                {
+                    if (matchesOutpoint(txin, *matchSet))
+                    {
+                        matched = true;
+                        break;
+                    }
+                }
+            }
+            block->matched.push_back(matched);
+        }
+    }
+    catch (...)
+    {
+        block->error = std::current_exception();
+    }
+    return block;
+}
+
+bool BlockFileImporter::matchesOutputs(const Coin::Transaction& tx, const MatchSet& matchSet)
+{
+    for (auto& txout: tx.outputs)
+    {
+        if (!matchSet.scriptFilter.match(txout.scriptPubKey)) continue;
+        if (matchSet.scripts.count(toKey(txout.scriptPubKey))) return true;
+    }
+    return false;
+}
+
+bool BlockFileImporter::matchesOutpoint(const Coin::TxIn& txin, const MatchSet& matchSet)
+{
+    // The same bytes as outpointKey, without the allocations.
+    unsigned char key[36];
+    std::memcpy(key, txin.previousOut.hash, 32);
+    std::memcpy(key + 32, &txin.previousOut.index, sizeof(uint32_t));
+
+    if (!matchSet.outpointFilter.match(key, sizeof(key))) return false;
+    return matchSet.outpoints.count(std::string((const char*)key, sizeof(key))) > 0;
+}
+
+std::string BlockFileImporter::outpointKey(const bytes_t& hash, uint32_t index)
+{
+    std::string key(hash.begin(), hash.end());
+    key.append((const char*)&index, sizeof(index));
+    return key;
+}
@@ -0,0 +1,104 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// blockimport.h
+//
+// Copyright (c) 2014 Eric Lombrozo
+//
+// All Rights Reserved.
+//
+
+#pragma once
+
+#include <Vault.h>
+
+#include <CoinCore/BloomFilter.h>
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+
+// Brings a vault up to date from a node's blkNNNNN.dat files without a network connection.
+//
+// The block files are indexed by header first since blocks are not stored in chain order, and the
+// best chain is taken to be the longest one from the genesis block. Blocks on it after the vault's
+// best block are then read and matched in parallel by worker threads, and applied in chain order
+// through Vault::insertBatch, a batch of blocks per database transaction.
+//
+// A tx matches if it pays one of the vault's scripts or spends one of its outputs. Scripts issued by
+// pool refills during the import are picked up after each batch, within the pool's lookahead.
+class BlockFileImporter
+{
+public:
+    struct Stats
+    {
+        Stats() : startHeight(0), height(0), bestHeight(0), blocks(0), txsScanned(0), txsMatched(0), txsInserted(0) { }
+
+        uint32_t startHeight;   // first block applied
+        uint32_t height;        // last block applied
+        uint32_t bestHeight;    // tip of the best chain in the files
+        uint64_t blocks;
+        uint64_t txsScanned;
+        uint64_t txsMatched;
+        uint64_t txsInserted;
+    };
+
+    typedef std::function<void(const Stats&)> progress_callback_t;
+
+    // magic is the network's message start as it appears in the files.
+    BlockFileImporter(CoinDB::Vault& vault, const std::string& blocksDir, const bytes_t& magic, unsigned int threads = 0, unsigned int batchBlocks = 100);
+
+    // Called after each batch is committed.
+    void setProgressCallback(progress_callback_t callback) { m_progressCallback = callback; }
+
+    // Throws if the files cannot be read or the vault's chain is not in them. Blocks committed before an error are kept.
+    Stats import();
+
+private:
+    struct IndexEntry
+    {
+        unsigned int file;
+        uint64_t offset;    // of the serialized block
+        uint32_t size;
+        std::string prevhash;
+        uint32_t timestamp;
+        uint32_t height;
+    };
+    typedef std::unordered_map<std::string, IndexEntry> index_t;
+
+    // What workers match against. Replaced rather than modified, so workers can keep using a snapshot.
+    // Almost every script and outpoint in a block misses, and the filters turn those away without
+    // building and hashing a key.
+    struct MatchSet
+    {
+        uint64_t version;
+        std::unordered_set<std::string> scripts;
+        std::unordered_set<std::string> outpoints;
+        Coin::BlockedBloomFilter scriptFilter;
+        Coin::BlockedBloomFilter outpointFilter;
+    };
+    typedef std::shared_ptr<const MatchSet> match_set_ptr_t;
+
+    struct ParsedBlock;
+    typedef std::shared_ptr<ParsedBlock> parsed_block_ptr_t;
+
+    void indexFiles(index_t& index) const;
+    void computeHeights(index_t& index) const;
+    uint32_t findStartHeight(const std::vector<const index_t::value_type*>& chain) const;
+    match_set_ptr_t loadMatchSet(uint64_t version) const;
+
+    parsed_block_ptr_t parseBlock(const index_t::value_type& entry, match_set_ptr_t matchSet) const;
+    static bool matchesOutputs(const Coin::Transaction& tx, const MatchSet& matchSet);
+    static bool matchesOutpoint(const Coin::TxIn& txin, const MatchSet& matchSet);
+    static std::string outpointKey(const bytes_t& hash, uint32_t index);
+
+    CoinDB::Vault& m_vault;
+    std::string m_blocksDir;
+    bytes_t m_magic;
+    unsigned int m_threads;
+    unsigned int m_batchBlocks;
+    progress_callback_t m_progressCallback;
+
+    std::vector<std::string> m_files;
+};
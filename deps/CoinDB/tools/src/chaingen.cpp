@@ -0,0 +1,224 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// chaingen.cpp
+//
+// Copyright (c) 2014 Eric Lombrozo
+//
+// All Rights Reserved.
+//
+// Generates a synthetic regtest chain for a vault and serves it over the P2P
+// protocol, for measuring sync and vault throughput on one machine.
+//
+
+#include "chaingenerator.h"
+#include "standinpeer.h"
+
+#include <cli.hpp>
+
+#include <SynchedVault.h>
+
+#include <logger/logger.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <csignal>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <mutex>
+#include <sstream>
+#include <thread>
+
+using namespace std;
+using namespace CoinDB;
+
+const char* SYNCTEST_BLOCKTREE_FILE = "chaingen-blocktree.dat";
+
+// Gives up on a sync that makes no progress for this long.
+const unsigned int SYNCTEST_STALL_SECONDS = 60;
+
+static double secondsSince(chrono::steady_clock::time_point start)
+{
+    return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+static volatile sig_atomic_t g_bStop = 0;
+
+static void onSignal(int /*sig*/)
+{
+    g_bStop = 1;
+}
+
+cli::result_t cmd_generate(const cli::params_t& params)
+{
+    ChainGenerator::Options options;
+    if (params.size() > 3) options.blocks = strtoul(params[3].c_str(), NULL, 0);
+    if (params.size() > 4) options.txsPerBlock = strtoul(params[4].c_str(), NULL, 0);
+    if (params.size() > 5) options.vaultTxsPerBlock = strtoul(params[5].c_str(), NULL, 0);
+    if (params.size() > 6) options.spendTxsPerBlock = strtoul(params[6].c_str(), NULL, 0);
+    if (params.size() > 7) options.scripts = strtoul(params[7].c_str(), NULL, 0);
+
+    Vault vault(params[0], false);
+    vault.unlockChainCodes(secure_bytes_t());
+    ChainGenerator generator(vault, params[1], options);
+
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    ChainGenerator::Stats stats = generator.generate(params[2]);
+
+    stringstream ss;
+    ss << "Generated " << stats.blocks << " blocks with " << stats.txs << " txs (" << stats.bytes << " bytes) in " << secondsSince(start) << " seconds. "
+       << stats.vaultTxs << " txs pay the vault and " << stats.spendTxs << " spend from it.";
+    return ss.str();
+}
+
+cli::result_t cmd_serve(const cli::params_t& params)
+{
+    string port = params.size() > 1 ? params[1] : string(CoinQ::getBitcoinRegtestParams().default_port());
+
+    StandInPeer standIn(CoinQ::getBitcoinRegtestParams(), params[0]);
+    standIn.start(port);
+    cerr << "Serving " << standIn.getBestHeight() << " blocks on port " << port << ". Press Ctrl-C to stop." << endl;
+
+    signal(SIGINT, &onSignal);
+    signal(SIGTERM, &onSignal);
+    while (!g_bStop) { this_thread::sleep_for(chrono::milliseconds(200)); }
+    standIn.stop();
+
+    StandInPeer::Stats stats = standIn.getStats();
+    stringstream ss;
+    ss << "Served " << stats.connections << " connections: " << stats.headers << " headers, " << stats.merkleBlocks << " merkle blocks, "
+       << stats.txs << " txs and " << stats.blocks << " blocks.";
+    return ss.str();
+}
+
+// Inserts the recorded merkle blocks and txs in the order a peer sends them, timing only the vault.
+cli::result_t cmd_replay(const cli::params_t& params)
+{
+    ifstream file(params[1].c_str(), ios::binary);
+    if (!file) throw runtime_error("Could not open " + params[1] + ".");
+    uchar_vector data((istreambuf_iterator<char>(file)), istreambuf_iterator<char>());
+
+    Vault vault(params[0], false);
+    uint32_t height = 0;
+    uint64_t txs = 0;
+    double seconds = 0;
+    size_t pos = 0;
+    while (pos + MIN_MESSAGE_HEADER_SIZE <= data.size())
+    {
+        uint32_t payloadSize = vch_to_uint<uint32_t>(uchar_vector(data.begin() + pos + 16, data.begin() + pos + 20), _BIG_ENDIAN);
+        if (pos + MIN_MESSAGE_HEADER_SIZE + payloadSize > data.size()) throw runtime_error("Truncated message in " + params[1] + ".");
+        Coin::CoinNodeMessage message(uchar_vector(data.begin() + pos, data.begin() + pos + MIN_MESSAGE_HEADER_SIZE + payloadSize));
+        pos += MIN_MESSAGE_HEADER_SIZE + payloadSize;
+
+        string command = message.getCommand();
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+        if (command == "merkleblock")
+        {
+            std::shared_ptr<MerkleBlock> merkleblock(new MerkleBlock());
+            merkleblock->fromCoinCore(*static_cast<Coin::MerkleBlock*>(message.getPayload()), ++height);
+            vault.insertMerkleBlock(merkleblock);
+        }
+        else if (command == "tx")
+        {
+            std::shared_ptr<Tx> tx(new Tx());
+            tx->set(*static_cast<Coin::Transaction*>(message.getPayload()));
+            vault.insertTx(tx);
+            txs++;
+        }
+        seconds += secondsSince(start);
+    }
+
+    stringstream ss;
+    ss << "Inserted " << height << " merkle blocks and " << txs << " txs in " << seconds << " seconds: "
+       << height / seconds << " blocks/s, " << txs / seconds << " txs/s.";
+    return ss.str();
+}
+
+// Syncs the vault from an in-process stand-in peer over a local connection, as SynchedVault does from a node.
+cli::result_t cmd_synctest(const cli::params_t& params)
+{
+    string port = params.size() > 2 ? params[2] : string(CoinQ::getBitcoinRegtestParams().default_port());
+
+    StandInPeer standIn(CoinQ::getBitcoinRegtestParams(), params[1]);
+    const uint32_t bestHeight = standIn.getBestHeight();
+    standIn.start(port);
+
+    // Start from an empty block tree so the headers are synched too.
+    remove(SYNCTEST_BLOCKTREE_FILE);
+    SynchedVault synchedVault(SYNCTEST_BLOCKTREE_FILE, CoinQ::getBitcoinRegtestParams());
+    synchedVault.openVault(params[0], false);
+
+    mutex progressMutex;
+    condition_variable progressCond;
+    uint32_t syncHeight = 0;
+    uint64_t txsInserted = 0;
+    synchedVault.subscribeTxInserted([&](const std::shared_ptr<Tx>& /*tx*/)
+    {
+        lock_guard<mutex> lock(progressMutex);
+        txsInserted++;
+    });
+    synchedVault.subscribeMerkleBlockInserted([&](const std::shared_ptr<MerkleBlock>& merkleblock)
+    {
+        {
+            lock_guard<mutex> lock(progressMutex);
+            syncHeight = merkleblock->blockheader()->height();
+        }
+        progressCond.notify_all();
+    });
+
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    synchedVault.startSync("localhost", port);
+    {
+        unique_lock<mutex> lock(progressMutex);
+        while (syncHeight < bestHeight)
+        {
+            uint32_t lastHeight = syncHeight;
+            progressCond.wait_for(lock, chrono::seconds(SYNCTEST_STALL_SECONDS), [&]() { return syncHeight != lastHeight; });
+            if (syncHeight == lastHeight)
+            {
+                stringstream err;
+                err << "Sync stalled at height " << syncHeight << " of " << bestHeight << ".";
+                throw runtime_error(err.str());
+            }
+        }
+    }
+    double seconds = secondsSince(start);
+
+    synchedVault.stopSync();
+    synchedVault.clearAllSlots();
+    standIn.stop();
+
+    StandInPeer::Stats stats = standIn.getStats();
+    stringstream ss;
+    ss << "Synched to height " << bestHeight << " in " << seconds << " seconds. "
+       << stats.merkleBlocks << " merkle blocks and " << stats.txs << " txs served, " << txsInserted << " txs inserted: "
+       << stats.merkleBlocks / seconds << " blocks/s, " << stats.txs / seconds << " txs/s.";
+    return ss.str();
+}
+
+int main(int argc, char* argv[])
+{
+    INIT_LOGGER("chaingen.log");
+
+    using namespace cli;
+    Shell shell("Synthetic regtest chain generator for CoinDB");
+
+    shell.add(command(&cmd_generate, "generate", "generate blocks paying an account's scripts into blkNNNNN.dat and merkleblocks.dat",
+        command::params(3, "db file", "account name", "output directory"),
+        command::params(5, "blocks = 1000", "txs per block = 50", "vault txs per block = 5", "spend txs per block = 1", "scripts = 100")));
+    shell.add(command(&cmd_serve, "serve", "serve generated blocks to peers until interrupted", command::params(1, "blocks directory"), command::params(1, "port = 18444")));
+    shell.add(command(&cmd_replay, "replay", "insert recorded merkle blocks and txs into a vault without the network", command::params(2, "db file", "merkle blocks file")));
+    shell.add(command(&cmd_synctest, "synctest", "sync a vault from an in-process stand-in peer and report throughput", command::params(2, "db file", "blocks directory"), command::params(1, "port = 18444")));
+
+    try
+    {
+        return shell.exec(argc, argv);
+    }
+    catch (const std::exception& e)
+    {
+        cerr << e.what() << endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,257 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// chaingenerator.cpp
+//
+// Copyright (c) 2014 Eric Lombrozo
+//
+// All Rights Reserved.
+//
+
+#define LOGGER_SUBSYSTEM "chaingen"
+
+#include "chaingenerator.h"
+
+#include <CoinCore/CoinNodeData.h>
+#include <CoinCore/MerkleTree.h>
+#include <CoinCore/numericdata.h>
+#include <CoinQ/CoinQ_script.h>
+
+#include <stdutils/benchutils.h>
+
+#include <logger/logger.h>
+
+#include <cstdio>
+#include <deque>
+#include <fstream>
+#include <stdexcept>
+
+using namespace CoinDB;
+
+// A node starts a new block file once one would grow past this.
+const uint64_t MAX_BLOCKFILE_SIZE = 0x8000000;
+const uint32_t BLOCK_INTERVAL = 600;
+const uint64_t COINBASE_VALUE = 5000000000ull;
+
+// The coinbase of the genesis block, which regtest shares with the main network.
+const char* GENESIS_COINBASE_HEX =
+    "01000000010000000000000000000000000000000000000000000000000000000000000000ffffffff4d04ffff001d0104455468652054696d65732030332f4a616e2f32303039204368616e63656c6c6f72206f6e206272696e6b206f66207365636f6e64206261696c6f757420666f722062616e6b73"
+    "ffffffff0100f2052a01000000434104678afdb0fe5548271967f1a67130b7105cd6a828e03909a67962e0ea1f61deb649f6bc3f4cef38c4f35504e51ec112de5c384df7ba0b8d578a4c702b6bf11d5fac00000000";
+
+struct VaultOutput
+{
+    uchar_vector txHash;    // little endian
+    uint32_t index;
+    std::size_t script;
+};
+
+static std::string blockFilename(const std::string& dir, unsigned int index)
+{
+    char filename[16];
+    std::snprintf(filename, sizeof(filename), "blk%05u.dat", index);
+    return dir + "/" + filename;
+}
+
+// Writes blocks as a node stores them: magic, size and block, in files of up to MAX_BLOCKFILE_SIZE.
+class BlockFileWriter
+{
+public:
+    BlockFileWriter(const std::string& dir, const uchar_vector& magic) : m_dir(dir), m_magic(magic), m_fileIndex(0), m_fileSize(0) { open(); }
+
+    ~BlockFileWriter()
+    {
+        // Files left from a longer chain would be read as part of this one.
+        for (unsigned int index = m_fileIndex + 1; std::remove(blockFilename(m_dir, index).c_str()) == 0; index++);
+    }
+
+    void write(const Coin::CoinBlock& block)
+    {
+        uchar_vector data = block.getSerialized();
+        if (m_fileSize > 0 && m_fileSize + 8 + data.size() > MAX_BLOCKFILE_SIZE)
+        {
+            m_fileIndex++;
+            open();
+        }
+
+        uchar_vector record = m_magic + uint_to_vch((uint32_t)data.size(), _BIG_ENDIAN) + data;
+        m_file.write((const char*)record.data(), record.size());
+        if (!m_file) throw std::runtime_error("Could not write " + blockFilename(m_dir, m_fileIndex) + ".");
+        m_fileSize += record.size();
+    }
+
+private:
+    void open()
+    {
+        m_file.close();
+        m_file.open(blockFilename(m_dir, m_fileIndex).c_str(), std::ios::binary | std::ios::trunc);
+        if (!m_file) throw std::runtime_error("Could not open " + blockFilename(m_dir, m_fileIndex) + ".");
+        m_fileSize = 0;
+    }
+
+    std::string m_dir;
+    uchar_vector m_magic;
+    unsigned int m_fileIndex;
+    uint64_t m_fileSize;
+    std::ofstream m_file;
+};
+
+static uchar_vector p2pkhScript(stdutils::bench_random& rng)
+{
+    return uchar_vector("76a914") + rng.bytes<uchar_vector>(20) + uchar_vector("88ac");
+}
+
+// A DER signature and a compressed pubkey
+static uchar_vector p2pkhScriptSig(stdutils::bench_random& rng)
+{
+    uchar_vector scriptSig;
+    scriptSig.push_back(72);
+    scriptSig += rng.bytes<uchar_vector>(72);
+    scriptSig.push_back(33);
+    scriptSig += rng.bytes<uchar_vector>(33);
+    return scriptSig;
+}
+
+// The script's signature placeholders filled with random bytes of a signature's length
+static uchar_vector placeholderSignedScriptSig(const bytes_t& txinscript, stdutils::bench_random& rng)
+{
+    CoinQ::Script::Script script(txinscript);
+    std::vector<bytes_t> pubkeys = script.missingsigs();
+    for (std::size_t i = 0; i < script.minsigs() && i < pubkeys.size(); i++)
+    {
+        script.addSig(pubkeys[i], rng.bytes<bytes_t>(72));
+    }
+    return script.txinscript(CoinQ::Script::Script::BROADCAST);
+}
+
+static Coin::Transaction coinbaseTx(uint32_t height, stdutils::bench_random& rng)
+{
+    // The height as BIP34 has it, then an extra nonce
+    uchar_vector scriptSig;
+    scriptSig.push_back(4);
+    scriptSig += uint_to_vch(height, _BIG_ENDIAN);
+    scriptSig.push_back(4);
+    scriptSig += rng.bytes<uchar_vector>(4);
+
+    Coin::Transaction tx;
+    tx.addInput(Coin::TxIn(Coin::OutPoint(g_zero32bytes, 0xffffffff), scriptSig, 0xffffffff));
+    tx.addOutput(Coin::TxOut(COINBASE_VALUE, p2pkhScript(rng)));
+    return tx;
+}
+
+static void mine(Coin::CoinBlockHeader& header)
+{
+    while (BigInt(header.getPOWHashLittleEndian()) > header.getTarget()) { header.incrementNonce(); }
+}
+
+static void writeMessage(std::ofstream& file, uint32_t magic, Coin::CoinNodeStructure& payload)
+{
+    uchar_vector data = Coin::CoinNodeMessage(magic, &payload).getSerialized();
+    file.write((const char*)data.data(), data.size());
+    if (!file) throw std::runtime_error("Could not write merkle blocks.");
+}
+
+ChainGenerator::ChainGenerator(Vault& vault, const std::string& accountName, const Options& options) :
+    m_vault(vault),
+    m_accountName(accountName),
+    m_options(options)
+{
+    if (m_options.scripts == 0) m_options.scripts = 1;
+    if (m_options.vaultTxsPerBlock + m_options.spendTxsPerBlock > m_options.txsPerBlock)
+        throw std::runtime_error("Vault and spend txs per block cannot exceed txs per block.");
+}
+
+Coin::CoinBlock ChainGenerator::getGenesisBlock()
+{
+    Coin::CoinBlock genesis;
+    genesis.blockHeader = CoinQ::getBitcoinRegtestParams().genesis_block();
+    genesis.addTransaction(Coin::Transaction(std::string(GENESIS_COINBASE_HEX)));
+    return genesis;
+}
+
+ChainGenerator::Stats ChainGenerator::generate(const std::string& outputDir)
+{
+    const CoinQ::CoinParams coinParams = CoinQ::getBitcoinRegtestParams();
+    Coin::CoinBlockHeader::setHashFunc(coinParams.block_header_hash_function());
+    Coin::CoinBlockHeader::setPOWHashFunc(coinParams.block_header_pow_hash_function(), coinParams.block_header_pow_batch_hash_function());
+
+    const uint32_t firstTimestamp = m_vault.getMaxFirstBlockTimestamp();
+    if (firstTimestamp == 0) throw std::runtime_error("Vault has no accounts.");
+
+    std::vector<std::shared_ptr<SigningScript>> scripts;
+    for (uint32_t i = 0; i < m_options.scripts; i++) { scripts.push_back(m_vault.issueSigningScript(m_accountName)); }
+
+    stdutils::bench_random rng(m_options.seed);
+    const uchar_vector magic = uint_to_vch(coinParams.magic_bytes(), _BIG_ENDIAN);
+    BlockFileWriter blockFiles(outputDir, magic);
+    std::ofstream merkleBlockFile((outputDir + "/merkleblocks.dat").c_str(), std::ios::binary | std::ios::trunc);
+    if (!merkleBlockFile) throw std::runtime_error("Could not open " + outputDir + "/merkleblocks.dat.");
+
+    Coin::CoinBlock genesis = getGenesisBlock();
+    blockFiles.write(genesis);
+
+    Stats stats;
+    std::deque<VaultOutput> vaultOutputs;
+    uchar_vector prevHash = genesis.blockHeader.getHashLittleEndian();
+    for (uint32_t height = 1; height <= m_options.blocks; height++)
+    {
+        Coin::CoinBlock block(2, firstTimestamp + BLOCK_INTERVAL * (height - 1), genesis.blockHeader.bits, prevHash);
+        block.addTransaction(coinbaseTx(height, rng));
+        std::vector<bool> matched(1, false);
+
+        // Block 1 is the vault's first block, so it confirms nothing.
+        std::vector<VaultOutput> newOutputs;
+        for (uint32_t i = 0; height > 1 && i < m_options.txsPerBlock; i++)
+        {
+            Coin::Transaction tx;
+            bool bVault = true;
+            if (i < m_options.vaultTxsPerBlock)
+            {
+                std::size_t script = rng.next() % scripts.size();
+                tx.addInput(Coin::TxIn(Coin::OutPoint(rng.bytes<uchar_vector>(32), 0), p2pkhScriptSig(rng), 0xffffffff));
+                tx.addOutput(Coin::TxOut(100000 + rng.next() % 100000000, scripts[script]->txoutscript()));
+                tx.addOutput(Coin::TxOut(100000 + rng.next() % 100000000, p2pkhScript(rng)));
+                newOutputs.push_back(VaultOutput{tx.getHashLittleEndian(), 0, script});
+                stats.vaultTxs++;
+            }
+            else if (i < m_options.vaultTxsPerBlock + m_options.spendTxsPerBlock && !vaultOutputs.empty())
+            {
+                VaultOutput output = vaultOutputs.front();
+                vaultOutputs.pop_front();
+                tx.addInput(Coin::TxIn(Coin::OutPoint(output.txHash, output.index), placeholderSignedScriptSig(scripts[output.script]->txinscript(), rng), 0xffffffff));
+                tx.addOutput(Coin::TxOut(100000 + rng.next() % 100000000, p2pkhScript(rng)));
+                stats.spendTxs++;
+            }
+            else
+            {
+                tx.addInput(Coin::TxIn(Coin::OutPoint(rng.bytes<uchar_vector>(32), rng.next() % 4), p2pkhScriptSig(rng), 0xffffffff));
+                tx.addOutput(Coin::TxOut(100000 + rng.next() % 100000000, p2pkhScript(rng)));
+                tx.addOutput(Coin::TxOut(100000 + rng.next() % 100000000, p2pkhScript(rng)));
+                bVault = false;
+            }
+            block.addTransaction(tx);
+            matched.push_back(bVault);
+        }
+        vaultOutputs.insert(vaultOutputs.end(), newOutputs.begin(), newOutputs.end());
+
+        block.updateMerkleRoot();
+        mine(block.blockHeader);
+        prevHash = block.blockHeader.getHashLittleEndian();
+        blockFiles.write(block);
+
+        std::vector<Coin::PartialMerkleTree::MerkleLeaf> leaves;
+        for (std::size_t i = 0; i < block.txs.size(); i++) { leaves.push_back(std::make_pair(block.txs[i].getHash(), matched[i])); }
+        Coin::PartialMerkleTree tree(leaves);
+        Coin::MerkleBlock merkleBlock(block.blockHeader, leaves.size(), tree.getMerkleHashesVector(), tree.getFlags());
+        writeMessage(merkleBlockFile, coinParams.magic_bytes(), merkleBlock);
+        for (std::size_t i = 0; i < block.txs.size(); i++)
+        {
+            if (matched[i]) { writeMessage(merkleBlockFile, coinParams.magic_bytes(), block.txs[i]); }
+        }
+
+        stats.blocks++;
+        stats.txs += block.txs.size();
+        stats.bytes += block.getSize();
+        if (height % 100 == 0) { LOGGER(debug) << "ChainGenerator::generate() - generated " << height << " of " << m_options.blocks << " blocks." << std::endl; }
+    }
+
+    return stats;
+}
@@ -0,0 +1,71 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// chaingenerator.h
+//
+// Copyright (c) 2014 Eric Lombrozo
+//
+// All Rights Reserved.
+//
+
+#pragma once
+
+#include <Vault.h>
+
+#include <CoinQ/CoinQ_coinparams.h>
+
+#include <string>
+
+// Generates a regtest chain whose blocks pay an account's scripts, so sync and vault performance can
+// be measured without a network.
+//
+// Block 1 is stamped with the vault's maximum first block timestamp so that a sync or import of the
+// vault starts there, and the blocks after it follow at ten minute intervals. Headers are mined at
+// the regtest difficulty, so they pass the block tree's proof of work check.
+//
+// From block 2 on, each block holds a coinbase and txsPerBlock txs. Of these, vaultTxsPerBlock pay
+// one of the account's scripts and spendTxsPerBlock spend vault outputs from earlier blocks with
+// placeholder signatures. The rest are unrelated transfers. Inputs that are not vault outputs spend
+// outpoints that do not exist, since nothing here validates them.
+//
+// The blocks are written to blkNNNNN.dat files in the node's format, which StandInPeer serves and
+// coindb importblocks reads. The merkle blocks a peer would send for the vault follow, each with its
+// vault txs, as P2P messages in merkleblocks.dat.
+class ChainGenerator
+{
+public:
+    struct Options
+    {
+        Options() : blocks(1000), txsPerBlock(50), vaultTxsPerBlock(5), spendTxsPerBlock(1), scripts(100), seed(1) { }
+
+        uint32_t blocks;            // not counting the genesis block
+        uint32_t txsPerBlock;       // not counting the coinbase
+        uint32_t vaultTxsPerBlock;
+        uint32_t spendTxsPerBlock;
+        uint32_t scripts;           // issued from the account before generating
+        uint64_t seed;
+    };
+
+    struct Stats
+    {
+        Stats() : blocks(0), txs(0), vaultTxs(0), spendTxs(0), bytes(0) { }
+
+        uint32_t blocks;
+        uint64_t txs;
+        uint64_t vaultTxs;
+        uint64_t spendTxs;
+        uint64_t bytes;             // of serialized blocks
+    };
+
+    ChainGenerator(CoinDB::Vault& vault, const std::string& accountName, const Options& options = Options());
+
+    // Writes the files to outputDir, which must exist. Existing files are replaced.
+    Stats generate(const std::string& outputDir);
+
+    // The regtest genesis block, with its coinbase.
+    static Coin::CoinBlock getGenesisBlock();
+
+private:
+    CoinDB::Vault& m_vault;
+    std::string m_accountName;
+    Options m_options;
+};
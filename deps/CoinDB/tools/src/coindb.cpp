@@ -8,6 +8,7 @@
 //
 
 #include "formatting.h"
+#include "blockimport.h"
 
 #include <cli.hpp>
 
@@ -787,6 +788,33 @@ cli::result_t cmd_insertrawmerkleblock(const cli::params_t& params)
     return ss.str();
 }
 
+cli::result_t cmd_importblocks(const cli::params_t& params)
+{
+    unsigned int threads = params.size() > 2 ? strtoul(params[2].c_str(), NULL, 0) : 0;
+    unsigned int batchBlocks = params.size() > 3 ? strtoul(params[3].c_str(), NULL, 0) : 100;
+    uchar_vector magic(params.size() > 4 ? params[4] : "f9beb4d9");
+
+    Vault vault(params[0], false);
+    BlockFileImporter importer(vault, params[1], magic, threads, batchBlocks);
+    importer.setProgressCallback([](const BlockFileImporter::Stats& stats)
+    {
+        cerr << "Imported to height " << stats.height << " of " << stats.bestHeight << ", " << stats.txsInserted << " txs inserted." << endl;
+    });
+    BlockFileImporter::Stats stats = importer.import();
+
+    stringstream ss;
+    if (stats.blocks == 0)
+    {
+        ss << "Vault is up to date at height " << stats.height << ".";
+    }
+    else
+    {
+        ss << "Imported blocks " << stats.startHeight << " to " << stats.height << ". "
+           << stats.txsScanned << " txs scanned, " << stats.txsMatched << " matched, " << stats.txsInserted << " inserted.";
+    }
+    return ss.str();
+}
+
 cli::result_t cmd_deleteblock(const cli::params_t& params)
 {
     uint32_t height = strtoull(params[1].c_str(), NULL, 0);
@@ -864,6 +892,7 @@ int main(int argc, char* argv[])
     shell.add(command(&cmd_rawblockheader, "rawblockheader", "construct a raw block header", command::params(6, "version", "previous block hash", "merkle root", "timestamp", "bits", "nonce")));
     shell.add(command(&cmd_rawmerkleblock, "rawmerkleblock", "construct a raw merkle block", command::params(4, "raw block header", "flags", "nTxs", "nHashes"), command::params(3, "hash 1", "hash 2", "...")));
     shell.add(command(&cmd_insertrawmerkleblock, "insertrawmerkleblock", "insert raw merkle block into database", command::params(2, "db file", "raw merkle block"), command::params(1, "height = 0")));
+    shell.add(command(&cmd_importblocks, "importblocks", "import blocks from a node's blkNNNNN.dat files", command::params(2, "db file", "blocks directory"), command::params(3, "threads = number of cores", "blocks per batch = 100", "network magic = f9beb4d9")));
     shell.add(command(&cmd_deleteblock, "deleteblock", "delete merkle block including all descendants", command::params(1, "db file"), command::params(1, "height = 0")));
 
     // Miscellaneous
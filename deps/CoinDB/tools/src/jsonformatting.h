@@ -0,0 +1,78 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// jsonformatting.h
+//
+// Copyright (c) 2014 Eric Lombrozo
+//
+// All Rights Reserved.
+//
+
+#pragma once
+
+#include "formatting.h"
+
+#include <CoinQ/CoinQ_jsonwriter.h>
+
+// JSON counterparts of the tables in formatting.h. Values are in satoshis.
+
+// SigningScripts
+inline void writeSigningScriptViewJson(CoinQ::Json::Writer& writer, const CoinDB::SigningScriptView& view)
+{
+    using namespace CoinDB;
+
+    writer.beginObject();
+    writer.member("account", view.account_name);
+    writer.member("bin", view.account_bin_name);
+    writer.member("index", view.index);
+    writer.member("label", view.label);
+    writer.key("script").hex(view.txoutscript);
+    writer.member("address", getAddressFromScript(view.txoutscript));
+    writer.member("status", SigningScript::getStatusString(view.status));
+    writer.endObject();
+}
+
+// TxOuts
+inline void writeTxOutViewJson(CoinQ::Json::Writer& writer, const CoinDB::TxOutView& view, unsigned int best_height)
+{
+    using namespace CoinDB;
+
+    const bytes_t& tx_hash = view.tx_status == Tx::UNSIGNED
+        ? view.tx_unsigned_hash : view.tx_hash;
+
+    unsigned int confirmations = view.height == 0
+        ? 0 : best_height - view.height + 1;
+
+    writer.beginObject();
+    writer.member("account", view.role_account());
+    writer.member("bin", view.role_bin());
+    writer.member("label", view.role_label());
+    writer.member("type", TxOut::getRoleString(view.role_flags));
+    writer.member("value", view.value);
+    writer.member("address", getAddressFromScript(view.script));
+    writer.member("confirmations", confirmations);
+    writer.member("txstatus", Tx::getStatusString(view.tx_status));
+    writer.member("txid", view.tx_id);
+    writer.key("txhash").hex(tx_hash);
+    writer.member("txindex", view.tx_index);
+    writer.member("timestamp", view.tx_timestamp);
+    writer.member("height", view.height);
+    writer.endObject();
+}
+
+// Accounts
+inline void writeAccountInfoJson(CoinQ::Json::Writer& writer, const CoinDB::AccountInfo& info)
+{
+    writer.beginObject();
+    writer.member("id", info.id());
+    writer.member("name", info.name());
+    writer.member("minsigs", info.minsigs());
+    writer.key("keychains").beginArray();
+    for (auto& name: info.keychain_names()) { writer.value(name); }
+    writer.endArray();
+    writer.member("unusedpoolsize", info.unused_pool_size());
+    writer.member("timecreated", info.time_created());
+    writer.key("bins").beginArray();
+    for (auto& name: info.bin_names()) { writer.value(name); }
+    writer.endArray();
+    writer.endObject();
+}
@@ -0,0 +1,350 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// standinpeer.cpp
+//
+// Copyright (c) 2014 Eric Lombrozo
+//
+// All Rights Reserved.
+//
+
+#define LOGGER_SUBSYSTEM "standin"
+
+#include "standinpeer.h"
+
+#include <CoinCore/MerkleTree.h>
+#include <CoinCore/BloomFilter.h>
+
+#include <logger/logger.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+
+using namespace CoinQ;
+
+const std::size_t MAX_HEADERS_PER_MESSAGE = 2000;
+const char* USER_AGENT = "/chaingen:0.1/";
+
+struct StandInPeer::Session
+{
+    Session(io_service_t& io_service, const CoinParams& coinParams, uint32_t bestHeight) :
+        peer(io_service, "", "", coinParams.magic_bytes(), coinParams.protocol_version(), USER_AGENT, bestHeight, false) { }
+
+    Peer peer;
+    Coin::BloomFilter filter;   // only used on the peer's strand
+};
+
+static std::string toKey(const uchar_vector& bytes)
+{
+    return std::string(bytes.begin(), bytes.end());
+}
+
+// Calls fn for each nonempty data push in the script until it returns true.
+template<typename Fn>
+static bool anyDataPush(const uchar_vector& script, Fn fn)
+{
+    std::size_t pos = 0;
+    while (pos < script.size())
+    {
+        unsigned char opcode = script[pos++];
+        std::size_t len;
+        std::size_t lenBytes = 0;
+        if (opcode < 0x4c)          { len = opcode; }
+        else if (opcode == 0x4c)    { lenBytes = 1; }   // OP_PUSHDATA1
+        else if (opcode == 0x4d)    { lenBytes = 2; }   // OP_PUSHDATA2
+        else if (opcode == 0x4e)    { lenBytes = 4; }   // OP_PUSHDATA4
+        else                        { continue; }
+
+        if (lenBytes > 0)
+        {
+            if (pos + lenBytes > script.size()) return false;
+            len = 0;
+            for (std::size_t i = 0; i < lenBytes; i++) { len |= (std::size_t)script[pos + i] << (8 * i); }
+            pos += lenBytes;
+        }
+
+        if (pos + len > script.size()) return false;
+        if (len > 0 && fn(&script[pos], len)) return true;
+        pos += len;
+    }
+    return false;
+}
+
+// Matches a tx as BIP37 describes, adding the outpoints of matched outputs to the filter if it was
+// loaded with BLOOM_UPDATE_ALL.
+static bool matchTx(Coin::BloomFilter& filter, const Coin::Transaction& tx)
+{
+    if (!filter.isSet()) return true;
+
+    auto match = [&](const unsigned char* data, std::size_t len) { return filter.match(data, len); };
+
+    bool bMatch = filter.match(tx.getHash());
+    for (std::size_t i = 0; i < tx.outputs.size(); i++)
+    {
+        if (!anyDataPush(tx.outputs[i].scriptPubKey, match)) continue;
+        bMatch = true;
+        if ((filter.getNFlags() & BLOOM_UPDATE_MASK) == BLOOM_UPDATE_ALL)
+        {
+            filter.insert(Coin::OutPoint(tx.getHashLittleEndian(), i).getSerialized());
+        }
+    }
+    if (bMatch) return true;
+
+    for (auto& txIn: tx.inputs)
+    {
+        if (filter.match(txIn.previousOut.getSerialized()) || anyDataPush(txIn.scriptSig, match)) return true;
+    }
+    return false;
+}
+
+StandInPeer::StandInPeer(const CoinParams& coinParams, const std::string& blocksDir) :
+    m_coinParams(coinParams),
+    m_connections(0),
+    m_headers(0),
+    m_blocksSent(0),
+    m_merkleBlocks(0),
+    m_txs(0)
+{
+    Coin::CoinBlockHeader::setHashFunc(m_coinParams.block_header_hash_function());
+    Coin::CoinBlockHeader::setPOWHashFunc(m_coinParams.block_header_pow_hash_function(), m_coinParams.block_header_pow_batch_hash_function());
+    loadBlocks(blocksDir);
+}
+
+StandInPeer::~StandInPeer()
+{
+    stop();
+}
+
+void StandInPeer::start(const std::string& port)
+{
+    if (m_acceptor) throw std::runtime_error("Stand-in peer already started.");
+
+    tcp::endpoint endpoint(tcp::v4(), (unsigned short)strtoul(port.c_str(), NULL, 10));
+    m_acceptor.reset(new tcp::acceptor(m_ioService, endpoint));
+    m_work.reset(new io_service_t::work(m_ioService));
+    m_ioServiceThread = std::thread([this]() { m_ioService.run(); });
+
+    LOGGER(debug) << "StandInPeer::start() - serving " << m_blocks.size() << " blocks on port " << port << "." << std::endl;
+    doAccept();
+}
+
+void StandInPeer::stop()
+{
+    if (!m_acceptor) return;
+
+    // Closed from the io_service thread so no connection is accepted after the sessions are stopped.
+    // The aborted handlers then run, leaving the io_service idle when the sessions are destroyed.
+    m_ioService.post([this]()
+    {
+        m_acceptor->close();
+        std::lock_guard<std::mutex> lock(m_sessionsMutex);
+        for (auto& session: m_sessions) { session->peer.stop(); }
+    });
+    m_work.reset();
+    m_ioServiceThread.join();
+
+    m_sessions.clear();
+    m_acceptor.reset();
+    m_ioService.reset();
+}
+
+StandInPeer::Stats StandInPeer::getStats() const
+{
+    Stats stats;
+    stats.connections = m_connections;
+    stats.headers = m_headers;
+    stats.blocks = m_blocksSent;
+    stats.merkleBlocks = m_merkleBlocks;
+    stats.txs = m_txs;
+    return stats;
+}
+
+void StandInPeer::loadBlocks(const std::string& blocksDir)
+{
+    const uchar_vector magic = uint_to_vch(m_coinParams.magic_bytes(), _BIG_ENDIAN);
+    for (unsigned int fileIndex = 0; ; fileIndex++)
+    {
+        char filename[16];
+        std::snprintf(filename, sizeof(filename), "blk%05u.dat", fileIndex);
+        std::ifstream file(blocksDir + "/" + filename, std::ios::binary);
+        if (!file) break;
+
+        uchar_vector data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+        std::size_t pos = 0;
+        while (pos + 8 <= data.size())
+        {
+            // Files preallocated by a node are padded with zeros.
+            if (!std::equal(magic.begin(), magic.end(), data.begin() + pos)) break;
+
+            uint32_t size = vch_to_uint<uint32_t>(uchar_vector(data.begin() + pos + 4, data.begin() + pos + 8), _BIG_ENDIAN);
+            pos += 8;
+            if (pos + size > data.size()) throw std::runtime_error(std::string("Truncated block in ") + filename + ".");
+
+            Coin::CoinBlock block(uchar_vector(data.begin() + pos, data.begin() + pos + size));
+            pos += size;
+
+            uchar_vector hash = block.blockHeader.getHashLittleEndian();
+            if (m_blocks.empty())
+            {
+                if (hash != m_coinParams.genesis_block().getHashLittleEndian())
+                    throw std::runtime_error(std::string("The block files do not start at the ") + m_coinParams.network_name() + " genesis block.");
+            }
+            else if (block.blockHeader.prevBlockHash != m_blocks.back().blockHeader.getHashLittleEndian())
+            {
+                throw std::runtime_error("The blocks in the files are not one chain in order.");
+            }
+
+            m_heights[toKey(hash)] = m_blocks.size();
+            m_blocks.push_back(block);
+        }
+    }
+    if (m_blocks.empty()) throw std::runtime_error("No block files found.");
+}
+
+void StandInPeer::doAccept()
+{
+    session_ptr_t session(new Session(m_ioService, m_coinParams, getBestHeight()));
+    m_acceptor->async_accept(session->peer.socket(), [this, session](const boost::system::error_code& ec)
+    {
+        if (ec)
+        {
+            if (ec != boost::asio::error::operation_aborted) { LOGGER(error) << "StandInPeer - accept error: " << ec.message() << std::endl; }
+            return;
+        }
+
+        Session& s = *session;
+        s.peer.subscribeOpen([this](Peer& peer)
+        {
+            m_connections++;
+            LOGGER(debug) << "StandInPeer - " << peer.resolved_name() << " connected." << std::endl;
+        });
+        s.peer.subscribeClose([](Peer& peer, int code, const std::string& message)
+        {
+            LOGGER(debug) << "StandInPeer - " << peer.resolved_name() << " closed with code " << code << ": " << message << std::endl;
+        });
+        s.peer.subscribeMessage([this, &s](Peer& /*peer*/, const Coin::CoinNodeMessage& message)
+        {
+            try
+            {
+                onMessage(s, message);
+            }
+            catch (const std::exception& e)
+            {
+                LOGGER(error) << "StandInPeer - " << message.getCommand() << " error: " << e.what() << std::endl;
+            }
+        });
+
+        try
+        {
+            s.peer.startAccepted();
+            std::lock_guard<std::mutex> lock(m_sessionsMutex);
+            m_sessions.push_back(session);
+        }
+        catch (const std::exception& e)
+        {
+            LOGGER(error) << "StandInPeer - could not start session: " << e.what() << std::endl;
+        }
+        doAccept();
+    });
+}
+
+void StandInPeer::onMessage(Session& session, const Coin::CoinNodeMessage& message)
+{
+    std::string command = message.getCommand();
+    if (command == "filterload")
+    {
+        const Coin::FilterLoadMessage* pFilterLoad = static_cast<const Coin::FilterLoadMessage*>(message.getPayload());
+        session.filter.load(pFilterLoad->filter, pFilterLoad->nHashFuncs, pFilterLoad->nTweak, pFilterLoad->nFlags);
+    }
+    else if (command == "filteradd")
+    {
+        const Coin::FilterAddMessage* pFilterAdd = static_cast<const Coin::FilterAddMessage*>(message.getPayload());
+        if (session.filter.isSet()) { session.filter.insert(pFilterAdd->data); }
+    }
+    else if (command == "filterclear")
+    {
+        session.filter = Coin::BloomFilter();
+    }
+    else if (command == "getheaders")
+    {
+        sendHeaders(session, *static_cast<const Coin::GetHeadersMessage*>(message.getPayload()));
+    }
+    else if (command == "getdata")
+    {
+        const Coin::GetDataMessage* pGetData = static_cast<const Coin::GetDataMessage*>(message.getPayload());
+        for (auto& item: pGetData->items)
+        {
+            auto it = m_heights.find(std::string((const char*)item.hash, 32));
+            if (it == m_heights.end())
+            {
+                LOGGER(debug) << "StandInPeer - unknown item requested: " << uchar_vector(item.hash, 32).getHex() << std::endl;
+                continue;
+            }
+
+            if (item.itemType == MSG_FILTERED_BLOCK)
+            {
+                sendFilteredBlock(session, it->second);
+            }
+            else if (item.itemType == MSG_BLOCK)
+            {
+                Coin::CoinBlock block(m_blocks[it->second]);
+                session.peer.send(block);
+                m_blocksSent++;
+            }
+        }
+    }
+}
+
+void StandInPeer::sendHeaders(Session& session, const Coin::GetHeadersMessage& getHeaders)
+{
+    // Start after the first locator hash on the chain, or after the genesis block if none are.
+    uint32_t height = 0;
+    for (auto& hash: getHeaders.blockLocatorHashes)
+    {
+        auto it = m_heights.find(toKey(hash));
+        if (it != m_heights.end())
+        {
+            height = it->second;
+            break;
+        }
+    }
+
+    Coin::HeadersMessage headers;
+    while (++height < m_blocks.size() && headers.headers.size() < MAX_HEADERS_PER_MESSAGE)
+    {
+        const Coin::CoinBlockHeader& header = m_blocks[height].blockHeader;
+        headers.addHeader(header);
+        if (header.getHashLittleEndian() == getHeaders.hashStop) break;
+    }
+    session.peer.send(headers);
+    m_headers += headers.headers.size();
+}
+
+void StandInPeer::sendFilteredBlock(Session& session, uint32_t height)
+{
+    const Coin::CoinBlock& block = m_blocks[height];
+
+    std::vector<Coin::PartialMerkleTree::MerkleLeaf> leaves;
+    std::vector<const Coin::Transaction*> matchedTxs;
+    for (auto& tx: block.txs)
+    {
+        bool bMatch = matchTx(session.filter, tx);
+        leaves.push_back(std::make_pair(tx.getHash(), bMatch));
+        if (bMatch) { matchedTxs.push_back(&tx); }
+    }
+
+    Coin::PartialMerkleTree tree(leaves);
+    Coin::MerkleBlock merkleBlock(block.blockHeader, leaves.size(), tree.getMerkleHashesVector(), tree.getFlags());
+    session.peer.send(merkleBlock);
+    m_merkleBlocks++;
+
+    // The txs follow in the same send queue, so the client has them before any later merkle block.
+    for (auto pTx: matchedTxs)
+    {
+        Coin::Transaction tx(*pTx);
+        session.peer.send(tx);
+    }
+    m_txs += matchedTxs.size();
+}
@@ -0,0 +1,85 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// standinpeer.h
+//
+// Copyright (c) 2014 Eric Lombrozo
+//
+// All Rights Reserved.
+//
+
+#pragma once
+
+#include <CoinQ/CoinQ_coinparams.h>
+#include <CoinQ/CoinQ_peer_io.h>
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// Serves a chain read from blkNNNNN.dat files over the P2P protocol, standing in for a node so that
+// NetworkSync and SynchedVault can be run end to end against generated blocks on one machine.
+//
+// Each connection gets its own CoinQ::Peer, which does the handshake. Requests are answered from its
+// message subscription: getheaders with up to 2000 headers after the first known locator hash, and
+// getdata for blocks and filtered blocks. Filtered blocks are matched against the connection's
+// filterload filter as BIP37 describes and are followed by the matched txs. With no filter loaded,
+// every tx matches. There is no mempool, so mempool requests go unanswered.
+class StandInPeer
+{
+public:
+    struct Stats
+    {
+        Stats() : connections(0), headers(0), blocks(0), merkleBlocks(0), txs(0) { }
+
+        uint64_t connections;
+        uint64_t headers;
+        uint64_t blocks;
+        uint64_t merkleBlocks;
+        uint64_t txs;           // sent after merkle blocks
+    };
+
+    // The files must hold one chain starting at the network's genesis block, in order.
+    StandInPeer(const CoinQ::CoinParams& coinParams, const std::string& blocksDir);
+    ~StandInPeer();
+
+    // Listens on all interfaces.
+    void start(const std::string& port);
+    void stop();
+
+    uint32_t getBestHeight() const { return m_blocks.size() - 1; }
+    Stats getStats() const;
+
+private:
+    struct Session;
+    typedef std::shared_ptr<Session> session_ptr_t;
+
+    void loadBlocks(const std::string& blocksDir);
+    void doAccept();
+
+    void onMessage(Session& session, const Coin::CoinNodeMessage& message);
+    void sendHeaders(Session& session, const Coin::GetHeadersMessage& getHeaders);
+    void sendFilteredBlock(Session& session, uint32_t height);
+
+    CoinQ::CoinParams m_coinParams;
+    std::vector<Coin::CoinBlock> m_blocks;
+    std::unordered_map<std::string, uint32_t> m_heights;   // by little endian block hash
+
+    CoinQ::io_service_t m_ioService;
+    std::unique_ptr<CoinQ::io_service_t::work> m_work;
+    std::unique_ptr<CoinQ::tcp::acceptor> m_acceptor;
+    std::thread m_ioServiceThread;
+
+    // Sessions are kept until stop() since a peer cannot be destroyed from its own handlers.
+    std::mutex m_sessionsMutex;
+    std::vector<session_ptr_t> m_sessions;
+
+    std::atomic<uint64_t> m_connections;
+    std::atomic<uint64_t> m_headers;
+    std::atomic<uint64_t> m_blocksSent;
+    std::atomic<uint64_t> m_merkleBlocks;
+    std::atomic<uint64_t> m_txs;
+};
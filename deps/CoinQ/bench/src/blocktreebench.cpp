@@ -0,0 +1,118 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// blocktreebench.cpp
+//
+// Copyright (c) 2014 Eric Lombrozo
+//
+// All Rights Reserved.
+//
+// Benchmarks for CoinQBlockTreeMem over a synthetic header chain: inserting
+// headers one at a time and a headers message at a time, and flushing and
+// loading the tree file. Proof of work is not checked.
+//
+// Usage: blocktreebench [--repeat=n] [--filter=name] [--out=file] [--headers=n]
+//
+
+#include <CoinQ_blocks.h>
+
+#include <stdutils/benchutils.h>
+
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <stdexcept>
+#include <vector>
+
+const unsigned int HEADERS_PER_MESSAGE = 2000;
+const char* TREE_FILE = "blocktreebench.dat";
+
+static std::vector<Coin::CoinBlockHeader> makeChain(const Coin::CoinBlockHeader& genesis, uint64_t count)
+{
+    std::vector<Coin::CoinBlockHeader> headers;
+    headers.reserve(count);
+    uchar_vector prevHash = genesis.getHashLittleEndian();
+    uchar_vector merkleRoot(32, 0);
+    for (uint64_t i = 0; i < count; i++) {
+        merkleRoot[i % 32]++;
+        Coin::CoinBlockHeader header(2, prevHash, merkleRoot, genesis.timestamp + 600 * (i + 1), genesis.bits, i);
+        prevHash = header.getHashLittleEndian();
+        headers.push_back(header);
+    }
+    return headers;
+}
+
+static double secondsSince(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+static void checkHeight(const CoinQBlockTreeMem& blockTree, uint64_t count)
+{
+    if (blockTree.getBestHeight() != (int)count) throw std::runtime_error("Headers were not all connected.");
+}
+
+int main(int argc, char* argv[])
+{
+    try {
+        stdutils::bench_runner bench("blocktreebench", argc, argv);
+        const uint64_t count = bench.param("headers", 100000);
+
+        Coin::CoinBlockHeader genesis(1, 1231006505, 0x207fffff);
+        std::vector<Coin::CoinBlockHeader> chain = makeChain(genesis, count);
+
+        // The tree is built and destroyed outside of the timed section.
+        std::vector<double> seconds;
+        for (int i = 0; i < bench.repeat(); i++) {
+            CoinQBlockTreeMem blockTree(genesis, false, false);
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            for (auto& header: chain) { blockTree.insertHeader(header, false); }
+            seconds.push_back(secondsSince(start));
+            checkHeight(blockTree, count);
+        }
+        bench.record("CoinQBlockTreeMem::insertHeader", count, seconds);
+
+        seconds.clear();
+        for (int i = 0; i < bench.repeat(); i++) {
+            CoinQBlockTreeMem blockTree(genesis, false, false);
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            for (std::size_t j = 0; j < chain.size(); j += HEADERS_PER_MESSAGE) {
+                std::vector<Coin::CoinBlockHeader> headers(chain.begin() + j, chain.begin() + std::min<std::size_t>(j + HEADERS_PER_MESSAGE, chain.size()));
+                blockTree.insertHeaders(headers, false);
+            }
+            seconds.push_back(secondsSince(start));
+            checkHeight(blockTree, count);
+        }
+        bench.record("CoinQBlockTreeMem::insertHeaders", count, seconds);
+
+        if (bench.enabled("CoinQBlockTreeMem::flushToFile") || bench.enabled("CoinQBlockTreeMem::loadFromFile")) {
+            CoinQBlockTreeMem blockTree(genesis, false, false);
+            blockTree.insertHeaders(chain, false);
+
+            seconds.clear();
+            for (int i = 0; i < bench.repeat(); i++) {
+                std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+                blockTree.flushToFile(TREE_FILE);
+                seconds.push_back(secondsSince(start));
+            }
+            bench.record("CoinQBlockTreeMem::flushToFile", count, seconds);
+
+            seconds.clear();
+            for (int i = 0; i < bench.repeat(); i++) {
+                CoinQBlockTreeMem loaded(false, false);
+                std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+                loaded.loadFromFile(TREE_FILE, false);
+                seconds.push_back(secondsSince(start));
+                checkHeight(loaded, count);
+            }
+            bench.record("CoinQBlockTreeMem::loadFromFile", count, seconds);
+
+            std::remove(TREE_FILE);
+        }
+
+        return bench.finish();
+    }
+    catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return -1;
+    }
+}
@@ -0,0 +1,183 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// broadcastbench.cpp
+//
+// Copyright (c) 2014 Eric Lombrozo
+//
+// All Rights Reserved.
+//
+// Broadcast benchmark for CoinQ::WebSocket::Server. Connects many local
+// clients, subscribes them all to the header stream and pushes headers,
+// reporting the time spent inside pushHeader and the time until every
+// client has received every header.
+//
+// Each client uses two file descriptors, so raise ulimit -n for large counts.
+//
+
+#include <CoinQ_websocket.h>
+
+#include <websocketpp/config/asio_no_tls_client.hpp>
+#include <websocketpp/client.hpp>
+
+#include <boost/thread.hpp>
+
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace CoinQ;
+
+typedef websocketpp::client<websocketpp::config::asio_client> ws_client_t;
+typedef std::chrono::steady_clock steady_clock_t;
+
+const std::string SUBSCRIBE_REQUEST = "{\"method\":\"subscribe\",\"params\":[\"header\"],\"id\":0}";
+const std::string HEADER_PREFIX = "{\"header\":";
+
+class Clients
+{
+public:
+    Clients(ws_client_t& client, int count, int messages) : m_client(client), m_count(count), m_messages(messages), m_subscribed(0), m_received(0), m_failed(0) { }
+
+    void onOpen(websocketpp::connection_hdl hdl)
+    {
+        m_client.send(hdl, SUBSCRIBE_REQUEST, websocketpp::frame::opcode::text);
+    }
+
+    void onFail(websocketpp::connection_hdl hdl)
+    {
+        boost::lock_guard<boost::mutex> lock(m_mutex);
+        m_failed++;
+        m_cond.notify_all();
+    }
+
+    void onMessage(websocketpp::connection_hdl hdl, ws_client_t::message_ptr msg)
+    {
+        const std::string& payload = msg->get_payload();
+        boost::lock_guard<boost::mutex> lock(m_mutex);
+        if (payload.compare(0, HEADER_PREFIX.size(), HEADER_PREFIX) == 0) {
+            if (++m_received == (long)m_count * m_messages) {
+                m_finish = steady_clock_t::now();
+                m_cond.notify_all();
+            }
+        }
+        else if (payload.find("subscribedstreams") != std::string::npos) {
+            if (++m_subscribed == m_count) m_cond.notify_all();
+        }
+    }
+
+    // Returns false if some clients could not connect.
+    bool waitSubscribed()
+    {
+        boost::unique_lock<boost::mutex> lock(m_mutex);
+        while (m_subscribed + m_failed < m_count) { m_cond.wait(lock); }
+        return m_failed == 0;
+    }
+
+    // Returns false on timeout.
+    bool waitReceived(steady_clock_t::time_point& finish, std::chrono::seconds timeout)
+    {
+        boost::unique_lock<boost::mutex> lock(m_mutex);
+        boost::chrono::steady_clock::time_point deadline = boost::chrono::steady_clock::now() + boost::chrono::seconds(timeout.count());
+        while (m_received < (long)m_count * m_messages) {
+            if (m_cond.wait_until(lock, deadline) == boost::cv_status::timeout) return false;
+        }
+        finish = m_finish;
+        return true;
+    }
+
+    long received()
+    {
+        boost::lock_guard<boost::mutex> lock(m_mutex);
+        return m_received;
+    }
+
+private:
+    ws_client_t& m_client;
+    int m_count;
+    int m_messages;
+
+    boost::mutex m_mutex;
+    boost::condition_variable m_cond;
+    int m_subscribed;
+    long m_received;
+    int m_failed;
+    steady_clock_t::time_point m_finish;
+};
+
+int main(int argc, char* argv[])
+{
+    int count = argc > 1 ? strtol(argv[1], NULL, 10) : 1000;
+    int messages = argc > 2 ? strtol(argv[2], NULL, 10) : 100;
+    int port = argc > 3 ? strtol(argv[3], NULL, 10) : 12346;
+    if (count <= 0 || messages <= 0 || port <= 0) {
+        std::cerr << "# Usage: " << argv[0] << " [clients = 1000] [messages = 100] [port = 12346]" << std::endl;
+        return -1;
+    }
+
+    // The server logs every connection and message to stdout, so results go to stderr.
+    try {
+        WebSocket::Server server(port);
+        server.start();
+
+        ws_client_t client;
+        client.clear_access_channels(websocketpp::log::alevel::all);
+        client.clear_error_channels(websocketpp::log::elevel::all);
+        client.init_asio();
+
+        Clients clients(client, count, messages);
+        client.set_open_handler(websocketpp::lib::bind(&Clients::onOpen, &clients, websocketpp::lib::placeholders::_1));
+        client.set_fail_handler(websocketpp::lib::bind(&Clients::onFail, &clients, websocketpp::lib::placeholders::_1));
+        client.set_message_handler(websocketpp::lib::bind(&Clients::onMessage, &clients, websocketpp::lib::placeholders::_1, websocketpp::lib::placeholders::_2));
+
+        std::stringstream uri;
+        uri << "ws://localhost:" << port;
+        for (int i = 0; i < count; i++) {
+            websocketpp::lib::error_code ec;
+            ws_client_t::connection_ptr con = client.get_connection(uri.str(), ec);
+            if (ec) throw std::runtime_error(ec.message());
+            client.connect(con);
+        }
+
+        // The pending connects keep run() from returning until stop().
+        boost::thread clientThread(websocketpp::lib::bind(&ws_client_t::run, &client));
+
+        if (!clients.waitSubscribed()) throw std::runtime_error("Not all clients could connect. Try raising ulimit -n.");
+
+        ChainHeader header(2, 1400000000, 0x1d00ffff);
+        double pushMs = 0.0;
+        steady_clock_t::time_point start = steady_clock_t::now();
+        for (int i = 0; i < messages; i++) {
+            header.nonce = i;
+            header.height = i;
+            steady_clock_t::time_point pushStart = steady_clock_t::now();
+            server.pushHeader(header);
+            pushMs += std::chrono::duration<double, std::milli>(steady_clock_t::now() - pushStart).count();
+        }
+
+        steady_clock_t::time_point finish;
+        bool bDone = clients.waitReceived(finish, std::chrono::seconds(60));
+        double totalMs = std::chrono::duration<double, std::milli>((bDone ? finish : steady_clock_t::now()) - start).count();
+        long received = clients.received();
+
+        std::cerr << std::fixed << std::setprecision(3)
+                  << "clients:           " << count << std::endl
+                  << "messages:          " << messages << std::endl
+                  << "delivered:         " << received << " of " << (long)count * messages << std::endl
+                  << "push time:         " << pushMs << " ms (" << pushMs / messages << " ms per push)" << std::endl
+                  << "delivery time:     " << totalMs << " ms" << std::endl
+                  << "deliveries/s:      " << (totalMs > 0.0 ? received * 1000.0 / totalMs : 0.0) << std::endl;
+
+        client.stop();
+        clientThread.join();
+        server.stop();
+
+        return bDone ? 0 : -3;
+    }
+    catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return -2;
+    }
+}
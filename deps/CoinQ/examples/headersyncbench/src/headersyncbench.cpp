@@ -0,0 +1,105 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// headersyncbench.cpp
+//
+// Copyright (c) 2014 Eric Lombrozo
+//
+// All Rights Reserved.
+//
+// Measures header sync throughput into CoinQBlockTreeMem with the trace
+// statements NetworkSync makes per message, plus a trace dump of every
+// header standing in for the per-block inventory and merkle block dumps.
+// Runs once with trace compiled in but disabled and once with it enabled.
+//
+
+#define LOGGER_SUBSYSTEM "netsync"
+
+#include <CoinQ_blocks.h>
+
+#include <logger/logger.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <iomanip>
+#include <vector>
+
+const unsigned int HEADERS_PER_MESSAGE = 2000;
+
+static std::vector<Coin::CoinBlockHeader> makeChain(const Coin::CoinBlockHeader& genesis, unsigned int count)
+{
+    std::vector<Coin::CoinBlockHeader> headers;
+    headers.reserve(count);
+    uchar_vector prevHash = genesis.getHashLittleEndian();
+    uchar_vector merkleRoot(32, 0);
+    for (unsigned int i = 0; i < count; i++) {
+        merkleRoot[i % 32]++;
+        Coin::CoinBlockHeader header(2, prevHash, merkleRoot, genesis.timestamp + 600 * (i + 1), genesis.bits, i);
+        prevHash = header.getHashLittleEndian();
+        headers.push_back(header);
+    }
+    return headers;
+}
+
+// Mirrors the headers handler in CoinQ_netsync.cpp.
+static double syncMs(const Coin::CoinBlockHeader& genesis, const std::vector<Coin::CoinBlockHeader>& chain)
+{
+    CoinQBlockTreeMem blockTree(genesis, false, false);
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (std::size_t i = 0; i < chain.size(); i += HEADERS_PER_MESSAGE) {
+        std::vector<Coin::CoinBlockHeader> headers(chain.begin() + i, chain.begin() + std::min(i + HEADERS_PER_MESSAGE, chain.size()));
+        LOGGER(trace) << "Received headers message..." << std::endl;
+        for (auto& header: headers) {
+            LOGGER(trace) << "Received header:" << std::endl << header.toIndentedString() << std::endl;
+        }
+        blockTree.insertHeaders(headers, false);
+        LOGGER(trace) << "Processed " << headers.size() << " headers."
+             << " mBestHeight: " << blockTree.getBestHeight()
+             << " Attempting to fetch more headers..." << std::endl;
+    }
+    logger::flush();
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    if (blockTree.getBestHeight() != (int)chain.size()) {
+        std::cerr << "Best height is " << blockTree.getBestHeight() << ", expected " << chain.size() << "." << std::endl;
+        exit(-2);
+    }
+    return ms;
+}
+
+static void report(const std::string& name, unsigned int count, double ms)
+{
+    std::cout << std::left << std::setw(24) << name << std::right << std::fixed << std::setprecision(1)
+              << std::setw(12) << ms << " ms"
+              << std::setw(14) << std::setprecision(0) << count / ms * 1000 << " headers/s" << std::endl;
+}
+
+int main(int argc, char* argv[])
+{
+    unsigned int count = argc > 1 ? strtoul(argv[1], NULL, 10) : 100000;
+    const char* logFile = argc > 2 ? argv[2] : "headersyncbench.log";
+    if (count == 0) {
+        std::cerr << "# Usage: " << argv[0] << " [headers = 100000] [log file = headersyncbench.log]" << std::endl;
+        return -1;
+    }
+
+    Coin::CoinBlockHeader genesis(1, 1231006505, 0x207fffff);
+    std::vector<Coin::CoinBlockHeader> chain = makeChain(genesis, count);
+
+    INIT_LOGGER(logFile);
+    std::cout << count << " headers, " << HEADERS_PER_MESSAGE << " per message" << std::endl;
+
+    logger::set_level(logger::debug);
+    report("trace disabled", count, syncMs(genesis, chain));
+
+    logger::set_level(logger::trace);
+    report("trace enabled", count, syncMs(genesis, chain));
+
+    if (logger::dropped() > 0) {
+        std::cout << logger::dropped() << " records dropped" << std::endl;
+    }
+
+    return 0;
+}
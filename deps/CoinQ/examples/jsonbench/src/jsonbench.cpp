@@ -0,0 +1,195 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// jsonbench.cpp
+//
+// Copyright (c) 2014 Eric Lombrozo
+//
+// All Rights Reserved.
+//
+// Compares CoinQ::Json::Writer against building a json_spirit::Value tree
+// and calling write_string, for history-like rows and for a JSON-RPC
+// response carrying a large string result.
+//
+
+#include <CoinQ_jsonwriter.h>
+#include <CoinQ_jsonrpc.h>
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+
+using namespace CoinQ;
+
+// Mirrors the fields written for a TxOutView.
+struct Row
+{
+    std::string account;
+    std::string bin;
+    std::string label;
+    std::string type;
+    uint64_t value;
+    std::string address;
+    unsigned int confirmations;
+    std::string txstatus;
+    unsigned long txid;
+    std::vector<unsigned char> txhash;
+    uint32_t txindex;
+    uint32_t timestamp;
+    uint32_t height;
+};
+
+static std::string toHex(const std::vector<unsigned char>& data)
+{
+    static const char digits[] = "0123456789abcdef";
+    std::string hex;
+    for (auto c: data) { hex += digits[c >> 4]; hex += digits[c & 0x0f]; }
+    return hex;
+}
+
+static std::vector<Row> makeRows(std::size_t count)
+{
+    std::vector<Row> rows(count);
+    srand(1);
+    for (std::size_t i = 0; i < count; i++) {
+        Row& row = rows[i];
+        row.account = "account" + std::to_string(i % 7);
+        row.bin = "@default";
+        row.label = i % 3 ? "payment for \"invoice\" #" + std::to_string(i) : "";
+        row.type = i % 2 ? "receive" : "send";
+        row.value = (uint64_t)rand() * 1000;
+        row.address = "1BoatSLRHtKNngkdXEeobR76b53LETtpyT";
+        row.confirmations = i % 100;
+        row.txstatus = "CONFIRMED";
+        row.txid = i + 1;
+        row.txhash.resize(32);
+        for (auto& c: row.txhash) { c = rand() & 0xff; }
+        row.txindex = i % 4;
+        row.timestamp = 1400000000 + i;
+        row.height = 300000 + i;
+    }
+    return rows;
+}
+
+static std::string writeRowsSpirit(const std::vector<Row>& rows)
+{
+    json_spirit::Array array;
+    for (auto& row: rows) {
+        json_spirit::Object obj;
+        obj.push_back(json_spirit::Pair("account", row.account));
+        obj.push_back(json_spirit::Pair("bin", row.bin));
+        obj.push_back(json_spirit::Pair("label", row.label));
+        obj.push_back(json_spirit::Pair("type", row.type));
+        obj.push_back(json_spirit::Pair("value", row.value));
+        obj.push_back(json_spirit::Pair("address", row.address));
+        obj.push_back(json_spirit::Pair("confirmations", (uint64_t)row.confirmations));
+        obj.push_back(json_spirit::Pair("txstatus", row.txstatus));
+        obj.push_back(json_spirit::Pair("txid", (uint64_t)row.txid));
+        obj.push_back(json_spirit::Pair("txhash", toHex(row.txhash)));
+        obj.push_back(json_spirit::Pair("txindex", (uint64_t)row.txindex));
+        obj.push_back(json_spirit::Pair("timestamp", (uint64_t)row.timestamp));
+        obj.push_back(json_spirit::Pair("height", (uint64_t)row.height));
+        array.push_back(obj);
+    }
+    return json_spirit::write_string<json_spirit::Value>(array);
+}
+
+static std::string writeRowsWriter(const std::vector<Row>& rows)
+{
+    std::string json;
+    Json::Writer writer(json);
+    writer.beginArray();
+    for (auto& row: rows) {
+        writer.beginObject();
+        writer.member("account", row.account);
+        writer.member("bin", row.bin);
+        writer.member("label", row.label);
+        writer.member("type", row.type);
+        writer.member("value", row.value);
+        writer.member("address", row.address);
+        writer.member("confirmations", row.confirmations);
+        writer.member("txstatus", row.txstatus);
+        writer.member("txid", row.txid);
+        writer.key("txhash").hex(row.txhash);
+        writer.member("txindex", row.txindex);
+        writer.member("timestamp", row.timestamp);
+        writer.member("height", row.height);
+        writer.endObject();
+    }
+    writer.endArray();
+    return json;
+}
+
+static std::string writeResponseSpirit(const std::string& result)
+{
+    json_spirit::Object res;
+    res.push_back(json_spirit::Pair("result", result));
+    res.push_back(json_spirit::Pair("error", json_spirit::Value()));
+    res.push_back(json_spirit::Pair("id", 1));
+    return json_spirit::write_string<json_spirit::Value>(res);
+}
+
+static std::string writeResponseWriter(const std::string& result)
+{
+    JsonRpc::Response response;
+    response.setResult(result, 1);
+    return response.getJson();
+}
+
+// Both outputs must describe the same value.
+static bool sameJson(const std::string& a, const std::string& b)
+{
+    json_spirit::Value va, vb;
+    if (!json_spirit::read_string(a, va) || !json_spirit::read_string(b, vb)) return false;
+    return va == vb;
+}
+
+template<typename F>
+static double timeMs(F f, int iterations, std::size_t& bytes)
+{
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; i++) { bytes += f().size(); }
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / iterations;
+}
+
+static void report(const std::string& name, double spiritMs, double writerMs)
+{
+    std::cout << std::left << std::setw(24) << name << std::right << std::fixed << std::setprecision(3)
+              << std::setw(12) << spiritMs << " ms"
+              << std::setw(12) << writerMs << " ms"
+              << std::setw(9) << std::setprecision(2) << spiritMs / writerMs << "x" << std::endl;
+}
+
+int main(int argc, char* argv[])
+{
+    std::size_t rowCount = argc > 1 ? strtoul(argv[1], NULL, 10) : 10000;
+    int iterations = argc > 2 ? strtol(argv[2], NULL, 10) : 20;
+    if (rowCount == 0 || iterations <= 0) {
+        std::cerr << "# Usage: " << argv[0] << " [rows = 10000] [iterations = 20]" << std::endl;
+        return -1;
+    }
+
+    std::vector<Row> rows = makeRows(rowCount);
+    std::string table = writeRowsSpirit(rows); // stands in for a formatted history table
+
+    if (!sameJson(writeRowsSpirit(rows), writeRowsWriter(rows)) || !sameJson(writeResponseSpirit(table), writeResponseWriter(table))) {
+        std::cerr << "Outputs differ." << std::endl;
+        return -2;
+    }
+
+    std::size_t bytes = 0;
+    std::cout << rowCount << " rows, " << iterations << " iterations" << std::endl
+              << std::left << std::setw(24) << "" << std::right << std::setw(15) << "json_spirit" << std::setw(15) << "Json::Writer" << std::setw(10) << "speedup" << std::endl;
+
+    report("history rows",
+        timeMs([&]() { return writeRowsSpirit(rows); }, iterations, bytes),
+        timeMs([&]() { return writeRowsWriter(rows); }, iterations, bytes));
+
+    report("rpc string result",
+        timeMs([&]() { return writeResponseSpirit(table); }, iterations, bytes),
+        timeMs([&]() { return writeResponseWriter(table); }, iterations, bytes));
+
+    return bytes == 0;
+}
@@ -0,0 +1,277 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// rpcload.cpp
+//
+// Copyright (c) 2014 Eric Lombrozo
+//
+// All Rights Reserved.
+//
+// Load test client for JSON-RPC over websockets. Sends the same method many
+// times and reports throughput and per-request latency.
+//
+//  sequential  - one request per message, waits for each response
+//  pipelined   - one request per message, sends all without waiting
+//  batch       - a single JSON-RPC 2.0 batch array
+//  batchmethod - a single vaultd "batch" request wrapping the requests
+//
+// A parameter of the form @filename is replaced by successive lines of the
+// file, e.g. a list of tx hashes for txinfo.
+//
+
+#include <CoinQ_jsonrpc.h>
+
+#include <websocketpp/config/asio_no_tls_client.hpp>
+#include <websocketpp/client.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace CoinQ;
+
+typedef websocketpp::client<websocketpp::config::asio_client> ws_client_t;
+typedef std::chrono::steady_clock steady_clock_t;
+
+enum Mode { SEQUENTIAL, PIPELINED, BATCH, BATCH_METHOD };
+
+class LoadTest
+{
+public:
+    LoadTest(ws_client_t& client, Mode mode, int count, const std::string& method, const std::vector<std::string>& params)
+        : m_client(client), m_mode(mode), m_count(count), m_sent(count), m_latency(count, -1.0), m_received(0), m_errors(0), m_unmatched(0), m_bBatchAcked(false), m_next(0)
+    {
+        m_requests.resize(count);
+        setParams(method, params);
+    }
+
+    void onOpen(websocketpp::connection_hdl hdl)
+    {
+        m_start = steady_clock_t::now();
+        switch (m_mode) {
+        case SEQUENTIAL:
+            sendNext(hdl);
+            break;
+
+        case PIPELINED:
+            while (m_next < m_count) { sendNext(hdl); }
+            break;
+
+        case BATCH:
+        case BATCH_METHOD: {
+            json_spirit::Array reqs;
+            for (auto& request: m_requests) { reqs.push_back(request.getJsonObject()); }
+
+            std::string json;
+            if (m_mode == BATCH) {
+                json = json_spirit::write_string<json_spirit::Value>(reqs);
+            }
+            else {
+                json_spirit::Object req;
+                req.push_back(json_spirit::Pair("method", "batch"));
+                req.push_back(json_spirit::Pair("params", reqs));
+                req.push_back(json_spirit::Pair("id", m_count));
+                json = json_spirit::write_string<json_spirit::Value>(req);
+            }
+
+            steady_clock_t::time_point now = steady_clock_t::now();
+            std::fill(m_sent.begin(), m_sent.end(), now);
+            m_next = m_count;
+            m_client.send(hdl, json, websocketpp::frame::opcode::text);
+            break;
+        }
+        }
+    }
+
+    void onMessage(websocketpp::connection_hdl hdl, ws_client_t::message_ptr msg)
+    {
+        steady_clock_t::time_point now = steady_clock_t::now();
+
+        JsonRpc::BatchResponse batch;
+        try {
+            batch.setJson(msg->get_payload());
+        }
+        catch (const std::exception&) {
+            m_unmatched++;
+            return;
+        }
+
+        for (auto& response: batch.getResponses()) {
+            const json_spirit::Value& id = response.getId();
+            if (id.type() != json_spirit::int_type) {
+                m_unmatched++;
+                continue;
+            }
+
+            int i = id.get_int();
+            if (m_mode == BATCH_METHOD && i == m_count) {
+                m_bBatchAcked = true;
+                continue;
+            }
+
+            if (i < 0 || i >= m_count || m_latency[i] >= 0.0) {
+                m_unmatched++;
+                continue;
+            }
+
+            m_latency[i] = std::chrono::duration<double, std::milli>(now - m_sent[i]).count();
+            m_received++;
+            if (response.getError().type() != json_spirit::null_type) {
+                if (m_errors == 0) { std::cerr << "First error: " << json_spirit::write_string(response.getError()) << std::endl; }
+                m_errors++;
+            }
+
+            if (m_mode == SEQUENTIAL && m_next < m_count) { sendNext(hdl); }
+        }
+
+        if (m_received == m_count && (m_mode != BATCH_METHOD || m_bBatchAcked)) {
+            m_finish = now;
+            m_client.close(hdl, websocketpp::close::status::normal, "");
+        }
+    }
+
+    void report() const
+    {
+        if (m_received < m_count) {
+            std::cout << "Only " << m_received << " of " << m_count << " responses received." << std::endl;
+            return;
+        }
+
+        std::vector<double> latency(m_latency);
+        std::sort(latency.begin(), latency.end());
+        double elapsed = std::chrono::duration<double, std::milli>(m_finish - m_start).count();
+
+        std::cout << std::fixed << std::setprecision(3)
+                  << "requests:    " << m_count << std::endl
+                  << "errors:      " << m_errors << std::endl
+                  << "unmatched:   " << m_unmatched << std::endl
+                  << "elapsed:     " << elapsed << " ms" << std::endl
+                  << "throughput:  " << (elapsed > 0.0 ? m_count * 1000.0 / elapsed : 0.0) << " req/s" << std::endl
+                  << "latency min: " << latency.front() << " ms" << std::endl
+                  << "latency p50: " << percentile(latency, 50) << " ms" << std::endl
+                  << "latency p90: " << percentile(latency, 90) << " ms" << std::endl
+                  << "latency p99: " << percentile(latency, 99) << " ms" << std::endl
+                  << "latency max: " << latency.back() << " ms" << std::endl;
+    }
+
+private:
+    ws_client_t& m_client;
+    Mode m_mode;
+    int m_count;
+
+    std::vector<JsonRpc::Request> m_requests;
+    std::vector<steady_clock_t::time_point> m_sent;
+    std::vector<double> m_latency;
+
+    int m_received;
+    int m_errors;
+    int m_unmatched;
+    bool m_bBatchAcked;
+    int m_next;
+
+    steady_clock_t::time_point m_start;
+    steady_clock_t::time_point m_finish;
+
+    void setParams(const std::string& method, const std::vector<std::string>& params)
+    {
+        std::vector<std::vector<std::string>> values(m_count, std::vector<std::string>());
+        for (auto& param: params) {
+            if (param.empty() || param[0] != '@') {
+                for (auto& v: values) { v.push_back(param); }
+                continue;
+            }
+
+            std::ifstream file(param.substr(1).c_str());
+            if (!file) throw std::runtime_error("Could not open " + param.substr(1) + ".");
+
+            std::vector<std::string> lines;
+            std::string line;
+            while (std::getline(file, line)) { if (!line.empty()) lines.push_back(line); }
+            if (lines.empty()) throw std::runtime_error(param.substr(1) + " is empty.");
+
+            for (int i = 0; i < m_count; i++) { values[i].push_back(lines[i % lines.size()]); }
+        }
+
+        for (int i = 0; i < m_count; i++) {
+            json_spirit::Array array(values[i].begin(), values[i].end());
+            json_spirit::Object req;
+            req.push_back(json_spirit::Pair("method", method));
+            req.push_back(json_spirit::Pair("params", array));
+            req.push_back(json_spirit::Pair("id", i));
+            m_requests[i].setJsonObject(req);
+        }
+    }
+
+    void sendNext(websocketpp::connection_hdl hdl)
+    {
+        int i = m_next++;
+        m_sent[i] = steady_clock_t::now();
+        m_client.send(hdl, m_requests[i].getJson(), websocketpp::frame::opcode::text);
+    }
+
+    static double percentile(const std::vector<double>& sorted, int p)
+    {
+        std::size_t i = (sorted.size() - 1) * p / 100;
+        return sorted[i];
+    }
+};
+
+int main(int argc, char* argv[])
+{
+    if (argc < 5) {
+        std::cerr << "# Usage: " << argv[0] << " <uri> <sequential | pipelined | batch | batchmethod> <count> <method> [param1 param2 ...]" << std::endl
+                  << "#   A param of the form @file takes successive lines of file." << std::endl
+                  << "#   Example: " << argv[0] << " ws://localhost:12345 batchmethod 500 txinfo vault.db @hashes.txt" << std::endl;
+        return -1;
+    }
+
+    std::string uri = argv[1];
+    std::string modename = argv[2];
+    int count = strtol(argv[3], NULL, 10);
+    std::string method = argv[4];
+    std::vector<std::string> params(&argv[5], &argv[argc]);
+
+    Mode mode;
+    if (modename == "sequential")       { mode = SEQUENTIAL; }
+    else if (modename == "pipelined")   { mode = PIPELINED; }
+    else if (modename == "batch")       { mode = BATCH; }
+    else if (modename == "batchmethod") { mode = BATCH_METHOD; }
+    else {
+        std::cerr << "Invalid mode." << std::endl;
+        return -1;
+    }
+
+    if (count <= 0) {
+        std::cerr << "Invalid count." << std::endl;
+        return -1;
+    }
+
+    try {
+        ws_client_t client;
+        client.clear_access_channels(websocketpp::log::alevel::all);
+        client.clear_error_channels(websocketpp::log::elevel::all);
+        client.init_asio();
+
+        LoadTest test(client, mode, count, method, params);
+        client.set_open_handler(websocketpp::lib::bind(&LoadTest::onOpen, &test, websocketpp::lib::placeholders::_1));
+        client.set_message_handler(websocketpp::lib::bind(&LoadTest::onMessage, &test, websocketpp::lib::placeholders::_1, websocketpp::lib::placeholders::_2));
+
+        websocketpp::lib::error_code ec;
+        ws_client_t::connection_ptr con = client.get_connection(uri, ec);
+        if (ec) throw std::runtime_error(ec.message());
+
+        client.connect(con);
+        client.run();
+
+        test.report();
+    }
+    catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return -2;
+    }
+
+    return 0;
+}
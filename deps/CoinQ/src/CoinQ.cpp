@@ -131,6 +131,8 @@ int main(int argc, char** argv)
     int peerPort;
     int wsPort;
     std::string wsAllowedIps;
+    unsigned int wsWorkers;
+    unsigned int wsMaxQueue;
     std::string blockTreeFile;
     std::string txFile;
     std::string addressesFile;
@@ -148,6 +150,8 @@ int main(int argc, char** argv)
         ("peerport", po::value<int>( &peerPort ), "p2p port on which to connect (default: 8333)")
         ("wsport", po::value<int>( &wsPort ), "port on which to accept websocket connections (default: 9002)")
         ("wsallowedips", po::value<std::string>( &wsAllowedIps ), wsAllowedIpsDesc.c_str())
+        ("wsworkers", po::value<unsigned int>( &wsWorkers ), "number of threads executing websocket requests (default: one per core)")
+        ("wsmaxqueue", po::value<unsigned int>( &wsMaxQueue ), "number of waiting websocket requests beyond which new ones are refused (default: unlimited)")
         ("blocktree", po::value<std::string>( &blockTreeFile ), "name of file in which block tree is stored (required)")
         ("txdb", po::value<std::string>( &txFile ), "name of file to use for transaction database (required)")
         ("addresses", po::value<std::string>( &addressesFile ), "name of file containing addresses to watch (required)")
@@ -179,6 +183,8 @@ int main(int argc, char** argv)
     if (!vm.count("peerport")) peerPort = 8333;
     if (!vm.count("wsport")) wsPort = 9002;
     if (!vm.count("wsallowedips")) wsAllowedIps = CoinQ::WebSocket::DEFAULT_ALLOWED_IPS;
+    if (!vm.count("wsworkers")) wsWorkers = 0;
+    if (!vm.count("wsmaxqueue")) wsMaxQueue = 0;
     bool bResync = vm.count("resyncheight");
 
     std::cout << std::endl;
@@ -247,6 +253,8 @@ int main(int argc, char** argv)
 
     // Start WebSocket server
     CoinQ::WebSocket::Server wsServer(wsPort, wsAllowedIps);
+    wsServer.setWorkerCount(wsWorkers);
+    wsServer.setMaxQueueDepth(wsMaxQueue);
     try {
         wsServer.setBestHeader(blockTree.getHeader(-1));
         std::cout << "Starting websockets server..." << std::flush;
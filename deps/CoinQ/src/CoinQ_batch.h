@@ -0,0 +1,40 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// CoinQ_batch.h
+//
+// Copyright (c) 2014 Eric Lombrozo
+//
+// All Rights Reserved.
+
+#ifndef _COINQ_BATCH_H_
+#define _COINQ_BATCH_H_
+
+#include <vector>
+
+namespace CoinQ {
+
+// Runs the requests of a batch in array order. Built-in requests run one at a time. The
+// application requests between them go to runApplication together, so the application can serve
+// them under one session. A run is always handed over before the built-in that follows it.
+template<typename Request, typename IsBuiltin, typename RunBuiltin, typename RunApplication>
+void dispatchBatch(const std::vector<Request>& reqs, IsBuiltin isBuiltin, RunBuiltin runBuiltin, RunApplication runApplication)
+{
+    std::vector<Request> run;
+    for (auto& req: reqs) {
+        if (!isBuiltin(req)) {
+            run.push_back(req);
+            continue;
+        }
+
+        if (!run.empty()) {
+            runApplication(run);
+            run.clear();
+        }
+        runBuiltin(req);
+    }
+    if (!run.empty()) { runApplication(run); }
+}
+
+}
+
+#endif // _COINQ_BATCH_H_
@@ -6,6 +6,8 @@
 //
 // All Rights Reserved.
 
+#define LOGGER_SUBSYSTEM "blocks"
+
 #include "CoinQ_blocks.h"
 
 #include <logger/logger.h>
@@ -103,6 +105,11 @@ void CoinQBlockTreeMem::setGenesisBlock(const Coin::CoinBlockHeader& header)
 }
 
 bool CoinQBlockTreeMem::insertHeader(const Coin::CoinBlockHeader& header, bool bCheckProofOfWork)
+{
+    return insertHeader_(header, bCheckProofOfWork, uchar_vector());
+}
+
+bool CoinQBlockTreeMem::insertHeader_(const Coin::CoinBlockHeader& header, bool bCheckProofOfWork, const uchar_vector& powHash)
 {
     if (mHeaderHashMap.size() == 0) {
         throw std::runtime_error("No genesis block.");
@@ -130,7 +137,7 @@ bool CoinQBlockTreeMem::insertHeader(const Coin::CoinBlockHeader& header, bool b
     if (!bCheckProofOfWork) { 
         // Do nothing
     }
-    else if (this->bCheckProofOfWork && BigInt(header.getPOWHashLittleEndian()) > header.getTarget()) {
+    else if (this->bCheckProofOfWork && BigInt(powHash.empty() ? header.getPOWHashLittleEndian() : powHash) > header.getTarget()) {
         throw std::runtime_error("Header hash is too big.");
     }
 
@@ -148,6 +155,67 @@ bool CoinQBlockTreeMem::insertHeader(const Coin::CoinBlockHeader& header, bool b
     return true;
 }
 
+unsigned int CoinQBlockTreeMem::insertHeaders(const std::vector<Coin::CoinBlockHeader>& headers, bool bCheckProofOfWork)
+{
+    if (mHeaderHashMap.size() == 0) {
+        throw std::runtime_error("No genesis block.");
+    }
+
+    // Check linkage for the whole batch before touching the tree.
+    std::vector<uchar_vector> hashes;
+    std::vector<Coin::CoinBlockHeader> newHeaders;
+    std::set<uchar_vector> batchHashes;
+    for (auto& header: headers) {
+        uchar_vector hash = header.getHashLittleEndian();
+        if (hasHeader(hash) || batchHashes.count(hash)) continue;
+
+        if (!hasHeader(header.prevBlockHash) && !batchHashes.count(header.prevBlockHash)) {
+            throw std::runtime_error(std::string("Parent not found for block ") + hash.getHex() + ".");
+        }
+        batchHashes.insert(hash);
+        hashes.push_back(hash);
+        newHeaders.push_back(header);
+    }
+
+    if (newHeaders.empty()) return 0;
+
+    // Check proof of work for the whole batch at once.
+    if (bCheckProofOfWork && this->bCheckProofOfWork) {
+        std::vector<uchar_vector> powHashes = Coin::CoinBlockHeader::getPOWHashesLittleEndian(newHeaders);
+        for (unsigned int i = 0; i < newHeaders.size(); i++) {
+            if (BigInt(powHashes[i]) > newHeaders[i].getTarget()) {
+                throw std::runtime_error(std::string("Header hash is too big for block ") + hashes[i].getHex() + ".");
+            }
+        }
+    }
+
+    ChainHeader* pBest = NULL;
+    for (unsigned int i = 0; i < newHeaders.size(); i++) {
+        ChainHeader& parent = mHeaderHashMap.at(newHeaders[i].prevBlockHash);
+        ChainHeader& chainHeader = mHeaderHashMap[hashes[i]] = newHeaders[i];
+        chainHeader.height = parent.height + 1;
+        chainHeader.chainWork = parent.chainWork + chainHeader.getWork();
+        parent.childHashes.insert(hashes[i]);
+        notifyInsert(chainHeader);
+
+        if (chainHeader.chainWork > (pBest ? pBest->chainWork : mTotalWork)) {
+            pBest = &chainHeader;
+        }
+    }
+
+    // Extend the best chain once, from the fork point to the best header in the batch.
+    int beginHeight = mBestHeight + 1;
+    if (pBest) {
+        ChainHeader* pFork = pBest;
+        while (!pFork->inBestChain) { pFork = &mHeaderHashMap.at(pFork->prevBlockHash); }
+        beginHeight = pFork->height + 1;
+        setBestChain(*pBest);
+    }
+
+    notifyInsertBatch(ChainHeaderRange(*pHead, beginHeight, mBestHeight, newHeaders.size()));
+    return newHeaders.size();
+}
+
 bool CoinQBlockTreeMem::deleteHeader(const uchar_vector& hash)
 {
     header_hash_map_t::iterator it = mHeaderHashMap.find(hash);
@@ -278,37 +346,54 @@ void CoinQBlockTreeMem::loadFromFile(const std::string& filename, bool bCheckPro
     clear();
     uchar_vector headerBytes;
     uchar_vector hash;
-    Coin::CoinBlockHeader header;
+    std::vector<Coin::CoinBlockHeader> headers;
+    std::vector<uchar_vector> powHashes;
+    bool bBatchProofOfWork = bCheckProofOfWork && this->bCheckProofOfWork;
 
     unsigned int count = 0;
 
-    char buf[RECORD_SIZE * 64];
+    // Headers are read in chunks so that proof of work hashes can be computed a chunk at a time.
+    const unsigned int CHUNK_RECORDS = 2016;
+    std::vector<char> buf(RECORD_SIZE * CHUNK_RECORDS);
     while (fs) {
-        fs.read(buf, RECORD_SIZE * 64);
+        fs.read(&buf[0], buf.size());
         if (fs.bad()) {
             throw std::runtime_error("Read failure.");
         }
 
         unsigned int nbytesread = fs.gcount();
-        unsigned int pos = 0;
-        for (; pos <= nbytesread - RECORD_SIZE; pos += RECORD_SIZE) {
+        if (nbytesread % RECORD_SIZE != 0) {
+            throw std::runtime_error("Unexpected end of file."); // Should never happen since length is checked above.
+        }
+
+        headers.clear();
+        for (unsigned int pos = 0; pos < nbytesread; pos += RECORD_SIZE) {
             headerBytes.assign((unsigned char*)&buf[pos], (unsigned char*)&buf[pos + MIN_COIN_BLOCK_HEADER_SIZE]);
-            header.setSerialized(headerBytes);
+            headers.push_back(Coin::CoinBlockHeader());
+            headers.back().setSerialized(headerBytes);
+        }
+
+        if (bBatchProofOfWork) {
+            powHashes = Coin::CoinBlockHeader::getPOWHashesLittleEndian(headers);
+        }
+
+        for (unsigned int i = 0; i < headers.size(); i++) {
+            const Coin::CoinBlockHeader& header = headers[i];
             hash = header.getHashLittleEndian();
-            if (memcmp(&buf[pos + MIN_COIN_BLOCK_HEADER_SIZE], &hash[0], 4)) {
+            if (memcmp(&buf[i * RECORD_SIZE + MIN_COIN_BLOCK_HEADER_SIZE], &hash[0], 4)) {
                 throw std::runtime_error("Checksum error in file.");
             }
 
             try {
                 if (mBestHeight >= 0) {
                     if (count % 10000 == 0) {
-                        LOGGER(debug) << "CoinQBlockTreeMem::loadFromFile() - header hash: " << header.getHashLittleEndian().getHex() << " height: " << count << std::endl;
+                        LOGGER(debug) << "CoinQBlockTreeMem::loadFromFile() - header hash: " << hash.getHex() << " height: " << count << std::endl;
                     }
-                    insertHeader(header, bCheckProofOfWork);
+                    insertHeader_(header, bCheckProofOfWork, bBatchProofOfWork ? powHashes[i] : uchar_vector());
                     count++;
                 }
                 else { 
-                    LOGGER(debug) << "CoinQBlockTreeMem::loadFromFile() - genesis hash: " << header.getHashLittleEndian().getHex() << std::endl;
+                    LOGGER(debug) << "CoinQBlockTreeMem::loadFromFile() - genesis hash: " << hash.getHex() << std::endl;
                     setGenesisBlock(header);
                     count++;
                 }
@@ -317,9 +402,6 @@ void CoinQBlockTreeMem::loadFromFile(const std::string& filename, bool bCheckPro
                 throw std::runtime_error(std::string("Block ") + hash.getHex() + ": " + e.what());
             }
         }
-        if (pos != nbytesread) {
-            throw std::runtime_error("Unexpected end of file."); // Should never happen since length is checked above.
-        }
     }
 }
 
@@ -72,9 +72,24 @@ public:
     ChainHeader getHeader() const { return ChainHeader(blockHeader, inBestChain, height, chainWork); }
 };
 
+// Summary of a batch of inserted headers. Heights beginHeight through endHeight were added to the best chain
+// (none if beginHeight > endHeight) and tip is the best header after the batch.
+class ChainHeaderRange
+{
+public:
+    ChainHeader tip;
+    int beginHeight;
+    int endHeight;
+    unsigned int count; // number of headers that were new to the tree
+
+    ChainHeaderRange() : beginHeight(0), endHeight(-1), count(0) { }
+    ChainHeaderRange(const ChainHeader& _tip, int _beginHeight, int _endHeight, unsigned int _count) : tip(_tip), beginHeight(_beginHeight), endHeight(_endHeight), count(_count) { }
+};
+
 typedef std::function<void(const ChainHeader&)>      chain_header_slot_t;
 typedef std::function<void(const ChainBlock&)>       chain_block_slot_t;
 typedef std::function<void(const ChainMerkleBlock&)> chain_merkle_block_slot_t;
+typedef std::function<void(const ChainHeaderRange&)> chain_header_range_slot_t;
 
 class ICoinQBlockTree
 {
@@ -88,11 +103,15 @@ public:
     virtual void clearRemoveBestChain() = 0;
     virtual void clearInsert() = 0;
     virtual void clearDelete() = 0;
-    void unsubscribeAll() { clearAddBestChain(); clearRemoveBestChain(); clearInsert(); clearDelete(); }
+    virtual void clearInsertBatch() = 0;
+    void unsubscribeAll() { clearAddBestChain(); clearRemoveBestChain(); clearInsert(); clearDelete(); clearInsertBatch(); }
 
     // slot is passed the header of the oldest block not in the old chain
     virtual void subscribeReorg(chain_header_slot_t slot) = 0;
 
+    // slot is called once per insertHeaders call, after the per header signals
+    virtual void subscribeInsertBatch(chain_header_range_slot_t slot) = 0;
+
     virtual void setGenesisBlock(const Coin::CoinBlockHeader& header) = 0;
 
     // returns true if new header added, false if header already exists
@@ -100,6 +119,10 @@ public:
 //    virtual bool insertHeader(const Coin::CoinBlockHeader& header) = 0;
     virtual bool insertHeader(const Coin::CoinBlockHeader& header, bool bCheckProofOfWork) = 0;
 
+    // inserts headers in order, each a child of a known header or of an earlier header in the batch.
+    // returns the number of new headers. throws runtime_error and inserts nothing if any header is invalid or unlinked.
+    virtual unsigned int insertHeaders(const std::vector<Coin::CoinBlockHeader>& headers, bool bCheckProofOfWork) = 0;
+
     // returns true if header removed, false if header unknown
     virtual bool deleteHeader(const uchar_vector& hash) = 0;
  
@@ -139,11 +162,15 @@ private:
     CoinQSignal<const ChainHeader&> notifyInsert;
     CoinQSignal<const ChainHeader&> notifyDelete;
     CoinQSignal<const ChainHeader&> notifyReorg;
+    CoinQSignal<const ChainHeaderRange&> notifyInsertBatch;
 
 protected:
     bool setBestChain(ChainHeader& header);
     bool unsetBestChain(ChainHeader& header);
 
+    // powHash is the little endian proof of work hash if it was already computed, or empty.
+    bool insertHeader_(const Coin::CoinBlockHeader& header, bool bCheckProofOfWork, const uchar_vector& powHash);
+
 public:
     CoinQBlockTreeMem(bool _bCheckTimestamp = true, bool _bCheckProofOfWork = true)
         : mBestHeight(-1), mTotalWork(0), pHead(NULL), bCheckTimestamp(_bCheckTimestamp), bCheckProofOfWork(_bCheckProofOfWork) { }
@@ -155,15 +182,18 @@ public:
     void subscribeInsert(chain_header_slot_t slot) { notifyInsert.connect(slot); }
     void subscribeDelete(chain_header_slot_t slot) { notifyDelete.connect(slot); }
     void subscribeReorg(chain_header_slot_t slot) { notifyReorg.connect(slot); }
+    void subscribeInsertBatch(chain_header_range_slot_t slot) { notifyInsertBatch.connect(slot); }
 
     void clearAddBestChain() { notifyAddBestChain.clear(); }
     void clearRemoveBestChain() { notifyRemoveBestChain.clear(); }
     void clearInsert() { notifyInsert.clear(); }
     void clearDelete() { notifyDelete.clear(); }
     void clearReorg() { notifyReorg.clear();; }
+    void clearInsertBatch() { notifyInsertBatch.clear(); }
 
     void setGenesisBlock(const Coin::CoinBlockHeader& header);
     bool insertHeader(const Coin::CoinBlockHeader& header, bool bCheckProofOfWork = true);
+    unsigned int insertHeaders(const std::vector<Coin::CoinBlockHeader>& headers, bool bCheckProofOfWork = true);
     bool deleteHeader(const uchar_vector& hash);
 
     bool hasHeader(const uchar_vector& hash) const;
@@ -108,4 +108,123 @@ json_spirit::Object getChainTransactionJsonObject(const ChainTransaction& tx)
     return obj;
 }
 
+
+
+// Members are written without the enclosing braces so derived types can append their own.
+static void writeHeaderMembers(Json::Writer& writer, const Coin::CoinBlockHeader& header)
+{
+    writer.key("hash").hex(header.getHashLittleEndian());
+    writer.member("version", header.version);
+    writer.key("prevblockhash").hex(header.prevBlockHash);
+    writer.key("merkleroot").hex(header.merkleRoot);
+    writer.member("timestamp", header.timestamp);
+    writer.member("bits", header.bits);
+    writer.member("nonce", header.nonce);
+}
+
+static void writeChainMembers(Json::Writer& writer, bool inBestChain, int height, const BigInt& chainWork)
+{
+    writer.member("inbestchain", inBestChain);
+    writer.member("height", height);
+    writer.member("chainwork", chainWork.getDec());
+}
+
+static void writeTransactionMembers(Json::Writer& writer, const Coin::Transaction& tx)
+{
+    writer.key("hash").hex(tx.getHashLittleEndian());
+    writer.member("version", tx.version);
+    writer.key("inputs").beginArray();
+    for (auto& txIn: tx.inputs) { writeTxInJson(writer, txIn); }
+    writer.endArray();
+    writer.key("outputs").beginArray();
+    for (auto& txOut: tx.outputs) { writeTxOutJson(writer, txOut); }
+    writer.endArray();
+    writer.member("locktime", tx.lockTime);
+}
+
+static void writeBlockMembers(Json::Writer& writer, const Coin::CoinBlock& block, bool allFields)
+{
+    writeHeaderMembers(writer, block.blockHeader);
+    if (allFields) {
+        writer.member("size", block.getSize());
+        writer.member("sent", block.getTotalSent());
+    }
+    writer.key("txs").beginArray();
+    for (auto& tx: block.txs) { writeTransactionJson(writer, tx); }
+    writer.endArray();
+}
+
+void writeTxInJson(Json::Writer& writer, const Coin::TxIn& txIn)
+{
+    writer.beginObject();
+    writer.key("outhash").hex(txIn.previousOut.hash, 32);
+    writer.member("outindex", txIn.getOutpointIndex());
+    writer.key("script").hex(txIn.scriptSig);
+    writer.member("address", txIn.getAddress());
+    writer.member("sequence", txIn.sequence);
+    writer.endObject();
+}
+
+void writeTxOutJson(Json::Writer& writer, const Coin::TxOut& txOut)
+{
+    // Amounts are sent as strings, as in getTxOutJsonObject().
+    std::stringstream ss;
+    ss << txOut.value;
+
+    writer.beginObject();
+    writer.member("amount_int", ss.str());
+    writer.key("script").hex(txOut.scriptPubKey);
+    writer.member("address", txOut.getAddress());
+    writer.endObject();
+}
+
+void writeTransactionJson(Json::Writer& writer, const Coin::Transaction& tx)
+{
+    writer.beginObject();
+    writeTransactionMembers(writer, tx);
+    writer.endObject();
+}
+
+void writeHeaderJson(Json::Writer& writer, const Coin::CoinBlockHeader& header)
+{
+    writer.beginObject();
+    writeHeaderMembers(writer, header);
+    writer.endObject();
+}
+
+void writeBlockJson(Json::Writer& writer, const Coin::CoinBlock& block, bool allFields)
+{
+    writer.beginObject();
+    writeBlockMembers(writer, block, allFields);
+    writer.endObject();
+}
+
+void writeChainHeaderJson(Json::Writer& writer, const ChainHeader& header)
+{
+    writer.beginObject();
+    writeHeaderMembers(writer, header);
+    writeChainMembers(writer, header.inBestChain, header.height, header.chainWork);
+    writer.endObject();
+}
+
+void writeChainBlockJson(Json::Writer& writer, const ChainBlock& block, bool allFields)
+{
+    writer.beginObject();
+    writeBlockMembers(writer, block, allFields);
+    writeChainMembers(writer, block.inBestChain, block.height, block.chainWork);
+    writer.endObject();
+}
+
+void writeChainTransactionJson(Json::Writer& writer, const ChainTransaction& tx)
+{
+    writer.beginObject();
+    writeTransactionMembers(writer, tx);
+    if (tx.blockHeader.height > -1) {
+        writer.key("header");
+        writeChainHeaderJson(writer, tx.blockHeader);
+        writer.member("index", tx.index);
+    }
+    writer.endObject();
+}
+
 }
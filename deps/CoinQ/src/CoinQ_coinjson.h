@@ -11,6 +11,7 @@
 
 #include "CoinQ_blocks.h"
 #include "CoinQ_txs.h"
+#include "CoinQ_jsonwriter.h"
 
 #include <json_spirit/json_spirit_reader_template.h>
 #include <json_spirit/json_spirit_writer_template.h>
@@ -29,6 +30,16 @@ json_spirit::Object getChainHeaderJsonObject(const ChainHeader& header);
 json_spirit::Object getChainBlockJsonObject(const ChainBlock& block, bool allFields = false);
 json_spirit::Object getChainTransactionJsonObject(const ChainTransaction& tx);
 
+// Streaming versions of the above. They produce the same fields without building a json_spirit tree.
+void writeTxInJson(Json::Writer& writer, const Coin::TxIn& txIn);
+void writeTxOutJson(Json::Writer& writer, const Coin::TxOut& txOut);
+void writeTransactionJson(Json::Writer& writer, const Coin::Transaction& tx);
+void writeHeaderJson(Json::Writer& writer, const Coin::CoinBlockHeader& header);
+void writeBlockJson(Json::Writer& writer, const Coin::CoinBlock& block, bool allFields = false);
+void writeChainHeaderJson(Json::Writer& writer, const ChainHeader& header);
+void writeChainBlockJson(Json::Writer& writer, const ChainBlock& block, bool allFields = false);
+void writeChainTransactionJson(Json::Writer& writer, const ChainTransaction& tx);
+
 }
 
 #endif // _COINQ_COINJSON_H_
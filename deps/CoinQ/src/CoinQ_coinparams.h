@@ -26,7 +26,8 @@ public:
         const char* url_prefix,
         Coin::hashfunc_t block_header_hash_function,
         Coin::hashfunc_t block_header_pow_hash_function,
-        const Coin::CoinBlockHeader& genesis_block) :
+        const Coin::CoinBlockHeader& genesis_block,
+        batch_hashfunc_t block_header_pow_batch_hash_function = batch_hashfunc_t()) :
     magic_bytes_(magic_bytes),
     protocol_version_(protocol_version),
     default_port_(default_port),
@@ -36,6 +37,7 @@ public:
     url_prefix_(url_prefix),
     block_header_hash_function_(block_header_hash_function),
     block_header_pow_hash_function_(block_header_pow_hash_function),
+    block_header_pow_batch_hash_function_(block_header_pow_batch_hash_function),
     genesis_block_(genesis_block) { }
 
     uint32_t                        magic_bytes() const { return magic_bytes_; }
@@ -47,6 +49,7 @@ public:
     const char*                     url_prefix() const { return url_prefix_; }
     Coin::hashfunc_t                block_header_hash_function() const { return block_header_hash_function_; }
     Coin::hashfunc_t                block_header_pow_hash_function() const { return block_header_pow_hash_function_; }
+    batch_hashfunc_t                block_header_pow_batch_hash_function() const { return block_header_pow_batch_hash_function_; }
     const Coin::CoinBlockHeader&    genesis_block() const { return genesis_block_; }
 
 private:
@@ -59,25 +62,37 @@ private:
     const char*             url_prefix_;
     Coin::hashfunc_t        block_header_hash_function_;
     Coin::hashfunc_t        block_header_pow_hash_function_;
+    batch_hashfunc_t        block_header_pow_batch_hash_function_;
     Coin::CoinBlockHeader   genesis_block_;
 };
 
 inline CoinParams getBitcoinParams()
 {
     return CoinParams(0xd9b4bef9ul, 70001, "8333", 0x00, 0x05, "Bitcoin", "bitcoin", &sha256_2, &sha256_2,
-        Coin::CoinBlockHeader(1, 1231006505, 486604799, 2083236893, uchar_vector(32, 0), uchar_vector("4a5e1e4baab89f3a32518a88c31bc87f618f76673e2cc77ab2127b7afdeda33b")));
+        Coin::CoinBlockHeader(1, 1231006505, 486604799, 2083236893, uchar_vector(32, 0), uchar_vector("4a5e1e4baab89f3a32518a88c31bc87f618f76673e2cc77ab2127b7afdeda33b")),
+        &sha256_2_batch);
+}
+
+// Bitcoin regression test network. Blocks are mined at minimum difficulty, so chains can be generated locally.
+inline CoinParams getBitcoinRegtestParams()
+{
+    return CoinParams(0xdab5bffaul, 70001, "18444", 0x6f, 0xc4, "Bitcoin Regtest", "bitcoin", &sha256_2, &sha256_2,
+        Coin::CoinBlockHeader(1, 1296688602, 0x207fffff, 2, uchar_vector(32, 0), uchar_vector("4a5e1e4baab89f3a32518a88c31bc87f618f76673e2cc77ab2127b7afdeda33b")),
+        &sha256_2_batch);
 }
 
 inline CoinParams getLitecoinParams()
 {
     return CoinParams(0xdbb6c0fbul, 70002, "9333", 0x30, 0x05, "Litecoin", "litecoin", &sha256_2, &scrypt_1024_1_1_256,
-        Coin::CoinBlockHeader(1, 1317972665, 0x1e0ffff0, 2084524493, uchar_vector(32, 0), uchar_vector("97ddfbbae6be97fd6cdf3e7ca13232a3afff2353e29badfab7f73011edd4ced9")));
+        Coin::CoinBlockHeader(1, 1317972665, 0x1e0ffff0, 2084524493, uchar_vector(32, 0), uchar_vector("97ddfbbae6be97fd6cdf3e7ca13232a3afff2353e29badfab7f73011edd4ced9")),
+        &scrypt_1024_1_1_256_batch);
 }
 
 inline CoinParams getQuarkcoinParams()
 {
     return CoinParams(0xdd03a5feul, 70001, "11973", 0x3a, 0x09, "Quarkcoin", "quarkcoin", &hash9, &hash9,
-        Coin::CoinBlockHeader(112, 1374408079, 0x1e0fffff, 12058113, uchar_vector(32, 0), uchar_vector("868b2fb28cb1a0b881480cc85eb207e29e6ae75cdd6d26688ed34c2d2d23c776")));
+        Coin::CoinBlockHeader(112, 1374408079, 0x1e0fffff, 12058113, uchar_vector(32, 0), uchar_vector("868b2fb28cb1a0b881480cc85eb207e29e6ae75cdd6d26688ed34c2d2d23c776")),
+        &hash9_batch);
 }
 
 #if defined(USE_BITCOIN)
@@ -8,8 +8,49 @@
 
 #include "CoinQ_jsonrpc.h"
 
+using namespace CoinQ;
 using namespace CoinQ::JsonRpc;
 
+void CoinQ::JsonRpc::writeValue(Json::Writer& writer, const json_spirit::Value& value)
+{
+    switch (value.type()) {
+    case json_spirit::obj_type:
+        writer.beginObject();
+        for (auto& pair: value.get_obj()) {
+            writer.key(pair.name_);
+            writeValue(writer, pair.value_);
+        }
+        writer.endObject();
+        break;
+
+    case json_spirit::array_type:
+        writer.beginArray();
+        for (auto& item: value.get_array()) { writeValue(writer, item); }
+        writer.endArray();
+        break;
+
+    case json_spirit::str_type:
+        writer.value(value.get_str());
+        break;
+
+    case json_spirit::bool_type:
+        writer.value(value.get_bool());
+        break;
+
+    case json_spirit::int_type:
+        if (value.is_uint64())  { writer.value((unsigned long long)value.get_uint64()); }
+        else                    { writer.value((long long)value.get_int64()); }
+        break;
+
+    case json_spirit::real_type:
+        writer.value(value.get_real());
+        break;
+
+    default:
+        writer.null();
+    }
+}
+
 void Request::setJson(const std::string& json)
 {
     json_spirit::Value value;
@@ -17,8 +58,11 @@ void Request::setJson(const std::string& json)
     if (value.type() != json_spirit::obj_type) {
         throw std::runtime_error("Invalid JSON.");
     }
+    setJsonObject(value.get_obj());
+}
 
-    const json_spirit::Object& obj = value.get_obj();
+void Request::setJsonObject(const json_spirit::Object& obj)
+{
     const json_spirit::Value& method = json_spirit::find_value(obj, "method");
     if (method.type() != json_spirit::str_type) {
         throw std::runtime_error("Missing method.");
@@ -29,12 +73,31 @@ void Request::setJson(const std::string& json)
 }
 
 std::string Request::getJson() const
+{
+    std::string json;
+    Json::Writer writer(json);
+    write(writer);
+    return json;
+}
+
+void Request::write(Json::Writer& writer) const
+{
+    writer.beginObject();
+    writer.key("method").value(m_method);
+    writer.key("params");
+    writeValue(writer, m_params);
+    writer.key("id");
+    writeValue(writer, m_id);
+    writer.endObject();
+}
+
+json_spirit::Object Request::getJsonObject() const
 {
     json_spirit::Object req;
     req.push_back(json_spirit::Pair("method", m_method));
     req.push_back(json_spirit::Pair("params", m_params));
     req.push_back(json_spirit::Pair("id", m_id));
-    return json_spirit::write_string<json_spirit::Value>(req);
+    return req;
 }
 
 
@@ -46,19 +109,43 @@ void Response::setJson(const std::string& json)
     if (value.type() != json_spirit::obj_type) {
         throw std::runtime_error("Invalid JSON.");
     }
-    const json_spirit::Object& obj = value.get_obj();
+    setJsonObject(value.get_obj());
+}
+
+void Response::setJsonObject(const json_spirit::Object& obj)
+{
     m_result = json_spirit::find_value(obj, "result");
     m_error = json_spirit::find_value(obj, "error");
     m_id = json_spirit::find_value(obj, "id");
 }
 
 std::string Response::getJson() const
+{
+    std::string json;
+    Json::Writer writer(json);
+    write(writer);
+    return json;
+}
+
+void Response::write(Json::Writer& writer) const
+{
+    writer.beginObject();
+    writer.key("result");
+    writeValue(writer, m_result);
+    writer.key("error");
+    writeValue(writer, m_error);
+    writer.key("id");
+    writeValue(writer, m_id);
+    writer.endObject();
+}
+
+json_spirit::Object Response::getJsonObject() const
 {
     json_spirit::Object res;
     res.push_back(json_spirit::Pair("result", m_result));
     res.push_back(json_spirit::Pair("error", m_error));
     res.push_back(json_spirit::Pair("id", m_id));
-    return json_spirit::write_string<json_spirit::Value>(res);
+    return res;
 }
 
 void Response::setResult(const json_spirit::Value& result, const json_spirit::Value& id)
@@ -75,3 +162,99 @@ void Response::setError(const json_spirit::Value& error, const json_spirit::Valu
     m_id = id;
 }
 
+
+
+void BatchRequest::setJson(const std::string& json)
+{
+    json_spirit::Value value;
+    json_spirit::read_string(json, value);
+
+    m_requests.clear();
+    m_invalid.clear();
+
+    if (value.type() == json_spirit::obj_type) {
+        m_isBatch = false;
+        m_requests.push_back(Request(value.get_obj()));
+        return;
+    }
+
+    if (value.type() != json_spirit::array_type) {
+        throw std::runtime_error("Invalid JSON.");
+    }
+
+    const json_spirit::Array& items = value.get_array();
+    if (items.empty()) {
+        throw std::runtime_error("Empty batch.");
+    }
+
+    // One bad element does not fail the rest of the batch.
+    m_isBatch = true;
+    m_requests.reserve(items.size());
+    for (auto& item: items) {
+        if (item.type() != json_spirit::obj_type) {
+            Response response;
+            response.setError("Invalid request.");
+            m_invalid.push_back(response);
+            continue;
+        }
+
+        try {
+            m_requests.push_back(Request(item.get_obj()));
+        }
+        catch (const std::exception& e) {
+            Response response;
+            response.setError(e.what(), json_spirit::find_value(item.get_obj(), "id"));
+            m_invalid.push_back(response);
+        }
+    }
+}
+
+std::string BatchRequest::getJson() const
+{
+    if (!m_isBatch && m_requests.size() == 1) return m_requests[0].getJson();
+
+    std::string json;
+    Json::Writer writer(json);
+    writer.beginArray();
+    for (auto& request: m_requests) { request.write(writer); }
+    writer.endArray();
+    return json;
+}
+
+
+
+void BatchResponse::setJson(const std::string& json)
+{
+    json_spirit::Value value;
+    json_spirit::read_string(json, value);
+
+    m_responses.clear();
+
+    if (value.type() == json_spirit::obj_type) {
+        m_responses.push_back(Response(value.get_obj()));
+        return;
+    }
+
+    if (value.type() != json_spirit::array_type) {
+        throw std::runtime_error("Invalid JSON.");
+    }
+
+    const json_spirit::Array& items = value.get_array();
+    m_responses.reserve(items.size());
+    for (auto& item: items) {
+        if (item.type() != json_spirit::obj_type) {
+            throw std::runtime_error("Invalid JSON.");
+        }
+        m_responses.push_back(Response(item.get_obj()));
+    }
+}
+
+std::string BatchResponse::getJson() const
+{
+    std::string json;
+    Json::Writer writer(json);
+    writer.beginArray();
+    for (auto& response: m_responses) { response.write(writer); }
+    writer.endArray();
+    return json;
+}
@@ -13,13 +13,19 @@
 #include <json_spirit/json_spirit_writer_template.h>
 #include <json_spirit/json_spirit_utils.h>
 
+#include "CoinQ_jsonwriter.h"
+
 #include <stdexcept>
 #include <sstream>
 #include <string>
+#include <vector>
 
 namespace CoinQ {
 namespace JsonRpc {
 
+// Writes an existing json_spirit value tree with a streaming writer.
+void writeValue(Json::Writer& writer, const json_spirit::Value& value);
+
 class Request
 {
 private:
@@ -33,10 +39,16 @@ public:
     Request(const std::string& method, const json_spirit::Object& params, const json_spirit::Value& id = json_spirit::Value())
         : m_method(method), m_params(params), m_id(id) { }
     Request(const std::string& json) { setJson(json); }
+    Request(const json_spirit::Object& obj) { setJsonObject(obj); }
 
     void setJson(const std::string& json);
     std::string getJson() const;
 
+    void setJsonObject(const json_spirit::Object& obj);
+    json_spirit::Object getJsonObject() const;
+
+    void write(Json::Writer& writer) const;
+
     const std::string& getMethod() const { return m_method; }
     const json_spirit::Value& getParams() const { return m_params; }
     const json_spirit::Value& getId() const { return m_id; }
@@ -56,10 +68,16 @@ public:
     Response(const json_spirit::Value& result, const json_spirit::Value& error, const json_spirit::Value& id)
         : m_result(result), m_error(error), m_id(id) { }
     Response(const std::string& json) { setJson(json); }
+    Response(const json_spirit::Object& obj) { setJsonObject(obj); }
 
     void setJson(const std::string& json);
     std::string getJson() const;
 
+    void setJsonObject(const json_spirit::Object& obj);
+    json_spirit::Object getJsonObject() const;
+
+    void write(Json::Writer& writer) const;
+
     void setResult(const json_spirit::Value& result, const json_spirit::Value& id = json_spirit::Value());
     void setError(const json_spirit::Value& error, const json_spirit::Value& id = json_spirit::Value());
 
@@ -68,6 +86,54 @@ public:
     const json_spirit::Value& getId() const { return m_id; }
 };
 
+
+// A JSON-RPC 2.0 batch is an array of requests sent in a single message.
+// A message holding a single request object is read as a batch of one with isBatch() false.
+class BatchRequest
+{
+private:
+    bool m_isBatch;
+    std::vector<Request> m_requests;
+    std::vector<Response> m_invalid; // error responses for array elements that are not valid requests
+
+public:
+    BatchRequest() : m_isBatch(true) { }
+    BatchRequest(const std::vector<Request>& requests) : m_isBatch(true), m_requests(requests) { }
+    BatchRequest(const std::string& json) { setJson(json); }
+
+    void setJson(const std::string& json);
+    std::string getJson() const;
+
+    void add(const Request& request) { m_requests.push_back(request); }
+
+    bool isBatch() const { return m_isBatch; }
+    bool empty() const { return m_requests.empty() && m_invalid.empty(); }
+    std::size_t size() const { return m_requests.size() + m_invalid.size(); }
+
+    const std::vector<Request>& getRequests() const { return m_requests; }
+    const std::vector<Response>& getInvalid() const { return m_invalid; }
+};
+
+
+class BatchResponse
+{
+private:
+    std::vector<Response> m_responses;
+
+public:
+    BatchResponse() { }
+    BatchResponse(const std::vector<Response>& responses) : m_responses(responses) { }
+    BatchResponse(const std::string& json) { setJson(json); }
+
+    // Accepts a single response object as well as an array.
+    void setJson(const std::string& json);
+    std::string getJson() const;
+
+    void add(const Response& response) { m_responses.push_back(response); }
+
+    const std::vector<Response>& getResponses() const { return m_responses; }
+};
+
 }
 }
 
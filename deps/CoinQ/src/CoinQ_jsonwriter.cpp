@@ -0,0 +1,222 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// CoinQ_jsonwriter.cpp
+//
+// Copyright (c) 2014 Eric Lombrozo
+//
+// All Rights Reserved.
+
+#include "CoinQ_jsonwriter.h"
+
+#include <stdexcept>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+using namespace CoinQ::Json;
+
+static const char HEX_DIGITS[] = "0123456789abcdef";
+
+void Writer::separate()
+{
+    if (m_bAfterKey) {
+        m_bAfterKey = false;
+        return;
+    }
+
+    if (m_containers.empty()) return;
+
+    container_t& container = m_containers.back();
+    if (container.close == '}') {
+        throw std::runtime_error("Json::Writer - object member without key.");
+    }
+
+    if (container.bEmpty)   { container.bEmpty = false; }
+    else                    { m_buffer += ','; }
+}
+
+Writer& Writer::begin(char open, char close)
+{
+    separate();
+    m_buffer += open;
+    container_t container;
+    container.close = close;
+    container.bEmpty = true;
+    m_containers.push_back(container);
+    return *this;
+}
+
+Writer& Writer::end(char close)
+{
+    if (m_containers.empty() || m_containers.back().close != close || m_bAfterKey) {
+        throw std::runtime_error("Json::Writer - mismatched end.");
+    }
+    m_containers.pop_back();
+    m_buffer += close;
+    return *this;
+}
+
+Writer& Writer::beginObject()
+{
+    return begin('{', '}');
+}
+
+Writer& Writer::endObject()
+{
+    return end('}');
+}
+
+Writer& Writer::beginArray()
+{
+    return begin('[', ']');
+}
+
+Writer& Writer::endArray()
+{
+    return end(']');
+}
+
+Writer& Writer::key(const char* name)
+{
+    if (m_containers.empty() || m_containers.back().close != '}' || m_bAfterKey) {
+        throw std::runtime_error("Json::Writer - key outside of object.");
+    }
+
+    container_t& container = m_containers.back();
+    if (container.bEmpty)   { container.bEmpty = false; }
+    else                    { m_buffer += ','; }
+
+    writeString(name, strlen(name));
+    m_buffer += ':';
+    m_bAfterKey = true;
+    return *this;
+}
+
+Writer& Writer::key(const std::string& name)
+{
+    return key(name.c_str());
+}
+
+Writer& Writer::value(const char* str)
+{
+    separate();
+    writeString(str, strlen(str));
+    return *this;
+}
+
+Writer& Writer::value(const std::string& str)
+{
+    separate();
+    writeString(str.data(), str.size());
+    return *this;
+}
+
+Writer& Writer::value(bool b)
+{
+    separate();
+    m_buffer += b ? "true" : "false";
+    return *this;
+}
+
+Writer& Writer::value(double d)
+{
+    separate();
+    if (!std::isfinite(d)) {
+        // JSON has no representation for these.
+        m_buffer += "null";
+        return *this;
+    }
+
+    char buf[32];
+    int len = snprintf(buf, sizeof(buf), "%.17g", d);
+    m_buffer.append(buf, len);
+    return *this;
+}
+
+Writer& Writer::null()
+{
+    separate();
+    m_buffer += "null";
+    return *this;
+}
+
+Writer& Writer::hex(const unsigned char* data, std::size_t len, bool reversed)
+{
+    separate();
+    std::size_t pos = m_buffer.size();
+    m_buffer.resize(pos + 2*len + 2);
+    char* p = &m_buffer[pos];
+    *p++ = '"';
+    for (std::size_t i = 0; i < len; i++) {
+        unsigned char c = reversed ? data[len - i - 1] : data[i];
+        *p++ = HEX_DIGITS[c >> 4];
+        *p++ = HEX_DIGITS[c & 0x0f];
+    }
+    *p = '"';
+    return *this;
+}
+
+Writer& Writer::raw(const std::string& json)
+{
+    separate();
+    m_buffer += json;
+    return *this;
+}
+
+Writer& Writer::writeInt(long long n)
+{
+    if (n >= 0) return writeUInt((unsigned long long)n);
+
+    separate();
+    m_buffer += '-';
+
+    // Negate in unsigned arithmetic so the most negative value does not overflow.
+    unsigned long long u = 0ull - (unsigned long long)n;
+    char buf[20];
+    char* p = buf + sizeof(buf);
+    do { *--p = '0' + (u % 10); u /= 10; } while (u);
+    m_buffer.append(p, buf + sizeof(buf) - p);
+    return *this;
+}
+
+Writer& Writer::writeUInt(unsigned long long n)
+{
+    separate();
+    char buf[20];
+    char* p = buf + sizeof(buf);
+    do { *--p = '0' + (n % 10); n /= 10; } while (n);
+    m_buffer.append(p, buf + sizeof(buf) - p);
+    return *this;
+}
+
+void Writer::writeString(const char* str, std::size_t len)
+{
+    m_buffer.reserve(m_buffer.size() + len + 2);
+    m_buffer += '"';
+
+    // Copy runs that need no escaping in one go. UTF-8 passes through unchanged.
+    const char* run = str;
+    const char* end = str + len;
+    for (const char* p = str; p < end; p++) {
+        unsigned char c = *p;
+        if (c >= 0x20 && c != '"' && c != '\\') continue;
+
+        m_buffer.append(run, p - run);
+        run = p + 1;
+        switch (c) {
+        case '"':  m_buffer += "\\\""; break;
+        case '\\': m_buffer += "\\\\"; break;
+        case '\b': m_buffer += "\\b"; break;
+        case '\f': m_buffer += "\\f"; break;
+        case '\n': m_buffer += "\\n"; break;
+        case '\r': m_buffer += "\\r"; break;
+        case '\t': m_buffer += "\\t"; break;
+        default: {
+            char esc[7] = { '\\', 'u', '0', '0', HEX_DIGITS[c >> 4], HEX_DIGITS[c & 0x0f], 0 };
+            m_buffer.append(esc, 6);
+        }
+        }
+    }
+    m_buffer.append(run, end - run);
+    m_buffer += '"';
+}
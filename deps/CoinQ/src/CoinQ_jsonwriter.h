@@ -0,0 +1,85 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// CoinQ_jsonwriter.h
+//
+// Copyright (c) 2014 Eric Lombrozo
+//
+// All Rights Reserved.
+
+#ifndef _COINQ_JSONWRITER_H_
+#define _COINQ_JSONWRITER_H_
+
+#include <string>
+#include <vector>
+
+namespace CoinQ {
+namespace Json {
+
+// Appends JSON text straight to a string, usually the outgoing message, without building a
+// json_spirit::Value tree first. Commas between members and elements are inserted automatically.
+//
+//  std::string payload;
+//  Json::Writer writer(payload);
+//  writer.beginObject().member("height", 100).key("hash").hex(hash).endObject();
+//
+class Writer
+{
+public:
+    explicit Writer(std::string& buffer) : m_buffer(buffer), m_bAfterKey(false) { }
+
+    Writer& beginObject();
+    Writer& endObject();
+    Writer& beginArray();
+    Writer& endArray();
+
+    Writer& key(const char* name);
+    Writer& key(const std::string& name);
+
+    Writer& value(const char* str);
+    Writer& value(const std::string& str);
+    Writer& value(bool b);
+    Writer& value(int n)                { return writeInt((long long)n); }
+    Writer& value(long n)               { return writeInt((long long)n); }
+    Writer& value(long long n)          { return writeInt(n); }
+    Writer& value(unsigned int n)       { return writeUInt((unsigned long long)n); }
+    Writer& value(unsigned long n)      { return writeUInt((unsigned long long)n); }
+    Writer& value(unsigned long long n) { return writeUInt(n); }
+    Writer& value(double d);
+    Writer& null();
+
+    // Quoted lowercase hex. Reversed writes the bytes last to first, as for little endian hashes.
+    Writer& hex(const unsigned char* data, std::size_t len, bool reversed = false);
+    Writer& hex(const std::vector<unsigned char>& data, bool reversed = false) { return hex(data.data(), data.size(), reversed); }
+
+    // Inserts text that is already valid JSON.
+    Writer& raw(const std::string& json);
+
+    template<typename T>
+    Writer& member(const char* name, const T& v) { key(name); return value(v); }
+
+    // True once every object and array that was begun has been ended.
+    bool complete() const { return m_containers.empty() && !m_bAfterKey; }
+
+private:
+    std::string& m_buffer;
+
+    struct container_t
+    {
+        char close;
+        bool bEmpty;
+    };
+    std::vector<container_t> m_containers;
+    bool m_bAfterKey;
+
+    void separate();
+    Writer& begin(char open, char close);
+    Writer& end(char close);
+    Writer& writeInt(long long n);
+    Writer& writeUInt(unsigned long long n);
+    void writeString(const char* str, std::size_t len);
+};
+
+}
+}
+
+#endif // _COINQ_JSONWRITER_H_
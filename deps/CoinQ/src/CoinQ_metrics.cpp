@@ -0,0 +1,177 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// CoinQ_metrics.cpp
+//
+// Copyright (c) 2014 Eric Lombrozo
+//
+// All Rights Reserved.
+
+#include "CoinQ_metrics.h"
+#include "CoinQ_jsonwriter.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <sstream>
+#include <stdexcept>
+
+using namespace CoinQ::Metrics;
+
+Histogram::Histogram(const std::vector<double>& bounds)
+    : m_bounds(bounds), m_counts(new std::atomic<uint64_t>[bounds.size() + 1]), m_sumNanoseconds(0)
+{
+    if (!std::is_sorted(m_bounds.begin(), m_bounds.end())) {
+        throw std::runtime_error("Histogram bounds must be ascending.");
+    }
+    for (std::size_t i = 0; i <= m_bounds.size(); i++) { m_counts[i].store(0, std::memory_order_relaxed); }
+}
+
+void Histogram::observe(double seconds)
+{
+    std::size_t i = std::lower_bound(m_bounds.begin(), m_bounds.end(), seconds) - m_bounds.begin();
+    m_counts[i].fetch_add(1, std::memory_order_relaxed);
+    if (seconds > 0) { m_sumNanoseconds.fetch_add((uint64_t)(seconds * 1e9), std::memory_order_relaxed); }
+}
+
+void Histogram::observe(std::chrono::steady_clock::duration elapsed)
+{
+    observe(std::chrono::duration<double>(elapsed).count());
+}
+
+Histogram::Snapshot Histogram::snapshot() const
+{
+    Snapshot snapshot;
+    snapshot.bounds = m_bounds;
+    snapshot.counts.resize(m_bounds.size() + 1);
+    uint64_t total = 0;
+    for (std::size_t i = 0; i <= m_bounds.size(); i++) {
+        total += m_counts[i].load(std::memory_order_relaxed);
+        snapshot.counts[i] = total;
+    }
+    snapshot.sum = m_sumNanoseconds.load(std::memory_order_relaxed) / 1e9;
+    return snapshot;
+}
+
+const std::vector<double>& Histogram::defaultBounds()
+{
+    static const std::vector<double> bounds = { 0.0001, 0.00025, 0.0005, 0.001, 0.0025, 0.005, 0.01, 0.025, 0.05, 0.1, 0.25, 0.5, 1, 2.5, 5, 10 };
+    return bounds;
+}
+
+Registry::Entry& Registry::getEntry(const std::string& name, Type type, const std::string& help)
+{
+    auto it = m_entries.find(name);
+    if (it != m_entries.end()) {
+        if (it->second.type != type) throw std::runtime_error("Metric " + name + " is already registered with another type.");
+        return it->second;
+    }
+
+    Entry& entry = m_entries[name];
+    entry.type = type;
+    entry.help = help;
+    return entry;
+}
+
+Counter& Registry::counter(const std::string& name, const std::string& help)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    Entry& entry = getEntry(name, COUNTER, help);
+    if (!entry.counter) entry.counter.reset(new Counter());
+    return *entry.counter;
+}
+
+Gauge& Registry::gauge(const std::string& name, const std::string& help)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    Entry& entry = getEntry(name, GAUGE, help);
+    if (!entry.gauge) entry.gauge.reset(new Gauge());
+    return *entry.gauge;
+}
+
+Histogram& Registry::histogram(const std::string& name, const std::string& help, const std::vector<double>& bounds)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    Entry& entry = getEntry(name, HISTOGRAM, help);
+    if (!entry.histogram) entry.histogram.reset(new Histogram(bounds));
+    return *entry.histogram;
+}
+
+std::string Registry::toJson() const
+{
+    std::string json;
+    Json::Writer writer(json);
+    writer.beginObject();
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (auto& item: m_entries) {
+        const Entry& entry = item.second;
+        writer.key(item.first).beginObject();
+        switch (entry.type) {
+        case COUNTER:
+            writer.member("type", "counter").member("value", (unsigned long long)entry.counter->value());
+            break;
+
+        case GAUGE:
+            writer.member("type", "gauge").member("value", (long long)entry.gauge->value());
+            break;
+
+        case HISTOGRAM: {
+            Histogram::Snapshot snapshot = entry.histogram->snapshot();
+            writer.member("type", "histogram").member("count", (unsigned long long)snapshot.counts.back()).member("sum", snapshot.sum);
+            writer.key("buckets").beginArray();
+            for (std::size_t i = 0; i < snapshot.counts.size(); i++) {
+                writer.beginArray();
+                if (i < snapshot.bounds.size()) { writer.value(snapshot.bounds[i]); }
+                else                            { writer.value("+Inf"); }
+                writer.value((unsigned long long)snapshot.counts[i]).endArray();
+            }
+            writer.endArray();
+            break;
+        }
+        }
+        writer.endObject();
+    }
+
+    writer.endObject();
+    return json;
+}
+
+std::string Registry::toText() const
+{
+    std::stringstream ss;
+    ss << std::setprecision(9);
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (auto& item: m_entries) {
+        const std::string& name = item.first;
+        const Entry& entry = item.second;
+        if (!entry.help.empty()) { ss << "# HELP " << name << " " << entry.help << "\n"; }
+        switch (entry.type) {
+        case COUNTER:
+            ss << "# TYPE " << name << " counter\n" << name << " " << entry.counter->value() << "\n";
+            break;
+
+        case GAUGE:
+            ss << "# TYPE " << name << " gauge\n" << name << " " << entry.gauge->value() << "\n";
+            break;
+
+        case HISTOGRAM: {
+            Histogram::Snapshot snapshot = entry.histogram->snapshot();
+            ss << "# TYPE " << name << " histogram\n";
+            for (std::size_t i = 0; i < snapshot.bounds.size(); i++) {
+                ss << name << "_bucket{le=\"" << snapshot.bounds[i] << "\"} " << snapshot.counts[i] << "\n";
+            }
+            ss << name << "_bucket{le=\"+Inf\"} " << snapshot.counts.back() << "\n"
+               << name << "_sum " << snapshot.sum << "\n"
+               << name << "_count " << snapshot.counts.back() << "\n";
+            break;
+        }
+        }
+    }
+    return ss.str();
+}
+
+CoinQ::Metrics::Registry& CoinQ::Metrics::registry()
+{
+    static Registry r;
+    return r;
+}
@@ -0,0 +1,137 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// CoinQ_metrics.h
+//
+// Copyright (c) 2014 Eric Lombrozo
+//
+// All Rights Reserved.
+
+#ifndef _COINQ_METRICS_H_
+#define _COINQ_METRICS_H_
+
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <stdint.h>
+
+namespace CoinQ {
+namespace Metrics {
+
+// Counters, gauges and histograms are updated with relaxed atomics only, so they can sit on hot
+// paths. They are created through the registry, usually once into a static reference:
+//
+//  static Metrics::Histogram& latency = Metrics::registry().histogram("coindb_insert_tx_seconds", "Vault::insertTx duration.");
+//  Metrics::Timer timer(latency);
+//
+
+class Counter
+{
+public:
+    Counter() : m_value(0) { }
+
+    void increment(uint64_t n = 1) { m_value.fetch_add(n, std::memory_order_relaxed); }
+    uint64_t value() const { return m_value.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<uint64_t> m_value;
+};
+
+class Gauge
+{
+public:
+    Gauge() : m_value(0) { }
+
+    void set(int64_t value) { m_value.store(value, std::memory_order_relaxed); }
+    void add(int64_t n) { m_value.fetch_add(n, std::memory_order_relaxed); }
+    void sub(int64_t n) { m_value.fetch_sub(n, std::memory_order_relaxed); }
+    int64_t value() const { return m_value.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<int64_t> m_value;
+};
+
+// Durations in seconds, counted into buckets with fixed upper bounds plus one for everything larger.
+class Histogram
+{
+public:
+    struct Snapshot
+    {
+        std::vector<double> bounds;
+        std::vector<uint64_t> counts;   // cumulative, one more than bounds for +Inf
+        double sum;
+    };
+
+    explicit Histogram(const std::vector<double>& bounds);
+
+    void observe(double seconds);
+    void observe(std::chrono::steady_clock::duration elapsed);
+
+    Snapshot snapshot() const;
+
+    // 100us to 10s.
+    static const std::vector<double>& defaultBounds();
+
+private:
+    std::vector<double> m_bounds;
+    std::unique_ptr<std::atomic<uint64_t>[]> m_counts;
+    std::atomic<uint64_t> m_sumNanoseconds;
+};
+
+// Observes the time from construction to destruction.
+class Timer
+{
+public:
+    explicit Timer(Histogram& histogram) : m_histogram(histogram), m_start(std::chrono::steady_clock::now()) { }
+    ~Timer() { m_histogram.observe(std::chrono::steady_clock::now() - m_start); }
+
+private:
+    Histogram& m_histogram;
+    std::chrono::steady_clock::time_point m_start;
+};
+
+class Registry
+{
+public:
+    // Return the metric registered under name, registering it on first use. Names follow Prometheus
+    // conventions: lowercase with underscores, counters ending in _total and durations in _seconds.
+    // Throws std::runtime_error if name is already registered as another type.
+    Counter& counter(const std::string& name, const std::string& help);
+    Gauge& gauge(const std::string& name, const std::string& help);
+    Histogram& histogram(const std::string& name, const std::string& help, const std::vector<double>& bounds = Histogram::defaultBounds());
+
+    // An object with a member per metric, e.g. {"coindb_commit_seconds":{"type":"histogram","count":12,"sum":0.031,"buckets":[[0.0001,0],...,["+Inf",12]]}}
+    std::string toJson() const;
+
+    // Prometheus text exposition format, version 0.0.4.
+    std::string toText() const;
+
+private:
+    enum Type { COUNTER, GAUGE, HISTOGRAM };
+
+    struct Entry
+    {
+        Type type;
+        std::string help;
+        std::unique_ptr<Counter> counter;
+        std::unique_ptr<Gauge> gauge;
+        std::unique_ptr<Histogram> histogram;
+    };
+
+    Entry& getEntry(const std::string& name, Type type, const std::string& help);
+
+    mutable std::mutex m_mutex;
+    std::map<std::string, Entry> m_entries;
+};
+
+// The process-wide registry.
+Registry& registry();
+
+}
+}
+
+#endif // _COINQ_METRICS_H_
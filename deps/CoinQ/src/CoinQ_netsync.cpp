@@ -6,9 +6,12 @@
 //
 // All Rights Reserved.
 
+#define LOGGER_SUBSYSTEM "netsync"
+
 #include "CoinQ_netsync.h"
 
 #include "CoinQ_typedefs.h"
+#include "CoinQ_metrics.h"
 
 #include <stdint.h>
 
@@ -16,11 +19,16 @@
 
 using namespace CoinQ::Network;
 
+// Rates come from the change in the totals between scrapes.
+static CoinQ::Metrics::Counter& g_headersInserted = CoinQ::Metrics::registry().counter("coinq_netsync_headers_total", "Headers added to the block tree.");
+static CoinQ::Metrics::Counter& g_blocksReceived = CoinQ::Metrics::registry().counter("coinq_netsync_blocks_total", "Blocks and merkle blocks passed on from peers.");
+static CoinQ::Metrics::Histogram& g_headerBatchLatency = CoinQ::Metrics::registry().histogram("coinq_netsync_headers_insert_seconds", "Time to insert one headers message into the block tree.");
+
 NetworkSync::NetworkSync(const CoinQ::CoinParams& coin_params)
-    : coin_params_(coin_params), work(io_service), io_service_thread(NULL), peer(io_service), blockFilter(&blockTree), resynching(false), isConnected_(false)
+    : coin_params_(coin_params), work(io_service), io_service_thread(NULL), peer(io_service), blockFilter(&blockTree), resynching(false), insertingHeaders(false), isConnected_(false)
 {
     Coin::CoinBlockHeader::setHashFunc(coin_params_.block_header_hash_function());
-    Coin::CoinBlockHeader::setPOWHashFunc(coin_params_.block_header_pow_hash_function());
+    Coin::CoinBlockHeader::setPOWHashFunc(coin_params_.block_header_pow_hash_function(), coin_params_.block_header_pow_batch_hash_function());
 
     io_service_thread = new boost::thread(boost::bind(&CoinQ::io_service_t::run, &io_service));
 
@@ -73,29 +81,31 @@ NetworkSync::NetworkSync(const CoinQ::CoinParams& coin_params)
         LOGGER(trace) << "Received headers message..." << std::endl;
         try {
             if (headers.headers.size() > 0) {
-                for (auto& item: headers.headers) {
-                    try {
-                        if (blockTree.insertHeader(item)) {
-                            blockTreeFlushed = false;
-                        }
+                try {
+                    insertingHeaders = true;
+                    unsigned int inserted;
+                    {
+                        CoinQ::Metrics::Timer timer(g_headerBatchLatency);
+                        inserted = blockTree.insertHeaders(headers.headers);
                     }
-                    catch (const std::exception& e) {
-                        std::stringstream err;
-                        err << "Block tree insertion error for block " << item.getHashLittleEndian().getHex() << ": " << e.what(); // TODO: localization
-                        LOGGER(error) << err.str() << std::endl;
-                        notifyError(err.str());
-                        throw e;
+                    if (inserted > 0) {
+                        g_headersInserted.increment(inserted);
+                        blockTreeFlushed = false;
                     }
+                    insertingHeaders = false;
+                }
+                catch (const std::exception& e) {
+                    insertingHeaders = false;
+                    std::stringstream err;
+                    err << "Block tree insertion error: " << e.what(); // TODO: localization
+                    LOGGER(error) << err.str() << std::endl;
+                    notifyError(err.str());
+                    throw;
                 }
 
                 LOGGER(trace) << "Processed " << headers.headers.size() << " headers."
                      << " mBestHeight: " << blockTree.getBestHeight()
-                     << " mTotalWork: " << blockTree.getTotalWork().getDec()
                      << " Attempting to fetch more headers..." << std::endl;
-                notifyBlockTreeChanged();
-                std::stringstream status;
-                status << "Best Height: " << blockTree.getBestHeight() << " / " << "Total Work: " << blockTree.getTotalWork().getDec();
-                notifyStatus(status.str());
                 peer.getHeaders(blockTree.getLocatorHashes(1));
             }
             else {
@@ -116,13 +126,16 @@ NetworkSync::NetworkSync(const CoinQ::CoinParams& coin_params)
         uchar_vector hash = block.blockHeader.getHashLittleEndian();
         try {
             if (blockTree.hasHeader(hash)) {
+                g_blocksReceived.increment();
                 notifyBlock(block);
             }
             else if (blockTree.insertHeader(block.blockHeader)) {
+                g_headersInserted.increment();
                 notifyStatus("Flushing block chain to file...");
                 blockTree.flushToFile(blockTreeFile);
                 blockTreeFlushed = true;
                 notifyStatus("Done flushing block chain to file");
+                g_blocksReceived.increment();
                 notifyBlock(block);
                 notifyDoneSync();
             }
@@ -144,6 +157,7 @@ NetworkSync::NetworkSync(const CoinQ::CoinParams& coin_params)
                 // Do nothing but skip over last else.
             }
             else if (blockTree.insertHeader(merkleBlock.blockHeader)) {
+                g_headersInserted.increment();
                 notifyStatus("Flushing block chain to file...");
                 blockTree.flushToFile(blockTreeFile);
                 blockTreeFlushed = true;
@@ -155,6 +169,7 @@ NetworkSync::NetworkSync(const CoinQ::CoinParams& coin_params)
             }
 
             ChainHeader header = blockTree.getHeader(hash);
+            g_blocksReceived.increment();
             notifyMerkleBlock(ChainMerkleBlock(merkleBlock, true, header.height, header.chainWork));
 
             if (resynching && blockTree.getBestHeight() > header.height) {
@@ -215,20 +230,30 @@ void NetworkSync::initBlockFilter()
 {
     blockTree.unsubscribeAll();
 
+    // While a headers message is being inserted, tree changes are reported once by the batch slot.
     blockTree.subscribeRemoveBestChain([&](const ChainHeader& header) {
-        notifyBlockTreeChanged();
+        if (!insertingHeaders) notifyBlockTreeChanged();
         notifyRemoveBestChain(header);
     });
 
     blockTree.subscribeAddBestChain([&](const ChainHeader& header) {
-        notifyBlockTreeChanged();
+        if (!insertingHeaders) notifyBlockTreeChanged();
         notifyAddBestChain(header);
+        if (insertingHeaders) return;
         uchar_vector hash = header.getHashLittleEndian();
         std::stringstream status;
         status << "Added to best chain: " << hash.getHex() << " Height: " << header.height << " ChainWork: " << header.chainWork.getDec();
         notifyStatus(status.str());
     });
 
+    blockTree.subscribeInsertBatch([&](const ChainHeaderRange& range) {
+        notifyBlockTreeChanged();
+        notifyHeaderBatch(range);
+        std::stringstream status;
+        status << "Best Height: " << range.tip.height << " / " << "Total Work: " << range.tip.chainWork.getDec();
+        notifyStatus(status.str());
+    });
+
     blockFilter.clear();
     blockFilter.connect([&](const ChainBlock& block) {
         uchar_vector blockHash = block.blockHeader.getHashLittleEndian();
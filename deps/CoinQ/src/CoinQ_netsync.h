@@ -81,6 +81,7 @@ public:
     void subscribeAddBestChain(chain_header_slot_t slot) { notifyAddBestChain.connect(slot); }
     void subscribeRemoveBestChain(chain_header_slot_t slot) { notifyRemoveBestChain.connect(slot); }
     void subscribeBlockTreeChanged(void_slot_t slot) { notifyBlockTreeChanged.connect(slot); }
+    void subscribeHeaderBatch(chain_header_range_slot_t slot) { notifyHeaderBatch.connect(slot); }
 
 private:
     CoinQ::CoinParams coin_params_;
@@ -98,6 +99,7 @@ private:
 
     boost::mutex mutex;
     bool resynching;
+    bool insertingHeaders;
 
     bool isConnected_;
 
@@ -125,6 +127,7 @@ private:
     CoinQSignal<const ChainHeader&> notifyAddBestChain;
     CoinQSignal<const ChainHeader&> notifyRemoveBestChain;
     CoinQSignal<void> notifyBlockTreeChanged;
+    CoinQSignal<const ChainHeaderRange&> notifyHeaderBatch;
 };
 
 }
@@ -7,11 +7,15 @@
 // All Rights Reserved.
 
 #include "CoinQ_peer_io.h"
+#include "CoinQ_metrics.h"
 
 using namespace CoinQ;
 
 const unsigned char Peer::DEFAULT_Ipv6[] = {0,0,0,0,0,0,0,0,0,0,255,255,127,0,0,1};
 
+static Metrics::Counter& g_bytesReceived = Metrics::registry().counter("coinq_peer_bytes_received_total", "Bytes read from peers.");
+static Metrics::Counter& g_bytesSent = Metrics::registry().counter("coinq_peer_bytes_sent_total", "Bytes written to peers.");
+
 void Peer::do_handshake()
 {
     if (!bRunning) return;
@@ -44,6 +48,7 @@ void Peer::do_read()
             return;
         }
 
+        g_bytesReceived.increment(bytes_read);
         read_message += uchar_vector(read_buffer, bytes_read);
 
         while (read_message.size() >= MIN_MESSAGE_HEADER_SIZE) {
@@ -126,6 +131,10 @@ void Peer::do_read()
                     Coin::HeadersMessage* pHeaders = static_cast<Coin::HeadersMessage*>(peerMessage.getPayload());
                     notifyHeaders(*this, *pHeaders);
                 }
+                else if (command == "getheaders" || command == "getblocks" || command == "getdata" || command == "mempool" ||
+                         command == "filterload" || command == "filteradd" || command == "filterclear") {
+                    // Requests to serving peers are handled by message subscribers.
+                }
                 else {
                     std::cout << "Command type not implemented: " << command << std::endl;
                 }
@@ -151,6 +160,7 @@ void Peer::do_write(boost::shared_ptr<uchar_vector> data)
             std::cout << "Peer::send() - Error " << ec.value() << ": " << ec.message() << std::endl;
             return;
         }
+        g_bytesSent.increment(bytes_written);
         boost::lock_guard<boost::mutex> sendLock(sendMutex);
         sendQueue.pop();
         if (!sendQueue.empty()) {
@@ -223,6 +233,27 @@ void Peer::start()
     }); 
 }
 
+void Peer::startAccepted()
+{
+    if (bRunning) {
+        throw std::runtime_error("Peer already started.");
+    }
+
+    boost::unique_lock<boost::shared_mutex> lock(mutex);
+    if (bRunning) {
+        throw std::runtime_error("Peer already started.");
+    }
+
+    endpoint_ = socket_.remote_endpoint();
+    bWriteReady = false;
+    bHandshakeComplete = false;
+    bRunning = true;
+    strand_.post([this]() {
+        do_read();
+        do_handshake();
+    });
+}
+
 void Peer::stop()
 {
     if (!bRunning) return;
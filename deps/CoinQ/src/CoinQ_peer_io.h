@@ -112,6 +112,11 @@ public:
     void stop();
     bool send(Coin::CoinNodeStructure& message);
 
+    // For serving peers: accept a connection into socket(), then call startAccepted() to run the same
+    // handshake as for outgoing connections. Requests such as getheaders and getdata reach subscribeMessage.
+    tcp::socket& socket() { return socket_; }
+    void startAccepted();
+
     bool isRunning() const { return bRunning; }
 
     uint32_t magic_bytes() const { return magic_bytes_; }
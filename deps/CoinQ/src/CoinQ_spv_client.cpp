@@ -8,6 +8,8 @@
 //
 // All Rights Reserved.
 
+#define LOGGER_SUBSYSTEM "netsync"
+
 #include "networksync.h"
 
 #include <CoinQ_peerasync.h>
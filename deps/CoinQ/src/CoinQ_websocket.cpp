@@ -9,11 +9,17 @@
 #include "CoinQ_websocket.h"
 #include "CoinQ_jsonrpc.h"
 #include "CoinQ_coinjson.h"
+#include "CoinQ_metrics.h"
+#include "CoinQ_batch.h"
 
 #include <boost/lexical_cast.hpp>
 
+#include <algorithm>
+
 using namespace CoinQ::WebSocket;
 
+static CoinQ::Metrics::Gauge& g_requestQueueDepth = CoinQ::Metrics::registry().gauge("coinq_websocket_request_queue_depth", "Requests waiting for a worker.");
+
 bool Server::onValidate(websocketpp::connection_hdl hdl)
 {
     std::cout << "Server::onValidate()" << std::endl;
@@ -30,12 +36,34 @@ bool Server::onValidate(websocketpp::connection_hdl hdl)
     }
 }
 
+void Server::onHttp(websocketpp::connection_hdl hdl)
+{
+    ws_server_t::connection_ptr con = m_ws_server.get_con_from_hdl(hdl);
+    if (m_metrics_path.empty() || con->get_resource() != m_metrics_path) {
+        con->set_status(websocketpp::http::status_code::not_found);
+        return;
+    }
+
+    std::string remote_endpoint = boost::lexical_cast<std::string>(con->get_remote_endpoint());
+    if (!boost::regex_match(remote_endpoint, m_allow_ips_regex)) {
+        con->set_status(websocketpp::http::status_code::forbidden);
+        return;
+    }
+
+    con->set_status(websocketpp::http::status_code::ok);
+    con->append_header("Content-Type", "text/plain; version=0.0.4");
+    con->set_body(Metrics::registry().toText());
+}
+
 void Server::onOpen(websocketpp::connection_hdl hdl)
 {
     std::cout << "Server::onOpen() called with hdl: " << hdl.lock().get() << std::endl;
-    json_spirit::Object obj;
-    obj.push_back(json_spirit::Pair("bestheader", getChainHeaderJsonObject(m_best_header)));
-    m_ws_server.send(hdl, json_spirit::write_string<json_spirit::Value>(obj), websocketpp::frame::opcode::text);
+    std::string payload;
+    Json::Writer writer(payload);
+    writer.beginObject().key("bestheader");
+    writeChainHeaderJson(writer, m_best_header);
+    writer.endObject();
+    m_ws_server.send(hdl, payload, websocketpp::frame::opcode::text);
 }
 
 void Server::onClose(websocketpp::connection_hdl hdl)
@@ -45,6 +73,7 @@ void Server::onClose(websocketpp::connection_hdl hdl)
     m_tx_subscribers.erase(hdl);
     m_header_subscribers.erase(hdl);
     m_block_subscribers.erase(hdl);
+    m_ordered_connections.erase(hdl);
 }
 
 void Server::onMessage(websocketpp::connection_hdl hdl, ws_server_t::message_ptr msg)
@@ -56,9 +85,61 @@ void Server::onMessage(websocketpp::connection_hdl hdl, ws_server_t::message_ptr
     std::stringstream err;
 
     try {
-        JsonRpc::Request request(msg->get_payload());
+        JsonRpc::BatchRequest batch(msg->get_payload());
+
+        // Elements of a batch that could not be parsed are answered right away.
+        for (auto& response: batch.getInvalid()) {
+            m_ws_server.send(hdl, response.getJson(), msg->get_opcode());
+        }
+
+        const std::vector<JsonRpc::Request>& requests = batch.getRequests();
+        if (requests.empty()) return;
+
+        if (m_max_batch_size > 0 && batch.size() > m_max_batch_size) {
+            for (auto& request: requests) {
+                JsonRpc::Response response;
+                response.setError("Batch too large.", request.getId());
+                m_ws_server.send(hdl, response.getJson(), msg->get_opcode());
+            }
+            return;
+        }
+
+        queued_request_t req;
+        req.requests.reserve(requests.size());
+        std::set<std::string> keys;
+        for (auto& request: requests) {
+            req.requests.push_back(std::make_pair(hdl, request));
+            if (m_request_key_callback) {
+                std::string key = m_request_key_callback(req.requests.back());
+                if (!key.empty()) keys.insert("request:" + key);
+            }
+        }
+        req.keys.assign(keys.begin(), keys.end());
+
+        {
+            boost::unique_lock<boost::mutex> lock(m_connectionMutex);
+            if (m_ordered_connections.count(hdl)) {
+                std::stringstream key;
+                key << "connection:" << hdl.lock().get();
+                req.keys.push_back(key.str());
+            }
+        }
+
         boost::unique_lock<boost::mutex> lock(m_requestMutex);
-        m_requests.push(std::make_pair(hdl, request));
+        if (m_max_queue_depth > 0 && m_requests.size() >= m_max_queue_depth) {
+            m_metrics.rejected += requests.size();
+            lock.unlock();
+            for (auto& request: requests) {
+                JsonRpc::Response response;
+                response.setError("Server busy.", request.getId());
+                m_ws_server.send(hdl, response.getJson(), msg->get_opcode());
+            }
+            return;
+        }
+        if (batch.isBatch()) m_metrics.batches++;
+        m_requests.push_back(req);
+        g_requestQueueDepth.set(m_requests.size());
+        if (m_requests.size() > m_metrics.peakQueued) m_metrics.peakQueued = m_requests.size();
         lock.unlock();
         m_requestCond.notify_one();
     }
@@ -75,93 +156,96 @@ void Server::onMessage(websocketpp::connection_hdl hdl, ws_server_t::message_ptr
     }*/
 }
 
+bool Server::popRunnableRequest(queued_request_t& req)
+{
+    // Take the oldest request whose keys are not held by a running request or by an older waiting one.
+    std::set<std::string> blocked_keys;
+    for (auto it = m_requests.begin(); it != m_requests.end(); ++it) {
+        bool runnable = true;
+        for (auto& key: it->keys) {
+            if (m_busy_keys.count(key) || blocked_keys.count(key)) { runnable = false; break; }
+        }
+
+        if (runnable) {
+            req = *it;
+            m_requests.erase(it);
+            g_requestQueueDepth.set(m_requests.size());
+            m_busy_keys.insert(req.keys.begin(), req.keys.end());
+            return true;
+        }
+
+        blocked_keys.insert(it->keys.begin(), it->keys.end());
+    }
+    return false;
+}
+
 void Server::requestLoop()
 {
     while (true) {
         boost::unique_lock<boost::mutex> lock(m_requestMutex);
 
-        while (m_bRunning && m_requests.empty()) {
+        // A popped request holds its keys, so it is run to the end even if stop() is called meanwhile.
+        queued_request_t req;
+        bool bPopped = false;
+        while (m_bRunning && !(bPopped = popRunnableRequest(req))) {
             m_requestCond.wait(lock);
         }
 
-        if (!m_bRunning) break;
+        if (!bPopped) break;
+
+        m_metrics.active++;
+        lock.unlock();
 
-        client_request_t req = m_requests.front();
-        m_requests.pop();
+        processBatch(req.requests);
 
+        lock.lock();
+        for (auto& key: req.keys) { m_busy_keys.erase(key); }
+        m_metrics.active--;
+        m_metrics.completed += req.requests.size();
         lock.unlock();
 
-        try {
-            const std::string& method = req.second.getMethod();
-            if (method == "subscribe") {
-                const json_spirit::Value& params = req.second.getParams();
-                if (params.type() != json_spirit::array_type) {
-                    m_ws_server.send(req.first, "Invalid parameters.", websocketpp::frame::opcode::text);
-                    continue;
-                }
-                const json_spirit::Array& streams = params.get_array();
-                json_spirit::Array subscribedstreams;
-                for (unsigned int i = 0; i < streams.size(); i++) {
-                    if (streams[i].type() == json_spirit::str_type) {
-                        std::string stream = streams[i].get_str();
-                        if (stream == "tx") {
-                            boost::unique_lock<boost::mutex> lock(m_connectionMutex);
-                            m_tx_subscribers.insert(req.first);
-                            subscribedstreams.push_back("tx");
-                        }
-                        else if (stream == "header") {
-                            boost::unique_lock<boost::mutex> lock(m_connectionMutex);
-                            m_header_subscribers.insert(req.first);
-                            subscribedstreams.push_back("header");
-                        }
-                        else if (stream == "block") {
-                            boost::unique_lock<boost::mutex> lock(m_connectionMutex);
-                            m_block_subscribers.insert(req.first);
-                            subscribedstreams.push_back("block");
-                        }
-                    }
-                }
-                json_spirit::Object result;
-                result.push_back(json_spirit::Pair("subscribedstreams", subscribedstreams));
-                JsonRpc::Response res;
-                res.setResult(result, req.second.getId());
-                m_ws_server.send(req.first, res.getJson(), websocketpp::frame::opcode::text);
+        // Requests that were waiting on these keys may be runnable now.
+        if (!req.keys.empty())  { m_requestCond.notify_all(); }
+    }
+}
+
+void Server::processBatch(const std::vector<client_request_t>& reqs)
+{
+    dispatchBatch(reqs,
+        [](const client_request_t& req) { return isBuiltinMethod(req.second.getMethod()); },
+        [this](const client_request_t& req) {
+            try {
+                processBuiltinRequest(req);
             }
-            else if (method == "unsubscribe") {
-                const json_spirit::Value& params = req.second.getParams();
-                if (params.type() != json_spirit::array_type) {
-                    m_ws_server.send(req.first, "Invalid parameters.", websocketpp::frame::opcode::text);
-                    continue;
-                }
-                const json_spirit::Array& streams = params.get_array();
-                json_spirit::Array unsubscribedstreams;
-                for (unsigned int i = 0; i < streams.size(); i++) {
-                    if (streams[i].type() == json_spirit::str_type) {
-                        std::string stream = streams[i].get_str();
-                        if (stream == "tx") {
-                            boost::unique_lock<boost::mutex> lock(m_connectionMutex);
-                            m_tx_subscribers.erase(req.first);
-                            unsubscribedstreams.push_back("tx");
-                        }
-                        else if (stream == "header") {
-                            boost::unique_lock<boost::mutex> lock(m_connectionMutex);
-                            m_header_subscribers.erase(req.first);
-                            unsubscribedstreams.push_back("header");
-                        }
-                        else if (stream == "block") {
-                            boost::unique_lock<boost::mutex> lock(m_connectionMutex);
-                            m_block_subscribers.erase(req.first);
-                            unsubscribedstreams.push_back("block");
-                        }
-                    }
-                }
-                json_spirit::Object result;
-                result.push_back(json_spirit::Pair("unsubscribedstreams", unsubscribedstreams));
-                JsonRpc::Response res;
-                res.setResult(result, req.second.getId());
-                m_ws_server.send(req.first, res.getJson(), websocketpp::frame::opcode::text);
+            catch (const std::exception& e) {
+                std::cout << "Server::processBatch() - Error: " << e.what() << std::endl;
             }
-            else if (m_client_request_callback) {
+        },
+        [this](const std::vector<client_request_t>& run) { processClientRequests(run); });
+}
+
+void Server::processClientRequests(const std::vector<client_request_t>& reqs)
+{
+    if (reqs.empty()) return;
+
+    if (reqs.size() > 1 && m_client_batch_callback) {
+        client_batch_t batch;
+        batch.first = reqs[0].first;
+        batch.second.reserve(reqs.size());
+        for (auto& req: reqs) { batch.second.push_back(req.second); }
+
+        try {
+            m_client_batch_callback(batch);
+        }
+        catch (const std::exception& e) {
+            std::cout << "Server::processClientRequests() - Error: " << e.what() << std::endl;
+        }
+        return;
+    }
+
+    for (auto& req: reqs) {
+        try {
+            if (m_client_request_callback) {
                 m_client_request_callback(req);
             }
             else {
@@ -169,9 +253,118 @@ void Server::requestLoop()
             }
         }
         catch (const std::exception& e) {
-            std::cout << "Server::requestLoop() - Error: " << e.what() << std::endl;
+            std::cout << "Server::processClientRequests() - Error: " << e.what() << std::endl;
+        }
+    }
+}
+
+bool Server::isBuiltinMethod(const std::string& method)
+{
+    return method == "subscribe" || method == "unsubscribe" || method == "setordered";
+}
+
+bool Server::processBuiltinRequest(const client_request_t& req)
+{
+    const std::string& method = req.second.getMethod();
+    if (method == "subscribe") {
+        const json_spirit::Value& params = req.second.getParams();
+        if (params.type() != json_spirit::array_type) {
+            m_ws_server.send(req.first, "Invalid parameters.", websocketpp::frame::opcode::text);
+            return true;
+        }
+        const json_spirit::Array& streams = params.get_array();
+        json_spirit::Array subscribedstreams;
+        for (unsigned int i = 0; i < streams.size(); i++) {
+            if (streams[i].type() == json_spirit::str_type) {
+                std::string stream = streams[i].get_str();
+                if (stream == "tx") {
+                    boost::unique_lock<boost::mutex> lock(m_connectionMutex);
+                    m_tx_subscribers.insert(req.first);
+                    subscribedstreams.push_back("tx");
+                }
+                else if (stream == "header") {
+                    boost::unique_lock<boost::mutex> lock(m_connectionMutex);
+                    m_header_subscribers.insert(req.first);
+                    subscribedstreams.push_back("header");
+                }
+                else if (stream == "block") {
+                    boost::unique_lock<boost::mutex> lock(m_connectionMutex);
+                    m_block_subscribers.insert(req.first);
+                    subscribedstreams.push_back("block");
+                }
+            }
         }
+        json_spirit::Object result;
+        result.push_back(json_spirit::Pair("subscribedstreams", subscribedstreams));
+        JsonRpc::Response res;
+        res.setResult(result, req.second.getId());
+        m_ws_server.send(req.first, res.getJson(), websocketpp::frame::opcode::text);
     }
+    else if (method == "unsubscribe") {
+        const json_spirit::Value& params = req.second.getParams();
+        if (params.type() != json_spirit::array_type) {
+            m_ws_server.send(req.first, "Invalid parameters.", websocketpp::frame::opcode::text);
+            return true;
+        }
+        const json_spirit::Array& streams = params.get_array();
+        json_spirit::Array unsubscribedstreams;
+        for (unsigned int i = 0; i < streams.size(); i++) {
+            if (streams[i].type() == json_spirit::str_type) {
+                std::string stream = streams[i].get_str();
+                if (stream == "tx") {
+                    boost::unique_lock<boost::mutex> lock(m_connectionMutex);
+                    m_tx_subscribers.erase(req.first);
+                    unsubscribedstreams.push_back("tx");
+                }
+                else if (stream == "header") {
+                    boost::unique_lock<boost::mutex> lock(m_connectionMutex);
+                    m_header_subscribers.erase(req.first);
+                    unsubscribedstreams.push_back("header");
+                }
+                else if (stream == "block") {
+                    boost::unique_lock<boost::mutex> lock(m_connectionMutex);
+                    m_block_subscribers.erase(req.first);
+                    unsubscribedstreams.push_back("block");
+                }
+            }
+        }
+        json_spirit::Object result;
+        result.push_back(json_spirit::Pair("unsubscribedstreams", unsubscribedstreams));
+        JsonRpc::Response res;
+        res.setResult(result, req.second.getId());
+        m_ws_server.send(req.first, res.getJson(), websocketpp::frame::opcode::text);
+    }
+    else if (method == "setordered") {
+        // Responses to a client that opts in are sent in the order its requests arrived.
+        const json_spirit::Value& params = req.second.getParams();
+        if (params.type() != json_spirit::array_type || params.get_array().size() != 1 || params.get_array()[0].type() != json_spirit::bool_type) {
+            m_ws_server.send(req.first, "Invalid parameters.", websocketpp::frame::opcode::text);
+            return true;
+        }
+        bool ordered = params.get_array()[0].get_bool();
+        {
+            boost::unique_lock<boost::mutex> lock(m_connectionMutex);
+            if (ordered)    { m_ordered_connections.insert(req.first); }
+            else            { m_ordered_connections.erase(req.first); }
+        }
+        json_spirit::Object result;
+        result.push_back(json_spirit::Pair("ordered", ordered));
+        JsonRpc::Response res;
+        res.setResult(result, req.second.getId());
+        m_ws_server.send(req.first, res.getJson(), websocketpp::frame::opcode::text);
+    }
+    else {
+        return false;
+    }
+    return true;
+}
+
+Server::RequestMetrics Server::getRequestMetrics()
+{
+    boost::unique_lock<boost::mutex> lock(m_requestMutex);
+    RequestMetrics metrics = m_metrics;
+    metrics.queued = m_requests.size();
+    return metrics;
 }
 
 void Server::init(int port, const std::string& allow_ips)
@@ -179,6 +372,16 @@ void Server::init(int port, const std::string& allow_ips)
     m_port = port;
     m_bRunning = false;
     m_client_request_callback = NULL;
+    m_client_batch_callback = NULL;
+    m_worker_count = 0;
+    m_max_queue_depth = 0;
+    m_max_batch_size = 0;
+    m_metrics.queued = 0;
+    m_metrics.active = 0;
+    m_metrics.peakQueued = 0;
+    m_metrics.completed = 0;
+    m_metrics.rejected = 0;
+    m_metrics.batches = 0;
     try {
         m_allow_ips_regex.assign(allow_ips);
     }
@@ -193,6 +396,7 @@ void Server::init(int port, const std::string& allow_ips)
     m_ws_server.init_asio();
 
     m_ws_server.set_validate_handler(websocketpp::lib::bind(&Server::onValidate, this, websocketpp::lib::placeholders::_1));
+    m_ws_server.set_http_handler(websocketpp::lib::bind(&Server::onHttp, this, websocketpp::lib::placeholders::_1));
     m_ws_server.set_open_handler(websocketpp::lib::bind(&Server::onOpen, this, websocketpp::lib::placeholders::_1));
     m_ws_server.set_close_handler(websocketpp::lib::bind(&Server::onClose, this, websocketpp::lib::placeholders::_1));
     m_ws_server.set_message_handler(websocketpp::lib::bind(&Server::onMessage, this, websocketpp::lib::placeholders::_1, websocketpp::lib::placeholders::_2));
@@ -210,7 +414,10 @@ void Server::start()
     m_ws_server.listen(m_port);
     m_ws_server.start_accept();
 
-    m_request_loop_thread   = boost::thread(websocketpp::lib::bind(&Server::requestLoop, this));
+    unsigned int worker_count = m_worker_count > 0 ? m_worker_count : std::max(boost::thread::hardware_concurrency(), 1u);
+    for (unsigned int i = 0; i < worker_count; i++) {
+        m_request_loop_threads.create_thread(websocketpp::lib::bind(&Server::requestLoop, this));
+    }
     m_io_service_thread     = boost::thread(websocketpp::lib::bind(&ws_server_t::run, &m_ws_server));
 }
 
@@ -220,9 +427,9 @@ void Server::stop()
     m_bRunning = false;
     lock.unlock();
 
-    std::cout << "Websocket server stopping request loop thread..." << std::flush;
+    std::cout << "Websocket server stopping request loop threads..." << std::flush;
     m_requestCond.notify_all();
-    m_request_loop_thread.join();
+    m_request_loop_threads.join_all();
     std::cout << "Done." << std::endl;
 
     std::cout << "Websocket server stopping io service thread..." << std::flush;
@@ -231,73 +438,91 @@ void Server::stop()
     std::cout << "Done." << std::endl;
 }
 
-void Server::pushTx(const ChainTransaction& tx)
+void Server::broadcast(const subscribers_t& subscribers, const std::string& payload, const char* caller)
 {
-    boost::unique_lock<boost::mutex> lock(m_connectionMutex);
-    for (auto hdl: m_tx_subscribers) {
+    // Copy the subscriber set so connections can open and close while we send.
+    std::vector<websocketpp::connection_hdl> hdls;
+    {
+        boost::unique_lock<boost::mutex> lock(m_connectionMutex);
+        hdls.assign(subscribers.begin(), subscribers.end());
+    }
+    if (hdls.empty()) return;
+
+    // Server frames are not masked, so a single RFC 6455 frame can be queued on every connection as is.
+    // websocketpp writes a prepared message without copying or revalidating it.
+    ws_server_t::message_ptr frame(new websocketpp::config::asio::message_type(websocketpp::config::asio::con_msg_manager_type::ptr(), websocketpp::frame::opcode::text, 0));
+    websocketpp::frame::basic_header header(websocketpp::frame::opcode::text, payload.size(), true, false);
+    frame->set_header(websocketpp::frame::prepare_header(header, websocketpp::frame::extended_header(payload.size())));
+    frame->set_payload(payload);
+    frame->set_prepared(true);
+
+    for (auto& hdl: hdls) {
         try {
-            json_spirit::Object obj;
-            obj.push_back(json_spirit::Pair("tx", CoinQ::getChainTransactionJsonObject(tx)));
-            m_ws_server.send(hdl, json_spirit::write_string<json_spirit::Value>(obj), websocketpp::frame::opcode::text);
-        }
-        catch (const boost::system::error_code& ec) {
-            std::cout << "Server::pushTx() - Boost error: (" << ec.value() << ") " << ec.message() << std::endl;
+            websocketpp::lib::error_code ec;
+            ws_server_t::connection_ptr con = m_ws_server.get_con_from_hdl(hdl, ec);
+            if (ec) continue; // closed meanwhile
+
+            // Hixie-76 clients send no version header and need their own framing.
+            if (con->get_request_header("Sec-WebSocket-Version").empty()) {
+                ec = con->send(payload, websocketpp::frame::opcode::text);
+            }
+            else {
+                ec = con->send(frame);
+            }
+
+            if (ec) {
+                std::cout << "Server::" << caller << "() - Error: (" << ec.value() << ") " << ec.message() << std::endl;
+            }
         }
         catch (const std::exception& e) {
-            std::cout << "Server::pushTx() - STL Exception: " << e.what() << std::endl;
+            std::cout << "Server::" << caller << "() - STL Exception: " << e.what() << std::endl;
         }
         catch (...) {
-            std::cout << "Server::pushTx() - Unknown error." << std::endl;
+            std::cout << "Server::" << caller << "() - Unknown error." << std::endl;
         }
     }
 }
 
+void Server::pushTx(const ChainTransaction& tx)
+{
+    std::string payload;
+    Json::Writer writer(payload);
+    writer.beginObject().key("tx");
+    writeChainTransactionJson(writer, tx);
+    writer.endObject();
+
+    broadcast(m_tx_subscribers, payload, "pushTx");
+}
+
 void Server::pushTx(websocketpp::connection_hdl hdl, const ChainTransaction& tx)
 {
-    json_spirit::Object obj;
-    obj.push_back(json_spirit::Pair("tx", CoinQ::getChainTransactionJsonObject(tx)));
-    m_ws_server.send(hdl, json_spirit::write_string<json_spirit::Value>(obj), websocketpp::frame::opcode::text);
+    std::string payload;
+    Json::Writer writer(payload);
+    writer.beginObject().key("tx");
+    writeChainTransactionJson(writer, tx);
+    writer.endObject();
+    m_ws_server.send(hdl, payload, websocketpp::frame::opcode::text);
 }
 
 void Server::pushHeader(const ChainHeader& header)
 {
-    boost::unique_lock<boost::mutex> lock(m_connectionMutex);
-    for (auto hdl: m_header_subscribers) {
-        try {
-            json_spirit::Object obj;
-            obj.push_back(json_spirit::Pair("header", CoinQ::getChainHeaderJsonObject(header)));
-            m_ws_server.send(hdl, json_spirit::write_string<json_spirit::Value>(obj), websocketpp::frame::opcode::text);
-        }
-        catch (const boost::system::error_code& ec) {
-            std::cout << "Server::pushHeader() - Boost error: (" << ec.value() << ") " << ec.message() << std::endl;
-        }
-        catch (const std::exception& e) {
-            std::cout << "Server::pushHeader() - STL Exception: " << e.what() << std::endl;
-        }
-        catch (...) {
-            std::cout << "Server::pushHeader() - Unknown error." << std::endl;
-        }
-    }
+    std::string payload;
+    Json::Writer writer(payload);
+    writer.beginObject().key("header");
+    writeChainHeaderJson(writer, header);
+    writer.endObject();
+
+    broadcast(m_header_subscribers, payload, "pushHeader");
 }
 
 void Server::pushBlock(const ChainBlock& block, bool allFields)
 {
-    boost::unique_lock<boost::mutex> lock(m_connectionMutex);
-    for (auto hdl: m_block_subscribers) {
-        try {
-            json_spirit::Object obj;
-            obj.push_back(json_spirit::Pair("block", CoinQ::getChainBlockJsonObject(block, allFields)));
-            m_ws_server.send(hdl, json_spirit::write_string<json_spirit::Value>(obj), websocketpp::frame::opcode::text);
-        }
-        catch (const boost::system::error_code& ec) {
-            std::cout << "Server::pushBlock() - Boost error: (" << ec.value() << ") " << ec.message() << std::endl;
-        }
-        catch (const std::exception& e) {
-            std::cout << "Server::pushBlock() - STL Exception: " << e.what() << std::endl;
-        }
-        catch (...) {
-            std::cout << "Server::pushBlock() - Unknown error." << std::endl;
-        }
-    }
+    std::string payload;
+    Json::Writer writer(payload);
+    writer.beginObject().key("block");
+    writeChainBlockJson(writer, block, allFields);
+    writer.endObject();
+
+    broadcast(m_block_subscribers, payload, "pushBlock");
 }
 
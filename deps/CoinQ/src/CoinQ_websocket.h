@@ -21,6 +21,7 @@
 #include <boost/thread.hpp>
 #include <boost/regex.hpp>
 
+#include <deque>
 #include <memory>
 #include <queue>
 #include <set>
@@ -36,6 +37,24 @@ public:
     typedef std::pair<websocketpp::connection_hdl, JsonRpc::Request> client_request_t;
     typedef std::function<void(const client_request_t&)> client_request_callback_t;
 
+    // Consecutive application requests from a JSON-RPC batch array. Each response is sent on its own
+    // as soon as it is ready rather than collected into an array, so clients match responses by id.
+    typedef std::pair<websocketpp::connection_hdl, std::vector<JsonRpc::Request>> client_batch_t;
+    typedef std::function<void(const client_batch_t&)> client_batch_callback_t;
+
+    // Requests with the same nonempty key never run at the same time and run in the order received.
+    typedef std::function<std::string(const client_request_t&)> request_key_callback_t;
+
+    struct RequestMetrics
+    {
+        std::size_t queued;         // requests waiting for a worker
+        std::size_t active;         // requests being executed
+        std::size_t peakQueued;     // largest number of waiting requests seen
+        uint64_t    completed;      // requests executed
+        uint64_t    rejected;       // requests refused because the queue was full
+        uint64_t    batches;        // batch arrays received
+    };
+
 private:
     typedef websocketpp::server<websocketpp::config::asio> ws_server_t;
     ws_server_t m_ws_server;
@@ -46,10 +65,26 @@ private:
     int m_port;
     boost::regex m_allow_ips_regex;
 
-    typedef std::queue<client_request_t> request_queue_t;
+    // A batch is queued and executed as a unit by one worker.
+    struct queued_request_t
+    {
+        std::vector<client_request_t> requests;
+        std::vector<std::string> keys;
+    };
+    typedef std::deque<queued_request_t> request_queue_t;
     request_queue_t m_requests;
+    std::set<std::string> m_busy_keys;
 
     client_request_callback_t m_client_request_callback;
+    client_batch_callback_t m_client_batch_callback;
+    request_key_callback_t m_request_key_callback;
+
+    connection_set_t m_ordered_connections;
+
+    unsigned int m_worker_count;
+    std::size_t m_max_queue_depth;
+    std::size_t m_max_batch_size;
+    RequestMetrics m_metrics;
 
     typedef std::set<websocketpp::connection_hdl> subscribers_t;
     subscribers_t m_tx_subscribers;
@@ -66,18 +101,29 @@ private:
 
     ChainHeader m_best_header;
 
+    std::string m_metrics_path;
+
     bool onValidate(websocketpp::connection_hdl hdl);
+    void onHttp(websocketpp::connection_hdl hdl);
     void onOpen(websocketpp::connection_hdl hdl);
     void onClose(websocketpp::connection_hdl hdl);
     void onMessage(websocketpp::connection_hdl hdl, ws_server_t::message_ptr msg);
 
     void requestLoop();
+    void processBatch(const std::vector<client_request_t>& reqs);
+    void processClientRequests(const std::vector<client_request_t>& reqs);
+    static bool isBuiltinMethod(const std::string& method); // must match processBuiltinRequest
+    bool processBuiltinRequest(const client_request_t& req);
+
+    // Frames the payload once and queues the same frame for every subscriber, without holding m_connectionMutex.
+    void broadcast(const subscribers_t& subscribers, const std::string& payload, const char* caller);
+    bool popRunnableRequest(queued_request_t& req);
 
     bool m_bRunning;
 
     boost::mutex m_startMutex;
 
-    boost::thread m_request_loop_thread;
+    boost::thread_group m_request_loop_threads;
     boost::thread m_io_service_thread;
 
     void init(int port, const std::string& allow_ips);
@@ -90,6 +136,9 @@ public:
     void stop();
     void send(websocketpp::connection_hdl hdl, const JsonRpc::Response& res) { m_ws_server.send(hdl, res.getJson(), websocketpp::frame::opcode::text); }
 
+    // Sends a payload already serialized, e.g. with a Json::Writer.
+    void send(websocketpp::connection_hdl hdl, const std::string& json) { m_ws_server.send(hdl, json, websocketpp::frame::opcode::text); }
+
     void pushTx(const ChainTransaction& tx);
     void pushHeader(const ChainHeader& header);
     void pushBlock(const ChainBlock& block, bool allFields = false);
@@ -98,7 +147,27 @@ public:
 
     void setBestHeader(const ChainHeader& header) { m_best_header = header; }
 
+    // The callback is called from several worker threads at once unless the worker count is 1.
     void setClientRequestCallback(client_request_callback_t callback) { m_client_request_callback = callback; }
+    void setRequestKeyCallback(request_key_callback_t callback) { m_request_key_callback = callback; }
+
+    // Without a batch callback, batched requests are passed one at a time to the request callback.
+    void setClientBatchCallback(client_batch_callback_t callback) { m_client_batch_callback = callback; }
+
+    // Must be called before start(). 0 uses one worker per core.
+    void setWorkerCount(unsigned int count) { m_worker_count = count; }
+
+    // Requests arriving while this many are queued are refused with an error. 0 means unlimited.
+    void setMaxQueueDepth(std::size_t depth) { m_max_queue_depth = depth; }
+
+    // Batch arrays with more elements than this are refused with an error. 0 means unlimited.
+    void setMaxBatchSize(std::size_t size) { m_max_batch_size = size; }
+
+    RequestMetrics getRequestMetrics();
+
+    // Plain HTTP GETs for path from allowed addresses are answered with Metrics::registry() in Prometheus
+    // text format. Empty, the default, answers every HTTP request with 404.
+    void setMetricsPath(const std::string& path) { m_metrics_path = path; }
 };
 
 }
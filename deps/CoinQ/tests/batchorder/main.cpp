@@ -0,0 +1,59 @@
+// Checks that the requests of a JSON-RPC batch run in array order when built-in methods
+// such as subscribe are mixed with application requests, including in the middle of the array.
+//
+// Usage: batchorder
+
+#include <CoinQ_batch.h>
+
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+static bool isBuiltin(const string& req)
+{
+    return req == "subscribe" || req == "unsubscribe" || req == "setordered";
+}
+
+// Returns the order in which the requests ran, with each run of application requests in brackets.
+static string dispatch(const vector<string>& reqs)
+{
+    stringstream ss;
+    CoinQ::dispatchBatch(reqs,
+        [](const string& req) { return isBuiltin(req); },
+        [&](const string& req) { ss << req << " "; },
+        [&](const vector<string>& run) {
+            ss << "[";
+            for (size_t i = 0; i < run.size(); i++) { ss << (i > 0 ? " " : "") << run[i]; }
+            ss << "] ";
+        });
+    return ss.str();
+}
+
+static bool check(const vector<string>& reqs, const string& expected)
+{
+    string actual = dispatch(reqs);
+    if (actual == expected) return true;
+
+    cout << "FAILED:";
+    for (auto& req: reqs) { cout << " " << req; }
+    cout << endl << "  expected: " << expected << endl << "  actual:   " << actual << endl;
+    return false;
+}
+
+int main()
+{
+    bool ok = true;
+    ok &= check({}, "");
+    ok &= check({"app1"}, "[app1] ");
+    ok &= check({"app1", "app2"}, "[app1 app2] ");
+    ok &= check({"subscribe"}, "subscribe ");
+    ok &= check({"app1", "subscribe", "app2"}, "[app1] subscribe [app2] ");
+    ok &= check({"app1", "app2", "subscribe", "unsubscribe", "app3"}, "[app1 app2] subscribe unsubscribe [app3] ");
+    ok &= check({"subscribe", "app1", "setordered"}, "subscribe [app1] setordered ");
+
+    cout << (ok ? "All batch order checks passed." : "Some batch order checks failed.") << endl;
+    return ok ? 0 : 1;
+}
@@ -1,6 +1,6 @@
 ///////////////////////////////////////////////////////////////////////////////
 //
-// Signals.h 
+// Signals.h
 //
 // Copyright (c) 2012-2014 Eric Lombrozo
 //
@@ -9,29 +9,39 @@
 
 #pragma once
 
+#include <algorithm>
 #include <functional>
+#include <memory>
 #include <set>
-#include <map>
 #include <mutex>
+#include <utility>
+#include <vector>
 
 namespace Signals
 {
 
 typedef uint64_t Connection;
 
+// Emission takes no Signal lock. It reads an immutable slot list, so slots can be invoked from
+// several threads at once and may connect, disconnect or emit from inside a slot. Connecting and
+// disconnecting copy the list and swap the copy in. An emission already under way keeps calling
+// the list it started with, so a slot disconnected during it can still be called once.
+//
+// std::atomic_load and std::atomic_store on a shared_ptr are not lock-free in libstdc++. They take
+// a short internal lock, which is never held while slots run.
 template<typename... Values>
 class Signal
 {
 public:
-    typedef std::function<void(Values...)> Slot;
+    typedef std::function<void(const Values&...)> Slot;
 
     Signal();
-    ~Signal();
 
     Connection connect(Slot slot);
     bool disconnect(Connection connection);
     void clear();
-    void operator()(Values... values) const;
+    bool empty() const; // lets emitters skip building arguments nobody will see
+    void operator()(const Values&... values) const;
 
 #ifdef SIGNALS_TEST
     std::string getTextualState()
@@ -41,28 +51,29 @@ public:
         ss << "next_: " << next_ << std::endl << "available_:";
         for (auto n: available_) ss << " " << n;
         ss << std::endl << "slots_:";
-        for (auto& slot: slots_) ss << " " << slot.first;
+        for (auto& slot: *slots_) ss << " " << slot.first;
         ss << std::endl;
-        return ss.str(); 
+        return ss.str();
     }
 #endif
 
 private:
+    // Sorted by connection
+    typedef std::vector<std::pair<Connection, Slot>> SlotList;
+    typedef std::shared_ptr<const SlotList> SlotListPtr;
+
+    // Serializes changes. Emission does not take it.
     mutable std::mutex mutex_;
     Connection next_;
     std::set<Connection> available_;
-    std::map<Connection, Slot> slots_;
-};
 
-template<typename... Values>
-inline Signal<Values...>::Signal() : next_(0)
-{
-}
+    // Replaced with std::atomic_store while holding mutex_, read by emission with std::atomic_load.
+    SlotListPtr slots_;
+};
 
 template<typename... Values>
-inline Signal<Values...>::~Signal()
+inline Signal<Values...>::Signal() : next_(0), slots_(std::make_shared<SlotList>())
 {
-    std::lock_guard<std::mutex> lock(mutex_);
 }
 
 template<typename... Values>
@@ -80,7 +91,12 @@ inline Connection Signal<Values...>::connect(Slot slot)
         connection = *it;
         available_.erase(it);
     }
-    slots_.insert(std::pair<Connection, Slot>(connection, slot));
+
+    std::shared_ptr<SlotList> slots = std::make_shared<SlotList>(*slots_);
+    auto pos = std::lower_bound(slots->begin(), slots->end(), connection,
+        [](const std::pair<Connection, Slot>& slot, Connection connection) { return slot.first < connection; });
+    slots->insert(pos, std::make_pair(connection, std::move(slot)));
+    std::atomic_store(&slots_, SlotListPtr(std::move(slots)));
     return connection;
 }
 
@@ -88,10 +104,13 @@ template<typename... Values>
 inline bool Signal<Values...>::disconnect(Connection connection)
 {
     std::lock_guard<std::mutex> lock(mutex_);
-    const auto& it = slots_.find(connection);
-    if (it == slots_.end()) return false;
+    auto it = std::lower_bound(slots_->begin(), slots_->end(), connection,
+        [](const std::pair<Connection, Slot>& slot, Connection connection) { return slot.first < connection; });
+    if (it == slots_->end() || it->first != connection) return false;
 
-    slots_.erase(it);
+    std::shared_ptr<SlotList> slots = std::make_shared<SlotList>(*slots_);
+    slots->erase(slots->begin() + (it - slots_->begin()));
+    std::atomic_store(&slots_, SlotListPtr(std::move(slots)));
     available_.insert(connection);
 
     // remove contiguous available connections from end
@@ -105,114 +124,27 @@ template<typename... Values>
 inline void Signal<Values...>::clear()
 {
     std::lock_guard<std::mutex> lock(mutex_);
-    slots_.clear();
+    std::atomic_store(&slots_, SlotListPtr(std::make_shared<SlotList>()));
     available_.clear();
     next_ = 0;
 }
 
 template<typename... Values>
-inline void Signal<Values...>::operator()(Values... values) const
+inline bool Signal<Values...>::empty() const
 {
-    std::lock_guard<std::mutex> lock(mutex_);
-    for (auto slot: slots_) slot.second(values...); 
+    return std::atomic_load(&slots_)->empty();
 }
 
-template<>
-class Signal<void>
-{
-public:
-    typedef std::function<void()> Slot;
-
-    Signal();
-    ~Signal();
-
-    Connection connect(Slot slot);
-    bool disconnect(Connection connection);
-    void clear();
-    void operator()() const;
-
-#ifdef SIGNALS_TEST
-    std::string getTextualState()
-    {
-        std::lock_guard<std::mutex> lock(mutex_);
-        std::stringstream ss;
-        ss << "next_: " << next_ << std::endl << "available_:";
-        for (auto n: available_) ss << " " << n;
-        ss << std::endl << "slots_:";
-        for (auto& slot: slots_) ss << " " << slot.first;
-        ss << std::endl;
-        return ss.str(); 
-    }
-#endif
-
-private:
-    mutable std::mutex mutex_;
-    Connection next_;
-    std::set<Connection> available_;
-    std::map<Connection, Slot> slots_;
-};
-
-template<>
-inline Signal<>::Signal() : next_(0)
-{
-}
-
-template<>
-inline Signal<>::~Signal()
-{
-    std::lock_guard<std::mutex> lock(mutex_);
-}
-
-template<>
-inline Connection Signal<>::connect(Slot slot)
-{
-    std::lock_guard<std::mutex> lock(mutex_);
-    Connection connection;
-    auto it = available_.begin();
-    if (it == available_.end())
-    {
-        connection = next_++;
-    }
-    else
-    {
-        connection = *it;
-        available_.erase(it);
-    }
-    slots_.insert(std::pair<Connection, Slot>(connection, slot));
-    return connection;
-}
-
-template<>
-inline bool Signal<>::disconnect(Connection connection)
-{
-    std::lock_guard<std::mutex> lock(mutex_);
-    const auto& it = slots_.find(connection);
-    if (it == slots_.end()) return false;
-
-    slots_.erase(it);
-    available_.insert(connection);
-
-    // remove contiguous available connections from end
-    auto rit = available_.rbegin();
-    for (; rit != available_.rend() && *rit == next_ - 1; ++rit, --next_);
-    available_.erase(rit.base(), available_.end());
-    return true;
-}
-
-template<>
-inline void Signal<>::clear()
+template<typename... Values>
+inline void Signal<Values...>::operator()(const Values&... values) const
 {
-    std::lock_guard<std::mutex> lock(mutex_);
-    slots_.clear();
-    available_.clear();
-    next_ = 0;
+    SlotListPtr slots = std::atomic_load(&slots_);
+    for (auto& slot: *slots) slot.second(values...);
 }
 
 template<>
-inline void Signal<>::operator()() const
+class Signal<void> : public Signal<>
 {
-    std::lock_guard<std::mutex> lock(mutex_);
-    for (auto slot: slots_) slot.second(); 
-}
+};
 
 }
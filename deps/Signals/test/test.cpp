@@ -3,7 +3,11 @@
 #define SIGNALS_TEST
 #include <Signals.h>
 
+#include <atomic>
 #include <iostream>
+#include <memory>
+#include <thread>
+#include <vector>
 
 using namespace Signals;
 using namespace std;
@@ -50,6 +54,39 @@ int main()
     notifyVoid.disconnect(9);
     cout << endl << "notifyInt state:" << endl << notifyInt.getTextualState();
     cout << endl << "notifyVoid state:" << endl << notifyVoid.getTextualState();
-    
+
+    cout << endl << "slot 0 disconnects itself and connects another while emitting..." << endl;
+    int calls = 0;
+    notifyInt.clear();
+    notifyInt.connect([&](int i) { calls++; notifyInt.disconnect(0); notifyInt.connect([&](int i) { calls++; }); });
+    notifyInt(1);
+    cout << "calls: " << calls << endl;
+    notifyInt(2);
+    cout << "calls: " << calls << endl;
+    cout << endl << "notifyInt state:" << endl << notifyInt.getTextualState();
+
+    cout << endl << "arguments are passed to the slots without copying..." << endl;
+    Signal<shared_ptr<int>> notifyPtr;
+    shared_ptr<int> ptr(new int(0));
+    notifyPtr.connect([](const shared_ptr<int>& p) { cout << "use_count: " << p.use_count() << endl; });
+    notifyPtr(ptr);
+
+    cout << endl << "emitting from four threads while connecting and disconnecting..." << endl;
+    atomic<int> emitted(0);
+    notifyInt.clear();
+    notifyInt.connect([&](int i) { emitted++; });
+    vector<thread> threads;
+    for (int t = 0; t < 4; t++)
+    {
+        threads.push_back(thread([&]() { for (int i = 0; i < 10000; i++) notifyInt(i); }));
+    }
+    for (int i = 0; i < 1000; i++)
+    {
+        notifyInt.disconnect(notifyInt.connect([](int i) { }));
+    }
+    for (auto& t: threads) t.join();
+    cout << "emitted: " << emitted << endl;
+    cout << endl << "notifyInt state:" << endl << notifyInt.getTextualState();
+
     return 0;
 }
@@ -22,16 +22,358 @@
 // OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
 // THE SOFTWARE.
 
+
 #include "logger.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdlib>
 #include <fstream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
 
 namespace logger {
-    std::ofstream file;
+    std::atomic<bool> opened(false);
+
+    namespace {
+        const char* const LEVEL_NAMES[] = { "trace", "debug", "info", "warning", "error", "fatal", "off" };
+
+        const level_t DEFAULT_LEVEL = debug;
+
+        // Must be a power of two.
+        const size_t RING_SIZE = 1 << 14;
+
+        // Bounded multi-producer single-consumer queue. Each slot's sequence number tells producers
+        // whether it is free for their ticket and the writer whether it has been filled.
+        class ring
+        {
+        public:
+            ring() : m_slots(RING_SIZE), m_enqueue(0), m_dequeue(0)
+            {
+                for (size_t i = 0; i < RING_SIZE; i++) { m_slots[i].seq.store(i, std::memory_order_relaxed); }
+            }
+
+            // Returns false if full.
+            bool push(std::string& text)
+            {
+                size_t pos = m_enqueue.load(std::memory_order_relaxed);
+                while (true)
+                {
+                    slot& s = m_slots[pos & (RING_SIZE - 1)];
+                    size_t seq = s.seq.load(std::memory_order_acquire);
+                    if (seq == pos)
+                    {
+                        if (m_enqueue.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                        {
+                            s.text.swap(text);
+                            s.seq.store(pos + 1, std::memory_order_release);
+                            return true;
+                        }
+                    }
+                    else if ((ptrdiff_t)(seq - pos) < 0)
+                    {
+                        return false;
+                    }
+                    else
+                    {
+                        pos = m_enqueue.load(std::memory_order_relaxed);
+                    }
+                }
+            }
+
+            // Only called by the writer.
+            bool pop(std::string& text)
+            {
+                slot& s = m_slots[m_dequeue & (RING_SIZE - 1)];
+                if (s.seq.load(std::memory_order_acquire) != m_dequeue + 1) return false;
+                text.swap(s.text);
+                s.text.clear();
+                s.seq.store(m_dequeue + RING_SIZE, std::memory_order_release);
+                m_dequeue++;
+                return true;
+            }
+
+            size_t enqueued() const { return m_enqueue.load(std::memory_order_acquire); }
+
+        private:
+            struct slot
+            {
+                std::atomic<size_t> seq;
+                std::string text;
+            };
+
+            std::vector<slot> m_slots;
+            std::atomic<size_t> m_enqueue;
+            size_t m_dequeue;
+        };
+
+        class writer
+        {
+        public:
+            writer() : m_running(false), m_stop(false), m_sleeping(false), m_written(0), m_dropped(0) { }
+            ~writer() { stop(); }
+
+            void start(const char* filename)
+            {
+                stop();
+                m_file.open(filename, std::ios_base::app);
+                m_stop = false;
+                m_thread = std::thread(&writer::run, this);
+                m_running = true;
+                opened = true;
+            }
+
+            void stop()
+            {
+                if (!m_running) return;
+                opened = false;
+                {
+                    std::lock_guard<std::mutex> lock(m_mutex);
+                    m_stop = true;
+                }
+                m_cond.notify_one();
+                m_thread.join();
+                m_file.close();
+                m_running = false;
+            }
+
+            void push(level_t level, std::string& text)
+            {
+                while (!m_ring.push(text))
+                {
+                    if (level < error || !opened.load(std::memory_order_relaxed))
+                    {
+                        m_dropped++;
+                        return;
+                    }
+                    m_cond.notify_one();
+                    std::this_thread::yield();
+                }
+                if (m_sleeping.load(std::memory_order_relaxed)) { m_cond.notify_one(); }
+            }
+
+            void flush()
+            {
+                if (!m_running) return;
+                size_t target = m_ring.enqueued();
+                while (m_written.load(std::memory_order_acquire) < target && m_running)
+                {
+                    m_cond.notify_one();
+                    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                }
+            }
+
+            unsigned long dropped() const { return m_dropped.load(); }
+
+        private:
+            void run()
+            {
+                std::string text;
+                unsigned long reported_dropped = 0;
+                while (true)
+                {
+                    size_t count = 0;
+                    while (m_ring.pop(text))
+                    {
+                        m_file << text;
+                        count++;
+                    }
+
+                    unsigned long total_dropped = m_dropped.load();
+                    if (total_dropped != reported_dropped)
+                    {
+                        m_file << "[warning] logger dropped " << (total_dropped - reported_dropped) << " records" << std::endl;
+                        reported_dropped = total_dropped;
+                    }
+
+                    if (count > 0)
+                    {
+                        m_file.flush();
+                        m_written.fetch_add(count, std::memory_order_release);
+                        continue;
+                    }
+
+                    std::unique_lock<std::mutex> lock(m_mutex);
+                    if (m_stop) break;
+
+                    // Producers notify without taking the mutex, so a notification can be missed. Do not wait long.
+                    m_sleeping = true;
+                    m_cond.wait_for(lock, std::chrono::milliseconds(50));
+                    m_sleeping = false;
+                }
+
+                // Records queued by threads that were still logging when stop() was called.
+                size_t count = 0;
+                while (m_ring.pop(text))
+                {
+                    m_file << text;
+                    count++;
+                }
+                m_file.flush();
+                m_written.fetch_add(count, std::memory_order_release);
+            }
+
+            ring m_ring;
+            std::ofstream m_file;
+            std::thread m_thread;
+            std::atomic<bool> m_running;
+
+            std::mutex m_mutex;
+            std::condition_variable m_cond;
+            bool m_stop;
+            std::atomic<bool> m_sleeping;
+
+            std::atomic<size_t> m_written;
+            std::atomic<unsigned long> m_dropped;
+        };
+
+        writer& get_writer()
+        {
+            static writer w;
+            return w;
+        }
+
+        struct registry
+        {
+            registry() : default_level(DEFAULT_LEVEL) { }
+
+            std::mutex mutex;
+            level_t default_level;
+            std::map<std::string, level_t> levels;  // set by name
+            std::map<std::string, std::unique_ptr<subsystem>> subsystems;
+        };
+
+        registry& get_registry()
+        {
+            static registry r;
+            return r;
+        }
+    }
+
     void init_logger(const char* filename)
     {
-        file.open(filename, std::ios_base::app);
+        const char* spec = getenv("LOGGER_LEVELS");
+        std::string spec_error;
+        if (spec)
+        {
+            try
+            {
+                set_levels(spec);
+            }
+            catch (const std::exception& e)
+            {
+                spec_error = e.what();
+            }
+        }
+
+        get_writer().start(filename);
+
+        if (!spec_error.empty())
+        {
+            record(warning).stream() << "Ignoring LOGGER_LEVELS: " << spec_error << std::endl;
+        }
+    }
+
+    void flush()
+    {
+        get_writer().flush();
+    }
+
+    void set_level(level_t level)
+    {
+        registry& r = get_registry();
+        std::lock_guard<std::mutex> lock(r.mutex);
+        r.default_level = level;
+        for (auto& item: r.subsystems)
+        {
+            if (!r.levels.count(item.first)) { item.second->level = level; }
+        }
+    }
+
+    void set_level(const std::string& subsystem_name, level_t level)
+    {
+        registry& r = get_registry();
+        std::lock_guard<std::mutex> lock(r.mutex);
+        r.levels[subsystem_name] = level;
+        auto it = r.subsystems.find(subsystem_name);
+        if (it != r.subsystems.end()) { it->second->level = level; }
     }
 
-    std::ostream out(file.rdbuf());
-    std::ostream no_out(NULL);
+    void set_levels(const std::string& spec)
+    {
+        // Parse everything first so a bad spec changes nothing.
+        std::vector<std::pair<std::string, level_t>> levels;
+        size_t pos = 0;
+        while (pos <= spec.size())
+        {
+            size_t end = spec.find(',', pos);
+            if (end == std::string::npos) { end = spec.size(); }
+            std::string item = spec.substr(pos, end - pos);
+            pos = end + 1;
+            if (item.empty()) continue;
+
+            size_t eq = item.find('=');
+            if (eq == std::string::npos)
+            {
+                levels.push_back(std::make_pair(std::string(), parse_level(item)));
+            }
+            else
+            {
+                if (eq == 0) throw std::invalid_argument("Missing subsystem name in \"" + item + "\".");
+                levels.push_back(std::make_pair(item.substr(0, eq), parse_level(item.substr(eq + 1))));
+            }
+        }
+
+        for (auto& level: levels)
+        {
+            if (level.first.empty())    { set_level(level.second); }
+            else                        { set_level(level.first, level.second); }
+        }
+    }
+
+    level_t parse_level(const std::string& name)
+    {
+        for (int i = trace; i <= off; i++)
+        {
+            if (name == LEVEL_NAMES[i]) return (level_t)i;
+        }
+        throw std::invalid_argument("Invalid log level \"" + name + "\".");
+    }
+
+    subsystem& get_subsystem(const char* name)
+    {
+        registry& r = get_registry();
+        std::lock_guard<std::mutex> lock(r.mutex);
+        std::unique_ptr<subsystem>& s = r.subsystems[name];
+        if (!s)
+        {
+            s.reset(new subsystem());
+            auto it = r.levels.find(name);
+            s->level = (it != r.levels.end()) ? it->second : r.default_level;
+        }
+        return *s;
+    }
+
+    unsigned long dropped()
+    {
+        return get_writer().dropped();
+    }
+
+    record::record(level_t level) : m_level(level)
+    {
+        m_stream << "[" << LEVEL_NAMES[level] << "] ";
+    }
+
+    record::~record()
+    {
+        if (!opened.load(std::memory_order_relaxed)) return;
+        std::string text = m_stream.str();
+        get_writer().push(m_level, text);
+        if (m_level == fatal) { get_writer().flush(); }
+    }
 }
@@ -22,56 +22,121 @@
 // OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
 // THE SOFTWARE.
 
+
 #ifndef _LOGGER_H__
 #define _LOGGER_H__
 
+#include <atomic>
 #include <sstream>
 #include <string>
 
+// Statements below the level of their subsystem cost one relaxed load and a branch: the stream
+// arguments are not evaluated. Enabled statements are formatted on the calling thread and handed
+// to a background writer through a lock-free ring buffer, so callers never wait on the file.
+//
+// A translation unit names its subsystem by defining LOGGER_SUBSYSTEM before including this header:
+//
+//     #define LOGGER_SUBSYSTEM "netsync"
+//
+// Levels are set with set_level()/set_levels() or the LOGGER_LEVELS environment variable, read by
+// init_logger(), e.g. LOGGER_LEVELS=info,netsync=trace. The default level is debug.
+//
+// Defining LOGGER_DEBUG, LOGGER_INFO, LOGGER_WARNING or LOGGER_ERROR removes statements below that
+// level at compile time.
+
 namespace logger {
+    enum level_t { trace, debug, info, warning, error, fatal, off };
+
+    // A group of statements sharing a runtime level.
+    struct subsystem
+    {
+        std::atomic<int> level;
+    };
+
+    // Opens the log file, appending, and starts the writer thread. Nothing is logged before this is called.
     void init_logger(const char* filename);
-    extern "C" std::ostream out;
-    extern "C" std::ostream no_out;
-}
 
-#define INIT_LOGGER(filename) logger::init_logger(filename)
+    // Blocks until everything logged so far has been written to the file.
+    void flush();
 
-#if !defined(LOGGER_TRACE) && !defined(LOGGER_DEBUG) && !defined(LOGGER_INFO) && !defined(LOGGER_WARNING) && !defined(LOGGER_ERROR) && !defined(LOGGER_FATAL)
-    #define LOGGER_TRACE
-#endif
+    // Sets the level of every subsystem that has not been given its own.
+    void set_level(level_t level);
+    void set_level(const std::string& subsystem_name, level_t level);
 
-#define LOGGER(level) LOGGER_##level
+    // Applies a comma-separated list of levels, for example "info,netsync=trace,vault=debug".
+    // A level without a name sets the default. Throws std::invalid_argument.
+    void set_levels(const std::string& spec);
 
-#if defined(LOGGER_TRACE)
-    #define LOGGER_trace logger::out << "[trace] "
-#else
-    #define LOGGER_trace logger::no_out
-#endif
+    // Throws std::invalid_argument.
+    level_t parse_level(const std::string& name);
 
-#if defined(LOGGER_TRACE) || defined(LOGGER_DEBUG)
-    #define LOGGER_debug logger::out << "[debug] "
-#else
-    #define LOGGER_debug logger::no_out
-#endif
+    // The same subsystem is returned for the same name for the life of the process.
+    subsystem& get_subsystem(const char* name);
 
-#if defined(LOGGER_TRACE) || defined(LOGGER_DEBUG) || defined(LOGGER_INFO)
-    #define LOGGER_info logger::out << "[info] "
-#else
-    #define LOGGER_info logger::no_out
-#endif
+    // Records that could not be queued because the writer fell behind. Errors are never dropped.
+    unsigned long dropped();
 
-#if defined(LOGGER_TRACE) || defined(LOGGER_DEBUG) || defined(LOGGER_INFO) || defined(LOGGER_WARNING)
-    #define LOGGER_warning logger::out << "[warning] "
-#else
-    #define LOGGER_warning logger::no_out
+    extern std::atomic<bool> opened;
+
+    inline bool enabled(level_t level, const subsystem& s)
+    {
+        return opened.load(std::memory_order_relaxed) && (int)level >= s.level.load(std::memory_order_relaxed);
+    }
+
+    // Collects one statement and queues it at the end of the full expression.
+    class record
+    {
+    public:
+        explicit record(level_t level);
+        ~record();
+
+        std::ostream& stream() { return m_stream; }
+
+    private:
+        level_t m_level;
+        std::ostringstream m_stream;
+    };
+
+    // Gives both branches of the LOGGER conditional type void.
+    struct voidify
+    {
+        void operator&(std::ostream&) { }
+    };
+}
+
+#ifndef LOGGER_SUBSYSTEM
+    #define LOGGER_SUBSYSTEM "main"
 #endif
 
-#if defined(LOGGER_TRACE) || defined(LOGGER_DEBUG) || defined(LOGGER_INFO) || defined(LOGGER_WARNING) || defined(LOGGER_ERROR)
-    #define LOGGER_error logger::out << "[error] "
+namespace {
+    inline const logger::subsystem& logger_subsystem()
+    {
+        static const logger::subsystem& s = logger::get_subsystem(LOGGER_SUBSYSTEM);
+        return s;
+    }
+}
+
+#define INIT_LOGGER(filename) logger::init_logger(filename)
+
+#if defined(LOGGER_TRACE)
+    #define LOGGER_MIN_LEVEL logger::trace
+#elif defined(LOGGER_DEBUG)
+    #define LOGGER_MIN_LEVEL logger::debug
+#elif defined(LOGGER_INFO)
+    #define LOGGER_MIN_LEVEL logger::info
+#elif defined(LOGGER_WARNING)
+    #define LOGGER_MIN_LEVEL logger::warning
+#elif defined(LOGGER_ERROR)
+    #define LOGGER_MIN_LEVEL logger::error
 #else
-    #define LOGGER_error logger:no_out
+    #define LOGGER_MIN_LEVEL logger::trace
 #endif
 
-#define LOGGER_fatal logger::out << "[fatal] "
+// Fatal statements are always compiled in.
+#define LOGGER_ENABLED(level) \
+    ((logger::level >= LOGGER_MIN_LEVEL || logger::level == logger::fatal) && logger::enabled(logger::level, logger_subsystem()))
+
+#define LOGGER(level) \
+    !LOGGER_ENABLED(level) ? (void)0 : logger::voidify() & logger::record(logger::level).stream()
 
 #endif // _LOGGER_H__
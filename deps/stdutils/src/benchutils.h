@@ -0,0 +1,244 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// benchutils.h
+//
+// Copyright (c) 2014 Eric Lombrozo
+//
+// All Rights Reserved.
+//
+// A small harness for the bench targets. Each benchmark is run a fixed
+// number of times on inputs built from a fixed seed, and the results are
+// written as one JSON document so runs can be compared by a script.
+//
+// Command line options, all of the form --name=value:
+//   --repeat   times each benchmark is run (default 5)
+//   --filter   only run benchmarks whose names contain this string
+//   --out      write the JSON to this file instead of stdout
+// Any other option is a parameter for the suite, read with param().
+//
+// ops_per_sec is null when the median run was too short for the clock to
+// measure, as can happen for benchmarks timed once by the caller.
+//
+
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace stdutils
+{
+
+// Keeps the compiler from dropping a computation whose result is unused.
+template<typename T>
+inline void do_not_optimize(const T& value)
+{
+    asm volatile("" : : "g"(&value) : "memory");
+}
+
+// Deterministic generator for benchmark inputs, so every run sees the same data.
+class bench_random
+{
+public:
+    explicit bench_random(uint64_t seed = 0x9e3779b97f4a7c15ull) : state_(seed) { }
+
+    uint64_t next()
+    {
+        // xorshift64*
+        state_ ^= state_ >> 12;
+        state_ ^= state_ << 25;
+        state_ ^= state_ >> 27;
+        return state_ * 0x2545f4914f6cdd1dull;
+    }
+
+    template<typename ByteVector>
+    ByteVector bytes(std::size_t n)
+    {
+        ByteVector rval(n);
+        for (std::size_t i = 0; i < n; i++) { rval[i] = (unsigned char)(next() >> 56); }
+        return rval;
+    }
+
+private:
+    uint64_t state_;
+};
+
+class bench_runner
+{
+public:
+    bench_runner(const std::string& suite, int argc, char* argv[])
+        : suite_(suite), repeat_(5)
+    {
+        for (int i = 1; i < argc; i++)
+        {
+            std::string arg(argv[i]);
+            std::size_t eq = arg.find('=');
+            if (arg.compare(0, 2, "--") != 0 || eq == std::string::npos)
+                throw std::runtime_error("Invalid option: " + arg + ". Options must be of the form --name=value.");
+
+            std::string name = arg.substr(2, eq - 2);
+            std::string value = arg.substr(eq + 1);
+            if (name == "repeat")
+            {
+                repeat_ = std::max(1, atoi(value.c_str()));
+            }
+            else if (name == "filter")
+            {
+                filter_ = value;
+            }
+            else if (name == "out")
+            {
+                out_ = value;
+            }
+            else
+            {
+                params_[name] = value;
+            }
+        }
+    }
+
+    // Suite parameters are included in the output whether or not they were given.
+    uint64_t param(const std::string& name, uint64_t default_value)
+    {
+        auto it = params_.find(name);
+        if (it == params_.end())
+        {
+            std::stringstream ss;
+            ss << default_value;
+            params_[name] = ss.str();
+            return default_value;
+        }
+        return strtoull(it->second.c_str(), NULL, 10);
+    }
+
+    int repeat() const { return repeat_; }
+
+    bool enabled(const std::string& name) const { return filter_.empty() || name.find(filter_) != std::string::npos; }
+
+    // Times fn, which performs ops operations, once per repeat.
+    template<typename Fn>
+    void run(const std::string& name, uint64_t ops, Fn fn)
+    {
+        if (!enabled(name)) return;
+
+        std::vector<double> seconds;
+        for (int i = 0; i < repeat_; i++)
+        {
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            fn();
+            seconds.push_back(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+        }
+        record(name, ops, seconds);
+    }
+
+    // For benchmarks that change their inputs and cannot simply be repeated, timed by the caller.
+    void record(const std::string& name, uint64_t ops, std::vector<double> seconds)
+    {
+        if (!enabled(name) || seconds.empty()) return;
+
+        std::sort(seconds.begin(), seconds.end());
+        result r;
+        r.name = name;
+        r.ops = std::max<uint64_t>(ops, 1);
+        r.repeats = seconds.size();
+        r.min_ns = seconds.front() * 1e9 / r.ops;
+        r.median_ns = seconds[seconds.size() / 2] * 1e9 / r.ops;
+        r.max_ns = seconds.back() * 1e9 / r.ops;
+        results_.push_back(r);
+
+        std::cerr << std::left << std::setw(40) << name << std::right << std::fixed << std::setprecision(1)
+                  << std::setw(14) << r.median_ns << " ns/op" << std::setw(14) << std::setprecision(0);
+        if (r.median_ns > 0)    { std::cerr << 1e9 / r.median_ns; }
+        else                    { std::cerr << "-"; }
+        std::cerr << " ops/s" << std::endl;
+    }
+
+    void record(const std::string& name, uint64_t ops, double seconds) { record(name, ops, std::vector<double>(1, seconds)); }
+
+    // Writes the results. Returns the exit code for main.
+    int finish() const
+    {
+        if (out_.empty())
+        {
+            write(std::cout);
+            return 0;
+        }
+
+        std::ofstream f(out_.c_str());
+        write(f);
+        if (!f)
+        {
+            std::cerr << "Could not write " << out_ << "." << std::endl;
+            return 1;
+        }
+        return 0;
+    }
+
+private:
+    struct result
+    {
+        std::string name;
+        uint64_t ops;
+        std::size_t repeats;
+        double min_ns;
+        double median_ns;
+        double max_ns;
+    };
+
+    static std::string quote(const std::string& s)
+    {
+        std::string rval("\"");
+        for (auto c: s)
+        {
+            if (c == '"' || c == '\\')  { rval += '\\'; rval += c; }
+            else if ((unsigned char)c < 0x20) { rval += ' '; }
+            else                        { rval += c; }
+        }
+        return rval + "\"";
+    }
+
+    void write(std::ostream& os) const
+    {
+        os << "{\"suite\":" << quote(suite_) << ",\"repeat\":" << repeat_ << ",\"params\":{";
+        bool comma = false;
+        for (auto& param: params_)
+        {
+            if (comma) os << ",";
+            comma = true;
+            os << quote(param.first) << ":" << quote(param.second);
+        }
+        os << "},\"results\":[";
+        comma = false;
+        for (auto& r: results_)
+        {
+            if (comma) os << ",";
+            comma = true;
+            os << std::fixed << std::setprecision(1)
+               << "{\"name\":" << quote(r.name) << ",\"ops\":" << r.ops << ",\"repeats\":" << r.repeats
+               << ",\"ns_per_op\":{\"min\":" << r.min_ns << ",\"median\":" << r.median_ns << ",\"max\":" << r.max_ns << "}"
+               << ",\"ops_per_sec\":";
+            if (r.median_ns > 0)    { os << 1e9 / r.median_ns; }
+            else                    { os << "null"; }
+            os << "}";
+        }
+        os << "]}" << std::endl;
+    }
+
+    std::string suite_;
+    int repeat_;
+    std::string filter_;
+    std::string out_;
+    std::map<std::string, std::string> params_;
+    std::vector<result> results_;
+};
+
+}
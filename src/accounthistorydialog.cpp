@@ -38,7 +38,6 @@ AccountHistoryDialog::AccountHistoryDialog(CoinDB::Vault* vault, const QString&
     createMenus();
 
     accountHistoryModel = new TxModel(vault, accountName, this);
-    accountHistoryModel->update();
 
     accountHistoryView = new TxView(this);
     accountHistoryView->setModel(accountHistoryModel);
@@ -65,8 +64,7 @@ void AccountHistoryDialog::updateCurrentTx(const QModelIndex& current, const QMo
 {
     currentRow = current.row();
     if (currentRow != -1) {
-        QStandardItem* typeItem = accountHistoryModel->item(currentRow, 6);
-        int type = typeItem->data(Qt::UserRole).toInt();
+        int type = accountHistoryModel->getTxStatus(currentRow);
         if (type == CoinDB::Tx::UNSIGNED) {
             signTxAction->setEnabled(true);
         }
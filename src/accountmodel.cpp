@@ -43,24 +43,37 @@ AccountModel::AccountModel()
 
 void AccountModel::update()
 {
-    removeRows(0, rowCount());
+    update(query(vault));
+}
 
-    if (!vault) {
-        numAccounts = 0;
-        return;
-    }
+AccountModel::SnapshotPtr AccountModel::query(CoinDB::Vault* vault)
+{
+    std::shared_ptr<Snapshot> snapshot(new Snapshot());
+    if (!vault) return snapshot;
 
-    QStringList accountNames;
     std::vector<AccountInfo> accounts = vault->getAllAccountInfo();
     for (auto& account: accounts) {
-        QString accountName = QString::fromStdString(account.name());
-        QString policy = QString::number(account.minsigs()) + tr(" of ") + QString::fromStdString(stdutils::delimited_list(account.keychain_names(), ", "));
-        QString balance = QString::number(vault->getAccountBalance(account.name(), 0)/100000000.0, 'g', 8);
-        accountNames << accountName;
+        Snapshot::Account item;
+        item.name = QString::fromStdString(account.name());
+        item.policy = QString::number(account.minsigs()) + tr(" of ") + QString::fromStdString(stdutils::delimited_list(account.keychain_names(), ", "));
+        item.balance = vault->getAccountBalance(account.name(), 0);
+        snapshot->accounts.push_back(item);
+    }
+    return snapshot;
+}
+
+void AccountModel::update(SnapshotPtr snapshot)
+{
+    removeRows(0, rowCount());
+
+    QStringList accountNames;
+    for (auto& account: snapshot->accounts) {
+        QString balance = QString::number(account.balance/100000000.0, 'g', 8);
+        accountNames << account.name;
 
         QList<QStandardItem*> row;
-        row.append(new QStandardItem(accountName));
-        row.append(new QStandardItem(policy));
+        row.append(new QStandardItem(account.name));
+        row.append(new QStandardItem(account.policy));
         row.append(new QStandardItem(balance));
         appendRow(row);
 
@@ -220,7 +233,6 @@ std::shared_ptr<Tx> AccountModel::insertTx(std::shared_ptr<Tx> tx, bool sign)
         tx = vault->signTx(tx->unsigned_hash(), keychain_names, true);
     }
 
-    update();
     emit newTx(tx->hash());
 
     return tx;
@@ -244,7 +256,6 @@ std::shared_ptr<Tx> AccountModel::insertTx(const Coin::Transaction& coinTx, Tx::
         vault->signTx(tx->unsigned_hash(), keychain_names, true);
     }
 
-    update();
     emit newTx(tx->hash());
 
     return tx;
@@ -19,6 +19,9 @@
 
 #include <CoinQ/CoinQ_typedefs.h>
 
+#include <memory>
+#include <vector>
+
 class TaggedOutput
 {
 public:
@@ -41,11 +44,27 @@ class AccountModel : public QStandardItemModel
     Q_OBJECT
 
 public:
+    struct Snapshot
+    {
+        struct Account
+        {
+            QString name;
+            QString policy;
+            uint64_t balance;
+        };
+        std::vector<Account> accounts;
+    };
+    typedef std::shared_ptr<const Snapshot> SnapshotPtr;
+
     AccountModel();
     ~AccountModel() { if (vault) delete vault; }
 
     void update();
 
+    // The query behind update(), for running on another thread. It only touches the vault.
+    static SnapshotPtr query(CoinDB::Vault* vault);
+    void update(SnapshotPtr snapshot);
+
     // Vault operations
     void create(const QString& fileName);
     void load(const QString& fileName);
@@ -24,7 +24,6 @@ AccountHistoryDialog::AccountHistoryDialog(CoinDB::Vault* vault, const QString&
     resize(QSize(800, 400));
 
     accountHistoryModel = new TxModel(vault, accountName, this);
-    accountHistoryModel->update();
 
     accountHistoryView = new TxView(this);
     accountHistoryView->setModel(accountHistoryModel);
@@ -31,12 +31,20 @@ void KeychainModel::setVault(CoinDB::Vault* vault)
 
 void KeychainModel::update()
 {
-    removeRows(0, rowCount());
+    update(query(vault));
+}
 
-    if (!vault) return;
+KeychainModel::SnapshotPtr KeychainModel::query(CoinDB::Vault* vault)
+{
+    if (!vault) return SnapshotPtr(new std::vector<KeychainView>());
+    return SnapshotPtr(new std::vector<KeychainView>(vault->getRootKeychainViews()));
+}
+
+void KeychainModel::update(SnapshotPtr snapshot)
+{
+    removeRows(0, rowCount());
 
-    std::vector<KeychainView> keychains = vault->getRootKeychainViews();
-    for (auto& keychain: keychains)
+    for (auto& keychain: *snapshot)
     {
         QList<QStandardItem*> row;
         row.append(new QStandardItem(QString::fromStdString(keychain.name)));
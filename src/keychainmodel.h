@@ -17,16 +17,25 @@
 
 #include <CoinQ/CoinQ_typedefs.h>
 
+#include <memory>
+#include <vector>
+
 class KeychainModel : public QStandardItemModel
 {
     Q_OBJECT
 
 public:
+    typedef std::shared_ptr<const std::vector<CoinDB::KeychainView>> SnapshotPtr;
+
     KeychainModel();
 
     void setVault(CoinDB::Vault* vault);
     void update();
 
+    // The query behind update(), for running on another thread. It only touches the vault.
+    static SnapshotPtr query(CoinDB::Vault* vault);
+    void update(SnapshotPtr snapshot);
+
     void exportKeychain(const QString& keychainName, const QString& fileName, bool exportPrivate) const;
     void importKeychain(const QString& keychainName, const QString& fileName, bool& importPrivate);
     bool exists(const QString& keychainName) const;
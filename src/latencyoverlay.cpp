@@ -0,0 +1,53 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// CoinVault
+//
+// latencyoverlay.cpp
+//
+// Copyright (c) 2013 Eric Lombrozo
+//
+// All Rights Reserved.
+
+#include "latencyoverlay.h"
+
+#include <QEvent>
+
+LatencyOverlay::LatencyOverlay(QWidget* parent)
+    : QLabel(parent), peakMs(0)
+{
+    setAttribute(Qt::WA_TransparentForMouseEvents);
+    setStyleSheet("QLabel { background-color: rgba(0, 0, 0, 160); color: white; padding: 3px; font-family: monospace; }");
+    parent->installEventFilter(this);
+    reset();
+}
+
+void LatencyOverlay::showRefresh(int latencyMs, int queryMs, int applyMs, int requests)
+{
+    if (latencyMs > peakMs) peakMs = latencyMs;
+
+    setText(tr("refresh %1 ms (query %2 ms, apply %3 ms)\n%4 changes coalesced, peak %5 ms")
+        .arg(latencyMs).arg(queryMs).arg(applyMs).arg(requests).arg(peakMs));
+    adjustSize();
+    reposition();
+}
+
+void LatencyOverlay::reset()
+{
+    peakMs = 0;
+    setText(tr("refresh -"));
+    adjustSize();
+    reposition();
+}
+
+bool LatencyOverlay::eventFilter(QObject* obj, QEvent* event)
+{
+    if (obj == parent() && event->type() == QEvent::Resize) reposition();
+    return QLabel::eventFilter(obj, event);
+}
+
+void LatencyOverlay::reposition()
+{
+    QWidget* parent = parentWidget();
+    move(parent->width() - width() - 4, 4);
+    raise();
+}
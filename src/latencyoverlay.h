@@ -0,0 +1,37 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// CoinVault
+//
+// latencyoverlay.h
+//
+// Copyright (c) 2013 Eric Lombrozo
+//
+// All Rights Reserved.
+
+#ifndef COINVAULT_LATENCYOVERLAY_H
+#define COINVAULT_LATENCYOVERLAY_H
+
+#include <QLabel>
+
+// Shows the latency of the last model refresh in the top right corner of its parent.
+class LatencyOverlay : public QLabel
+{
+    Q_OBJECT
+
+public:
+    LatencyOverlay(QWidget* parent);
+
+public slots:
+    void showRefresh(int latencyMs, int queryMs, int applyMs, int requests);
+    void reset();
+
+protected:
+    bool eventFilter(QObject* obj, QEvent* event);
+
+private:
+    void reposition();
+
+    int peakMs;
+};
+
+#endif // COINVAULT_LATENCYOVERLAY_H
@@ -41,6 +41,10 @@
 // Actions
 #include "txactions.h"
 
+// Background refreshes
+#include "vaultrefresher.h"
+#include "latencyoverlay.h"
+
 // Dialogs
 #include "newkeychaindialog.h"
 #include "quicknewaccountdialog.h"
@@ -75,7 +79,9 @@ MainWindow::MainWindow() :
     doneHeaderSync(false),
     networkState(NETWORK_STATE_NOT_CONNECTED),
     accountModel(nullptr),
-    keychainModel(nullptr)
+    keychainModel(nullptr),
+    vaultRefresher(nullptr),
+    latencyOverlay(nullptr)
 {
     loadSettings();
 
@@ -149,6 +155,12 @@ MainWindow::MainWindow() :
     tabWidget->addTab(txView, tr("Transactions"));
     setCentralWidget(tabWidget);
 
+    // Vault queries for the models run off the UI thread, so sync does not freeze it
+    vaultRefresher = new VaultRefresher(accountModel, keychainModel, txModel, this);
+    latencyOverlay = new LatencyOverlay(tabWidget);
+    latencyOverlay->setVisible(showRefreshLatency);
+    connect(vaultRefresher, SIGNAL(refreshed(int, int, int, int)), latencyOverlay, SLOT(showRefresh(int, int, int, int)));
+
     requestPaymentDialog = new RequestPaymentDialog(accountModel, this);
 
     // status updates
@@ -320,7 +332,9 @@ void MainWindow::newVault(QString fileName)
     saveSettings();
 
     try {
+        vaultRefresher->setVault(NULL);
         accountModel->create(fileName);
+        vaultRefresher->setVault(accountModel->getVault());
         accountView->update();
 
         keychainModel->setVault(accountModel->getVault());
@@ -395,6 +409,7 @@ void MainWindow::closeVault()
     try {
         networkSync.stopResync();
 
+        vaultRefresher->setVault(NULL);
         accountModel->close();
         keychainModel->setVault(NULL);
         txModel->setVault(NULL);
@@ -1101,8 +1116,7 @@ void MainWindow::newTx(const bytes_t& hash)
 //    updateStatusMessage(tr("Added transaction ") + QString::fromStdString(uchar_vector(hash).getHex()));
     emit status(message);
 
-    txModel->update();
-    txView->update();
+    vaultRefresher->requestTxRefresh(hash);
 }
 
 void MainWindow::newBlock(const bytes_t& hash, int height)
@@ -1114,8 +1128,7 @@ void MainWindow::newBlock(const bytes_t& hash, int height)
 //    updateStatusMessage(tr("Inserted block ") + QString::fromStdString(uchar_vector(hash).getHex()) + tr(" height: ") + QString::number(height));
     emit status(message);
 
-    txModel->update();
-    txView->update();
+    vaultRefresher->requestBlockRefresh();
 }
 
 /*
@@ -1663,6 +1676,19 @@ void MainWindow::createActions()
     networkSettingsAction->setEnabled(true);
     connect(networkSettingsAction, SIGNAL(triggered()), this, SLOT(networkSettings()));
 
+    // view actions
+    showRefreshLatencyAction = new QAction(tr("Show Refresh Latency"), this);
+    showRefreshLatencyAction->setCheckable(true);
+    showRefreshLatencyAction->setChecked(showRefreshLatency);
+    showRefreshLatencyAction->setStatusTip(tr("Show how long the vault takes to refresh the tables"));
+    connect(showRefreshLatencyAction, &QAction::toggled, [=](bool checked) {
+        this->showRefreshLatency = checked;
+        if (latencyOverlay) {
+            latencyOverlay->reset();
+            latencyOverlay->setVisible(checked);
+        }
+    });
+
     // about/help actions
     aboutAction = new QAction(tr("About..."), this);
     aboutAction->setStatusTip(tr("About ") + getDefaultSettings().getAppName());
@@ -1734,6 +1760,9 @@ void MainWindow::createMenus()
     networkMenu->addSeparator();
     networkMenu->addAction(networkSettingsAction);
 
+    viewMenu = menuBar()->addMenu(tr("&View"));
+    viewMenu->addAction(showRefreshLatencyAction);
+
     menuBar()->addSeparator();
 
     helpMenu = menuBar()->addMenu(tr("&Help"));
@@ -1808,6 +1837,7 @@ void MainWindow::loadSettings()
     port = settings.value("port", getCoinParams().default_port()).toInt();
     autoConnect = settings.value("autoconnect", false).toBool();
     resyncHeight = settings.value("resyncheight", 0).toInt();
+    showRefreshLatency = settings.value("showrefreshlatency", false).toBool();
 
     lastVaultDir = settings.value("lastvaultdir", getDefaultSettings().getDocumentDir()).toString();
 }
@@ -1823,6 +1853,7 @@ void MainWindow::saveSettings()
     settings.setValue("port", port);
     settings.setValue("autoconnect", autoConnect);
     settings.setValue("resyncheight", resyncHeight);
+    settings.setValue("showrefreshlatency", showRefreshLatency);
     settings.setValue("lastvaultdir", lastVaultDir);
 }
 
@@ -1835,7 +1866,9 @@ void MainWindow::clearSettings()
 
 void MainWindow::loadVault(const QString &fileName)
 {
+    vaultRefresher->setVault(NULL);
     accountModel->load(fileName);
+    vaultRefresher->setVault(accountModel->getVault());
     accountView->update();
     keychainModel->setVault(accountModel->getVault());
     keychainModel->update();
@@ -30,6 +30,9 @@ class TxView;
 
 class TxActions;
 
+class VaultRefresher;
+class LatencyOverlay;
+
 class RequestPaymentDialog;
 
 #include <CoinQ/CoinQ_netsync.h>
@@ -220,6 +223,7 @@ private:
     QMenu* accountMenu;
     QMenu* txMenu;
     QMenu* networkMenu;
+    QMenu* viewMenu;
     QMenu* helpMenu;
 
     // toolbars
@@ -290,6 +294,10 @@ private:
     QAction* stopResyncAction;
     QAction* networkSettingsAction;
 
+    // view actions
+    bool showRefreshLatency;
+    QAction* showRefreshLatencyAction;
+
     // network sync state
     network_state_t networkState;
 
@@ -316,6 +324,10 @@ private:
     // tab actions
     TxActions* txActions;
 
+    // background model refreshes
+    VaultRefresher* vaultRefresher;
+    LatencyOverlay* latencyOverlay;
+
     // models
     QItemSelectionModel* keychainSelectionModel;
     QItemSelectionModel* accountSelectionModel;
@@ -17,6 +17,7 @@
 #include "scriptview.h"
 
 #include <QVBoxLayout>
+#include <QLineEdit>
 
 ScriptDialog::ScriptDialog(CoinDB::Vault* vault, const QString& accountName, QWidget* parent)
     : QDialog(parent)
@@ -28,9 +29,15 @@ ScriptDialog::ScriptDialog(CoinDB::Vault* vault, const QString& accountName, QWi
 
     scriptView = new ScriptView(this);
     scriptView->setModel(scriptModel);
+    scriptView->setSortingEnabled(true);
     scriptView->update();
 
+    filterEdit = new QLineEdit(this);
+    filterEdit->setPlaceholderText(tr("Filter descriptions"));
+    connect(filterEdit, &QLineEdit::textChanged, [this](const QString& text) { scriptModel->setFilter(text); });
+
     QVBoxLayout* mainLayout = new QVBoxLayout();
+    mainLayout->addWidget(filterEdit);
     mainLayout->addWidget(scriptView);
     setLayout(mainLayout);
     setWindowTitle(getDefaultSettings().getAppName() + " - " + accountName + tr(" scripts"));
@@ -16,6 +16,8 @@
 class ScriptModel;
 class ScriptView;
 
+class QLineEdit;
+
 #include <QDialog>
 
 class ScriptDialog : public QDialog
@@ -26,6 +28,7 @@ public:
     ScriptDialog(CoinDB::Vault* vault, const QString& accountName, QWidget* parent = NULL);
 
 private:
+    QLineEdit* filterEdit;
     ScriptModel* scriptModel;
     ScriptView* scriptView;
 };
@@ -14,20 +14,20 @@
 
 #include <CoinQ/CoinQ_script.h>
 
-#include <QStandardItemModel>
-
 using namespace CoinDB;
 using namespace CoinQ::Script;
 using namespace std;
 
+const int SCRIPT_STATUS_FLAGS = SigningScript::CHANGE | SigningScript::ISSUED | SigningScript::USED;
+
 ScriptModel::ScriptModel(QObject* parent)
-    : QStandardItemModel(parent)
+    : QAbstractTableModel(parent), vault(NULL), sortKey(SCRIPT_SORT_DEFAULT), sortDescending(false)
 {
     initColumns();
 }
 
 ScriptModel::ScriptModel(CoinDB::Vault* vault, const QString& accountName, QObject* parent)
-    : QStandardItemModel(parent)
+    : QAbstractTableModel(parent), vault(NULL), sortKey(SCRIPT_SORT_DEFAULT), sortDescending(false)
 {
     initColumns();
     setVault(vault);
@@ -36,9 +36,7 @@ ScriptModel::ScriptModel(CoinDB::Vault* vault, const QString& accountName, QObje
 
 void ScriptModel::initColumns()
 {
-    QStringList columns;
     columns << tr("Address") << tr("Type") << tr("Description");
-    setHorizontalHeaderLabels(columns);
 }
 
 void ScriptModel::setVault(CoinDB::Vault* vault)
@@ -60,41 +58,113 @@ void ScriptModel::setAccount(const QString& accountName)
     this->accountName = accountName;
 }
 
+void ScriptModel::setFilter(const QString& filter)
+{
+    if (filter == this->filter) return;
+    this->filter = filter;
+    update();
+}
+
 void ScriptModel::update()
 {
-    removeRows(0, rowCount());
+    beginResetModel();
+    rows.clear();
+    next = SigningScriptViewCursor();
+    endResetModel();
 
     if (!vault || accountName.isEmpty()) return;
 
-    std::vector<SigningScriptView> scripts = vault->getSigningScriptViews(accountName.toStdString(), "", SigningScript::CHANGE | SigningScript::ISSUED | SigningScript::USED);
-    for (auto& script: scripts) {
-        QList<QStandardItem*> row;
-        QString address = QString::fromStdString(getAddressForTxOutScript(script.txoutscript, getDefaultSettings().getBase58Versions()));
-
-        QString type;
-        switch (script.status) {
-        case SigningScript::CHANGE:
-            type = tr("Change");
-            break;
+    // Later pages are fetched as the view scrolls.
+    fetchMore(QModelIndex());
+}
 
-        case SigningScript::ISSUED:
-            type = tr("Issued");
-            break;
+int ScriptModel::rowCount(const QModelIndex& parent) const
+{
+    return parent.isValid() ? 0 : rows.size();
+}
 
-        case SigningScript::USED:
-            type = tr("Used");
-            break;
+int ScriptModel::columnCount(const QModelIndex& parent) const
+{
+    return parent.isValid() ? 0 : COLUMN_COUNT;
+}
 
-        default:
-            type = tr("Unknown");
+QVariant ScriptModel::data(const QModelIndex& index, int role) const
+{
+    if (role != Qt::DisplayRole || !index.isValid() || index.row() >= (int)rows.size()) return QVariant();
+
+    const Row& row = rows[index.row()];
+    switch (index.column()) {
+    case COLUMN_ADDRESS:
+        return row.address;
+
+    case COLUMN_TYPE:
+        switch (row.status) {
+        case SigningScript::CHANGE: return tr("Change");
+        case SigningScript::ISSUED: return tr("Issued");
+        case SigningScript::USED:   return tr("Used");
+        default:                    return tr("Unknown");
         }
 
-        QString description = QString::fromStdString(script.label);
+    case COLUMN_DESCRIPTION:
+        return row.label;
 
-        row.append(new QStandardItem(address));
-        row.append(new QStandardItem(type));
-        row.append(new QStandardItem(description));
+    default:
+        return QVariant();
+    }
+}
+
+QVariant ScriptModel::headerData(int section, Qt::Orientation orientation, int role) const
+{
+    if (orientation == Qt::Horizontal && role == Qt::DisplayRole && section >= 0 && section < columns.size()) {
+        return columns[section];
+    }
+    return QAbstractTableModel::headerData(section, orientation, role);
+}
+
+Qt::ItemFlags ScriptModel::flags(const QModelIndex& /*index*/) const
+{
+    return Qt::ItemIsSelectable | Qt::ItemIsEnabled;
+}
+
+bool ScriptModel::canFetchMore(const QModelIndex& parent) const
+{
+    return !parent.isValid() && !next.isNull();
+}
+
+void ScriptModel::fetchMore(const QModelIndex& parent)
+{
+    if (parent.isValid() || !vault || accountName.isEmpty()) return;
+
+    // The page call resets next before reading after, so they cannot be the same object.
+    SigningScriptViewCursor after = next;
+    std::vector<SigningScriptView> scripts = vault->getSigningScriptViewsPage(after, PAGE_SIZE, next, accountName.toStdString(), "", SCRIPT_STATUS_FLAGS, sortKey, sortDescending, filter.toStdString());
+    if (scripts.empty()) return;
+
+    beginInsertRows(QModelIndex(), rows.size(), rows.size() + scripts.size() - 1);
+    for (auto& script: scripts) {
+        Row row;
+        row.address = QString::fromStdString(getAddressForTxOutScript(script.txoutscript, getDefaultSettings().getBase58Versions()));
+        row.status = script.status;
+        row.label = QString::fromStdString(script.label);
+        rows.push_back(row);
+    }
+    endInsertRows();
+}
+
+void ScriptModel::sort(int column, Qt::SortOrder order)
+{
+    // Addresses are hashes of the scripts, so there is no meaningful order for the database to sort them in.
+    // Issue order is used instead.
+    SigningScriptViewSort newSortKey;
+    switch (column) {
+    case COLUMN_TYPE:           newSortKey = SCRIPT_SORT_STATUS; break;
+    case COLUMN_DESCRIPTION:    newSortKey = SCRIPT_SORT_LABEL; break;
+    default:                    newSortKey = SCRIPT_SORT_INDEX; break;
+    }
+    bool newSortDescending = (order == Qt::DescendingOrder);
 
-        appendRow(row);
-    }    
+    if (newSortKey == sortKey && newSortDescending == sortDescending) return;
+    sortKey = newSortKey;
+    sortDescending = newSortDescending;
+    update();
 }
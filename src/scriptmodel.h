@@ -11,27 +11,66 @@
 #ifndef COINVAULT_SCRIPTMODEL_H
 #define COINVAULT_SCRIPTMODEL_H
 
-#include <QStandardItemModel>
+#include <QAbstractTableModel>
+#include <QStringList>
 
 #include <CoinDB/Vault.h>
 
-class ScriptModel : public QStandardItemModel
+#include <vector>
+
+// Rows are fetched from the vault a page at a time as the view scrolls. Sorting and filtering
+// are done by the vault query, so they restart the listing from the first page.
+class ScriptModel : public QAbstractTableModel
 {
     Q_OBJECT
 
 public:
+    enum {
+        COLUMN_ADDRESS,
+        COLUMN_TYPE,
+        COLUMN_DESCRIPTION,
+        COLUMN_COUNT
+    };
+
+    enum { PAGE_SIZE = 500 };
+
     ScriptModel(QObject* parent = NULL);
     ScriptModel(CoinDB::Vault* vault, const QString& accountName, QObject* parent = NULL);
 
     void setVault(CoinDB::Vault* vault);
     void setAccount(const QString& accountName);
+    void setFilter(const QString& filter); // only show scripts with descriptions containing filter
     void update();
 
+    // Overridden methods
+    int rowCount(const QModelIndex& parent = QModelIndex()) const;
+    int columnCount(const QModelIndex& parent = QModelIndex()) const;
+    QVariant data(const QModelIndex& index, int role = Qt::DisplayRole) const;
+    QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const;
+    Qt::ItemFlags flags(const QModelIndex& index) const;
+    bool canFetchMore(const QModelIndex& parent) const;
+    void fetchMore(const QModelIndex& parent);
+    void sort(int column, Qt::SortOrder order = Qt::AscendingOrder);
+
 private:
+    struct Row
+    {
+        QString address;
+        int status;
+        QString label;
+    };
+
     void initColumns();
 
+    std::vector<Row> rows;
+    CoinDB::SigningScriptViewCursor next; // null once the last page is fetched
+    QStringList columns;
+
     CoinDB::Vault* vault;
     QString accountName; // empty when not loaded
+    QString filter;
+    CoinDB::SigningScriptViewSort sortKey;
+    bool sortDescending;
 };
 
 #endif // COINVAULT_SCRIPTMODEL_H
@@ -17,6 +17,7 @@
 ScriptView::ScriptView(QWidget* parent)
     : QTreeView(parent), scriptModel(NULL)
 {
+    setUniformRowHeights(true);
 }
 
 void ScriptView::setModel(ScriptModel* model)
@@ -39,8 +39,7 @@ void TxActions::updateCurrentTx(const QModelIndex& current, const QModelIndex& /
 {
     currentRow = current.row();
     if (txModel && currentRow != -1) {
-        QStandardItem* typeItem = txModel->item(currentRow, 6);
-        int type = typeItem->data(Qt::UserRole).toInt();
+        int type = txModel->getTxStatus(currentRow);
         if (type == CoinDB::Tx::UNSIGNED) {
             signTxAction->setEnabled(true);
         }
@@ -54,7 +53,7 @@ void TxActions::updateCurrentTx(const QModelIndex& current, const QModelIndex& /
         }
         else {
             sendTxAction->setText(tr("Resend Transaction"));
-            sendTxAction->setEnabled(networkSync && networkSync->isConnected() && typeItem->text() == "0");
+            sendTxAction->setEnabled(networkSync && networkSync->isConnected() && type != CoinDB::Tx::UNSIGNED && txModel->getConfirmations(currentRow) == 0);
         }
 
         if (type == CoinDB::Tx::PROPAGATED || type == CoinDB::Tx::CONFIRMED) {
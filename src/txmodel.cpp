@@ -15,7 +15,6 @@
 
 #include <stdutils/stringutils.h>
 
-#include <QStandardItemModel>
 #include <QDateTime>
 #include <QMessageBox>
 
@@ -24,25 +23,21 @@
 
 #include "severitylogger.h"
 
+#include <algorithm>
+
 using namespace CoinDB;
 using namespace CoinQ::Script;
 using namespace std;
 
 TxModel::TxModel(QObject* parent)
-    : QStandardItemModel(parent)
+    : QAbstractTableModel(parent), feeTxId(0), totalValue(0), vault(NULL), bestHeight(0)
 {
-    base58_versions[0] = getCoinParams().pay_to_pubkey_hash_version();
-    base58_versions[1] = getCoinParams().pay_to_script_hash_version();
-
     initColumns();
 }
 
 TxModel::TxModel(CoinDB::Vault* vault, const QString& accountName, QObject* parent)
-    : QStandardItemModel(parent)
+    : QAbstractTableModel(parent), feeTxId(0), totalValue(0), vault(NULL), bestHeight(0)
 {
-    base58_versions[0] = getCoinParams().pay_to_pubkey_hash_version();
-    base58_versions[1] = getCoinParams().pay_to_script_hash_version();
-
     initColumns();
     setVault(vault);
     setAccount(accountName);
@@ -50,9 +45,7 @@ TxModel::TxModel(CoinDB::Vault* vault, const QString& accountName, QObject* pare
 
 void TxModel::initColumns()
 {
-    QStringList columns;
     columns << tr("Time") << tr("Description") << tr("Type") << tr("Amount") << tr("Fee") << tr("Balance") << tr("Confirmations") << tr("Address") << tr("Transaction Hash");
-    setHorizontalHeaderLabels(columns);
 }
 
 void TxModel::setVault(CoinDB::Vault* vault)
@@ -78,157 +71,372 @@ void TxModel::setAccount(const QString& accountName)
 
 void TxModel::update()
 {
-    removeRows(0, rowCount());
+    update(query(vault, accountName));
+}
 
-    if (!vault || accountName.isEmpty()) return;
+TxModel::SnapshotPtr TxModel::query(CoinDB::Vault* vault, const QString& accountName)
+{
+    std::shared_ptr<Snapshot> snapshot(new Snapshot());
+    snapshot->full = true;
+    snapshot->bestHeight = 0;
+    snapshot->feeTxId = 0;
+    snapshot->totalValue = 0;
+
+    if (!vault || accountName.isEmpty()) return snapshot;
 
     std::shared_ptr<BlockHeader> bestHeader = vault->getBestBlockHeader();
+    if (bestHeader) snapshot->bestHeight = bestHeader->height();
+
+    // A balance sums the values of every row below it, fetched or not, so the values are summed over the
+    // whole history. Rows are not built for this, and the sums per tx let updates to unfetched txs keep it exact.
+    std::string account = accountName.toStdString();
+    unsigned long sumFeeTxId = 0;
+    vault->visitTxOutViews([&](const TxOutView& view) {
+        bool feeCharged;
+        int64_t value = viewValue(view, sumFeeTxId, feeCharged);
+        snapshot->txValues[view.tx_id] += value;
+        snapshot->totalValue += value;
+        return true;
+    }, account, "", TxOut::ROLE_BOTH, TxOut::BOTH, Tx::ALL, true);
+
+    // The vault lists confirmed rows newest first, which is the order they are shown in, below the pending rows.
+    std::vector<Row>& rows = snapshot->rows;
+    unsigned long pendingFeeTxId = 0;
+    rows = loadRows(vault->getTxOutViews(account, "", TxOut::ROLE_BOTH, TxOut::BOTH, Tx::ALL & ~Tx::CONFIRMED, true), pendingFeeTxId);
+
+    std::vector<Row> confirmedRows = loadRows(vault->getTxOutViewsPage(TxOutViewCursor(), FETCH_SIZE, snapshot->next, account, "", TxOut::ROLE_BOTH, TxOut::BOTH, Tx::CONFIRMED, true), snapshot->feeTxId);
+    rows.insert(rows.end(), confirmedRows.begin(), confirmedRows.end());
+    setBalances(rows, 0, snapshot->totalValue);
+
+    return snapshot;
+}
 
-    std::vector<TxOutView> txoutviews = vault->getTxOutViews(accountName.toStdString(), "", TxOut::ROLE_BOTH, TxOut::BOTH, Tx::ALL, true);
-    bytes_t last_txhash;
-    typedef std::pair<unsigned long, uint32_t> sorting_info_t;
-    typedef std::pair<QList<QStandardItem*>, int64_t> value_row_t; // used to associate output values with rows for computing balance
-    typedef std::pair<sorting_info_t, value_row_t> sortable_row_t;
-    QList<sortable_row_t> rows;
-    for (auto& item: txoutviews) {
-        QList<QStandardItem*> row;
+TxModel::SnapshotPtr TxModel::queryTxs(CoinDB::Vault* vault, const QString& accountName, const std::vector<bytes_t>& txHashes, const std::vector<unsigned long>& txIds, uint32_t knownBestHeight)
+{
+    if (!vault || accountName.isEmpty()) return query(vault, accountName);
 
-        QDateTime utc;
-        utc.setTime_t(item.tx_timestamp);
-        QString time = utc.toLocalTime().toString();
+    std::shared_ptr<Snapshot> snapshot(new Snapshot());
+    snapshot->full = false;
+    snapshot->bestHeight = 0;
 
-        QString description = QString::fromStdString(item.role_label());
-        if (description.isEmpty()) description = "Not available";
+    std::shared_ptr<BlockHeader> bestHeader = vault->getBestBlockHeader();
+    if (bestHeader) snapshot->bestHeight = bestHeader->height();
+    if (snapshot->bestHeight < knownBestHeight) return query(vault, accountName);
 
-        // The type stuff is just to test the new db schema. It's all wrong, we're not going to use TxOutViews for this.
-        QString type;
-        QString amount;
-        QString fee;
-        int64_t value = 0;
-        bytes_t this_txhash = item.tx_status == Tx::UNSIGNED ? item.tx_unsigned_hash : item.tx_hash;
-        switch (item.role_flags) {
-        case TxOut::ROLE_NONE:
-            type = tr("None");
-            break;
-
-        case TxOut::ROLE_SENDER:
-            type = tr("Send");
-            amount = "-";
-            value -= item.value;
-            if (item.have_fee && item.fee > 0) {
-                if (this_txhash != last_txhash) {
-                    fee = "-";
-                    fee += QString::number(item.fee/100000000.0, 'g', 8);
-                    value -= item.fee;
-                    last_txhash = this_txhash;
-                }
-                else {
-                    fee = "||";
-                }
-            }
-            break;
+    std::vector<unsigned long> allTxIds(txIds);
+    for (auto& hash: txHashes) {
+        try {
+            allTxIds.push_back(vault->getTx(hash)->id());
+        }
+        catch (const TxNotFoundException& e) {
+            LOGGER(debug) << "TxModel::queryTxs - " << e.what() << std::endl;
+            return query(vault, accountName);
+        }
+    }
 
-        case TxOut::ROLE_RECEIVER:
-            type = tr("Receive");
-            amount = "+";
-            value += item.value;
-            break;
+    std::sort(allTxIds.begin(), allTxIds.end());
+    allTxIds.erase(std::unique(allTxIds.begin(), allTxIds.end()), allTxIds.end());
+    for (auto txId: allTxIds) {
+        unsigned long txFeeTxId = 0;
+        std::vector<Row> rows = loadRows(vault->getTxOutViewsForTx(txId, accountName.toStdString(), TxOut::ROLE_BOTH, true), txFeeTxId);
+        std::stable_sort(rows.begin(), rows.end(), &TxModel::rowLessThan);
+        snapshot->txs.push_back(std::make_pair(txId, rows));
+    }
 
-        default:
-            type = tr("Unknown");
-        }
+    return snapshot;
+}
 
-        amount += QString::number(item.value/100000000.0, 'g', 8);
+void TxModel::update(SnapshotPtr snapshot)
+{
+    if (snapshot->full) {
+        beginResetModel();
+        rows = snapshot->rows;
+        next = snapshot->next;
+        feeTxId = snapshot->feeTxId;
+        totalValue = snapshot->totalValue;
+        txValues = snapshot->txValues;
+        bestHeight = snapshot->bestHeight;
+        endResetModel();
+        return;
+    }
 
-        uint32_t nConfirmations = 0;
-        QString confirmations;
-        if (item.tx_status >= Tx::PROPAGATED) {
-            if (bestHeader && item.height) {
-                nConfirmations = bestHeader->height() + 1 - item.height;
-                confirmations = QString::number(nConfirmations);
-            }
-            else {
-                confirmations = "0";
+    for (auto& tx: snapshot->txs) {
+        applyTxRows(tx.first, tx.second);
+    }
+
+    if (snapshot->bestHeight != bestHeight) {
+        bestHeight = snapshot->bestHeight;
+        emitRowsChanged(0, rows.size() - 1, COLUMN_CONFIRMATIONS, COLUMN_CONFIRMATIONS);
+    }
+}
+
+void TxModel::updateTx(const bytes_t& hash)
+{
+    if (!vault || accountName.isEmpty()) return;
+
+    std::shared_ptr<Tx> tx;
+    try {
+        tx = vault->getTx(hash);
+    }
+    catch (const TxNotFoundException& e) {
+        LOGGER(debug) << "TxModel::updateTx - " << e.what() << std::endl;
+        update();
+        return;
+    }
+
+    updateTx(tx->id());
+}
+
+void TxModel::updateTx(unsigned long txId)
+{
+    if (!vault || accountName.isEmpty()) return;
+
+    unsigned long txFeeTxId = 0;
+    std::vector<Row> newRows = loadRows(vault->getTxOutViewsForTx(txId, accountName.toStdString(), TxOut::ROLE_BOTH, true), txFeeTxId);
+    std::stable_sort(newRows.begin(), newRows.end(), &TxModel::rowLessThan);
+    applyTxRows(txId, newRows);
+}
+
+void TxModel::applyTxRows(unsigned long txId, const std::vector<Row>& txRows)
+{
+    // The tx's old value is known even if its rows were never fetched, so the total stays exact.
+    int64_t value = 0;
+    for (auto& row: txRows) { value += row.value; }
+    TxValues::iterator it = txValues.find(txId);
+    totalValue += value - (it == txValues.end() ? 0 : it->second);
+    if (!txRows.empty())            { txValues[txId] = value; }
+    else if (it != txValues.end())  { txValues.erase(it); }
+
+    // Rows past the fetched confirmed rows are left for fetchMore, which reads them in order.
+    std::vector<Row> newRows;
+    for (auto& row: txRows) {
+        if (isFetched(row)) newRows.push_back(row);
+    }
+
+    std::vector<int> oldPositions;
+    for (int i = 0; i < (int)rows.size(); i++) {
+        if (rows[i].txId == txId) oldPositions.push_back(i);
+    }
+
+    if (oldPositions.empty() && newRows.empty()) {
+        updateBalances();
+        return;
+    }
+
+    // Status and label changes usually leave the rows where they are, so try updating them in place.
+    if (oldPositions.size() == newRows.size()) {
+        std::vector<Row> oldRows;
+        for (std::size_t k = 0; k < oldPositions.size(); k++) {
+            oldRows.push_back(rows[oldPositions[k]]);
+            rows[oldPositions[k]] = newRows[k];
+        }
+
+        bool sorted = true;
+        for (int i: oldPositions) {
+            if ((i > 0 && rowLessThan(rows[i], rows[i - 1])) || (i + 1 < (int)rows.size() && rowLessThan(rows[i + 1], rows[i]))) {
+                sorted = false;
+                break;
             }
         }
-        else if (item.tx_status == Tx::UNSIGNED) {
-            confirmations = tr("Unsigned");
+
+        if (sorted) {
+            emitRowsChanged(oldPositions.front(), oldPositions.back(), 0, COLUMN_COUNT - 1);
+            updateBalances();
+            return;
         }
-        else if (item.tx_status == Tx::UNSENT) {
-            confirmations = tr("Unsent");
+
+        for (std::size_t k = 0; k < oldPositions.size(); k++) {
+            rows[oldPositions[k]] = oldRows[k];
         }
-        QStandardItem* confirmationsItem = new QStandardItem(confirmations);
-        confirmationsItem->setData(item.tx_status, Qt::UserRole);
+    }
+
+    for (auto it = oldPositions.rbegin(); it != oldPositions.rend(); ++it) {
+        beginRemoveRows(QModelIndex(), *it, *it);
+        rows.erase(rows.begin() + *it);
+        endRemoveRows();
+    }
 
-        QString address = QString::fromStdString(getAddressForTxOutScript(item.script, base58_versions));
-        QString hash = QString::fromStdString(uchar_vector(this_txhash).getHex());
+    for (auto& row: newRows) {
+        int i = std::upper_bound(rows.begin(), rows.end(), row, &TxModel::rowLessThan) - rows.begin();
+        beginInsertRows(QModelIndex(), i, i);
+        rows.insert(rows.begin() + i, row);
+        endInsertRows();
+    }
 
-        row.append(new QStandardItem(time));
-        row.append(new QStandardItem(description));
-        row.append(new QStandardItem(type));
-        row.append(new QStandardItem(amount));
-        row.append(new QStandardItem(fee));
-        row.append(new QStandardItem("")); // placeholder for balance, once sorted
-        row.append(confirmationsItem);
-        row.append(new QStandardItem(address));
-        row.append(new QStandardItem(hash));
+    updateBalances();
+}
 
-        rows.append(std::make_pair(std::make_pair(item.tx_id, nConfirmations), std::make_pair(row, value)));
+int64_t TxModel::viewValue(const TxOutView& item, unsigned long& feeTxId, bool& feeCharged)
+{
+    feeCharged = false;
+    switch (item.role_flags) {
+    case TxOut::ROLE_SENDER: {
+        int64_t value = -(int64_t)item.value;
+        if (item.have_fee && item.fee > 0 && item.tx_id != feeTxId) {
+            value -= item.fee;
+            feeTxId = item.tx_id;
+            feeCharged = true;
+        }
+        return value;
     }
 
-    qSort(rows.begin(), rows.end(), [](const sortable_row_t& a, const sortable_row_t& b) {
-        sorting_info_t a_info = a.first;
-        sorting_info_t b_info = b.first;
+    case TxOut::ROLE_RECEIVER:
+        return item.value;
 
-        // if confirmation counts are equal
-        if (a_info.second == b_info.second) {
-            // if one value is positive and the other is negative, sort so that running balance remains positive
-            if (a.second.second < 0 && b.second.second > 0) return true;
-            if (a.second.second > 0 && b.second.second < 0) return false;
+    default:
+        return 0;
+    }
+}
 
-            // otherwise sort by descending index
-            return (a_info.first > b_info.first);
-        }
+std::vector<TxModel::Row> TxModel::loadRows(const std::vector<TxOutView>& views, unsigned long& feeTxId)
+{
+    unsigned char base58_versions[2];
+    base58_versions[0] = getCoinParams().pay_to_pubkey_hash_version();
+    base58_versions[1] = getCoinParams().pay_to_script_hash_version();
+
+    std::vector<Row> newRows;
+    newRows.reserve(views.size());
+
+    for (auto& item: views) {
+        Row row;
+        row.txId = item.tx_id;
+        row.txOutId = item.id;
+        row.timestamp = item.tx_timestamp;
+        row.status = item.tx_status;
+        row.roleFlags = item.role_flags;
+        row.amount = item.value;
+        row.fee = item.role_flags == TxOut::ROLE_SENDER && item.have_fee ? item.fee : 0;
+        row.value = viewValue(item, feeTxId, row.showFee);
+        row.balance = 0;
+        row.hash = item.tx_status == Tx::UNSIGNED ? item.tx_unsigned_hash : item.tx_hash;
+
+        // Only counted once propagated, as that is when the tx gets confirmations.
+        row.height = item.tx_status >= Tx::PROPAGATED ? item.height : 0;
+
+        row.description = QString::fromStdString(item.role_label());
+        if (row.description.isEmpty()) row.description = tr("Not available");
 
-        // otherwise sort by ascending confirmation count
-        return (a_info.second < b_info.second);
-    });
+        row.address = QString::fromStdString(getAddressForTxOutScript(item.script, base58_versions));
 
-    // iterate in reverse order to compute running balance
-    int64_t balance = 0;
-    for (int i = rows.size() - 1; i >= 0; i--) {
-        balance += rows[i].second.second;
-        (rows[i].second.first)[5]->setText(QString::number(balance/100000000.0, 'g', 8));
+        newRows.push_back(row);
     }
 
-    // iterate in forward order to display
-    for (auto& row: rows) appendRow(row.second.first);
+    return newRows;
 }
 
-void TxModel::signTx(int row)
+bool TxModel::rowLessThan(const Row& a, const Row& b)
 {
-    LOGGER(trace) << "TxModel::signTx(" << row << ")" << std::endl;
+    // Pending txs first, then confirmed ones. Each in the vault's page order, so fetched pages append in order:
+    // descending height, descending timestamp, descending tx id, then ascending txout id.
+    bool aConfirmed = (a.status == Tx::CONFIRMED);
+    bool bConfirmed = (b.status == Tx::CONFIRMED);
+    if (aConfirmed != bConfirmed) return bConfirmed;
+    if (a.height != b.height) return a.height > b.height;
+    if (a.timestamp != b.timestamp) return a.timestamp > b.timestamp;
+    if (a.txId != b.txId) return a.txId > b.txId;
+    return a.txOutId < b.txOutId;
+}
+
+bool TxModel::isFetched(const Row& row) const
+{
+    if (next.isNull() || row.status != Tx::CONFIRMED) return true;
 
-    if (row == -1 || row >= rowCount()) {
+    // At or before the last row fetched, in the vault's page order.
+    if (row.height != next.height) return row.height > next.height;
+    if (row.timestamp != next.timestamp) return row.timestamp > next.timestamp;
+    if (row.txId != next.tx_id) return row.txId > next.tx_id;
+    return row.txOutId <= next.id;
+}
+
+void TxModel::setBalances(std::vector<Row>& rows, std::size_t first, int64_t balance)
+{
+    for (std::size_t i = first; i < rows.size(); i++) {
+        rows[i].balance = balance;
+        balance -= rows[i].value;
+    }
+}
+
+uint32_t TxModel::rowConfirmations(const Row& row) const
+{
+    if (!row.height || !bestHeight) return 0;
+    return bestHeight + 1 - row.height;
+}
+
+QString TxModel::confirmationsText(const Row& row) const
+{
+    if (row.status >= Tx::PROPAGATED) {
+        return QString::number(rowConfirmations(row));
+    }
+    else if (row.status == Tx::UNSIGNED) {
+        return tr("Unsigned");
+    }
+    else if (row.status == Tx::UNSENT) {
+        return tr("Unsent");
+    }
+    return QString();
+}
+
+void TxModel::updateBalances()
+{
+    // Only rows above a change, or all of them if the change is below the fetched rows, get a new balance.
+    int lastRow = -1;
+    int64_t balance = totalValue;
+    for (int i = 0; i < (int)rows.size(); i++) {
+        if (rows[i].balance != balance) {
+            rows[i].balance = balance;
+            lastRow = i;
+        }
+        balance -= rows[i].value;
+    }
+    emitRowsChanged(0, lastRow, COLUMN_BALANCE, COLUMN_BALANCE);
+}
+
+void TxModel::emitRowsChanged(int firstRow, int lastRow, int firstColumn, int lastColumn)
+{
+    lastRow = std::min(lastRow, (int)rows.size() - 1);
+    if (firstRow > lastRow) return;
+    emit dataChanged(index(firstRow, firstColumn), index(lastRow, lastColumn));
+}
+
+void TxModel::checkRow(int row) const
+{
+    if (row < 0 || row >= (int)rows.size()) {
         throw std::runtime_error(tr("Invalid row.").toStdString());
     }
+}
 
-    QStandardItem* typeItem = item(row, 6);
-    int type = typeItem->data(Qt::UserRole).toInt();
-    if (type != CoinDB::Tx::UNSIGNED) {
+int TxModel::getTxStatus(int row) const
+{
+    checkRow(row);
+    return rows[row].status;
+}
+
+uint32_t TxModel::getConfirmations(int row) const
+{
+    checkRow(row);
+    return rowConfirmations(rows[row]);
+}
+
+bytes_t TxModel::getTxHash(int row) const
+{
+    checkRow(row);
+    return rows[row].hash;
+}
+
+void TxModel::signTx(int row)
+{
+    LOGGER(trace) << "TxModel::signTx(" << row << ")" << std::endl;
+
+    if (getTxStatus(row) != CoinDB::Tx::UNSIGNED) {
         throw std::runtime_error(tr("Transaction is already signed.").toStdString());
     }
 
-    QStandardItem* txHashItem = item(row, 8);
-    uchar_vector txhash;
-    txhash.setHex(txHashItem->text().toStdString());
-
     std::vector<std::string> keychainNames;
-    std::shared_ptr<Tx> tx = vault->signTx(txhash, keychainNames, true);
+    std::shared_ptr<Tx> tx = vault->signTx(rows[row].hash, keychainNames, true);
     if (!tx) throw std::runtime_error(tr("No new signatures were added.").toStdString());
 
     LOGGER(trace) << "TxModel::signTx - signature(s) added. raw tx: " << uchar_vector(tx->raw()).getHex() << std::endl;
-    update();
+    updateTx(tx->id());
 
     QString msg = tr("Signatures added using keychain(s) ") + QString::fromStdString(stdutils::delimited_list(keychainNames, ", ")) + tr(".");
     emit txSigned(msg);
@@ -236,16 +444,13 @@ void TxModel::signTx(int row)
 
 void TxModel::sendTx(int row, CoinQ::Network::NetworkSync* networkSync)
 {
-    if (row == -1 || row >= rowCount()) {
-        throw std::runtime_error(tr("Invalid row.").toStdString());
-    }
+    checkRow(row);
 
     if (!networkSync || !networkSync->isConnected()) {
         throw std::runtime_error(tr("Must be connected to network to send.").toStdString());
     }
 
-    QStandardItem* typeItem = item(row, 6);
-    int type = typeItem->data(Qt::UserRole).toInt();
+    int type = rows[row].status;
     if (type == CoinDB::Tx::UNSIGNED) {
         throw std::runtime_error(tr("Transaction must be fully signed before sending.").toStdString());
     }
@@ -253,11 +458,7 @@ void TxModel::sendTx(int row, CoinQ::Network::NetworkSync* networkSync)
         throw std::runtime_error(tr("Transaction already sent.").toStdString());
     }
 
-    QStandardItem* txHashItem = item(row, 8);
-    uchar_vector txhash;
-    txhash.setHex(txHashItem->text().toStdString());
-
-    std::shared_ptr<CoinDB::Tx> tx = vault->getTx(txhash);
+    std::shared_ptr<CoinDB::Tx> tx = vault->getTx(rows[row].hash);
     Coin::Transaction coin_tx = tx->toCoinCore();
     networkSync->sendTx(coin_tx);
 
@@ -265,48 +466,103 @@ void TxModel::sendTx(int row, CoinQ::Network::NetworkSync* networkSync)
     tx->updateStatus(CoinDB::Tx::PROPAGATED);
     vault->insertTx(tx);
 
-    update();
+    updateTx(tx->id());
 //    networkSync->getTx(txhash);
 }
 
 std::shared_ptr<Tx> TxModel::getTx(int row)
 {
-    if (row == -1 || row >= rowCount()) {
-        throw std::runtime_error(tr("Invalid row.").toStdString());
-    }
-
-    QStandardItem* txHashItem = item(row, 8);
-    uchar_vector txhash;
-    txhash.setHex(txHashItem->text().toStdString());
-
-    return vault->getTx(txhash);
+    checkRow(row);
+    return vault->getTx(rows[row].hash);
 }
 
 void TxModel::deleteTx(int row)
 {
-    if (row == -1 || row >= rowCount()) {
-        throw std::runtime_error(tr("Invalid row.").toStdString());
-    }
-
-    QStandardItem* txHashItem = item(row, 8);
-    uchar_vector txhash;
-    txhash.setHex(txHashItem->text().toStdString());
+    checkRow(row);
 
-    vault->deleteTx(txhash);
+    // Txs that spend this one are deleted with it, so reload everything.
+    vault->deleteTx(rows[row].hash);
     update();
 
     emit txDeleted();
 }
 
+int TxModel::rowCount(const QModelIndex& parent) const
+{
+    return parent.isValid() ? 0 : (int)rows.size();
+}
+
+int TxModel::columnCount(const QModelIndex& parent) const
+{
+    return parent.isValid() ? 0 : COLUMN_COUNT;
+}
+
 QVariant TxModel::data(const QModelIndex& index, int role) const
 {
+    if (!index.isValid() || index.row() >= (int)rows.size()) return QVariant();
+
     // Right-align numeric fields
-    if (role == Qt::TextAlignmentRole && index.column() >= 3 && index.column() <= 6) {
-        return Qt::AlignRight;
+    if (role == Qt::TextAlignmentRole) {
+        if (index.column() >= COLUMN_AMOUNT && index.column() <= COLUMN_CONFIRMATIONS) return Qt::AlignRight;
+        return QVariant();
+    }
+
+    if (role != Qt::DisplayRole) return QVariant();
+
+    const Row& row = rows[index.row()];
+    switch (index.column()) {
+    case COLUMN_TIME: {
+        QDateTime utc;
+        utc.setTime_t(row.timestamp);
+        return utc.toLocalTime().toString();
+    }
+
+    case COLUMN_DESCRIPTION:
+        return row.description;
+
+    case COLUMN_TYPE:
+        switch (row.roleFlags) {
+        case TxOut::ROLE_NONE:      return tr("None");
+        case TxOut::ROLE_SENDER:    return tr("Send");
+        case TxOut::ROLE_RECEIVER:  return tr("Receive");
+        default:                    return tr("Unknown");
+        }
+
+    case COLUMN_AMOUNT: {
+        QString amount;
+        if (row.roleFlags == TxOut::ROLE_SENDER)        amount = "-";
+        else if (row.roleFlags == TxOut::ROLE_RECEIVER) amount = "+";
+        return amount + QString::number(row.amount/100000000.0, 'g', 8);
+    }
+
+    case COLUMN_FEE:
+        if (row.fee == 0) return QString();
+        if (!row.showFee) return QString("||");
+        return QString("-") + QString::number(row.fee/100000000.0, 'g', 8);
+
+    case COLUMN_BALANCE:
+        return QString::number(row.balance/100000000.0, 'g', 8);
+
+    case COLUMN_CONFIRMATIONS:
+        return confirmationsText(row);
+
+    case COLUMN_ADDRESS:
+        return row.address;
+
+    case COLUMN_HASH:
+        return QString::fromStdString(uchar_vector(row.hash).getHex());
+
+    default:
+        return QVariant();
     }
-    else {
-        return QStandardItemModel::data(index, role);
+}
+
+QVariant TxModel::headerData(int section, Qt::Orientation orientation, int role) const
+{
+    if (orientation == Qt::Horizontal && role == Qt::DisplayRole && section >= 0 && section < columns.size()) {
+        return columns[section];
     }
+    return QAbstractTableModel::headerData(section, orientation, role);
 }
 
 Qt::ItemFlags TxModel::flags(const QModelIndex& /*index*/) const
@@ -314,3 +570,23 @@ Qt::ItemFlags TxModel::flags(const QModelIndex& /*index*/) const
     return Qt::ItemIsSelectable | Qt::ItemIsEnabled;
 }
 
+bool TxModel::canFetchMore(const QModelIndex& parent) const
+{
+    return !parent.isValid() && !next.isNull();
+}
+
+void TxModel::fetchMore(const QModelIndex& parent)
+{
+    if (parent.isValid() || !vault || accountName.isEmpty() || next.isNull()) return;
+
+    // The page call resets next before reading after, so they cannot be the same object.
+    TxOutViewCursor after = next;
+    std::vector<Row> newRows = loadRows(vault->getTxOutViewsPage(after, FETCH_SIZE, next, accountName.toStdString(), "", TxOut::ROLE_BOTH, TxOut::BOTH, Tx::CONFIRMED, true), feeTxId);
+    if (newRows.empty()) return;
+
+    setBalances(newRows, 0, rows.empty() ? totalValue : rows.back().balance - rows.back().value);
+
+    beginInsertRows(QModelIndex(), rows.size(), rows.size() + newRows.size() - 1);
+    rows.insert(rows.end(), newRows.begin(), newRows.end());
+    endInsertRows();
+}
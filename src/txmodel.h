@@ -11,50 +11,158 @@
 #ifndef COINVAULT_TXMODEL_H
 #define COINVAULT_TXMODEL_H
 
-#include <QStandardItemModel>
+#include <QAbstractTableModel>
+#include <QStringList>
 
 #include <CoinDB/Vault.h>
 
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
 namespace CoinQ {
     namespace Network {
         class NetworkSync;
     }
 }
 
-class TxModel : public QStandardItemModel
+class TxModel : public QAbstractTableModel
 {
     Q_OBJECT
 
 public:
+    enum {
+        COLUMN_TIME,
+        COLUMN_DESCRIPTION,
+        COLUMN_TYPE,
+        COLUMN_AMOUNT,
+        COLUMN_FEE,
+        COLUMN_BALANCE,
+        COLUMN_CONFIRMATIONS,
+        COLUMN_ADDRESS,
+        COLUMN_HASH,
+        COLUMN_COUNT
+    };
+
+    // Pending txs are few, so their rows are loaded at once. Confirmed rows are read from the vault this many
+    // at a time as views scroll, newest first, so huge accounts are not loaded or laid out all at once.
+    enum { FETCH_SIZE = 1000 };
+
+    struct Snapshot;
+    typedef std::shared_ptr<const Snapshot> SnapshotPtr;
+
     TxModel(QObject* parent = NULL);
     TxModel(CoinDB::Vault* vault, const QString& accountName, QObject* parent = NULL);
 
     void setVault(CoinDB::Vault* vault);
     void setAccount(const QString& accountName);
+
+    // Reloads all rows.
     void update();
 
+    // The queries behind update() and updateTx(), for running on another thread. They only touch the vault.
+    // query loads the pending rows and the first page of confirmed rows.
+    // queryTxs reloads the given txs, by hash and by id. It returns a full snapshot if a tx cannot be found
+    // or the best height went below knownBestHeight.
+    static SnapshotPtr query(CoinDB::Vault* vault, const QString& accountName);
+    static SnapshotPtr queryTxs(CoinDB::Vault* vault, const QString& accountName, const std::vector<bytes_t>& txHashes, const std::vector<unsigned long>& txIds, uint32_t knownBestHeight);
+
+    // Applies a snapshot taken for the current vault and account.
+    void update(SnapshotPtr snapshot);
+
+    // Refresh only the rows of one tx, inserting, updating or removing them as needed.
+    // Falls back to update() if the tx cannot be found.
+    void updateTx(const bytes_t& hash);
+    void updateTx(unsigned long txId);
+
     void signTx(int row);
     void sendTx(int row, CoinQ::Network::NetworkSync* networkSync);
     std::shared_ptr<CoinDB::Tx> getTx(int row);
     void deleteTx(int row);
 
+    const QString& getAccountName() const { return accountName; }
+    uint32_t getBestHeight() const { return bestHeight; }
+
+    int getTxStatus(int row) const;
+    uint32_t getConfirmations(int row) const; // 0 if unconfirmed
+    bytes_t getTxHash(int row) const;
+
     // Overridden methods
+    int rowCount(const QModelIndex& parent = QModelIndex()) const;
+    int columnCount(const QModelIndex& parent = QModelIndex()) const;
     QVariant data(const QModelIndex& index, int role = Qt::DisplayRole) const;
+    QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const;
     Qt::ItemFlags flags(const QModelIndex& index) const;
+    bool canFetchMore(const QModelIndex& parent) const;
+    void fetchMore(const QModelIndex& parent);
 
 signals:
     void txSigned(const QString& keychainNames);
     void txDeleted();
 
 private:
-    unsigned char base58_versions[2];
+    // One row per txout view. Display strings that are costly to build are made once, the rest in data().
+    struct Row
+    {
+        unsigned long txId;
+        unsigned long txOutId;
+        uint32_t timestamp;
+        uint32_t height;        // 0 if unconfirmed
+        int status;
+        int roleFlags;
+        uint64_t amount;
+        uint64_t fee;
+        bool showFee;           // false for the tx's other send rows, which show "||" instead
+        int64_t value;          // change to the balance
+        int64_t balance;        // sum of value over this row and all rows below it, fetched or not
+        bytes_t hash;
+        QString description;
+        QString address;
+    };
+
+public:
+    typedef std::unordered_map<unsigned long, int64_t> TxValues;
+
+    struct Snapshot
+    {
+        bool full;                  // rows replaces the whole table, otherwise only the txs listed are replaced
+        uint32_t bestHeight;
+        std::vector<Row> rows;      // sorted, with balances
+        CoinDB::TxOutViewCursor next; // where the next page of confirmed rows starts, null if none follows
+        unsigned long feeTxId;      // tx last charged a fee, which may continue on the next page
+        int64_t totalValue;         // sum of value over every row, fetched or not
+        TxValues txValues;          // sum of value over the rows of each tx, fetched or not
+        std::vector<std::pair<unsigned long, std::vector<Row>>> txs;
+    };
 
+private:
     void initColumns();
 
+    // The fee is charged to the first send row of a tx. feeTxId is the tx charged last, so a tx split over two pages is charged once.
+    static int64_t viewValue(const CoinDB::TxOutView& view, unsigned long& feeTxId, bool& feeCharged);
+    static std::vector<Row> loadRows(const std::vector<CoinDB::TxOutView>& views, unsigned long& feeTxId);
+    static bool rowLessThan(const Row& a, const Row& b);
+    static void setBalances(std::vector<Row>& rows, std::size_t first, int64_t balance);
+    bool isFetched(const Row& row) const; // false if the row comes after the fetched confirmed rows
+    void applyTxRows(unsigned long txId, const std::vector<Row>& newRows);
+    uint32_t rowConfirmations(const Row& row) const;
+    QString confirmationsText(const Row& row) const;
+    void checkRow(int row) const;
+    void emitRowsChanged(int firstRow, int lastRow, int firstColumn, int lastColumn); // clipped to the rows
+
+    // Recomputes the balances from the total down and announces the rows whose balance changed.
+    void updateBalances();
+
+    std::vector<Row> rows; // pending rows, then confirmed rows up to next
+    CoinDB::TxOutViewCursor next;
+    unsigned long feeTxId;
+    int64_t totalValue;
+    TxValues txValues;
+    QStringList columns;
+
     CoinDB::Vault* vault;
     QString accountName; // empty when not loaded
-    uint64_t confirmedBalance;
-    uint64_t pendingBalance;
+    uint32_t bestHeight; // 0 if no headers
 };
 
 #endif // COINVAULT_TXMODEL_H
@@ -17,6 +17,8 @@
 TxView::TxView(QWidget* parent)
     : QTreeView(parent), accountHistoryModel(NULL), menu(NULL)
 {
+    // Rows are fetched lazily, so let the view skip measuring each one.
+    setUniformRowHeights(true);
 }
 
 void TxView::setModel(TxModel* model)
@@ -0,0 +1,216 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// CoinVault
+//
+// vaultrefresher.cpp
+//
+// Copyright (c) 2013 Eric Lombrozo
+//
+// All Rights Reserved.
+
+#include "vaultrefresher.h"
+
+#include <QMutexLocker>
+
+#include "severitylogger.h"
+
+using namespace CoinDB;
+using namespace std;
+
+void VaultRefreshWorker::run(VaultRefreshRequestPtr request)
+{
+    emit finished(refresher->query(*request));
+}
+
+VaultRefresher::VaultRefresher(AccountModel* accountModel, KeychainModel* keychainModel, TxModel* txModel, QObject* parent)
+    : QObject(parent),
+    accountModel(accountModel),
+    keychainModel(keychainModel),
+    txModel(txModel),
+    vault(NULL),
+    generation(0),
+    busy(false),
+    pendingFlags(0),
+    pendingBlocks(false),
+    pendingRequests(0),
+    burstStartMs(0),
+    inFlightRequests(0),
+    inFlightBurstStartMs(0)
+{
+    qRegisterMetaType<VaultRefreshRequestPtr>("VaultRefreshRequestPtr");
+    qRegisterMetaType<VaultRefreshResultPtr>("VaultRefreshResultPtr");
+    qRegisterMetaType<VaultTxIds>("VaultTxIds");
+
+    clock.start();
+
+    timer.setSingleShot(true);
+    timer.setInterval(FRAME_INTERVAL_MS);
+    connect(&timer, SIGNAL(timeout()), this, SLOT(flush()));
+
+    // The vault is still locked while it emits, so the batch is only queued here.
+    connect(this, SIGNAL(vaultTxsChanged(unsigned int, VaultTxIds)), this, SLOT(requestTxBatchRefresh(unsigned int, VaultTxIds)), Qt::QueuedConnection);
+
+    worker = new VaultRefreshWorker(this);
+    worker->moveToThread(&thread);
+    connect(&thread, SIGNAL(finished()), worker, SLOT(deleteLater()));
+    connect(worker, SIGNAL(finished(VaultRefreshResultPtr)), this, SLOT(apply(VaultRefreshResultPtr)));
+    thread.start();
+}
+
+VaultRefresher::~VaultRefresher()
+{
+    thread.quit();
+    thread.wait();
+}
+
+void VaultRefresher::setVault(CoinDB::Vault* vault)
+{
+    {
+        QMutexLocker lock(&vaultMutex);
+        if (this->vault) this->vault->unsubscribeTxBatch(txBatchConnection);
+        this->vault = vault;
+        generation++;
+    }
+
+    if (vault) {
+        unsigned int batchGeneration = generation;
+        txBatchConnection = vault->subscribeTxBatch([this, batchGeneration](const TxBatch& batch) {
+            VaultTxIds txIds(batch.inserted);
+            for (auto& delta: batch.status_changed) txIds.push_back(delta.tx_id);
+            emit vaultTxsChanged(batchGeneration, txIds);
+        });
+    }
+
+    pendingFlags = 0;
+    pendingTxHashes.clear();
+    pendingTxIds.clear();
+    pendingBlocks = false;
+    pendingRequests = 0;
+}
+
+void VaultRefresher::requestRefresh(int flags)
+{
+    pendingFlags |= flags;
+    schedule();
+}
+
+void VaultRefresher::requestTxRefresh(const bytes_t& hash)
+{
+    pendingFlags |= ACCOUNTS;
+    if (pendingTxHashes.size() < MAX_TX_DELTAS) {
+        pendingTxHashes.push_back(hash);
+    }
+    else {
+        pendingFlags |= TXS;
+    }
+    schedule();
+}
+
+void VaultRefresher::requestTxBatchRefresh(unsigned int generation, VaultTxIds txIds)
+{
+    // Batches from a vault that has since been closed are dropped.
+    if (generation != this->generation) return;
+
+    pendingFlags |= ACCOUNTS;
+    if (pendingTxHashes.size() + pendingTxIds.size() + txIds.size() <= MAX_TX_DELTAS) {
+        pendingTxIds.insert(pendingTxIds.end(), txIds.begin(), txIds.end());
+    }
+    else {
+        pendingFlags |= TXS;
+    }
+    schedule();
+}
+
+void VaultRefresher::requestBlockRefresh()
+{
+    pendingFlags |= ACCOUNTS;
+    pendingBlocks = true;
+    schedule();
+}
+
+void VaultRefresher::schedule()
+{
+    if (pendingRequests++ == 0) burstStartMs = clock.elapsed();
+    if (!busy && !timer.isActive()) timer.start();
+}
+
+void VaultRefresher::flush()
+{
+    if (busy || pendingRequests == 0) return;
+
+    std::shared_ptr<VaultRefreshRequest> request(new VaultRefreshRequest());
+    request->generation = generation;
+    request->flags = pendingFlags;
+    request->accountName = txModel->getAccountName();
+    request->knownBestHeight = txModel->getBestHeight();
+    request->newBlocks = pendingBlocks;
+    if (!(pendingFlags & TXS)) {
+        request->txHashes.swap(pendingTxHashes);
+        request->txIds.swap(pendingTxIds);
+    }
+
+    inFlightRequests = pendingRequests;
+    inFlightBurstStartMs = burstStartMs;
+
+    pendingFlags = 0;
+    pendingTxHashes.clear();
+    pendingTxIds.clear();
+    pendingBlocks = false;
+    pendingRequests = 0;
+
+    busy = true;
+    QMetaObject::invokeMethod(worker, "run", Qt::QueuedConnection, Q_ARG(VaultRefreshRequestPtr, request));
+}
+
+VaultRefreshResultPtr VaultRefresher::query(const VaultRefreshRequest& request)
+{
+    std::shared_ptr<VaultRefreshResult> result(new VaultRefreshResult());
+    result->generation = request.generation;
+    result->accountName = request.accountName;
+
+    QElapsedTimer queryClock;
+    queryClock.start();
+
+    try {
+        QMutexLocker lock(&vaultMutex);
+        if (request.generation == generation) {
+            if (request.flags & ACCOUNTS)   { result->accounts = AccountModel::query(vault); }
+            if (request.flags & KEYCHAINS)  { result->keychains = KeychainModel::query(vault); }
+            if (request.flags & TXS) {
+                result->txs = TxModel::query(vault, request.accountName);
+            }
+            else if (!request.txHashes.empty() || !request.txIds.empty() || request.newBlocks) {
+                result->txs = TxModel::queryTxs(vault, request.accountName, request.txHashes, request.txIds, request.knownBestHeight);
+            }
+        }
+    }
+    catch (const std::exception& e) {
+        LOGGER(error) << "VaultRefresher::query - " << e.what() << std::endl;
+        result->accounts.reset();
+        result->keychains.reset();
+        result->txs.reset();
+    }
+
+    result->queryMs = queryClock.elapsed();
+    return result;
+}
+
+void VaultRefresher::apply(VaultRefreshResultPtr result)
+{
+    busy = false;
+
+    // Results for a vault that has since been closed are dropped, as are tx rows for another account.
+    if (result->generation == generation) {
+        QElapsedTimer applyClock;
+        applyClock.start();
+
+        if (result->accounts)   { accountModel->update(result->accounts); }
+        if (result->keychains)  { keychainModel->update(result->keychains); }
+        if (result->txs && result->accountName == txModel->getAccountName()) { txModel->update(result->txs); }
+
+        int applyMs = applyClock.elapsed();
+        emit refreshed(clock.elapsed() - inFlightBurstStartMs, result->queryMs, applyMs, inFlightRequests);
+    }
+
+    if (pendingRequests > 0) timer.start();
+}
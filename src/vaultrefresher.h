@@ -0,0 +1,158 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// CoinVault
+//
+// vaultrefresher.h
+//
+// Copyright (c) 2013 Eric Lombrozo
+//
+// All Rights Reserved.
+
+#ifndef COINVAULT_VAULTREFRESHER_H
+#define COINVAULT_VAULTREFRESHER_H
+
+#include "accountmodel.h"
+#include "keychainmodel.h"
+#include "txmodel.h"
+
+#include <QObject>
+#include <QMutex>
+#include <QThread>
+#include <QTimer>
+#include <QElapsedTimer>
+
+#include <memory>
+#include <vector>
+
+struct VaultRefreshRequest
+{
+    unsigned int generation;
+    int flags;
+    QString accountName;
+    std::vector<bytes_t> txHashes;
+    std::vector<unsigned long> txIds;
+    uint32_t knownBestHeight;
+    bool newBlocks;
+};
+typedef std::shared_ptr<const VaultRefreshRequest> VaultRefreshRequestPtr;
+
+struct VaultRefreshResult
+{
+    unsigned int generation;
+    QString accountName;
+    AccountModel::SnapshotPtr accounts;     // null if not queried
+    KeychainModel::SnapshotPtr keychains;   // null if not queried
+    TxModel::SnapshotPtr txs;               // null if not queried
+    qint64 queryMs;
+};
+typedef std::shared_ptr<const VaultRefreshResult> VaultRefreshResultPtr;
+
+typedef std::vector<unsigned long> VaultTxIds;
+
+Q_DECLARE_METATYPE(VaultRefreshRequestPtr)
+Q_DECLARE_METATYPE(VaultRefreshResultPtr)
+Q_DECLARE_METATYPE(VaultTxIds)
+
+class VaultRefresher;
+
+class VaultRefreshWorker : public QObject
+{
+    Q_OBJECT
+
+public:
+    VaultRefreshWorker(VaultRefresher* refresher) : refresher(refresher) { }
+
+public slots:
+    void run(VaultRefreshRequestPtr request);
+
+signals:
+    void finished(VaultRefreshResultPtr result);
+
+private:
+    VaultRefresher* refresher;
+};
+
+// Runs model queries on a background thread so the UI thread never waits on the vault while the
+// network thread is inserting into it. Requests are coalesced, with at most one refresh started per
+// frame interval and only one query in flight. Results are applied to the models on the UI thread
+// as immutable snapshots. Txs the vault inserts or changes are taken from its batch signal, so
+// only their rows are reloaded.
+//
+// All methods must be called on the UI thread.
+class VaultRefresher : public QObject
+{
+    Q_OBJECT
+
+public:
+    enum {
+        ACCOUNTS    = 1,
+        KEYCHAINS   = 1 << 1,
+        TXS         = 1 << 2,        // reload all rows rather than only changed txs
+        ALL         = (1 << 3) - 1
+    };
+
+    enum { FRAME_INTERVAL_MS = 16 };
+
+    // More changed txs than this in one refresh reloads the whole table instead.
+    enum { MAX_TX_DELTAS = 256 };
+
+    VaultRefresher(AccountModel* accountModel, KeychainModel* keychainModel, TxModel* txModel, QObject* parent = NULL);
+    ~VaultRefresher();
+
+    // Waits for a query in flight to finish, so the old vault can be deleted once this returns.
+    // Results of queries on the old vault are dropped.
+    void setVault(CoinDB::Vault* vault);
+
+public slots:
+    void requestRefresh(int flags = ALL);
+    void requestTxRefresh(const bytes_t& hash);
+    void requestBlockRefresh();
+
+signals:
+    // latencyMs is from the first coalesced request to the models being updated.
+    void refreshed(int latencyMs, int queryMs, int applyMs, int requests);
+
+    // Emitted on the thread writing to the vault.
+    void vaultTxsChanged(unsigned int generation, VaultTxIds txIds);
+
+private slots:
+    void requestTxBatchRefresh(unsigned int generation, VaultTxIds txIds);
+    void flush();
+    void apply(VaultRefreshResultPtr result);
+
+private:
+    friend class VaultRefreshWorker;
+
+    // Runs on the worker thread.
+    VaultRefreshResultPtr query(const VaultRefreshRequest& request);
+
+    void schedule();
+
+    AccountModel* accountModel;
+    KeychainModel* keychainModel;
+    TxModel* txModel;
+
+    QThread thread;
+    VaultRefreshWorker* worker;
+
+    QMutex vaultMutex; // held while querying and while changing vaults
+    CoinDB::Vault* vault;
+    unsigned int generation;
+    Signals::Connection txBatchConnection;
+
+    QTimer timer;
+    QElapsedTimer clock;
+    bool busy;
+
+    int pendingFlags;
+    std::vector<bytes_t> pendingTxHashes;
+    std::vector<unsigned long> pendingTxIds;
+    bool pendingBlocks;
+    int pendingRequests;
+    qint64 burstStartMs;
+
+    int inFlightRequests;
+    qint64 inFlightBurstStartMs;
+};
+
+#endif // COINVAULT_VAULTREFRESHER_H
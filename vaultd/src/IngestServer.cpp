@@ -0,0 +1,372 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// IngestServer.cpp
+//
+// Copyright (c) 2014 Eric Lombrozo
+//
+// All Rights Reserved.
+//
+// vaultd - binary batch insertion of raw transactions and merkle blocks
+//
+
+#define LOGGER_SUBSYSTEM "vaultd"
+
+#include "IngestServer.h"
+
+#include <logger.h>
+
+#include <stdexcept>
+
+#if defined(BOOST_ASIO_HAS_LOCAL_SOCKETS)
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace CoinDB;
+
+enum
+{
+    ITEM_TX = 1,
+    ITEM_MERKLEBLOCK = 2
+};
+
+enum
+{
+    REQUEST_OK = 0,
+    REQUEST_FAILED = 1
+};
+
+// Reads little-endian fields, throwing if the frame ends early.
+class FrameReader
+{
+public:
+    explicit FrameReader(const std::string& data) : m_data(data), m_pos(0) { }
+
+    uint8_t u8()
+    {
+        require(1);
+        return (uint8_t)m_data[m_pos++];
+    }
+
+    uint16_t u16()
+    {
+        uint16_t n = u8();
+        return n | ((uint16_t)u8() << 8);
+    }
+
+    uint32_t u32()
+    {
+        uint32_t n = u16();
+        return n | ((uint32_t)u16() << 16);
+    }
+
+    std::string bytes(std::size_t length)
+    {
+        require(length);
+        std::string data(m_data, m_pos, length);
+        m_pos += length;
+        return data;
+    }
+
+    std::size_t remaining() const { return m_data.size() - m_pos; }
+
+private:
+    void require(std::size_t length) const
+    {
+        if (m_data.size() - m_pos < length) throw std::runtime_error("Truncated request.");
+    }
+
+    const std::string& m_data;
+    std::size_t m_pos;
+};
+
+static void writeU8(std::string& frame, uint8_t n)
+{
+    frame += (char)n;
+}
+
+static void writeU16(std::string& frame, uint16_t n)
+{
+    writeU8(frame, n & 0xff);
+    writeU8(frame, n >> 8);
+}
+
+static void writeU32(std::string& frame, uint32_t n)
+{
+    writeU16(frame, n & 0xffff);
+    writeU16(frame, n >> 16);
+}
+
+static void writeString(std::string& frame, const std::string& s)
+{
+    std::size_t length = std::min<std::size_t>(s.size(), 0xffff);
+    writeU16(frame, length);
+    frame.append(s, 0, length);
+}
+
+#if defined(BOOST_ASIO_HAS_LOCAL_SOCKETS)
+class IngestServer::Connection : public std::enable_shared_from_this<IngestServer::Connection>
+{
+public:
+    explicit Connection(IngestServer& server) : m_server(server), m_socket(server.m_io) { }
+
+    boost::asio::local::stream_protocol::socket& socket() { return m_socket; }
+
+    void start() { readHeader(); }
+
+    void close()
+    {
+        boost::system::error_code ec;
+        m_socket.close(ec);
+    }
+
+private:
+    void readHeader()
+    {
+        connection_ptr_t self(shared_from_this());
+        boost::asio::async_read(m_socket, boost::asio::buffer(m_header), [this, self](const boost::system::error_code& ec, std::size_t /*bytes*/)
+        {
+            if (ec)
+            {
+                m_server.removeConnection(self);
+                return;
+            }
+
+            uint32_t length = m_header[0] | (m_header[1] << 8) | (m_header[2] << 16) | ((uint32_t)m_header[3] << 24);
+            if (length > MAX_FRAME_SIZE)
+            {
+                LOGGER(error) << "IngestServer - closing connection after frame of " << length << " bytes." << std::endl;
+                m_server.removeConnection(self);
+                return;
+            }
+
+            m_request.resize(length);
+            readRequest();
+        });
+    }
+
+    void readRequest()
+    {
+        connection_ptr_t self(shared_from_this());
+        boost::asio::async_read(m_socket, boost::asio::buffer(&m_request[0], m_request.size()), [this, self](const boost::system::error_code& ec, std::size_t /*bytes*/)
+        {
+            if (ec)
+            {
+                m_server.removeConnection(self);
+                return;
+            }
+
+            std::string response = m_server.processRequest(m_request);
+            m_response.clear();
+            writeU32(m_response, response.size());
+            m_response += response;
+            writeResponse();
+        });
+    }
+
+    void writeResponse()
+    {
+        connection_ptr_t self(shared_from_this());
+        boost::asio::async_write(m_socket, boost::asio::buffer(m_response), [this, self](const boost::system::error_code& ec, std::size_t /*bytes*/)
+        {
+            if (ec)
+            {
+                m_server.removeConnection(self);
+                return;
+            }
+
+            readHeader();
+        });
+    }
+
+    IngestServer& m_server;
+    boost::asio::local::stream_protocol::socket m_socket;
+    unsigned char m_header[4];
+    std::string m_request;
+    std::string m_response;
+};
+#else
+class IngestServer::Connection
+{
+public:
+    void close() { }
+};
+#endif
+
+IngestServer::IngestServer(const std::string& path, vault_callback_t vaultCallback) :
+    m_path(path),
+    m_vaultCallback(vaultCallback),
+    m_bRunning(false)
+{
+}
+
+IngestServer::~IngestServer()
+{
+    stop();
+}
+
+void IngestServer::start()
+{
+#if defined(BOOST_ASIO_HAS_LOCAL_SOCKETS)
+    if (m_bRunning) return;
+
+    // A socket file left behind by an unclean shutdown would make bind fail.
+    ::unlink(m_path.c_str());
+
+    // Anyone who can connect can write to any vault the daemon can open, so the socket is created
+    // with mode 0600 rather than chmod'ed after bind, which would leave it open in between. The umask
+    // is process wide, so files other threads create meanwhile are also owner only.
+    using boost::asio::local::stream_protocol;
+    mode_t oldMask = ::umask(S_IXUSR | S_IRWXG | S_IRWXO);
+    try
+    {
+        m_acceptor.reset(new stream_protocol::acceptor(m_io, stream_protocol::endpoint(m_path)));
+    }
+    catch (...)
+    {
+        ::umask(oldMask);
+        throw;
+    }
+    ::umask(oldMask);
+
+    accept();
+    m_io.reset();
+    m_bRunning = true;
+    m_ioThread = std::thread([this]() { m_io.run(); });
+#else
+    throw std::runtime_error("Local sockets are not supported on this platform.");
+#endif
+}
+
+void IngestServer::stop()
+{
+    if (!m_bRunning) return;
+    m_bRunning = false;
+
+    // Handlers run to completion, so a batch being inserted finishes first.
+    m_io.stop();
+    m_ioThread.join();
+
+#if defined(BOOST_ASIO_HAS_LOCAL_SOCKETS)
+    boost::system::error_code ec;
+    m_acceptor->close(ec);
+    ::unlink(m_path.c_str());
+#endif
+
+    for (auto& connection: m_connections) { connection->close(); }
+    m_connections.clear();
+}
+
+std::string IngestServer::processRequest(const std::string& request)
+{
+    std::vector<bytes_t> hashes;
+    std::vector<BatchInsertResult> results;
+    try
+    {
+        FrameReader reader(request);
+        std::string filename = reader.bytes(reader.u16());
+        uint32_t count = reader.u32();
+
+        // Each item takes at least 9 bytes, so this bounds the allocation below.
+        if (count > reader.remaining() / 9) throw std::runtime_error("Invalid item count.");
+        hashes.resize(count);
+        results.resize(count);
+
+        // Items that cannot be parsed are reported without reaching the vault.
+        std::vector<BatchInsertItem> items;
+        std::vector<std::size_t> itemIndices;
+        for (std::size_t i = 0; i < count; i++)
+        {
+            uint8_t type = reader.u8();
+            uint32_t height = reader.u32();
+            std::string data = reader.bytes(reader.u32());
+            try
+            {
+                bytes_t raw(data.begin(), data.end());
+                if (type == ITEM_TX)
+                {
+                    std::shared_ptr<Tx> tx(new Tx());
+                    tx->set(raw);
+                    hashes[i] = tx->hash();
+                    items.push_back(BatchInsertItem(tx));
+                }
+                else if (type == ITEM_MERKLEBLOCK)
+                {
+                    std::shared_ptr<MerkleBlock> merkleblock(new MerkleBlock());
+                    merkleblock->fromCoinCore(Coin::MerkleBlock(uchar_vector(raw)), height);
+                    hashes[i] = merkleblock->blockheader()->hash();
+                    items.push_back(BatchInsertItem(merkleblock));
+                }
+                else
+                {
+                    throw std::runtime_error("Invalid item type.");
+                }
+                itemIndices.push_back(i);
+            }
+            catch (const std::exception& e)
+            {
+                results[i].status = BatchInsertResult::FAILED;
+                results[i].error = e.what();
+            }
+        }
+        if (reader.remaining() > 0) throw std::runtime_error("Trailing data in request.");
+
+        if (!items.empty())
+        {
+            std::vector<BatchInsertResult> inserted = m_vaultCallback(filename)->insertBatch(items);
+            for (std::size_t i = 0; i < inserted.size(); i++) { results[itemIndices[i]] = inserted[i]; }
+        }
+
+        LOGGER(debug) << "IngestServer - " << count << " items for " << filename << "." << std::endl;
+    }
+    catch (const std::exception& e)
+    {
+        LOGGER(debug) << "IngestServer - request failed: " << e.what() << std::endl;
+        std::string response;
+        writeU8(response, REQUEST_FAILED);
+        writeString(response, e.what());
+        writeU32(response, 0);
+        return response;
+    }
+
+    std::string response;
+    writeU8(response, REQUEST_OK);
+    writeString(response, "");
+    writeU32(response, results.size());
+    for (std::size_t i = 0; i < results.size(); i++)
+    {
+        writeU8(response, results[i].status);
+        if (hashes[i].size() == 32) { response.append(hashes[i].begin(), hashes[i].end()); }
+        else                        { response.append(32, '\0'); }
+        writeString(response, results[i].error);
+    }
+    return response;
+}
+
+void IngestServer::accept()
+{
+#if defined(BOOST_ASIO_HAS_LOCAL_SOCKETS)
+    connection_ptr_t connection = std::make_shared<Connection>(*this);
+    m_acceptor->async_accept(connection->socket(), [this, connection](const boost::system::error_code& ec)
+    {
+        if (ec == boost::asio::error::operation_aborted) return;
+
+        if (ec)
+        {
+            LOGGER(error) << "IngestServer - accept failed: " << ec.message() << std::endl;
+        }
+        else
+        {
+            m_connections.insert(connection);
+            connection->start();
+        }
+        accept();
+    });
+#endif
+}
+
+void IngestServer::removeConnection(connection_ptr_t connection)
+{
+    connection->close();
+    m_connections.erase(connection);
+}
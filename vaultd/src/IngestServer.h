@@ -0,0 +1,86 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// IngestServer.h
+//
+// Copyright (c) 2014 Eric Lombrozo
+//
+// All Rights Reserved.
+//
+// vaultd - binary batch insertion of raw transactions and merkle blocks
+//
+
+#pragma once
+
+#include <Vault.h>
+
+#include <boost/asio.hpp>
+
+#include <functional>
+#include <memory>
+#include <set>
+#include <string>
+#include <thread>
+
+// A Unix socket endpoint for bulk loading. Raw transactions and merkle blocks go over the socket in
+// wire format instead of as hex inside JSON. Each request frame is inserted with Vault::insertBatch.
+//
+// All integers are little-endian. Each frame is prefixed with uint32 length, not counting the prefix.
+//
+// Request:
+//  uint16 filename length, filename     vault to insert into, as given to the websocket commands
+//  uint32 item count
+//  per item:
+//      uint8 type                          1 = transaction, 2 = merkle block
+//      uint32 height                       merkle blocks only, 0 if unknown. Ignored for transactions.
+//      uint32 length, data                 the serialized transaction or merkle block message
+//
+// Response:
+//  uint8 status                            0 = ok, 1 = the request failed and no items were inserted
+//  uint16 message length, message          why the request failed, empty if ok
+//  uint32 item count                       0 if the request failed
+//  per item, in request order:
+//      uint8 status                        0 = inserted, 1 = unchanged, 2 = failed
+//      32 bytes hash                       tx or block hash as the vault stores it, zero if the item could not be parsed
+//      uint16 message length, message      why the item failed, empty otherwise
+//
+// Requests on a connection are answered in order. A frame longer than MAX_FRAME_SIZE closes the connection.
+class IngestServer
+{
+public:
+    typedef std::shared_ptr<CoinDB::Vault> vault_ptr_t;
+    typedef std::function<vault_ptr_t(const std::string& filename)> vault_callback_t;
+
+    enum { MAX_FRAME_SIZE = 64 * 1024 * 1024 };
+
+    // Vaults are fetched through the callback so they come from the daemon's registry.
+    IngestServer(const std::string& path, vault_callback_t vaultCallback);
+    ~IngestServer();
+
+    // Throws if the socket cannot be created or local sockets are not supported.
+    void start();
+
+    // Waits for the batch being inserted, if any, then closes all connections and removes the socket.
+    void stop();
+
+    // Processes one request frame, without the length prefix, and returns the response frame without it.
+    std::string processRequest(const std::string& request);
+
+private:
+    class Connection;
+    typedef std::shared_ptr<Connection> connection_ptr_t;
+
+    void accept();
+    void removeConnection(connection_ptr_t connection);
+
+    std::string m_path;
+    vault_callback_t m_vaultCallback;
+
+    boost::asio::io_service m_io;
+#if defined(BOOST_ASIO_HAS_LOCAL_SOCKETS)
+    std::unique_ptr<boost::asio::local::stream_protocol::acceptor> m_acceptor;
+#endif
+    std::set<connection_ptr_t> m_connections; // only touched on the io thread, or after it has stopped
+
+    bool m_bRunning;
+    std::thread m_ioThread;
+};
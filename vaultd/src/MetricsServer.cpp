@@ -0,0 +1,64 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// MetricsServer.cpp
+//
+// Copyright (c) 2014 Eric Lombrozo
+//
+// All Rights Reserved.
+//
+// vaultd - plain text metrics endpoint for scrapers
+//
+
+#include "MetricsServer.h"
+
+#include <CoinQ/CoinQ_metrics.h>
+
+MetricsServer::MetricsServer(unsigned short port, const std::string& path) :
+    m_port(port),
+    m_path(path),
+    m_bRunning(false)
+{
+    m_server.clear_access_channels(websocketpp::log::alevel::all);
+    m_server.clear_error_channels(websocketpp::log::elevel::all);
+    m_server.init_asio();
+    m_server.set_http_handler([this](websocketpp::connection_hdl hdl) { onHttp(hdl); });
+}
+
+MetricsServer::~MetricsServer()
+{
+    stop();
+}
+
+void MetricsServer::start()
+{
+    if (m_bRunning) return;
+
+    m_server.listen(boost::asio::ip::tcp::endpoint(boost::asio::ip::address_v4::loopback(), m_port));
+    m_server.start_accept();
+    m_bRunning = true;
+    m_ioThread = std::thread([this]() { m_server.run(); });
+}
+
+void MetricsServer::stop()
+{
+    if (!m_bRunning) return;
+    m_bRunning = false;
+
+    m_server.stop_listening();
+    m_server.stop();
+    m_ioThread.join();
+}
+
+void MetricsServer::onHttp(websocketpp::connection_hdl hdl)
+{
+    server_t::connection_ptr con = m_server.get_con_from_hdl(hdl);
+    if (con->get_request().get_method() != "GET" || con->get_resource() != m_path)
+    {
+        con->set_status(websocketpp::http::status_code::not_found);
+        return;
+    }
+
+    con->set_status(websocketpp::http::status_code::ok);
+    con->append_header("Content-Type", "text/plain; version=0.0.4");
+    con->set_body(CoinQ::Metrics::registry().toText());
+}
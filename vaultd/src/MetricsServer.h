@@ -0,0 +1,46 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// MetricsServer.h
+//
+// Copyright (c) 2014 Eric Lombrozo
+//
+// All Rights Reserved.
+//
+// vaultd - plain text metrics endpoint for scrapers
+//
+
+#pragma once
+
+#include <websocketpp/config/asio_no_tls.hpp>
+#include <websocketpp/server.hpp>
+
+#include <string>
+#include <thread>
+
+// Answers HTTP GETs for path with CoinQ::Metrics::registry() in Prometheus text format, and
+// anything else with 404.
+//
+// The websocket API's server does not expose its websocketpp endpoint, so this runs a websocketpp
+// endpoint of its own. It listens on the loopback interface only.
+class MetricsServer
+{
+public:
+    MetricsServer(unsigned short port, const std::string& path = "/metrics");
+    ~MetricsServer();
+
+    // Throws if the port cannot be bound.
+    void start();
+    void stop();
+
+private:
+    typedef websocketpp::server<websocketpp::config::asio> server_t;
+
+    void onHttp(websocketpp::connection_hdl hdl);
+
+    unsigned short m_port;
+    std::string m_path;
+
+    server_t m_server;
+    bool m_bRunning;
+    std::thread m_ioThread;
+};
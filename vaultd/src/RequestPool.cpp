@@ -0,0 +1,136 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// RequestPool.cpp
+//
+// Copyright (c) 2014 Eric Lombrozo
+//
+// All Rights Reserved.
+//
+// vaultd - runs websocket requests on worker threads
+//
+
+#define LOGGER_SUBSYSTEM "vaultd"
+
+#include "RequestPool.h"
+
+#include <logger.h>
+
+#include <algorithm>
+#include <stdexcept>
+
+RequestPool::RequestPool(unsigned int workers) :
+    m_workerCount(workers > 0 ? workers : std::max(std::thread::hardware_concurrency(), 1u)),
+    m_bRunning(false),
+    m_bStopping(false)
+{
+}
+
+RequestPool::~RequestPool()
+{
+    stop();
+}
+
+void RequestPool::start()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_bRunning) throw std::runtime_error("RequestPool::start() - already running.");
+
+    m_bRunning = true;
+    m_bStopping = false;
+    for (unsigned int i = 0; i < m_workerCount; i++)
+    {
+        m_workers.push_back(std::thread(&RequestPool::workerLoop, this));
+    }
+}
+
+void RequestPool::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!m_bRunning) return;
+        m_bStopping = true;
+    }
+    m_cond.notify_all();
+
+    for (auto& worker: m_workers) { worker.join(); }
+    m_workers.clear();
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_bRunning = false;
+}
+
+void RequestPool::post(const keys_t& keys, task_t task)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!m_bRunning || m_bStopping) return;
+
+        Queued queued;
+        queued.keys = keys;
+        queued.task = task;
+        m_queue.push_back(queued);
+    }
+    m_cond.notify_one();
+}
+
+std::size_t RequestPool::getQueued() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_queue.size();
+}
+
+bool RequestPool::popRunnable(Queued& queued)
+{
+    // Take the oldest task whose keys are not held by a running task or by an older waiting one.
+    std::set<std::string> blockedKeys;
+    for (auto it = m_queue.begin(); it != m_queue.end(); ++it)
+    {
+        bool bRunnable = true;
+        for (auto& key: it->keys)
+        {
+            if (m_busyKeys.count(key) || blockedKeys.count(key)) { bRunnable = false; break; }
+        }
+
+        if (bRunnable)
+        {
+            queued = *it;
+            m_queue.erase(it);
+            m_busyKeys.insert(queued.keys.begin(), queued.keys.end());
+            return true;
+        }
+
+        blockedKeys.insert(it->keys.begin(), it->keys.end());
+    }
+    return false;
+}
+
+void RequestPool::workerLoop()
+{
+    while (true)
+    {
+        Queued queued;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            bool bPopped = false;
+            m_cond.wait(lock, [&]() { return (bPopped = popRunnable(queued)) || (m_bStopping && m_queue.empty()); });
+            if (!bPopped) break;
+        }
+
+        try
+        {
+            queued.task();
+        }
+        catch (const std::exception& e)
+        {
+            LOGGER(error) << "RequestPool::workerLoop() - " << e.what() << std::endl;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            for (auto& key: queued.keys) { m_busyKeys.erase(key); }
+        }
+
+        // Tasks waiting on these keys may be runnable now, and stop() may be waiting for the queue to empty.
+        m_cond.notify_all();
+    }
+}
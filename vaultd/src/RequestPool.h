@@ -0,0 +1,70 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// RequestPool.h
+//
+// Copyright (c) 2014 Eric Lombrozo
+//
+// All Rights Reserved.
+//
+// vaultd - runs websocket requests on worker threads
+//
+
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+// The websocket server calls back from a single thread, so a slow request would hold up every client.
+// Requests are queued here instead and run by a fixed set of workers. Tasks sharing a key, such as the
+// vault they touch, run one at a time and in the order posted. Tasks with no keys in common run in parallel.
+class RequestPool
+{
+public:
+    typedef std::function<void()> task_t;
+    typedef std::vector<std::string> keys_t;
+
+    // A worker count of 0 uses one worker per hardware thread.
+    explicit RequestPool(unsigned int workers = 0);
+    ~RequestPool();
+
+    void start();
+
+    // Runs the tasks already posted, then joins the workers. Tasks posted afterwards are dropped.
+    void stop();
+
+    // Exceptions thrown by the task are caught and logged.
+    void post(const keys_t& keys, task_t task);
+
+    unsigned int getWorkerCount() const { return m_workerCount; }
+    std::size_t getQueued() const;
+
+private:
+    RequestPool(const RequestPool&);
+    RequestPool& operator=(const RequestPool&);
+
+    struct Queued
+    {
+        keys_t keys;
+        task_t task;
+    };
+
+    bool popRunnable(Queued& queued);
+    void workerLoop();
+
+    unsigned int m_workerCount;
+
+    mutable std::mutex m_mutex;
+    std::condition_variable m_cond;
+    std::deque<Queued> m_queue;
+    std::set<std::string> m_busyKeys; // held by running tasks
+    bool m_bRunning;
+    bool m_bStopping;
+
+    std::vector<std::thread> m_workers;
+};
@@ -0,0 +1,511 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// VaultEvents.cpp
+//
+// Copyright (c) 2014 Eric Lombrozo
+//
+// All Rights Reserved.
+//
+// vaultd - per-vault event streams pushed to websocket subscribers
+//
+
+#define LOGGER_SUBSYSTEM "vaultd"
+
+#include "VaultEvents.h"
+
+#include <CoinQ/CoinQ_metrics.h>
+
+#include <logger.h>
+
+#include <algorithm>
+#include <chrono>
+#include <set>
+#include <stdexcept>
+
+using namespace CoinDB;
+
+static CoinQ::Metrics::Gauge& g_queuedEvents = CoinQ::Metrics::registry().gauge("vaultd_event_queue_depth", "Events waiting to be sent to subscribers, over all subscribers.");
+static CoinQ::Metrics::Counter& g_droppedEvents = CoinQ::Metrics::registry().counter("vaultd_events_dropped_total", "Events dropped from subscriber queues that overflowed.");
+
+static bool sameConnection(websocketpp::connection_hdl a, websocketpp::connection_hdl b)
+{
+    return !a.owner_before(b) && !b.owner_before(a);
+}
+
+VaultEvents::VaultEvents(std::size_t queueLimit, std::size_t replayLimit) :
+    m_queueLimit(queueLimit),
+    m_replayLimit(replayLimit),
+    m_lastEpoch(0),
+    m_dropped(0),
+    m_bRunning(false),
+    m_bDelivering(false)
+{
+}
+
+VaultEvents::~VaultEvents()
+{
+    stop();
+}
+
+void VaultEvents::start()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_bRunning) return;
+    m_bRunning = true;
+    m_bDelivering = true;
+    m_publishThread = std::thread(&VaultEvents::publishLoop, this);
+    m_deliveryThread = std::thread(&VaultEvents::deliveryLoop, this);
+}
+
+void VaultEvents::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!m_bRunning) return;
+        m_bRunning = false;
+    }
+    m_pendingCond.notify_all();
+
+    {
+        std::lock_guard<std::mutex> attachLock(m_attachMutex);
+        std::vector<stream_ptr_t> streams;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            for (auto& item: m_streams) { streams.push_back(item.second); }
+        }
+        for (auto& stream: streams) { detach_unwrapped(stream); }
+    }
+
+    // Changes queued before stopping are published, then the events queued for subscribers are sent.
+    m_publishThread.join();
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_bDelivering = false;
+    }
+    m_cond.notify_all();
+    m_deliveryThread.join();
+}
+
+void VaultEvents::onVaultOpened(const std::string& key, vault_ptr_t vault)
+{
+    std::lock_guard<std::mutex> attachLock(m_attachMutex);
+    stream_ptr_t stream;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto it = m_streams.find(key);
+        if (it == m_streams.end()) return;
+        stream = it->second;
+    }
+    attach_unwrapped(stream, vault);
+}
+
+VaultEvents::Position VaultEvents::subscribe(websocketpp::connection_hdl hdl, const std::string& key, vault_ptr_t vault, const Position* after, bool& bResync)
+{
+    std::lock_guard<std::mutex> attachLock(m_attachMutex);
+    stream_ptr_t stream;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        stream_ptr_t& s = m_streams[key];
+        if (!s)
+        {
+            // Epochs only increase, so a client can never resume a stream that was removed and created again.
+            uint64_t now = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+            m_lastEpoch = std::max(now, m_lastEpoch + 1);
+
+            s = std::make_shared<Stream>();
+            s->key = key;
+            s->epoch = m_lastEpoch;
+            s->seq = 0;
+            s->txBatchConnection = 0;
+            s->merkleBlockConnection = 0;
+        }
+        stream = s;
+    }
+
+    attach_unwrapped(stream, vault);
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (auto& subscriber: stream->subscribers)
+    {
+        if (sameConnection(subscriber->hdl, hdl))
+        {
+            removeSubscriber_unwrapped(stream, subscriber);
+            break;
+        }
+    }
+
+    subscriber_ptr_t subscriber = std::make_shared<Subscriber>();
+    subscriber->hdl = hdl;
+    subscriber->key = key;
+    subscriber->lastTakenSeq = stream->seq;
+    subscriber->overflowSeq = 0;
+    subscriber->bReady = false;
+    subscriber->bOverflowed = false;
+    subscriber->bRemoved = false;
+
+    bResync = false;
+    if (after && after->seq != stream->seq)
+    {
+        // The replay buffer holds the most recent events only, and a stream created again starts a new epoch.
+        bResync = after->epoch != stream->epoch || after->seq > stream->seq || stream->seq - after->seq > m_queueLimit ||
+            stream->replay.empty() || stream->replay.front()->seq > after->seq + 1;
+
+        if (!bResync)
+        {
+            subscriber->lastTakenSeq = after->seq;
+            for (auto& event: stream->replay)
+            {
+                if (event->seq > after->seq) { enqueue_unwrapped(subscriber, event); }
+            }
+        }
+    }
+    else if (after && after->epoch != stream->epoch)
+    {
+        bResync = true;
+    }
+
+    stream->subscribers.push_back(subscriber);
+
+    Position position;
+    position.epoch = stream->epoch;
+    position.seq = stream->seq;
+    return position;
+}
+
+bool VaultEvents::unsubscribe(websocketpp::connection_hdl hdl, const std::string& key)
+{
+    std::lock_guard<std::mutex> attachLock(m_attachMutex);
+    stream_ptr_t stream;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto it = m_streams.find(key);
+        if (it == m_streams.end()) return false;
+
+        for (auto& subscriber: it->second->subscribers)
+        {
+            if (sameConnection(subscriber->hdl, hdl))
+            {
+                stream = it->second;
+                removeSubscriber_unwrapped(stream, subscriber);
+                break;
+            }
+        }
+    }
+
+    if (!stream) return false;
+    removeIfUnused_unwrapped(stream);
+    return true;
+}
+
+void VaultEvents::unsubscribeAll(websocketpp::connection_hdl hdl)
+{
+    std::lock_guard<std::mutex> attachLock(m_attachMutex);
+    std::vector<stream_ptr_t> streams;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (auto& item: m_streams)
+        {
+            std::vector<subscriber_ptr_t>& subscribers = item.second->subscribers;
+            for (auto& subscriber: subscribers)
+            {
+                if (sameConnection(subscriber->hdl, hdl))
+                {
+                    removeSubscriber_unwrapped(item.second, subscriber);
+                    streams.push_back(item.second);
+                    break;
+                }
+            }
+        }
+    }
+
+    for (auto& stream: streams) { removeIfUnused_unwrapped(stream); }
+}
+
+uint64_t VaultEvents::getDroppedCount() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_dropped;
+}
+
+void VaultEvents::attach_unwrapped(stream_ptr_t stream, vault_ptr_t vault)
+{
+    if (stream->vault.lock() == vault) return;
+    detach_unwrapped(stream);
+    stream->vault = vault;
+
+    LOGGER(debug) << "VaultEvents::attach_unwrapped() - " << stream->key << std::endl;
+
+    // The vault is still locked while it emits, so slots only queue the change for the publishing thread.
+    std::weak_ptr<Vault> weakVault(vault);
+    stream->txBatchConnection = vault->subscribeTxBatch([this, stream, weakVault](const TxBatch& batch)
+    {
+        Pending pending;
+        pending.stream = stream;
+        pending.vault = weakVault.lock();
+        pending.batch = batch;
+        queue(std::move(pending));
+    });
+
+    stream->merkleBlockConnection = vault->subscribeMerkleBlockInserted([this, stream](const std::shared_ptr<MerkleBlock>& merkleblock)
+    {
+        const std::shared_ptr<BlockHeader>& header = merkleblock->blockheader();
+        bytes_t hash = header->hash();
+        uint32_t height = header->height();
+        uint32_t timestamp = header->timestamp();
+        uint32_t txcount = merkleblock->txcount();
+
+        Pending pending;
+        pending.stream = stream;
+        pending.type = "merkleblockinserted";
+        pending.writeBody = [=](CoinQ::Json::Writer& writer)
+        {
+            writer.key("block").beginObject();
+            writer.key("hash").hex(hash);
+            writer.member("height", height);
+            writer.member("timestamp", timestamp);
+            writer.member("txcount", txcount);
+            writer.endObject();
+        };
+        queue(std::move(pending));
+    });
+}
+
+void VaultEvents::detach_unwrapped(stream_ptr_t stream)
+{
+    vault_ptr_t vault = stream->vault.lock();
+    if (vault)
+    {
+        LOGGER(debug) << "VaultEvents::detach_unwrapped() - " << stream->key << std::endl;
+        vault->unsubscribeTxBatch(stream->txBatchConnection);
+        vault->unsubscribeMerkleBlockInserted(stream->merkleBlockConnection);
+    }
+    stream->vault.reset();
+}
+
+void VaultEvents::removeIfUnused_unwrapped(stream_ptr_t stream)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!stream->subscribers.empty()) return;
+
+        auto it = m_streams.find(stream->key);
+        if (it != m_streams.end() && it->second == stream) { m_streams.erase(it); }
+    }
+    detach_unwrapped(stream);
+}
+
+void VaultEvents::queue(Pending pending)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!m_bRunning) return;
+        m_pending.push_back(std::move(pending));
+    }
+    m_pendingCond.notify_one();
+}
+
+void VaultEvents::publishTxBatch(const Pending& pending)
+{
+    // Dropped if the vault was already gone when the batch was emitted.
+    if (!pending.vault) return;
+    const TxBatch& batch = pending.batch;
+
+    // A tx can change several times within a batch. Only its last status was committed.
+    std::map<unsigned long, const TxStatusDelta*> lastDeltas;
+    for (auto& delta: batch.status_changed) { lastDeltas[delta.tx_id] = &delta; }
+
+    auto publishTx = [&](const std::string& type, unsigned long tx_id)
+    {
+        std::shared_ptr<Tx> tx;
+        try
+        {
+            tx = pending.vault->getTx(tx_id);
+        }
+        catch (const TxNotFoundException&)
+        {
+            LOGGER(debug) << "VaultEvents::publishTxBatch() - tx " << tx_id << " in " << pending.stream->key << " was deleted before it could be published." << std::endl;
+            return;
+        }
+
+        auto it = lastDeltas.find(tx_id);
+        Tx::status_t status = it != lastDeltas.end() ? it->second->status : tx->status();
+        uint32_t height = it != lastDeltas.end() ? it->second->height : (tx->blockheader() ? tx->blockheader()->height() : 0);
+
+        publish(pending.stream, type, [&](CoinQ::Json::Writer& writer)
+        {
+            writer.key("tx").beginObject();
+            writer.key("hash").hex(tx->hash());
+            writer.key("unsignedhash").hex(tx->unsigned_hash());
+            writer.member("status", Tx::getStatusString(status));
+            writer.member("timestamp", tx->timestamp());
+            writer.key("height");
+            if (height) { writer.value(height); }
+            else        { writer.null(); }
+            writer.endObject();
+        });
+    };
+
+    for (auto tx_id: batch.inserted) { publishTx("txinserted", tx_id); }
+
+    // The inserted event already carries the committed status of a tx inserted in this batch.
+    std::set<unsigned long> inserted(batch.inserted.begin(), batch.inserted.end());
+    for (auto& delta: batch.status_changed)
+    {
+        if (lastDeltas[delta.tx_id] != &delta || inserted.count(delta.tx_id)) continue;
+        publishTx("txstatuschanged", delta.tx_id);
+    }
+}
+
+void VaultEvents::publish(stream_ptr_t stream, const std::string& type, std::function<void(CoinQ::Json::Writer&)> writeBody)
+{
+    std::shared_ptr<Event> event = std::make_shared<Event>();
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    event->seq = ++stream->seq;
+    CoinQ::Json::Writer writer(event->json);
+    writer.beginObject();
+    writer.member("event", type);
+    writer.member("stream", stream->key);
+    writer.member("seq", event->seq);
+    writeBody(writer);
+    writer.endObject();
+
+    stream->replay.push_back(event);
+    if (stream->replay.size() > m_replayLimit) { stream->replay.pop_front(); }
+
+    // Overflowed subscribers are removed from the list, so iterate over a copy.
+    std::vector<subscriber_ptr_t> subscribers(stream->subscribers);
+    for (auto& subscriber: subscribers) { enqueue_unwrapped(subscriber, event); }
+
+    m_cond.notify_one();
+}
+
+void VaultEvents::enqueue_unwrapped(subscriber_ptr_t subscriber, event_ptr_t event)
+{
+    if (subscriber->bOverflowed) return;
+
+    if (subscriber->queue.size() >= m_queueLimit)
+    {
+        LOGGER(debug) << "VaultEvents - subscriber " << subscriber->hdl.lock().get() << " to " << subscriber->key << " overflowed at seq " << subscriber->lastTakenSeq << std::endl;
+        m_dropped += subscriber->queue.size() + 1;
+        g_droppedEvents.increment(subscriber->queue.size() + 1);
+        g_queuedEvents.sub(subscriber->queue.size());
+        subscriber->queue.clear();
+        subscriber->bOverflowed = true;
+        subscriber->overflowSeq = subscriber->lastTakenSeq;
+
+        auto it = m_streams.find(subscriber->key);
+        if (it != m_streams.end()) { removeSubscriber_unwrapped(it->second, subscriber); }
+    }
+    else
+    {
+        subscriber->queue.push_back(event);
+        g_queuedEvents.add(1);
+    }
+
+    if (!subscriber->bReady)
+    {
+        subscriber->bReady = true;
+        m_ready.push_back(subscriber);
+    }
+}
+
+void VaultEvents::removeSubscriber_unwrapped(stream_ptr_t stream, subscriber_ptr_t subscriber)
+{
+    // Keep a reference since the caller may hold one from the list being modified.
+    subscriber_ptr_t keep(subscriber);
+    subscriber->bRemoved = true;
+    std::vector<subscriber_ptr_t>& subscribers = stream->subscribers;
+    for (auto it = subscribers.begin(); it != subscribers.end(); ++it)
+    {
+        if (*it == keep)
+        {
+            subscribers.erase(it);
+            break;
+        }
+    }
+}
+
+void VaultEvents::publishLoop()
+{
+    while (true)
+    {
+        Pending pending;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_pendingCond.wait(lock, [this]() { return !m_bRunning || !m_pending.empty(); });
+
+            // Changes already queued are still published when stopping.
+            if (m_pending.empty()) break;
+
+            pending = std::move(m_pending.front());
+            m_pending.pop_front();
+        }
+
+        try
+        {
+            if (pending.type.empty()) { publishTxBatch(pending); }
+            else                      { publish(pending.stream, pending.type, pending.writeBody); }
+        }
+        catch (const std::exception& e)
+        {
+            LOGGER(error) << "VaultEvents::publishLoop() - " << pending.stream->key << ": " << e.what() << std::endl;
+        }
+
+        // Subscribers that overflowed were removed, which may have left the stream unused.
+        std::lock_guard<std::mutex> attachLock(m_attachMutex);
+        removeIfUnused_unwrapped(pending.stream);
+    }
+}
+
+void VaultEvents::deliveryLoop()
+{
+    while (true)
+    {
+        subscriber_ptr_t subscriber;
+        std::deque<event_ptr_t> events;
+        bool bOverflowed;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_cond.wait(lock, [this]() { return !m_bDelivering || !m_ready.empty(); });
+
+            // Queued events are still sent when stopping.
+            if (m_ready.empty()) break;
+
+            subscriber = m_ready.front();
+            m_ready.pop_front();
+            subscriber->bReady = false;
+            events.swap(subscriber->queue);
+            g_queuedEvents.sub(events.size());
+            if (!events.empty()) { subscriber->lastTakenSeq = events.back()->seq; }
+            bOverflowed = subscriber->bOverflowed;
+
+            // Unsubscribed without overflowing - nothing more to send.
+            if (subscriber->bRemoved && !bOverflowed) continue;
+        }
+
+        if (!m_sendCallback) continue;
+
+        try
+        {
+            for (auto& event: events) { m_sendCallback(subscriber->hdl, event->json); }
+
+            if (bOverflowed)
+            {
+                std::string json;
+                CoinQ::Json::Writer writer(json);
+                writer.beginObject();
+                writer.member("event", "overflow");
+                writer.member("stream", subscriber->key);
+                writer.member("seq", subscriber->overflowSeq);
+                writer.endObject();
+                m_sendCallback(subscriber->hdl, json);
+            }
+        }
+        catch (const std::exception& e)
+        {
+            LOGGER(debug) << "VaultEvents - dropping subscriber " << subscriber->hdl.lock().get() << ": " << e.what() << std::endl;
+            unsubscribe(subscriber->hdl, subscriber->key);
+        }
+    }
+}
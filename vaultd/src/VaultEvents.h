@@ -0,0 +1,155 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// VaultEvents.h
+//
+// Copyright (c) 2014 Eric Lombrozo
+//
+// All Rights Reserved.
+//
+// vaultd - per-vault event streams pushed to websocket subscribers
+//
+
+#pragma once
+
+#include <Vault.h>
+
+#include <CoinQ/CoinQ_jsonwriter.h>
+
+#include <websocketpp/common/connection_hdl.hpp>
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Each subscribed vault gets a stream of compact deltas for inserted txs, tx status changes and
+// inserted merkle blocks. Events are numbered in order within the stream so a client that reconnects
+// can resume from the last number it saw instead of requerying everything. A stream and its vault
+// connections are removed once its last subscriber leaves.
+//
+// Tx events come from the batch a vault emits after each commit, so rolled back changes are never
+// published. Vault slots only queue the change, since the vault is still locked while it emits. A
+// publishing thread loads the txs, serializes each event once and appends it to bounded
+// per-subscriber queues. A delivery thread does the sending, so a slow client never holds up the
+// vault. A subscriber whose queue overflows is dropped after being told the last sequence number it
+// was sent.
+class VaultEvents
+{
+public:
+    typedef std::shared_ptr<CoinDB::Vault> vault_ptr_t;
+    typedef std::function<void(websocketpp::connection_hdl, const std::string&)> send_callback_t;
+
+    struct Position
+    {
+        uint64_t epoch;     // differs whenever the stream is created again, as after a restart
+        uint64_t seq;       // last event numbered in the stream
+    };
+
+    VaultEvents(std::size_t queueLimit = 1000, std::size_t replayLimit = 10000);
+    ~VaultEvents();
+
+    void setSendCallback(send_callback_t callback) { m_sendCallback = callback; }
+
+    void start();
+    void stop();
+
+    // Must be called whenever the registry opens a vault so an existing stream follows the new instance.
+    void onVaultOpened(const std::string& key, vault_ptr_t vault);
+
+    // Subscribes hdl to the stream for key, creating it if necessary. Returns the current position.
+    // If after is given, events numbered after it are queued first. bResync is set if they are no longer
+    // all held, in which case the client must requery.
+    Position subscribe(websocketpp::connection_hdl hdl, const std::string& key, vault_ptr_t vault, const Position* after, bool& bResync);
+
+    // Returns false if hdl was not subscribed. Streams left without subscribers are removed.
+    bool unsubscribe(websocketpp::connection_hdl hdl, const std::string& key);
+    void unsubscribeAll(websocketpp::connection_hdl hdl);
+
+    // Events dropped from subscriber queues that overflowed.
+    uint64_t getDroppedCount() const;
+
+private:
+    struct Event
+    {
+        uint64_t seq;
+        std::string json;
+    };
+    typedef std::shared_ptr<const Event> event_ptr_t;
+
+    struct Subscriber
+    {
+        websocketpp::connection_hdl hdl;
+        std::string key;
+        std::deque<event_ptr_t> queue;
+        uint64_t lastTakenSeq;  // last event handed to the delivery thread
+        uint64_t overflowSeq;
+        bool bReady;        // in m_ready
+        bool bOverflowed;
+        bool bRemoved;
+    };
+    typedef std::shared_ptr<Subscriber> subscriber_ptr_t;
+
+    struct Stream
+    {
+        std::string key;
+        uint64_t epoch;
+        uint64_t seq;
+        std::deque<event_ptr_t> replay;
+        std::vector<subscriber_ptr_t> subscribers;
+
+        // Guarded by m_attachMutex.
+        std::weak_ptr<CoinDB::Vault> vault;
+        Signals::Connection txBatchConnection;
+        Signals::Connection merkleBlockConnection;
+    };
+    typedef std::shared_ptr<Stream> stream_ptr_t;
+
+    // A change queued by a vault slot. Either a tx batch to load, or an event already described.
+    struct Pending
+    {
+        stream_ptr_t stream;
+        vault_ptr_t vault;
+        CoinDB::TxBatch batch;
+        std::string type;
+        std::function<void(CoinQ::Json::Writer&)> writeBody;
+    };
+
+    // The following are called with m_attachMutex held.
+    void attach_unwrapped(stream_ptr_t stream, vault_ptr_t vault);
+    void detach_unwrapped(stream_ptr_t stream);
+    void removeIfUnused_unwrapped(stream_ptr_t stream);
+
+    void queue(Pending pending);
+    void publishTxBatch(const Pending& pending);
+    void publish(stream_ptr_t stream, const std::string& type, std::function<void(CoinQ::Json::Writer&)> writeBody);
+    void enqueue_unwrapped(subscriber_ptr_t subscriber, event_ptr_t event);
+    void removeSubscriber_unwrapped(stream_ptr_t stream, subscriber_ptr_t subscriber);
+    void publishLoop();
+    void deliveryLoop();
+
+    std::size_t m_queueLimit;
+    std::size_t m_replayLimit;
+    uint64_t m_lastEpoch;
+    uint64_t m_dropped;
+    send_callback_t m_sendCallback;
+
+    mutable std::mutex m_mutex;
+    std::condition_variable m_cond;
+    std::map<std::string, stream_ptr_t> m_streams;
+    std::condition_variable m_pendingCond;
+    std::deque<Pending> m_pending;
+    std::deque<subscriber_ptr_t> m_ready;
+
+    // Taken before m_mutex. Guards creating and removing streams and connecting them to vaults.
+    std::mutex m_attachMutex;
+
+    bool m_bRunning;    // publishing
+    bool m_bDelivering;
+    std::thread m_publishThread;
+    std::thread m_deliveryThread;
+};
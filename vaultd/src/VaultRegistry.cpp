@@ -0,0 +1,262 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// VaultRegistry.cpp
+//
+// Copyright (c) 2014 Eric Lombrozo
+//
+// All Rights Reserved.
+//
+// vaultd - keeps vaults open between requests
+//
+
+#define LOGGER_SUBSYSTEM "vaultd"
+
+#include "VaultRegistry.h"
+
+#include <logger.h>
+
+#include <boost/filesystem.hpp>
+
+#include <stdexcept>
+
+using namespace CoinDB;
+
+static thread_local VaultRegistry::Session* t_session = nullptr;
+
+VaultRegistry::Session::Session(VaultRegistry& registry) :
+    m_registry(registry),
+    m_previous(t_session)
+{
+    t_session = this;
+}
+
+VaultRegistry::Session::~Session()
+{
+    t_session = m_previous;
+
+    // Pinned lookups skipped the registry, so mark the vaults used now.
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    std::lock_guard<std::mutex> lock(m_registry.m_mutex);
+    for (auto& item: m_vaults)
+    {
+        auto it = m_registry.m_vaults.find(item.second.key);
+        if (it != m_registry.m_vaults.end() && it->second->vault == item.second.vault) { it->second->lastUsed = now; }
+    }
+}
+
+VaultRegistry::VaultRegistry(std::chrono::seconds idleTimeout) :
+    m_idleTimeout(idleTimeout)
+{
+}
+
+VaultRegistry::vault_ptr_t VaultRegistry::get(const std::string& filename)
+{
+    Session* session = currentSession();
+    if (!session) return open(filename, false);
+
+    auto it = session->m_vaults.find(filename);
+    if (it != session->m_vaults.end()) return it->second.vault;
+
+    Session::Pinned& pinned = session->m_vaults[filename];
+    pinned.key = getKey(filename);
+    try
+    {
+        pinned.vault = open(filename, false);
+    }
+    catch (...)
+    {
+        session->m_vaults.erase(filename);
+        throw;
+    }
+    return pinned.vault;
+}
+
+VaultRegistry::vault_ptr_t VaultRegistry::open(const std::string& filename, bool bCreate)
+{
+    std::string key = getKey(filename);
+
+    entry_ptr_t entry;
+    std::promise<vault_ptr_t> promise;
+    bool bOpening = false;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto it = m_vaults.find(key);
+        auto released = m_released.find(key);
+        vault_ptr_t live = (it == m_vaults.end() && released != m_released.end()) ? released->second.lock() : vault_ptr_t();
+        if (it != m_vaults.end())
+        {
+            if (bCreate) throw std::runtime_error("Vault is already open.");
+            it->second->lastUsed = std::chrono::steady_clock::now();
+            entry = it->second;
+        }
+        else if (live)
+        {
+            // Closed while a request still held it. Opening the file again would give two vaults on it.
+            if (bCreate) throw std::runtime_error("Vault is already open.");
+            LOGGER(debug) << "VaultRegistry::open() - reusing " << key << ", still open since it was closed" << std::endl;
+            m_released.erase(released);
+
+            std::promise<vault_ptr_t> ready;
+            ready.set_value(live);
+            entry = std::make_shared<Entry>();
+            entry->vault = live;
+            entry->opened = ready.get_future().share();
+            entry->lastUsed = std::chrono::steady_clock::now();
+            m_vaults[key] = entry;
+            if (m_openCallback) { m_openCallback(key, live); }
+            return live;
+        }
+        else
+        {
+            // A placeholder, so that concurrent opens of this vault wait for this one.
+            entry = std::make_shared<Entry>();
+            entry->opened = promise.get_future().share();
+            entry->lastUsed = std::chrono::steady_clock::now();
+            m_vaults[key] = entry;
+            bOpening = true;
+        }
+    }
+
+    // Opened or being opened by another thread. Rethrows if that failed.
+    if (!bOpening) return entry->opened.get();
+
+    // Opening runs the schema checks, so it is done at most once per vault while it stays open.
+    LOGGER(debug) << "VaultRegistry::open() - opening " << key << std::endl;
+    vault_ptr_t vault;
+    try
+    {
+        vault = vault_ptr_t(new Vault(filename, bCreate));
+    }
+    catch (...)
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            auto it = m_vaults.find(key);
+            if (it != m_vaults.end() && it->second == entry) { m_vaults.erase(it); }
+        }
+        promise.set_exception(std::current_exception());
+        throw;
+    }
+
+    {
+        // If the vault was closed while opening, the callers waiting still get it.
+        std::lock_guard<std::mutex> lock(m_mutex);
+        entry->vault = vault;
+        entry->lastUsed = std::chrono::steady_clock::now();
+        auto it = m_vaults.find(key);
+        if (it != m_vaults.end() && it->second == entry)    { if (m_openCallback) m_openCallback(key, vault); }
+        else if (it == m_vaults.end())                      { m_released[key] = vault; }
+    }
+    promise.set_value(vault);
+    return vault;
+}
+
+bool VaultRegistry::close(const std::string& filename)
+{
+    std::string key = getKey(filename);
+
+    // Later requests in the same session must not keep using the closed vault.
+    Session* session = currentSession();
+    if (session)
+    {
+        for (auto it = session->m_vaults.begin(); it != session->m_vaults.end();)
+        {
+            if (it->second.key == key)  { it = session->m_vaults.erase(it); }
+            else                        { ++it; }
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_vaults.find(key);
+    if (it == m_vaults.end()) return false;
+
+    LOGGER(debug) << "VaultRegistry::close() - closing " << key << std::endl;
+    release_unwrapped(it->first, it->second);
+    m_vaults.erase(it);
+    return true;
+}
+
+void VaultRegistry::closeAll()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (auto& item: m_vaults) { release_unwrapped(item.first, item.second); }
+    m_vaults.clear();
+}
+
+unsigned int VaultRegistry::evictIdle()
+{
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    unsigned int count = 0;
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (auto it = m_vaults.begin(); it != m_vaults.end();)
+    {
+        // Vaults still opening are left alone.
+        if (it->second->vault && now - it->second->lastUsed >= m_idleTimeout)
+        {
+            LOGGER(debug) << "VaultRegistry::evictIdle() - closing idle vault " << it->first << std::endl;
+            release_unwrapped(it->first, it->second);
+            it = m_vaults.erase(it);
+            count++;
+        }
+        else
+        {
+            ++it;
+        }
+    }
+    return count;
+}
+
+void VaultRegistry::setIdleTimeout(std::chrono::seconds idleTimeout)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_idleTimeout = idleTimeout;
+}
+
+std::chrono::seconds VaultRegistry::getIdleTimeout() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_idleTimeout;
+}
+
+std::vector<std::string> VaultRegistry::getOpenFilenames() const
+{
+    std::vector<std::string> filenames;
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (auto& item: m_vaults)
+    {
+        if (item.second->vault) { filenames.push_back(item.first); }
+    }
+    return filenames;
+}
+
+void VaultRegistry::release_unwrapped(const std::string& key, const entry_ptr_t& entry)
+{
+    // Forget vaults that have since been destroyed.
+    for (auto it = m_released.begin(); it != m_released.end();)
+    {
+        if (it->second.expired())   { it = m_released.erase(it); }
+        else                        { ++it; }
+    }
+
+    // A vault still opening is recorded once it has opened.
+    if (entry->vault) { m_released[key] = entry->vault; }
+}
+
+VaultRegistry::Session* VaultRegistry::currentSession() const
+{
+    return (t_session && &t_session->m_registry == this) ? t_session : nullptr;
+}
+
+std::string VaultRegistry::getKey(const std::string& filename)
+{
+    // The same file may be named by different relative paths, with .. or through symlinks.
+    boost::filesystem::path path(filename);
+    if (boost::filesystem::exists(path)) return boost::filesystem::canonical(path).string();
+
+    // Being created, so only its directory can be resolved.
+    boost::filesystem::path parent = boost::filesystem::absolute(path).parent_path();
+    if (boost::filesystem::exists(parent)) return (boost::filesystem::canonical(parent) / path.filename()).string();
+    return boost::filesystem::absolute(path).string();
+}
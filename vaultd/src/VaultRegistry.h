@@ -0,0 +1,104 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// VaultRegistry.h
+//
+// Copyright (c) 2014 Eric Lombrozo
+//
+// All Rights Reserved.
+//
+// vaultd - keeps vaults open between requests
+//
+
+#pragma once
+
+#include <Vault.h>
+
+#include <chrono>
+#include <functional>
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+class VaultRegistry
+{
+public:
+    typedef std::shared_ptr<CoinDB::Vault> vault_ptr_t;
+    typedef std::function<void(const std::string& key, vault_ptr_t vault)> open_callback_t;
+
+    // While a session is alive, vaults fetched by get() on the creating thread are pinned and
+    // looked up by filename without touching the registry again. Used to run a batch of requests.
+    class Session
+    {
+    public:
+        explicit Session(VaultRegistry& registry);
+        ~Session();
+
+    private:
+        Session(const Session&);
+        Session& operator=(const Session&);
+
+        friend class VaultRegistry;
+
+        struct Pinned
+        {
+            std::string key;
+            vault_ptr_t vault;
+        };
+
+        VaultRegistry& m_registry;
+        Session* m_previous;
+        std::map<std::string, Pinned> m_vaults; // by filename as given to get()
+    };
+
+    VaultRegistry(std::chrono::seconds idleTimeout = std::chrono::seconds(300));
+
+    // Returns the open vault for filename, opening it first if necessary.
+    // The returned pointer keeps the vault alive even if it is closed or evicted meanwhile.
+    vault_ptr_t get(const std::string& filename);
+
+    // Opens a vault and keeps it open. Throws if bCreate is set and the vault is already open.
+    // The vault is built without holding the registry lock. Concurrent opens of the same vault
+    // wait for the first and share its result.
+    vault_ptr_t open(const std::string& filename, bool bCreate = false);
+
+    // Returns false if the vault was not open. A vault still in use by a request stays open until it
+    // is released, and opening it meanwhile gets the same instance back rather than a second one.
+    bool close(const std::string& filename);
+    void closeAll();
+
+    // Closes vaults that have not been used within the idle timeout, as close() does. Returns the number closed.
+    unsigned int evictIdle();
+
+    void setIdleTimeout(std::chrono::seconds idleTimeout);
+    std::chrono::seconds getIdleTimeout() const;
+
+    std::vector<std::string> getOpenFilenames() const;
+
+    // Called with the registry locked each time a vault is opened. It must not call back into the registry.
+    void setOpenCallback(open_callback_t callback) { m_openCallback = callback; }
+
+    // Vaults are keyed by canonical path, so that every name for a file gets the same key.
+    // A file that does not exist yet is keyed by its canonical directory.
+    static std::string getKey(const std::string& filename);
+
+private:
+    struct Entry
+    {
+        vault_ptr_t vault; // null while opening
+        std::shared_future<vault_ptr_t> opened;
+        std::chrono::steady_clock::time_point lastUsed;
+    };
+    typedef std::shared_ptr<Entry> entry_ptr_t;
+
+    Session* currentSession() const;
+    void release_unwrapped(const std::string& key, const entry_ptr_t& entry);
+
+    mutable std::mutex m_mutex;
+    std::map<std::string, entry_ptr_t> m_vaults;
+    std::map<std::string, std::weak_ptr<CoinDB::Vault>> m_released; // closed but possibly still held
+    std::chrono::seconds m_idleTimeout;
+    open_callback_t m_openCallback;
+};
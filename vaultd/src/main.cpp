@@ -9,48 +9,124 @@
 // vaultd - headless daemon with WebSockets API
 //
 
+#define LOGGER_SUBSYSTEM "vaultd"
+
+#include "VaultRegistry.h"
+#include "VaultEvents.h"
+#include "IngestServer.h"
+#include "MetricsServer.h"
+#include "RequestPool.h"
+
 #include <WebSocketServer.h>
 #include <cli.hpp>
 
 #include <formatting.h>
+#include <jsonformatting.h>
 
 #include <Vault.h>
 #include <Schema-odb.hxx>
 
 #include <random.h>
 
+#include <CoinQ/CoinQ_metrics.h>
+
 #include <logger.h>
 
 #include <Base58Check.h>
+#include <keystretch.h>
 
 #include <thread>
 #include <chrono>
+#include <mutex>
+#include <condition_variable>
 
 #include <iostream>
+#include <fstream>
 #include <sstream>
+#include <cstdio>
 #include <ctime>
+#include <cerrno>
+#include <limits>
 #include <functional>
+#include <memory>
+#include <set>
 
 #include <signal.h>
 
+#include <boost/asio.hpp>
+
 using namespace std;
 using namespace odb::core;
 using namespace CoinDB;
 
 const string WS_PORT = "12345";
+const string INGEST_SOCKET_PATH = "vaultd-ingest.sock";
+const std::chrono::seconds VAULT_IDLE_TIMEOUT(300);
+const std::chrono::seconds VAULT_EVICTION_INTERVAL(5);
+const std::chrono::seconds SHUTDOWN_DRAIN_TIMEOUT(10);
+
+// The key stretching cost set by calibratekdf, as "log2N r p", so it survives restarts.
+const string KDF_PARAMS_FILE = "vaultd-kdf.conf";
+
+// Set to a port number to serve metrics over HTTP on localhost.
+const char* METRICS_PORT_ENV = "VAULTD_METRICS_PORT";
+
+// Set to the number of threads running websocket requests. Defaults to one per hardware thread.
+const char* REQUEST_WORKERS_ENV = "VAULTD_REQUEST_WORKERS";
+
+// Declared first so it outlives the vaults whose signals reference it.
+VaultEvents g_vaultEvents;
+VaultRegistry g_vaultRegistry(VAULT_IDLE_TIMEOUT);
 
+// Declared after the registry so vaults held by queued requests are released first.
+std::unique_ptr<RequestPool> g_requestPool;
+
+// Requests being executed, so shutdown can wait for them to finish.
+std::mutex g_requestMutex;
+std::condition_variable g_requestCond;
+unsigned int g_requestsInFlight = 0;
 bool g_bShutdown = false;
+CoinQ::Metrics::Gauge& g_requestsInFlightGauge = CoinQ::Metrics::registry().gauge("vaultd_requests_in_flight", "WebSocket requests being executed.");
 
-void finish(int sig)
+class InFlightRequest
 {
-    LOGGER(debug) << "Stopping..." << endl;
+public:
+    InFlightRequest() : m_bAccepted(false)
+    {
+        std::lock_guard<std::mutex> lock(g_requestMutex);
+        if (g_bShutdown) return;
+        g_requestsInFlight++;
+        g_requestsInFlightGauge.set(g_requestsInFlight);
+        m_bAccepted = true;
+    }
+
+    ~InFlightRequest()
+    {
+        if (!m_bAccepted) return;
+        std::lock_guard<std::mutex> lock(g_requestMutex);
+        g_requestsInFlightGauge.set(--g_requestsInFlight);
+        if (g_requestsInFlight == 0) g_requestCond.notify_all();
+    }
+
+    // False once shutdown has begun.
+    bool accepted() const { return m_bAccepted; }
+
+private:
+    bool m_bAccepted;
+};
+
+// Refuses new requests and waits for those in flight. Returns false if some are still running at the deadline.
+bool drainRequests(std::chrono::seconds timeout)
+{
+    std::unique_lock<std::mutex> lock(g_requestMutex);
     g_bShutdown = true;
+    return g_requestCond.wait_for(lock, timeout, []() { return g_requestsInFlight == 0; });
 }
 
 // Global operations
 cli::result_t cmd_create(const cli::params_t& params)
 {
-    Vault vault(params[0], true);
+    g_vaultRegistry.open(params[0], true);
 
     stringstream ss;
     ss << "Vault " << params[0] << " created.";
@@ -59,9 +135,9 @@ cli::result_t cmd_create(const cli::params_t& params)
 
 cli::result_t cmd_info(const cli::params_t& params)
 {
-    Vault vault(params[0], false);
-    uint32_t schema_version = vault.getSchemaVersion();
-    uint32_t horizon_timestamp = vault.getHorizonTimestamp();
+    VaultRegistry::vault_ptr_t vault = g_vaultRegistry.get(params[0]);
+    uint32_t schema_version = vault->getSchemaVersion();
+    uint32_t horizon_timestamp = vault->getHorizonTimestamp();
 
     stringstream ss;
     ss << "filename:            " << params[0] << endl
@@ -70,11 +146,35 @@ cli::result_t cmd_info(const cli::params_t& params)
     return ss.str();
 }
 
+cli::result_t cmd_open(const cli::params_t& params)
+{
+    g_vaultRegistry.open(params[0]);
+
+    stringstream ss;
+    ss << "Vault " << params[0] << " opened.";
+    return ss.str();
+}
+
+cli::result_t cmd_close(const cli::params_t& params)
+{
+    if (!g_vaultRegistry.close(params[0])) throw runtime_error("Vault is not open.");
+
+    stringstream ss;
+    ss << "Vault " << params[0] << " closed.";
+    return ss.str();
+}
+
+cli::result_t cmd_listopen(const cli::params_t& params)
+{
+    using namespace stdutils;
+    return delimited_list(g_vaultRegistry.getOpenFilenames(), "\n");
+}
+
 // Keychain operations
 cli::result_t cmd_keychainexists(const cli::params_t& params)
 {
-    Vault vault(params[0], false);
-    bool bExists = vault.keychainExists(params[1]);
+    VaultRegistry::vault_ptr_t vault = g_vaultRegistry.get(params[0]);
+    bool bExists = vault->keychainExists(params[1]);
 
     stringstream ss;
     ss << (bExists ? "true" : "false");
@@ -83,8 +183,8 @@ cli::result_t cmd_keychainexists(const cli::params_t& params)
 
 cli::result_t cmd_newkeychain(const cli::params_t& params)
 {
-    Vault vault(params[0], false);
-    vault.newKeychain(params[1], random_bytes(32));
+    VaultRegistry::vault_ptr_t vault = g_vaultRegistry.get(params[0]);
+    vault->newKeychain(params[1], random_bytes(32));
 
     stringstream ss;
     ss << "Added keychain " << params[1] << " to vault " << params[0] << ".";
@@ -97,11 +197,11 @@ cli::result_t cmd_erasekeychain(bool bHelp, const cli::params_t& params)
         return "erasekeychain <db file> <keychain_name> - erase a keychain.";
     }
 
-    Vault vault(params[0], false);
-    if (!vault.keychainExists(params[1]))
+    VaultRegistry::vault_ptr_t vault = g_vaultRegistry.get(params[0]);
+    if (!vault->keychainExists(params[1]))
         throw runtime_error("Keychain not found.");
 
-    vault.eraseKeychain(params[1]);
+    vault->eraseKeychain(params[1]);
 
     stringstream ss;
     ss << "Keychain " << params[1] << " erased.";
@@ -110,8 +210,8 @@ cli::result_t cmd_erasekeychain(bool bHelp, const cli::params_t& params)
 */
 cli::result_t cmd_renamekeychain(const cli::params_t& params)
 {
-    Vault vault(params[0], false);
-    vault.renameKeychain(params[1], params[2]);
+    VaultRegistry::vault_ptr_t vault = g_vaultRegistry.get(params[0]);
+    vault->renameKeychain(params[1], params[2]);
 
     stringstream ss;
     ss << "Keychain " << params[1] << " renamed to " << params[2] << ".";
@@ -120,8 +220,8 @@ cli::result_t cmd_renamekeychain(const cli::params_t& params)
 
 cli::result_t cmd_keychaininfo(const cli::params_t& params)
 {
-    Vault vault(params[0], false);
-    shared_ptr<Keychain> keychain = vault.getKeychain(params[1]);
+    VaultRegistry::vault_ptr_t vault = g_vaultRegistry.get(params[0]);
+    shared_ptr<Keychain> keychain = vault->getKeychain(params[1]);
 
     stringstream ss;
     ss << "id:        " << keychain->id() << endl
@@ -141,8 +241,8 @@ cli::result_t cmd_keychains(const cli::params_t& params)
 
     bool show_hidden = params.size() > 2 && params[2] == "true";
 
-    Vault vault(params[0], false);
-    vector<KeychainView> views = vault.getRootKeychainViews(account_name, show_hidden);
+    VaultRegistry::vault_ptr_t vault = g_vaultRegistry.get(params[0]);
+    vector<KeychainView> views = vault->getRootKeychainViews(account_name, show_hidden);
 
     stringstream ss;
     ss << formattedKeychainViewHeader();
@@ -158,8 +258,8 @@ cli::result_t cmd_listkeychains(bool bHelp, const cli::params_t& params)
 
     bool root_only = params.size() > 1 ? (params[1] == "true") : false;
 
-    Vault vault(params[0], false);
-    vector<shared_ptr<Keychain>> keychains = vault.getAllKeychains(root_only);
+    VaultRegistry::vault_ptr_t vault = g_vaultRegistry.get(params[0]);
+    vector<shared_ptr<Keychain>> keychains = vault->getAllKeychains(root_only);
 
     stringstream ss;
     ss << formattedKeychainHeader();
@@ -177,8 +277,8 @@ cli::result_t cmd_exportkeychain(const cli::params_t& params)
     if (params.size() > 3)  { output_file = params[3]; }
     else                    { output_file = params[1] + (export_privkey ? ".priv" : ".pub"); }
 
-    Vault vault(params[0], false);
-    vault.exportKeychain(params[1], output_file, export_privkey);
+    VaultRegistry::vault_ptr_t vault = g_vaultRegistry.get(params[0]);
+    vault->exportKeychain(params[1], output_file, export_privkey);
 
     stringstream ss;
     ss << (export_privkey ? "Private" : "Public") << " keychain " << params[1] << " exported to " << output_file << ".";
@@ -189,8 +289,8 @@ cli::result_t cmd_importkeychain(const cli::params_t& params)
 {
     bool import_privkey = params.size() > 2 ? (params[2] == "true") : true;
 
-    Vault vault(params[0], false);
-    std::shared_ptr<Keychain> keychain = vault.importKeychain(params[1], import_privkey);
+    VaultRegistry::vault_ptr_t vault = g_vaultRegistry.get(params[0]);
+    std::shared_ptr<Keychain> keychain = vault->importKeychain(params[1], import_privkey);
 
     stringstream ss;
     ss << (import_privkey ? "Private" : "Public") << " keychain " << keychain->name() << " imported from " << params[1] << ".";
@@ -201,14 +301,14 @@ cli::result_t cmd_exportbip32(const cli::params_t& params)
 {
     bool export_privkey = params.size() > 2;
 
-    Vault vault(params[0], false);
-    vault.unlockChainCodes(uchar_vector("1234"));
+    VaultRegistry::vault_ptr_t vault = g_vaultRegistry.get(params[0]);
+    vault->unlockChainCodes(uchar_vector("1234"));
     if (export_privkey)
     {
         secure_bytes_t unlock_key = sha256_2(params[2]);
-        vault.unlockKeychain(params[1], unlock_key);
+        vault->unlockKeychain(params[1], unlock_key);
     }
-    secure_bytes_t extkey = vault.getKeychainExtendedKey(params[1], export_privkey);
+    secure_bytes_t extkey = vault->getKeychainExtendedKey(params[1], export_privkey);
 
     stringstream ss;
     ss << toBase58Check(extkey);
@@ -229,8 +329,8 @@ cli::result_t cmd_importbip32(const cli::params_t& params)
     secure_bytes_t extkey;
     if (!fromBase58Check(params[2], extkey)) throw std::runtime_error("Invalid BIP32.");
 
-    Vault vault(params[0], false);
-    std::shared_ptr<Keychain> keychain = vault.importKeychainExtendedKey(params[1], extkey, import_privkey, lock_key);
+    VaultRegistry::vault_ptr_t vault = g_vaultRegistry.get(params[0]);
+    std::shared_ptr<Keychain> keychain = vault->importKeychainExtendedKey(params[1], extkey, import_privkey, lock_key);
 
     stringstream ss;
     ss << (keychain->isPrivate() ? "Private" : "Public") << " keychain " << keychain->name() << " imported from BIP32.";
@@ -240,8 +340,8 @@ cli::result_t cmd_importbip32(const cli::params_t& params)
 // Account operations
 cli::result_t cmd_accountexists(const cli::params_t& params)
 {
-    Vault vault(params[0], false);
-    bool bExists = vault.accountExists(params[1]);
+    VaultRegistry::vault_ptr_t vault = g_vaultRegistry.get(params[0]);
+    bool bExists = vault->accountExists(params[1]);
 
     stringstream ss;
     ss << (bExists ? "true" : "false");
@@ -259,9 +359,9 @@ cli::result_t cmd_newaccount(const cli::params_t& params)
     for (size_t i = 3; i < params.size(); i++)
         keychain_names.push_back(params[i]);
 
-    Vault vault(params[0], false);
-    vault.unlockChainCodes(secure_bytes_t());
-    vault.newAccount(params[1], minsigs, keychain_names);
+    VaultRegistry::vault_ptr_t vault = g_vaultRegistry.get(params[0]);
+    vault->unlockChainCodes(secure_bytes_t());
+    vault->newAccount(params[1], minsigs, keychain_names);
 
     stringstream ss;
     ss << "Added account " << params[1] << " to vault " << params[0] << ".";
@@ -270,8 +370,8 @@ cli::result_t cmd_newaccount(const cli::params_t& params)
 
 cli::result_t cmd_renameaccount(const cli::params_t& params)
 {
-    Vault vault(params[0], false);
-    vault.renameAccount(params[1], params[2]);
+    VaultRegistry::vault_ptr_t vault = g_vaultRegistry.get(params[0]);
+    vault->renameAccount(params[1], params[2]);
 
     stringstream ss;
     ss << "Renamed account " << params[1] << " to " << params[2] << ".";
@@ -280,10 +380,24 @@ cli::result_t cmd_renameaccount(const cli::params_t& params)
 
 cli::result_t cmd_accountinfo(const cli::params_t& params)
 {
-    Vault vault(params[0], false);
-    AccountInfo accountInfo = vault.getAccountInfo(params[1]);
-    uint64_t balance = vault.getAccountBalance(params[1], 0);
-    uint64_t confirmed_balance = vault.getAccountBalance(params[1], 1);
+    bool json = params.size() > 2 && params[2] == "json";
+
+    VaultRegistry::vault_ptr_t vault = g_vaultRegistry.get(params[0]);
+    AccountInfo accountInfo = vault->getAccountInfo(params[1]);
+    uint64_t balance = vault->getAccountBalance(params[1], 0);
+    uint64_t confirmed_balance = vault->getAccountBalance(params[1], 1);
+
+    if (json)
+    {
+        string result;
+        CoinQ::Json::Writer writer(result);
+        writer.beginObject().key("account");
+        writeAccountInfoJson(writer, accountInfo);
+        writer.member("balance", balance);
+        writer.member("confirmedbalance", confirmed_balance);
+        writer.endObject();
+        return result;
+    }
 
     using namespace stdutils;
     stringstream ss;
@@ -301,8 +415,20 @@ cli::result_t cmd_accountinfo(const cli::params_t& params)
 
 cli::result_t cmd_listaccounts(const cli::params_t& params)
 {
-    Vault vault(params[0], false);
-    vector<AccountInfo> accounts = vault.getAllAccountInfo();
+    bool json = params.size() > 1 && params[1] == "json";
+
+    VaultRegistry::vault_ptr_t vault = g_vaultRegistry.get(params[0]);
+    vector<AccountInfo> accounts = vault->getAllAccountInfo();
+
+    if (json)
+    {
+        string result;
+        CoinQ::Json::Writer writer(result);
+        writer.beginArray();
+        for (auto& account: accounts) { writeAccountInfoJson(writer, account); }
+        writer.endArray();
+        return result;
+    }
 
     stringstream ss;
     ss << formattedAccountHeader();
@@ -313,17 +439,17 @@ cli::result_t cmd_listaccounts(const cli::params_t& params)
 
 cli::result_t cmd_exportaccount(const cli::params_t& params)
 {
-    Vault vault(params[0], false);
+    VaultRegistry::vault_ptr_t vault = g_vaultRegistry.get(params[0]);
 
     secure_bytes_t exportChainCodeUnlockKey;
     if (params.size() > 2 && !params[2].empty())
         exportChainCodeUnlockKey = sha256_2(params[2]);
 
     if (params.size() > 3 && !params[3].empty())
-        vault.unlockChainCodes(sha256_2(params[3]));
+        vault->unlockChainCodes(sha256_2(params[3]));
 
     std::string output_file = params.size() > 4 ? params[4] : (params[1] + ".account");
-    vault.exportAccount(params[1], output_file, true, exportChainCodeUnlockKey);
+    vault->exportAccount(params[1], output_file, true, exportChainCodeUnlockKey);
 
     stringstream ss;
     ss << "Account " << params[1] << " exported to " << output_file << ".";
@@ -332,7 +458,7 @@ cli::result_t cmd_exportaccount(const cli::params_t& params)
 
 cli::result_t cmd_importaccount(const cli::params_t& params)
 {
-    Vault vault(params[0], false);
+    VaultRegistry::vault_ptr_t vault = g_vaultRegistry.get(params[0]);
 
     unsigned int privkeycount = 1;
 
@@ -341,9 +467,9 @@ cli::result_t cmd_importaccount(const cli::params_t& params)
         chainCodeUnlockKey = sha256_2(params[2]);
 
     if (params.size() > 3 && !params[3].empty())
-        vault.unlockChainCodes(sha256_2(params[3]));
+        vault->unlockChainCodes(sha256_2(params[3]));
 
-    std::shared_ptr<Account> account = vault.importAccount(params[1], privkeycount, chainCodeUnlockKey);
+    std::shared_ptr<Account> account = vault->importAccount(params[1], privkeycount, chainCodeUnlockKey);
 
     stringstream ss;
     ss << "Account " << account->name() << " imported from " << params[1] << ".";
@@ -352,10 +478,10 @@ cli::result_t cmd_importaccount(const cli::params_t& params)
 
 cli::result_t cmd_newaccountbin(const cli::params_t& params)
 {
-    Vault vault(params[0], false);
-    AccountInfo accountInfo = vault.getAccountInfo(params[1]);
-    vault.unlockChainCodes(secure_bytes_t());
-    vault.addAccountBin(params[1], params[2]);
+    VaultRegistry::vault_ptr_t vault = g_vaultRegistry.get(params[0]);
+    AccountInfo accountInfo = vault->getAccountInfo(params[1]);
+    vault->unlockChainCodes(secure_bytes_t());
+    vault->addAccountBin(params[1], params[2]);
 
     stringstream ss;
     ss << "Account bin " << params[2] << " added to account " << params[1] << ".";
@@ -364,8 +490,8 @@ cli::result_t cmd_newaccountbin(const cli::params_t& params)
 
 cli::result_t cmd_listbins(const cli::params_t& params)
 {
-    Vault vault(params[0], false);
-    vector<AccountBinView> bins = vault.getAllAccountBinViews();
+    VaultRegistry::vault_ptr_t vault = g_vaultRegistry.get(params[0]);
+    vector<AccountBinView> bins = vault->getAllAccountBinViews();
 
     stringstream ss;
     ss << formattedAccountBinViewHeader();
@@ -376,12 +502,12 @@ cli::result_t cmd_listbins(const cli::params_t& params)
 
 cli::result_t cmd_issuescript(const cli::params_t& params)
 {
-    Vault vault(params[0], false);
+    VaultRegistry::vault_ptr_t vault = g_vaultRegistry.get(params[0]);
     std::string account_name;
     if (params[1] != "@null") account_name = params[1];
     std::string bin_name = params.size() > 2 ? params[2] : std::string(DEFAULT_BIN_NAME);
     std::string label = params.size() > 3 ? params[3] : std::string("");
-    std::shared_ptr<SigningScript> script = vault.issueSigningScript(account_name, bin_name, label);
+    std::shared_ptr<SigningScript> script = vault->issueSigningScript(account_name, bin_name, label);
 
     std::string address = getAddressFromScript(script->txoutscript());
 
@@ -403,9 +529,20 @@ cli::result_t cmd_listscripts(const cli::params_t& params)
     if (bin_name == "@all") bin_name = "";
 
     int flags = params.size() > 3 ? (int)strtoul(params[3].c_str(), NULL, 0) : ((int)SigningScript::ISSUED | (int)SigningScript::USED);
+    bool json = params.size() > 4 && params[4] == "json";
     
-    Vault vault(params[0], false);
-    vector<SigningScriptView> scriptViews = vault.getSigningScriptViews(account_name, bin_name, flags);
+    VaultRegistry::vault_ptr_t vault = g_vaultRegistry.get(params[0]);
+    vector<SigningScriptView> scriptViews = vault->getSigningScriptViews(account_name, bin_name, flags);
+
+    if (json)
+    {
+        string result;
+        CoinQ::Json::Writer writer(result);
+        writer.beginArray();
+        for (auto& scriptView: scriptViews) { writeSigningScriptViewJson(writer, scriptView); }
+        writer.endArray();
+        return result;
+    }
 
     stringstream ss;
     ss << formattedScriptHeader();
@@ -423,23 +560,209 @@ cli::result_t cmd_history(const cli::params_t& params)
     if (bin_name == "@all") bin_name = "";
 
     bool hide_change = params.size() > 3 ? params[3] == "true" : true;
+    bool json = params.size() > 4 && params[4] == "json";
     
-    Vault vault(params[0], false);
-    uint32_t best_height = vault.getBestHeight();
-    vector<TxOutView> txOutViews = vault.getTxOutViews(account_name, bin_name, TxOut::ROLE_BOTH, TxOut::BOTH, Tx::ALL, hide_change);
+    VaultRegistry::vault_ptr_t vault = g_vaultRegistry.get(params[0]);
+    uint32_t best_height = vault->getBestHeight();
+
+    // Rows are formatted as they are read rather than collected first.
+    if (json)
+    {
+        // Large histories are written straight into the result without per-row stringstreams.
+        string result;
+        CoinQ::Json::Writer writer(result);
+        writer.beginArray();
+        vault->visitTxOutViews([&](const TxOutView& txOutView) { writeTxOutViewJson(writer, txOutView, best_height); return true; },
+            account_name, bin_name, TxOut::ROLE_BOTH, TxOut::BOTH, Tx::ALL, hide_change);
+        writer.endArray();
+        return result;
+    }
+
+    stringstream ss;
+    ss << formattedTxOutViewHeader();
+    vault->visitTxOutViews([&](const TxOutView& txOutView) { ss << endl << formattedTxOutView(txOutView, best_height); return true; },
+        account_name, bin_name, TxOut::ROLE_BOTH, TxOut::BOTH, Tx::ALL, hide_change);
+    return ss.str();
+}
+
+// Page tokens are the keyset cursor fields joined with dots. Names are hex encoded so they may contain dots.
+const string FIRST_PAGE_TOKEN = "@first";
+
+vector<string> splitPageToken(const string& token, size_t fields)
+{
+    vector<string> parts;
+    stringstream ss(token);
+    string part;
+    while (getline(ss, part, '.')) { parts.push_back(part); }
+    if (!token.empty() && token[token.size() - 1] == '.') { parts.push_back(""); }
+    if (parts.size() != fields) throw runtime_error("Invalid page token.");
+    return parts;
+}
+
+// Token fields are decimal, with no sign, spaces or trailing characters, and must fit max.
+unsigned long parsePageTokenNumber(const string& field, unsigned long max)
+{
+    if (field.empty() || field.size() > 20 || field.find_first_not_of("0123456789") != string::npos) throw runtime_error("Invalid page token.");
+
+    errno = 0;
+    unsigned long long value = strtoull(field.c_str(), NULL, 10);
+    if (errno == ERANGE || value > max) throw runtime_error("Invalid page token.");
+    return (unsigned long)value;
+}
+
+string parsePageTokenName(const string& field)
+{
+    if (field.size() % 2 || field.find_first_not_of("0123456789abcdefABCDEF") != string::npos) throw runtime_error("Invalid page token.");
+
+    uchar_vector name(field);
+    return string(name.begin(), name.end());
+}
+
+string encodePageToken(const TxOutViewCursor& cursor)
+{
+    if (cursor.isNull()) return "";
+    stringstream ss;
+    ss << cursor.height << "." << cursor.timestamp << "." << cursor.tx_id << "." << cursor.id;
+    return ss.str();
+}
+
+string encodePageToken(const SigningScriptViewCursor& cursor)
+{
+    if (cursor.isNull()) return "";
+    stringstream ss;
+    ss << uchar_vector(cursor.account_name.begin(), cursor.account_name.end()).getHex() << "."
+       << uchar_vector(cursor.bin_name.begin(), cursor.bin_name.end()).getHex() << "."
+       << cursor.status << "." << cursor.index << "." << cursor.id;
+    return ss.str();
+}
+
+TxOutViewCursor decodeTxOutPageToken(const string& token)
+{
+    TxOutViewCursor cursor;
+    if (token == FIRST_PAGE_TOKEN) return cursor;
+
+    vector<string> parts = splitPageToken(token, 4);
+    cursor.height = parsePageTokenNumber(parts[0], numeric_limits<uint32_t>::max());
+    cursor.timestamp = parsePageTokenNumber(parts[1], numeric_limits<uint32_t>::max());
+    cursor.tx_id = parsePageTokenNumber(parts[2], numeric_limits<unsigned long>::max());
+    cursor.id = parsePageTokenNumber(parts[3], numeric_limits<unsigned long>::max());
+    if (cursor.isNull()) throw runtime_error("Invalid page token.");
+    return cursor;
+}
+
+SigningScriptViewCursor decodeSigningScriptPageToken(const string& token)
+{
+    SigningScriptViewCursor cursor;
+    if (token == FIRST_PAGE_TOKEN) return cursor;
+
+    vector<string> parts = splitPageToken(token, 5);
+    cursor.account_name = parsePageTokenName(parts[0]);
+    cursor.bin_name = parsePageTokenName(parts[1]);
+    cursor.status = (int)parsePageTokenNumber(parts[2], numeric_limits<int>::max());
+    cursor.index = parsePageTokenNumber(parts[3], numeric_limits<uint32_t>::max());
+    cursor.id = parsePageTokenNumber(parts[4], numeric_limits<unsigned long>::max());
+    if (cursor.isNull()) throw runtime_error("Invalid page token.");
+    return cursor;
+}
+
+size_t parsePageLimit(const cli::params_t& params, size_t i)
+{
+    if (params.size() <= i) return 100;
+    const string& param = params[i];
+    if (param.empty() || param.size() > 5 || param.find_first_not_of("0123456789") != string::npos) throw runtime_error("Invalid limit.");
+    size_t limit = strtoul(param.c_str(), NULL, 10);
+    if (limit == 0 || limit > 10000) throw runtime_error("Invalid limit.");
+    return limit;
+}
+
+cli::result_t cmd_listscriptspage(const cli::params_t& params)
+{
+    std::string account_name = params.size() > 1 ? params[1] : std::string("@all");
+    if (account_name == "@all") account_name = "";
+
+    std::string bin_name = params.size() > 2 ? params[2] : std::string("@all");
+    if (bin_name == "@all") bin_name = "";
+
+    int flags = params.size() > 3 ? (int)strtoul(params[3].c_str(), NULL, 0) : ((int)SigningScript::ISSUED | (int)SigningScript::USED);
+    size_t limit = parsePageLimit(params, 4);
+    SigningScriptViewCursor after = decodeSigningScriptPageToken(params.size() > 5 ? params[5] : FIRST_PAGE_TOKEN);
+    bool json = params.size() > 6 && params[6] == "json";
+
+    VaultRegistry::vault_ptr_t vault = g_vaultRegistry.get(params[0]);
+    SigningScriptViewCursor next;
+    vector<SigningScriptView> scriptViews = vault->getSigningScriptViewsPage(after, limit, next, account_name, bin_name, flags);
+
+    if (json)
+    {
+        string result;
+        CoinQ::Json::Writer writer(result);
+        writer.beginObject();
+        writer.key("rows").beginArray();
+        for (auto& scriptView: scriptViews) { writeSigningScriptViewJson(writer, scriptView); }
+        writer.endArray();
+        writer.key("next");
+        if (next.isNull())  { writer.null(); }
+        else                { writer.value(encodePageToken(next)); }
+        writer.endObject();
+        return result;
+    }
+
+    stringstream ss;
+    ss << formattedScriptHeader();
+    for (auto& scriptView: scriptViews)
+        ss << endl << formattedScript(scriptView);
+    ss << endl << "next page token: " << (next.isNull() ? string("none") : encodePageToken(next));
+    return ss.str();
+}
+
+cli::result_t cmd_historypage(const cli::params_t& params)
+{
+    std::string account_name = params.size() > 1 ? params[1] : std::string("@all");
+    if (account_name == "@all") account_name = "";
+
+    std::string bin_name = params.size() > 2 ? params[2] : std::string("@all");
+    if (bin_name == "@all") bin_name = "";
+
+    bool hide_change = params.size() > 3 ? params[3] == "true" : true;
+    size_t limit = parsePageLimit(params, 4);
+    TxOutViewCursor after = decodeTxOutPageToken(params.size() > 5 ? params[5] : FIRST_PAGE_TOKEN);
+    bool json = params.size() > 6 && params[6] == "json";
+
+    VaultRegistry::vault_ptr_t vault = g_vaultRegistry.get(params[0]);
+    uint32_t best_height = vault->getBestHeight();
+    TxOutViewCursor next;
+    vector<TxOutView> txOutViews = vault->getTxOutViewsPage(after, limit, next, account_name, bin_name, TxOut::ROLE_BOTH, TxOut::BOTH, Tx::ALL, hide_change);
+
+    if (json)
+    {
+        string result;
+        result.reserve(txOutViews.size() * 400);
+        CoinQ::Json::Writer writer(result);
+        writer.beginObject();
+        writer.key("rows").beginArray();
+        for (auto& txOutView: txOutViews) { writeTxOutViewJson(writer, txOutView, best_height); }
+        writer.endArray();
+        writer.key("next");
+        if (next.isNull())  { writer.null(); }
+        else                { writer.value(encodePageToken(next)); }
+        writer.endObject();
+        return result;
+    }
+
     stringstream ss;
     ss << formattedTxOutViewHeader();
     for (auto& txOutView: txOutViews)
         ss << endl << formattedTxOutView(txOutView, best_height);
+    ss << endl << "next page token: " << (next.isNull() ? string("none") : encodePageToken(next));
     return ss.str();
 }
 
 cli::result_t cmd_refillaccountpool(const cli::params_t& params)
 {
-    Vault vault(params[0], false);
-    AccountInfo accountInfo = vault.getAccountInfo(params[1]);
-    vault.unlockChainCodes(secure_bytes_t());
-    vault.refillAccountPool(params[1]);
+    VaultRegistry::vault_ptr_t vault = g_vaultRegistry.get(params[0]);
+    AccountInfo accountInfo = vault->getAccountInfo(params[1]);
+    vault->unlockChainCodes(secure_bytes_t());
+    vault->refillAccountPool(params[1]);
 
     stringstream ss;
     ss << "Refilled account pool for account " << params[1] << ".";
@@ -449,17 +772,17 @@ cli::result_t cmd_refillaccountpool(const cli::params_t& params)
 // Account bin operations
 cli::result_t cmd_exportbin(const cli::params_t& params)
 {
-    Vault vault(params[0], false);
+    VaultRegistry::vault_ptr_t vault = g_vaultRegistry.get(params[0]);
 
     string export_name = params.size() > 3 ? params[3] : (params[1].empty() ? params[2] : params[1] + "-" + params[2]);
     secure_bytes_t exportChainCodeUnlockKey;
     if (params.size() > 4 && !params[4].empty())
         exportChainCodeUnlockKey = sha256_2(params[4]);
 
-    vault.unlockChainCodes(secure_bytes_t());
+    vault->unlockChainCodes(secure_bytes_t());
 
     string output_file = params.size() > 5 ? params[5] : (export_name + ".bin");
-    vault.exportAccountBin(params[1], params[2], export_name, output_file, exportChainCodeUnlockKey);
+    vault->exportAccountBin(params[1], params[2], export_name, output_file, exportChainCodeUnlockKey);
 
     stringstream ss;
     ss << "Account bin " << export_name << " exported to " << output_file << ".";
@@ -468,15 +791,15 @@ cli::result_t cmd_exportbin(const cli::params_t& params)
 
 cli::result_t cmd_importbin(const cli::params_t& params)
 {
-    Vault vault(params[0], false);
+    VaultRegistry::vault_ptr_t vault = g_vaultRegistry.get(params[0]);
 
     secure_bytes_t importChainCodeUnlockKey;
     if (params.size() > 2 && !params[2].empty())
         importChainCodeUnlockKey = sha256_2(params[2]);
 
-    vault.unlockChainCodes(uchar_vector("1234"));
+    vault->unlockChainCodes(uchar_vector("1234"));
 
-    std::shared_ptr<AccountBin> bin = vault.importAccountBin(params[1], importChainCodeUnlockKey);
+    std::shared_ptr<AccountBin> bin = vault->importAccountBin(params[1], importChainCodeUnlockKey);
 
     stringstream ss;
     ss << "Account bin " << bin->name() << " imported from " << params[1] << ".";
@@ -488,8 +811,8 @@ cli::result_t cmd_txinfo(const cli::params_t& params)
 {
     bool raw = params.size() > 2 ? params[2] == "true" : false;
 
-    Vault vault(params[0], false);
-    std::shared_ptr<Tx> tx = vault.getTx(uchar_vector(params[1]));
+    VaultRegistry::vault_ptr_t vault = g_vaultRegistry.get(params[0]);
+    std::shared_ptr<Tx> tx = vault->getTx(uchar_vector(params[1]));
 
     if (raw) return uchar_vector(tx->raw()).getHex();
 
@@ -515,11 +838,11 @@ cli::result_t cmd_txinfo(const cli::params_t& params)
 
 cli::result_t cmd_insertrawtx(const cli::params_t& params)
 {
-    Vault vault(params[0], false);
+    VaultRegistry::vault_ptr_t vault = g_vaultRegistry.get(params[0]);
 
     std::shared_ptr<Tx> tx(new Tx());
     tx->set(uchar_vector(params[1]));
-    tx = vault.insertTx(tx);
+    tx = vault->insertTx(tx);
 
     stringstream ss;
     if (tx)
@@ -540,7 +863,7 @@ cli::result_t cmd_newrawtx(const cli::params_t& params)
     using namespace CoinQ::Script;
     const size_t MAX_VERSION_LEN = 2;
 
-    Vault vault(params[0], false);
+    VaultRegistry::vault_ptr_t vault = g_vaultRegistry.get(params[0]);
 
     // Get outputs
     size_t i = 2;
@@ -558,15 +881,15 @@ cli::result_t cmd_newrawtx(const cli::params_t& params)
     uint32_t version = i < params.size() ? strtoul(params[i++].c_str(), NULL, 0) : 1;
     uint32_t locktime = i < params.size() ? strtoul(params[i++].c_str(), NULL, 0) : 0;
 
-    std::shared_ptr<Tx> tx = vault.createTx(params[1], version, locktime, txouts, fee, 1, true);
+    std::shared_ptr<Tx> tx = vault->createTx(params[1], version, locktime, txouts, fee, 1, true);
     return uchar_vector(tx->raw()).getHex();
 }
 
 cli::result_t cmd_deletetx(const cli::params_t& params)
 {
-    Vault vault(params[0], false);
+    VaultRegistry::vault_ptr_t vault = g_vaultRegistry.get(params[0]);
     uchar_vector hash(params[1]);
-    vault.deleteTx(hash);
+    vault->deleteTx(hash);
 
     stringstream ss;
     ss << "Tx deleted. hash: " << hash.getHex();
@@ -575,10 +898,10 @@ cli::result_t cmd_deletetx(const cli::params_t& params)
 
 cli::result_t cmd_signingrequest(const cli::params_t& params)
 {
-    Vault vault(params[0], false);
+    VaultRegistry::vault_ptr_t vault = g_vaultRegistry.get(params[0]);
     uchar_vector hash(params[1]);
 
-    SigningRequest req = vault.getSigningRequest(hash, true);
+    SigningRequest req = vault->getSigningRequest(hash, true);
     vector<string>keychain_names;
     vector<string>keychain_hashes;
     for (auto& keychain_pair: req.keychain_info())
@@ -599,14 +922,14 @@ cli::result_t cmd_signingrequest(const cli::params_t& params)
 // TODO: do something with passphrase
 cli::result_t cmd_signtx(const cli::params_t& params)
 {
-    Vault vault(params[0], false);
-    vault.unlockChainCodes(uchar_vector("1234"));
-    vault.unlockKeychain(params[2], secure_bytes_t());
+    VaultRegistry::vault_ptr_t vault = g_vaultRegistry.get(params[0]);
+    vault->unlockChainCodes(uchar_vector("1234"));
+    vault->unlockKeychain(params[2], secure_bytes_t());
 
     stringstream ss;
     std::vector<std::string> keychain_names;
     keychain_names.push_back(params[2]);
-    if (vault.signTx(uchar_vector(params[1]), keychain_names, true))
+    if (vault->signTx(uchar_vector(params[1]), keychain_names, true))
     {
         ss << "Signatures added.";
     }
@@ -620,8 +943,8 @@ cli::result_t cmd_signtx(const cli::params_t& params)
 // Blockchain operations
 cli::result_t cmd_bestheight(const cli::params_t& params)
 {
-    Vault vault(params[0], false);
-    uint32_t best_height = vault.getBestHeight();
+    VaultRegistry::vault_ptr_t vault = g_vaultRegistry.get(params[0]);
+    uint32_t best_height = vault->getBestHeight();
 
     stringstream ss;
     ss << best_height;
@@ -630,8 +953,8 @@ cli::result_t cmd_bestheight(const cli::params_t& params)
 
 cli::result_t cmd_horizonheight(const cli::params_t& params)
 {
-    Vault vault(params[0], false);
-    uint32_t horizon_height = vault.getHorizonHeight();
+    VaultRegistry::vault_ptr_t vault = g_vaultRegistry.get(params[0]);
+    uint32_t horizon_height = vault->getHorizonHeight();
 
     stringstream ss;
     ss << horizon_height;
@@ -642,8 +965,8 @@ cli::result_t cmd_horizontimestamp(const cli::params_t& params)
 {
     bool use_gmt = params.size() > 1 && params[1] == "true";
 
-    Vault vault(params[0], false);
-    long timestamp = vault.getHorizonTimestamp();
+    VaultRegistry::vault_ptr_t vault = g_vaultRegistry.get(params[0]);
+    long timestamp = vault->getHorizonTimestamp();
 
     std::function<struct tm*(const time_t*)> fConvert = use_gmt ? &gmtime : &localtime;
     string formatted_timestamp = asctime(fConvert((const time_t*)&timestamp));
@@ -658,8 +981,8 @@ cli::result_t cmd_blockinfo(const cli::params_t& params)
 {
     uint32_t height = strtoul(params[1].c_str(), NULL, 0);
 
-    Vault vault(params[0], false);
-    std::shared_ptr<BlockHeader> blockheader = vault.getBlockHeader(height);
+    VaultRegistry::vault_ptr_t vault = g_vaultRegistry.get(params[0]);
+    std::shared_ptr<BlockHeader> blockheader = vault->getBlockHeader(height);
 
     return blockheader->toCoinClasses().toIndentedString();
 }
@@ -709,8 +1032,8 @@ cli::result_t cmd_insertrawmerkleblock(const cli::params_t& params)
     std::shared_ptr<MerkleBlock> merkleblock(new MerkleBlock());
     merkleblock->fromCoinClasses(rawmerkleblock, height);
 
-    Vault vault(params[0], false);
-    bool rval = (bool)vault.insertMerkleBlock(merkleblock);
+    VaultRegistry::vault_ptr_t vault = g_vaultRegistry.get(params[0]);
+    bool rval = (bool)vault->insertMerkleBlock(merkleblock);
 
     stringstream ss;
     ss << "Merkle block " << uchar_vector(merkleblock->blockheader()->hash()).getHex() << (rval ? " " : " not ") << "inserted.";
@@ -720,8 +1043,8 @@ cli::result_t cmd_insertrawmerkleblock(const cli::params_t& params)
 cli::result_t cmd_deleteblock(const cli::params_t& params)
 {
     uint32_t height = strtoull(params[1].c_str(), NULL, 0);
-    Vault vault(params[0], false);
-    unsigned int count = vault.deleteMerkleBlock(height);
+    VaultRegistry::vault_ptr_t vault = g_vaultRegistry.get(params[0]);
+    unsigned int count = vault->deleteMerkleBlock(height);
 
     stringstream ss;
     ss << count << " merkle blocks deleted.";
@@ -734,6 +1057,67 @@ cli::result_t cmd_randombytes(const cli::params_t& params)
     return bytes.getHex();
 }
 
+// A missing or unreadable file leaves the built-in default.
+static void loadStretchParams()
+{
+    ifstream file(KDF_PARAMS_FILE.c_str());
+    if (!file) return;
+
+    unsigned int log2N, r, p;
+    if (!(file >> log2N >> r >> p) || log2N > Coin::MAX_STRETCH_LOG2N)
+    {
+        LOGGER(error) << "Ignoring invalid " << KDF_PARAMS_FILE << "." << endl;
+        return;
+    }
+
+    try
+    {
+        Coin::setDefaultStretchParams(Coin::ScryptParams(log2N, r, p));
+        LOGGER(debug) << "Using key stretching cost N = 2^" << log2N << ", r = " << r << ", p = " << p << " from " << KDF_PARAMS_FILE << "." << endl;
+    }
+    catch (const std::exception& e)
+    {
+        LOGGER(error) << "Ignoring " << KDF_PARAMS_FILE << ": " << e.what() << endl;
+    }
+}
+
+// Written to a temporary file first so a crash never leaves a partial one.
+static void saveStretchParams(const Coin::ScryptParams& params)
+{
+    static std::mutex saveMutex;
+    std::lock_guard<std::mutex> lock(saveMutex);
+
+    string tmpFilename = KDF_PARAMS_FILE + ".tmp";
+    {
+        ofstream file(tmpFilename.c_str(), ios::trunc);
+        file << (unsigned int)params.log2N << " " << params.r << " " << params.p << endl;
+        if (!file) throw std::runtime_error("Could not write " + tmpFilename + ".");
+    }
+    if (std::rename(tmpFilename.c_str(), KDF_PARAMS_FILE.c_str()) != 0)
+        throw std::runtime_error("Could not replace " + KDF_PARAMS_FILE + ".");
+}
+
+cli::result_t cmd_calibratekdf(const cli::params_t& params)
+{
+    unsigned int target_ms = params.size() > 0 ? strtoul(params[0].c_str(), NULL, 0) : 250;
+    if (target_ms == 0) throw std::runtime_error("Invalid target time.");
+
+    Coin::ScryptParams kdf_params = Coin::calibrateStretchParams(target_ms);
+    Coin::setDefaultStretchParams(kdf_params);
+    saveStretchParams(kdf_params);
+
+    stringstream ss;
+    ss << "Keychains locked from now on will use scrypt N = 2^" << (int)kdf_params.log2N << ", r = " << kdf_params.r << ", p = " << kdf_params.p
+       << " (" << (kdf_params.memory() >> 20) << " MiB). Saved to " << KDF_PARAMS_FILE << ".";
+    return ss.str();
+}
+
+cli::result_t cmd_metrics(const cli::params_t& params)
+{
+    bool text = params.size() > 0 && params[0] == "text";
+    return text ? CoinQ::Metrics::registry().toText() : CoinQ::Metrics::registry().toJson();
+}
+
 // WebSocket callbacks
 void openCallback(WebSocket::Server& server, websocketpp::connection_hdl hdl)
 {
@@ -743,40 +1127,235 @@ void openCallback(WebSocket::Server& server, websocketpp::connection_hdl hdl)
 void closeCallback(WebSocket::Server& server, websocketpp::connection_hdl hdl)
 {
     LOGGER(debug) << "Client " << hdl.lock().get() << " disconnected." << endl;
+    g_vaultEvents.unsubscribeAll(hdl);
 }
 
 using namespace cli;
 Shell shell("vaultd by Eric Lombrozo v0.0.1");
 
-void requestCallback(WebSocket::Server& server, const WebSocket::Server::client_request_t& req)
+JsonRpc::Response execRequest(const string& cmdname, const json_spirit::Array& jsonParams, const json_spirit::Value& id)
 {
     JsonRpc::Response response;
-
-    const string& cmdname = req.second.getMethod();
-    params_t params;
-    for (auto& param: req.second.getParams()) { params.push_back(param.get_str()); }
     try
     {
+        params_t params;
+        for (auto& param: jsonParams) { params.push_back(param.get_str()); }
         result_t result = shell.exec(cmdname, params);
-        response.setResult(result, req.second.getId());
+        response.setResult(result, id);
     }
     catch (const std::exception& e)
     {
-        response.setError(e.what(), req.second.getId());        
+        response.setError(e.what(), id);
+    }
+    return response;
+}
+
+// subscribe <db file> [resume from = epoch.seq]
+// Starts pushing events for the vault to the connection. Events are objects with event, stream and seq fields:
+//  {"event":"txinserted","stream":...,"seq":12,"tx":{"hash":...,"unsignedhash":...,"status":...,"timestamp":...,"height":...}}
+//  {"event":"txstatuschanged",...} has the same form, and {"event":"merkleblockinserted",...,"block":{"hash":...,"height":...,"timestamp":...,"txcount":...}}
+//  {"event":"overflow","stream":...,"seq":n} means the client fell behind and was unsubscribed after event n.
+// The result gives the current position. Pass it back as epoch.seq after reconnecting to receive the events missed meanwhile.
+// If resync is true they could not be replayed and the client must requery. This is always the case once the
+// stream has had no subscribers, since it is then removed and starts a new epoch.
+JsonRpc::Response execSubscribe(websocketpp::connection_hdl hdl, const json_spirit::Array& params, const json_spirit::Value& id)
+{
+    JsonRpc::Response response;
+    try
+    {
+        if (params.empty() || params.size() > 2) throw runtime_error("Invalid parameters.");
+
+        string filename = params[0].get_str();
+        VaultEvents::Position after;
+        if (params.size() > 1)
+        {
+            string resume = params[1].get_str();
+            size_t dot = resume.find('.');
+            if (dot == string::npos) throw runtime_error("Invalid resume position.");
+            after.epoch = strtoull(resume.substr(0, dot).c_str(), NULL, 10);
+            after.seq = strtoull(resume.substr(dot + 1).c_str(), NULL, 10);
+        }
+
+        string key = VaultRegistry::getKey(filename);
+        bool bResync;
+        VaultEvents::Position position = g_vaultEvents.subscribe(hdl, key, g_vaultRegistry.get(filename), params.size() > 1 ? &after : nullptr, bResync);
+
+        string result;
+        CoinQ::Json::Writer writer(result);
+        writer.beginObject();
+        writer.member("stream", key);
+        writer.member("epoch", position.epoch);
+        writer.member("seq", position.seq);
+        writer.member("resync", bResync);
+        writer.endObject();
+        response.setResult(result, id);
+    }
+    catch (const std::exception& e)
+    {
+        response.setError(e.what(), id);
+    }
+    return response;
+}
+
+// unsubscribe <db file>
+JsonRpc::Response execUnsubscribe(websocketpp::connection_hdl hdl, const json_spirit::Array& params, const json_spirit::Value& id)
+{
+    JsonRpc::Response response;
+    try
+    {
+        if (params.size() != 1) throw runtime_error("Invalid parameters.");
+
+        bool bUnsubscribed = g_vaultEvents.unsubscribe(hdl, VaultRegistry::getKey(params[0].get_str()));
+        response.setResult(bUnsubscribed ? "true" : "false", id);
+    }
+    catch (const std::exception& e)
+    {
+        response.setError(e.what(), id);
+    }
+    return response;
+}
+
+// Runs a request on behalf of the connection hdl. Subscriptions belong to the connection, so they are
+// handled here rather than by the shell.
+JsonRpc::Response execClientRequest(websocketpp::connection_hdl hdl, const string& cmdname, const json_spirit::Array& params, const json_spirit::Value& id)
+{
+    if (cmdname == "subscribe") return execSubscribe(hdl, params, id);
+    if (cmdname == "unsubscribe") return execUnsubscribe(hdl, params, id);
+    return execRequest(cmdname, params, id);
+}
+
+// The params of a batch request are request objects. They run in order on one worker under a single
+// vault session, and each response is sent as soon as it is ready. The batch request itself is answered
+// last with the number of requests run. A subscribe or unsubscribe in the batch applies to the connection
+// that sent it, as it would if sent alone.
+void batchRequestCallback(WebSocket::Server& server, const WebSocket::Server::client_request_t& req)
+{
+    VaultRegistry::Session session(g_vaultRegistry);
+
+    int count = 0;
+    for (auto& item: req.second.getParams())
+    {
+        JsonRpc::Response response;
+        if (item.type() != json_spirit::obj_type)
+        {
+            response.setError("Invalid request.");
+        }
+        else
+        {
+            const json_spirit::Object& obj = item.get_obj();
+            const json_spirit::Value& method = json_spirit::find_value(obj, "method");
+            const json_spirit::Value& params = json_spirit::find_value(obj, "params");
+            const json_spirit::Value& id = json_spirit::find_value(obj, "id");
+
+            if (method.type() != json_spirit::str_type)
+                response.setError("Missing method.", id);
+            else if (method.get_str() == "batch")
+                response.setError("Nested batch.", id);
+            else if (params.type() == json_spirit::null_type)
+                response = execClientRequest(req.first, method.get_str(), json_spirit::Array(), id);
+            else if (params.type() == json_spirit::array_type)
+                response = execClientRequest(req.first, method.get_str(), params.get_array(), id);
+            else
+                response.setError("Invalid parameters.", id);
+        }
+
+        server.send(req.first, response);
+        count++;
     }
 
+    JsonRpc::Response response;
+    response.setResult(count, req.second.getId());
     server.send(req.first, response);
 }
 
+// Requests are keyed by the vault named by their first parameter, and a batch by those of its requests.
+// Requests on one vault then run one at a time and in the order received, while other vaults are served
+// meanwhile. A first parameter that is not a vault only serializes requests passing the same string.
+void addRequestKey(const json_spirit::Value& params, set<string>& keys)
+{
+    if (params.type() != json_spirit::array_type) return;
+    const json_spirit::Array& array = params.get_array();
+    if (array.empty() || array[0].type() != json_spirit::str_type) return;
+
+    const string& filename = array[0].get_str();
+    try
+    {
+        keys.insert(VaultRegistry::getKey(filename));
+    }
+    catch (const std::exception&)
+    {
+        keys.insert(filename);
+    }
+}
+
+RequestPool::keys_t getRequestKeys(const WebSocket::Server::client_request_t& req)
+{
+    set<string> keys;
+    if (req.second.getMethod() == "batch")
+    {
+        for (auto& item: req.second.getParams())
+        {
+            if (item.type() == json_spirit::obj_type) { addRequestKey(json_spirit::find_value(item.get_obj(), "params"), keys); }
+        }
+    }
+    else
+    {
+        addRequestKey(req.second.getParams(), keys);
+    }
+    return RequestPool::keys_t(keys.begin(), keys.end());
+}
+
+void runRequest(WebSocket::Server& server, const WebSocket::Server::client_request_t& req)
+{
+    if (req.second.getMethod() == "batch")
+    {
+        batchRequestCallback(server, req);
+        return;
+    }
+
+    server.send(req.first, execClientRequest(req.first, req.second.getMethod(), req.second.getParams(), req.second.getId()));
+}
+
+// Called on the websocket server's only request thread, so the request is queued for a worker rather than run here.
+void requestCallback(WebSocket::Server& server, const WebSocket::Server::client_request_t& req)
+{
+    // Counted from here so shutdown also waits for requests that are still queued.
+    std::shared_ptr<InFlightRequest> inFlight(new InFlightRequest());
+    if (!inFlight->accepted())
+    {
+        JsonRpc::Response response;
+        response.setError("Shutting down.", req.second.getId());
+        server.send(req.first, response);
+        return;
+    }
+
+    WebSocket::Server* pServer = &server;
+    WebSocket::Server::client_request_t request(req);
+    g_requestPool->post(getRequestKeys(req), [pServer, request, inFlight]() { runRequest(*pServer, request); });
+}
+
 int main(int argc, char* argv[])
 {
     INIT_LOGGER("vaultd.log");
+    loadStretchParams();
 
-    signal(SIGINT, &finish);
+    // The main thread sleeps in the io_service until a signal arrives or idle vaults are due to be evicted.
+    // Signals are installed before any other thread starts so they all inherit the handlers.
+    boost::asio::io_service io;
+    boost::asio::signal_set signals(io, SIGINT, SIGTERM);
+    signals.async_wait([&](const boost::system::error_code& ec, int sig)
+    {
+        if (ec) return;
+        LOGGER(debug) << "Stopping on signal " << sig << "..." << endl;
+        io.stop();
+    });
 
     // Global operations
     shell.add(command(&cmd_create, "create", "create a new vault", command::params(1, "db file")));
     shell.add(command(&cmd_info, "info", "display general information about file", command::params(1, "db file")));
+    shell.add(command(&cmd_open, "open", "open a vault and keep it open until closed or idle", command::params(1, "db file")));
+    shell.add(command(&cmd_close, "close", "close an open vault, locking its keychains", command::params(1, "db file")));
+    shell.add(command(&cmd_listopen, "listopen", "display open vaults", command::params(0)));
 
     // Keychain operations
     shell.add(command(&cmd_keychainexists, "keychainexists", "check if a keychain exists", command::params(1, "db file")));
@@ -793,15 +1372,19 @@ int main(int argc, char* argv[])
     shell.add(command(&cmd_accountexists, "accountexists", "check if an account exists", command::params(2, "db file", "account name")));
     shell.add(command(&cmd_newaccount, "newaccount", "create a new account using specified keychains", command::params(4, "db file", "account name", "minsigs", "keychain 1"), command::params(3, "keychain 2", "keychain 3", "...")));
     shell.add(command(&cmd_renameaccount, "renameaccount", "rename an account", command::params(3, "db file", "old name", "new name")));
-    shell.add(command(&cmd_accountinfo, "accountinfo", "display account information", command::params(2, "db file", "account name")));
-    shell.add(command(&cmd_listaccounts, "listaccounts", "display list of accounts", command::params(1, "db file")));
+    shell.add(command(&cmd_accountinfo, "accountinfo", "display account information", command::params(2, "db file", "account name"), command::params(1, "format = text | json")));
+    shell.add(command(&cmd_listaccounts, "listaccounts", "display list of accounts", command::params(1, "db file"), command::params(1, "format = table | json")));
     shell.add(command(&cmd_exportaccount, "exportaccount", "export account to file", command::params(2, "db file", "account name"), command::params(3, "export chain code passphrase", "native chain code passphrase", "output file = *.account")));
     shell.add(command(&cmd_importaccount, "importaccount", "import account from file", command::params(2, "db file", "account file"), command::params(2, "import chain code passphrase", "native chain code passphrase"))); 
     shell.add(command(&cmd_newaccountbin, "newaccountbin", "add a new account bin", command::params(3, "db file", "account name", "bin name")));
     shell.add(command(&cmd_issuescript, "issuescript", "issue a new signing script", command::params(2, "db file", "account name"), command::params(1, (std::string("bin name = ") + DEFAULT_BIN_NAME).c_str())));
     shell.add(command(&cmd_listscripts, "listscripts", "display list of signing scripts (flags: UNUSED=1, CHANGE=2, PENDING=4, RECEIVED=8, CANCELED=16)", command::params(1, "db file"),
-        command::params(3, "account name = @all", "bin name = @all", "flags = PENDING | RECEIVED")));
-    shell.add(command(&cmd_history, "history", "display transaction history", command::params(1, "db file"), command::params(3, "account name = @all", "bin name = @all", "hide change = true")));
+        command::params(4, "account name = @all", "bin name = @all", "flags = PENDING | RECEIVED", "format = table | json")));
+    shell.add(command(&cmd_history, "history", "display transaction history", command::params(1, "db file"), command::params(4, "account name = @all", "bin name = @all", "hide change = true", "format = table | json")));
+    shell.add(command(&cmd_listscriptspage, "listscriptspage", "display one page of signing scripts, see listscripts", command::params(1, "db file"),
+        command::params(6, "account name = @all", "bin name = @all", "flags = PENDING | RECEIVED", "limit = 100", "page token = @first", "format = table | json")));
+    shell.add(command(&cmd_historypage, "historypage", "display one page of transaction history, newest first", command::params(1, "db file"),
+        command::params(6, "account name = @all", "bin name = @all", "hide change = true", "limit = 100", "page token = @first", "format = table | json")));
     shell.add(command(&cmd_refillaccountpool, "refillaccountpool", "refill signing script pool for account", command::params(2, "db file", "account name")));
 
     // Account bin operations
@@ -829,12 +1412,24 @@ int main(int argc, char* argv[])
 
     // Miscellaneous
     shell.add(command(&cmd_randombytes, "randombytes", "output random bytes in hex", command::params(1, "length")));
+    shell.add(command(&cmd_calibratekdf, "calibratekdf", "calibrate key stretching cost for newly locked keychains", command::params(0), command::params(1, "target unlock time in ms = 250")));
+    shell.add(command(&cmd_metrics, "metrics", "display counters, gauges and latency histograms", command::params(0), command::params(1, "format = json | text")));
+
+    const char* requestWorkers = getenv(REQUEST_WORKERS_ENV);
+    g_requestPool.reset(new RequestPool(requestWorkers ? strtoul(requestWorkers, NULL, 10) : 0));
+    g_requestPool->start();
+    LOGGER(debug) << "Running requests on " << g_requestPool->getWorkerCount() << " worker threads." << endl;
 
     WebSocket::Server wsServer(WS_PORT);
     wsServer.setOpenCallback(&openCallback);
     wsServer.setCloseCallback(&closeCallback);
     wsServer.setRequestCallback(&requestCallback);
 
+    // Event payloads are serialized once and sent as is to every subscriber.
+    g_vaultEvents.setSendCallback([&](websocketpp::connection_hdl hdl, const string& json) { wsServer.send(hdl, json); });
+    g_vaultRegistry.setOpenCallback([](const string& key, VaultRegistry::vault_ptr_t vault) { g_vaultEvents.onVaultOpened(key, vault); });
+    g_vaultEvents.start();
+
     try 
     {
         LOGGER(debug) << "Starting websocket server on port " << WS_PORT << "..." << endl;
@@ -847,8 +1442,70 @@ int main(int argc, char* argv[])
         return 1;
     }
 
-    while (!g_bShutdown) { std::this_thread::sleep_for(std::chrono::microseconds(200)); }
+    // Bulk loading is optional, so the daemon runs without it if the socket cannot be created.
+    IngestServer ingestServer(INGEST_SOCKET_PATH, [](const string& filename) { return g_vaultRegistry.get(filename); });
+    try
+    {
+        LOGGER(debug) << "Starting ingest server on " << INGEST_SOCKET_PATH << "..." << endl;
+        ingestServer.start();
+        LOGGER(debug) << "Ingest server started." << endl;
+    }
+    catch (const std::exception& e)
+    {
+        LOGGER(error) << "Error starting ingest server: " << e.what() << endl;
+    }
+
+    std::unique_ptr<MetricsServer> metricsServer;
+    const char* metricsPort = getenv(METRICS_PORT_ENV);
+    if (metricsPort)
+    {
+        try
+        {
+            LOGGER(debug) << "Starting metrics server on port " << metricsPort << "..." << endl;
+            metricsServer.reset(new MetricsServer(strtoul(metricsPort, NULL, 10)));
+            metricsServer->start();
+            LOGGER(debug) << "Metrics server started." << endl;
+        }
+        catch (const std::exception& e)
+        {
+            LOGGER(error) << "Error starting metrics server: " << e.what() << endl;
+            metricsServer.reset();
+        }
+    }
+
+    boost::asio::deadline_timer evictionTimer(io);
+    std::function<void()> scheduleEviction = [&]()
+    {
+        evictionTimer.expires_from_now(boost::posix_time::seconds(VAULT_EVICTION_INTERVAL.count()));
+        evictionTimer.async_wait([&](const boost::system::error_code& ec)
+        {
+            if (ec) return;
+            g_vaultRegistry.evictIdle();
+            scheduleEviction();
+        });
+    };
+    scheduleEviction();
+
+    io.run();
+
+    // Lets the batch being inserted finish.
+    LOGGER(debug) << "Stopping ingest server..." << endl;
+    ingestServer.stop();
+
+    // New requests are refused from here on. Requests already running get until the deadline.
+    LOGGER(debug) << "Waiting for requests in progress..." << endl;
+    if (!drainRequests(SHUTDOWN_DRAIN_TIMEOUT))
+    {
+        LOGGER(error) << "Requests still running after " << SHUTDOWN_DRAIN_TIMEOUT.count() << " seconds. Waiting for them to finish." << endl;
+    }
+
+    // Requests still running past the deadline are finished before the workers exit.
+    g_requestPool->stop();
 
+    // Send queued events before the connections go away.
+    g_vaultEvents.stop();
+
+    int exitCode = 0;
     try
     {
         LOGGER(debug) << "Stopping websocket server..." << endl;
@@ -858,9 +1515,19 @@ int main(int argc, char* argv[])
     catch (const std::exception& e)
     {
         LOGGER(error) << "Error stopping websocket server: " << e.what() << endl;
-        return 2;
+        exitCode = 2;
     }
 
-    return 0;
+    if (metricsServer)
+    {
+        LOGGER(debug) << "Stopping metrics server..." << endl;
+        metricsServer->stop();
+    }
+
+    // Vaults are closed even if the server did not stop cleanly.
+    LOGGER(debug) << "Closing " << g_vaultRegistry.getOpenFilenames().size() << " open vaults..." << endl;
+    g_vaultRegistry.closeAll();
+
+    return exitCode;
 }
 
@@ -0,0 +1,147 @@
+// Starts vaultd, leaves it idle and checks that it neither burns CPU nor wakes up
+// often, then stops it with SIGTERM and checks that it shuts down cleanly in time.
+// Linux only: the counters come from /proc.
+//
+// Usage: idle [vaultd = ../../build/vaultd] [idle seconds = 10]
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <chrono>
+#include <thread>
+#include <cstdlib>
+
+#include <dirent.h>
+#include <signal.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+using namespace std;
+
+const double MAX_CPU_PERCENT = 1.0;
+const double MAX_WAKEUPS_PER_SECOND = 20.0;
+const chrono::seconds STARTUP_TIME(2);
+const chrono::seconds SHUTDOWN_DEADLINE(15);
+
+struct Sample
+{
+    double cpuSeconds;
+    unsigned long contextSwitches;
+};
+
+// Sums over all threads, since a busy loop in any of them counts.
+bool takeSample(pid_t pid, Sample& sample)
+{
+    stringstream path;
+    path << "/proc/" << pid << "/stat";
+    ifstream stat(path.str().c_str());
+    string line;
+    if (!getline(stat, line)) return false;
+
+    // The command name may contain spaces, so fields are counted from the closing parenthesis.
+    istringstream fields(line.substr(line.rfind(')') + 2));
+    string field;
+    unsigned long utime = 0, stime = 0;
+    for (int i = 3; fields >> field; i++)
+    {
+        if (i == 14) utime = strtoul(field.c_str(), NULL, 10);
+        if (i == 15) { stime = strtoul(field.c_str(), NULL, 10); break; }
+    }
+    sample.cpuSeconds = (double)(utime + stime) / sysconf(_SC_CLK_TCK);
+
+    path.str("");
+    path << "/proc/" << pid << "/task";
+    DIR* dir = opendir(path.str().c_str());
+    if (!dir) return false;
+
+    sample.contextSwitches = 0;
+    while (dirent* entry = readdir(dir))
+    {
+        if (entry->d_name[0] == '.') continue;
+        ifstream status((path.str() + "/" + entry->d_name + "/status").c_str());
+        while (getline(status, line))
+        {
+            if (line.find("voluntary_ctxt_switches:") != string::npos)
+                sample.contextSwitches += strtoul(line.substr(line.find(':') + 1).c_str(), NULL, 10);
+        }
+    }
+    closedir(dir);
+    return true;
+}
+
+int main(int argc, char* argv[])
+{
+    string vaultd = argc > 1 ? argv[1] : "../../build/vaultd";
+    int idleSeconds = argc > 2 ? strtol(argv[2], NULL, 10) : 10;
+    if (idleSeconds <= 0)
+    {
+        cerr << "# Usage: " << argv[0] << " [vaultd = ../../build/vaultd] [idle seconds = 10]" << endl;
+        return -1;
+    }
+
+    pid_t pid = fork();
+    if (pid < 0)
+    {
+        cerr << "fork failed." << endl;
+        return -1;
+    }
+    if (pid == 0)
+    {
+        execl(vaultd.c_str(), vaultd.c_str(), (char*)NULL);
+        cerr << "Could not run " << vaultd << "." << endl;
+        _exit(127);
+    }
+
+    this_thread::sleep_for(STARTUP_TIME);
+
+    int failures = 0;
+    Sample before, after;
+    if (!takeSample(pid, before))
+    {
+        cerr << "vaultd is not running." << endl;
+        return -2;
+    }
+    this_thread::sleep_for(chrono::seconds(idleSeconds));
+    if (!takeSample(pid, after))
+    {
+        cerr << "vaultd exited while idle." << endl;
+        return -2;
+    }
+
+    double cpuPercent = 100.0 * (after.cpuSeconds - before.cpuSeconds) / idleSeconds;
+    double wakeups = (double)(after.contextSwitches - before.contextSwitches) / idleSeconds;
+    cout << "idle cpu:     " << cpuPercent << " % (max " << MAX_CPU_PERCENT << ")" << endl
+         << "idle wakeups: " << wakeups << " /s (max " << MAX_WAKEUPS_PER_SECOND << ")" << endl;
+    if (cpuPercent > MAX_CPU_PERCENT) failures++;
+    if (wakeups > MAX_WAKEUPS_PER_SECOND) failures++;
+
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    kill(pid, SIGTERM);
+
+    int status = 0;
+    pid_t result = 0;
+    while ((result = waitpid(pid, &status, WNOHANG)) == 0 && chrono::steady_clock::now() - start < SHUTDOWN_DEADLINE)
+    {
+        this_thread::sleep_for(chrono::milliseconds(10));
+    }
+
+    if (result == 0)
+    {
+        cout << "shutdown:     did not exit within " << SHUTDOWN_DEADLINE.count() << " s" << endl;
+        kill(pid, SIGKILL);
+        waitpid(pid, &status, 0);
+        failures++;
+    }
+    else
+    {
+        double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+        bool clean = WIFEXITED(status) && WEXITSTATUS(status) == 0;
+        cout << "shutdown:     " << ms << " ms, " << (clean ? "exit 0" : "unclean exit") << endl;
+        if (!clean) failures++;
+    }
+
+    cout << (failures ? "FAILED" : "passed") << endl;
+    return failures;
+}
@@ -0,0 +1,259 @@
+// Runs IngestServer over a real Unix socket against the mock vault in mock/Vault.h and checks the
+// socket's permissions, the per-item results of mixed batches, request failures, in-order answers
+// on one connection, the frame size limit and removal of the socket on stop.
+// Unix only.
+//
+// Usage: ingest
+
+#include "IngestServer.h"
+
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+using namespace std;
+using namespace CoinDB;
+
+const string SOCKET_PATH = "ingest-test.sock";
+const string VAULT_NAME = "test.db";
+
+enum { ITEM_TX = 1, ITEM_MERKLEBLOCK = 2 };
+
+static bool g_ok = true;
+
+static void check(bool condition, const string& what)
+{
+    if (condition) return;
+    cout << "FAILED: " << what << endl;
+    g_ok = false;
+}
+
+static void writeU8(string& frame, uint8_t n) { frame += (char)n; }
+static void writeU16(string& frame, uint16_t n) { writeU8(frame, n & 0xff); writeU8(frame, n >> 8); }
+static void writeU32(string& frame, uint32_t n) { writeU16(frame, n & 0xffff); writeU16(frame, n >> 16); }
+
+struct Item
+{
+    uint8_t type;
+    uint32_t height;
+    string data;
+};
+
+static string makeRequest(const string& filename, const vector<Item>& items, uint32_t count)
+{
+    string request;
+    writeU16(request, filename.size());
+    request += filename;
+    writeU32(request, count);
+    for (auto& item: items)
+    {
+        writeU8(request, item.type);
+        writeU32(request, item.height);
+        writeU32(request, item.data.size());
+        request += item.data;
+    }
+    return request;
+}
+
+static string makeRequest(const string& filename, const vector<Item>& items)
+{
+    return makeRequest(filename, items, items.size());
+}
+
+static string frame(const string& payload)
+{
+    string data;
+    writeU32(data, payload.size());
+    return data + payload;
+}
+
+struct ItemResult
+{
+    uint8_t status;
+    string hash;
+    string message;
+};
+
+struct Response
+{
+    uint8_t status;
+    string message;
+    vector<ItemResult> items;
+};
+
+class Reader
+{
+public:
+    explicit Reader(const string& data) : m_data(data), m_pos(0) { }
+
+    uint8_t u8() { require(1); return (uint8_t)m_data[m_pos++]; }
+    uint16_t u16() { uint16_t n = u8(); return n | ((uint16_t)u8() << 8); }
+    uint32_t u32() { uint32_t n = u16(); return n | ((uint32_t)u16() << 16); }
+    string bytes(size_t length) { require(length); string s(m_data, m_pos, length); m_pos += length; return s; }
+    bool done() const { return m_pos == m_data.size(); }
+
+private:
+    void require(size_t length) { if (m_data.size() - m_pos < length) throw runtime_error("Truncated response."); }
+
+    const string& m_data;
+    size_t m_pos;
+};
+
+static Response parseResponse(const string& data)
+{
+    Reader reader(data);
+    Response response;
+    response.status = reader.u8();
+    response.message = reader.bytes(reader.u16());
+    uint32_t count = reader.u32();
+    for (uint32_t i = 0; i < count; i++)
+    {
+        ItemResult item;
+        item.status = reader.u8();
+        item.hash = reader.bytes(32);
+        item.message = reader.bytes(reader.u16());
+        response.items.push_back(item);
+    }
+    if (!reader.done()) throw runtime_error("Trailing data in response.");
+    return response;
+}
+
+class Client
+{
+public:
+    Client()
+    {
+        m_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        sockaddr_un addr = sockaddr_un();
+        addr.sun_family = AF_UNIX;
+        SOCKET_PATH.copy(addr.sun_path, sizeof(addr.sun_path) - 1);
+        if (m_fd < 0 || connect(m_fd, (sockaddr*)&addr, sizeof(addr)) != 0) throw runtime_error("Could not connect.");
+    }
+
+    ~Client() { close(m_fd); }
+
+    void send(const string& data)
+    {
+        for (size_t sent = 0; sent < data.size();)
+        {
+            ssize_t n = write(m_fd, data.data() + sent, data.size() - sent);
+            if (n <= 0) throw runtime_error("Could not send.");
+            sent += n;
+        }
+    }
+
+    // Returns false if the server closed the connection.
+    bool receive(string& data, size_t length)
+    {
+        data.resize(length);
+        for (size_t received = 0; received < length;)
+        {
+            ssize_t n = read(m_fd, &data[received], length - received);
+            if (n <= 0) return false;
+            received += n;
+        }
+        return true;
+    }
+
+    Response receiveResponse()
+    {
+        string header, payload;
+        if (!receive(header, 4)) throw runtime_error("Connection closed.");
+        Reader reader(header);
+        if (!receive(payload, reader.u32())) throw runtime_error("Connection closed.");
+        return parseResponse(payload);
+    }
+
+    Response request(const string& payload)
+    {
+        send(frame(payload));
+        return receiveResponse();
+    }
+
+private:
+    int m_fd;
+};
+
+int main()
+{
+    shared_ptr<Vault> vault = make_shared<Vault>();
+    IngestServer server(SOCKET_PATH, [&](const string& filename)
+    {
+        if (filename != VAULT_NAME) throw runtime_error("Vault not found.");
+        return vault;
+    });
+
+    // The socket must not be reachable by others even with a permissive umask, and the umask is restored.
+    ::umask(0);
+    server.start();
+    struct stat st;
+    check(::stat(SOCKET_PATH.c_str(), &st) == 0 && (st.st_mode & 0777) == 0600, "socket is created with mode 0600");
+    check(::umask(0) == 0, "umask is restored after start");
+
+    try
+    {
+        Client client;
+
+        string txHash(32, '\x11');
+        string blockHash(32, '\x22');
+        vector<Item> items = {
+            { ITEM_TX, 0, txHash + "tx data" },
+            { ITEM_TX, 0, "too short" },
+            { ITEM_MERKLEBLOCK, 7, blockHash + string(48, '\0') },
+            { 9, 0, string(40, '\0') },
+            { ITEM_TX, 0, txHash + "the same tx" }
+        };
+        Response response = client.request(makeRequest(VAULT_NAME, items));
+        check(response.status == 0 && response.message.empty(), "mixed batch succeeds");
+        check(response.items.size() == items.size(), "mixed batch answers every item");
+        if (response.items.size() == items.size())
+        {
+            check(response.items[0].status == BatchInsertResult::INSERTED && response.items[0].hash == txHash, "tx is inserted");
+            check(response.items[1].status == BatchInsertResult::FAILED && response.items[1].hash == string(32, '\0') && !response.items[1].message.empty(), "unparseable tx fails");
+            check(response.items[2].status == BatchInsertResult::INSERTED && response.items[2].hash == blockHash, "merkle block is inserted");
+            check(response.items[3].status == BatchInsertResult::FAILED && response.items[3].message == "Invalid item type.", "unknown item type fails");
+            check(response.items[4].status == BatchInsertResult::UNCHANGED && response.items[4].hash == txHash, "repeated tx is unchanged");
+        }
+        check(vault->getBatchCount() == 1, "parsed items go to the vault as one batch");
+
+        response = client.request(makeRequest("missing.db", { { ITEM_TX, 0, txHash } }));
+        check(response.status == 1 && response.message == "Vault not found." && response.items.empty(), "unknown vault fails the request");
+
+        response = client.request(makeRequest(VAULT_NAME, {}, 1000));
+        check(response.status == 1 && response.message == "Invalid item count." && response.items.empty(), "bogus item count fails the request");
+
+        response = client.request(makeRequest(VAULT_NAME, { { ITEM_TX, 0, txHash } }) + "x");
+        check(response.status == 1 && response.message == "Trailing data in request.", "trailing data fails the request");
+
+        // Pipelined requests are answered in order.
+        client.send(frame(makeRequest(VAULT_NAME, { { ITEM_TX, 0, string(32, '\x33') } })) + frame(makeRequest("missing.db", { { ITEM_TX, 0, txHash } })));
+        Response first = client.receiveResponse();
+        Response second = client.receiveResponse();
+        check(first.status == 0 && first.items.size() == 1 && first.items[0].status == BatchInsertResult::INSERTED, "first pipelined request is answered first");
+        check(second.status == 1, "second pipelined request is answered second");
+
+        // A frame over the limit closes the connection without an answer.
+        Client oversized;
+        string header;
+        writeU32(header, IngestServer::MAX_FRAME_SIZE + 1);
+        oversized.send(header);
+        string data;
+        check(!oversized.receive(data, 1), "oversized frame closes the connection");
+    }
+    catch (const exception& e)
+    {
+        check(false, string("no exception: ") + e.what());
+    }
+
+    server.stop();
+    check(::access(SOCKET_PATH.c_str(), F_OK) != 0, "socket is removed on stop");
+
+    cout << (g_ok ? "All ingest checks passed." : "Some ingest checks failed.") << endl;
+    return g_ok ? 0 : 1;
+}
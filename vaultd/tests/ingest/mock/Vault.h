@@ -0,0 +1,143 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// Vault.h
+//
+// Copyright (c) 2014 Eric Lombrozo
+//
+// All Rights Reserved.
+//
+// Stands in for CoinDB's Vault.h so IngestServer can be tested without a database.
+// Only what IngestServer uses is here. Items are recognized by their first bytes:
+// a tx must be at least 32 bytes and a merkle block at least 80, and the hash of
+// either is its first 32 bytes.
+//
+
+#pragma once
+
+#include <stdint.h>
+
+#include <memory>
+#include <mutex>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+typedef std::vector<unsigned char> bytes_t;
+
+class uchar_vector : public bytes_t
+{
+public:
+    uchar_vector(const bytes_t& bytes) : bytes_t(bytes) { }
+};
+
+namespace Coin {
+
+class MerkleBlock
+{
+public:
+    explicit MerkleBlock(const uchar_vector& raw) : raw(raw)
+    {
+        if (raw.size() < 80) throw std::runtime_error("Invalid merkle block.");
+    }
+
+    bytes_t raw;
+};
+
+}
+
+namespace CoinDB {
+
+class BlockHeader
+{
+public:
+    BlockHeader(const bytes_t& hash, uint32_t height) : hash_(hash), height_(height) { }
+
+    const bytes_t& hash() const { return hash_; }
+    uint32_t height() const { return height_; }
+
+private:
+    bytes_t hash_;
+    uint32_t height_;
+};
+
+class Tx
+{
+public:
+    void set(const bytes_t& raw)
+    {
+        if (raw.size() < 32) throw std::runtime_error("Invalid transaction.");
+        hash_.assign(raw.begin(), raw.begin() + 32);
+    }
+
+    const bytes_t& hash() const { return hash_; }
+
+private:
+    bytes_t hash_;
+};
+
+class MerkleBlock
+{
+public:
+    void fromCoinCore(const Coin::MerkleBlock& merkleblock, uint32_t height)
+    {
+        blockheader_ = std::make_shared<BlockHeader>(bytes_t(merkleblock.raw.begin(), merkleblock.raw.begin() + 32), height);
+    }
+
+    std::shared_ptr<BlockHeader> blockheader() const { return blockheader_; }
+
+private:
+    std::shared_ptr<BlockHeader> blockheader_;
+};
+
+struct BatchInsertItem
+{
+    BatchInsertItem() { }
+    explicit BatchInsertItem(std::shared_ptr<Tx> tx_) : tx(tx_) { }
+    explicit BatchInsertItem(std::shared_ptr<MerkleBlock> merkleblock_) : merkleblock(merkleblock_) { }
+
+    std::shared_ptr<Tx> tx;
+    std::shared_ptr<MerkleBlock> merkleblock;
+};
+
+struct BatchInsertResult
+{
+    enum status_t { INSERTED, UNCHANGED, FAILED };
+
+    BatchInsertResult() : status(UNCHANGED) { }
+
+    status_t status;
+    std::string error; // set if FAILED
+};
+
+// Inserts each hash once. Later inserts of the same hash are unchanged.
+class Vault
+{
+public:
+    std::vector<BatchInsertResult> insertBatch(const std::vector<BatchInsertItem>& items)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_batches++;
+
+        std::vector<BatchInsertResult> results(items.size());
+        for (std::size_t i = 0; i < items.size(); i++)
+        {
+            const bytes_t& hash = items[i].tx ? items[i].tx->hash() : items[i].merkleblock->blockheader()->hash();
+            results[i].status = m_hashes.insert(hash).second ? BatchInsertResult::INSERTED : BatchInsertResult::UNCHANGED;
+        }
+        return results;
+    }
+
+    unsigned int getBatchCount() const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_batches;
+    }
+
+private:
+    mutable std::mutex m_mutex;
+    std::set<bytes_t> m_hashes;
+    unsigned int m_batches = 0;
+};
+
+}
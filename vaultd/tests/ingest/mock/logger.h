@@ -0,0 +1,16 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// logger.h
+//
+// Copyright (c) 2014 Eric Lombrozo
+//
+// All Rights Reserved.
+//
+// Stands in for the logger library, discarding everything.
+//
+
+#pragma once
+
+#include <iostream>
+
+#define LOGGER(level) if (true) { } else std::cerr
@@ -0,0 +1,62 @@
+// Runs VaultRegistry against the mock vault in mock/Vault.h and checks that closing or evicting a
+// vault a request still holds never leads to a second instance on the same file, and that vaults
+// nobody holds are really closed.
+//
+// Usage: registry
+
+#include "VaultRegistry.h"
+
+#include <iostream>
+#include <string>
+
+using namespace std;
+using namespace CoinDB;
+
+const string VAULT_NAME = "registry-test.db";
+
+static bool g_ok = true;
+
+static void check(bool condition, const string& what)
+{
+    if (condition) return;
+    cout << "FAILED: " << what << endl;
+    g_ok = false;
+}
+
+int main()
+{
+    VaultRegistry registry(chrono::seconds(0));
+
+    {
+        VaultRegistry::vault_ptr_t held = registry.get(VAULT_NAME);
+        check(registry.get(VAULT_NAME) == held, "get returns the open vault");
+
+        check(registry.close(VAULT_NAME), "close succeeds");
+        check(registry.getOpenFilenames().empty(), "closed vault is not listed");
+        check(Vault::getInstanceCount(VAULT_NAME) == 1, "held vault stays open after close");
+
+        VaultRegistry::vault_ptr_t reopened = registry.get(VAULT_NAME);
+        check(reopened == held && Vault::getInstanceCount(VAULT_NAME) == 1, "get after close reuses the held vault");
+
+        bool bThrew = false;
+        try { registry.close(VAULT_NAME); registry.open(VAULT_NAME, true); } catch (const exception&) { bThrew = true; }
+        check(bThrew, "creating a vault that is still held fails");
+
+        registry.get(VAULT_NAME);
+        check(registry.evictIdle() == 1, "idle vault is evicted");
+        check(registry.get(VAULT_NAME) == held && Vault::getInstanceCount(VAULT_NAME) == 1, "get after eviction reuses the held vault");
+
+        registry.closeAll();
+        check(registry.get(VAULT_NAME) == held && Vault::getInstanceCount(VAULT_NAME) == 1, "get after closeAll reuses the held vault");
+        registry.closeAll();
+    }
+
+    check(Vault::getInstanceCount(VAULT_NAME) == 0, "vault closes once its last holder releases it");
+
+    registry.get(VAULT_NAME);
+    check(Vault::getInstanceCount(VAULT_NAME) == 1, "vault opens again after it was released");
+    check(registry.evictIdle() == 1 && Vault::getInstanceCount(VAULT_NAME) == 0, "evicting a vault nobody holds closes it");
+
+    cout << (g_ok ? "All registry checks passed." : "Some registry checks failed.") << endl;
+    return g_ok ? 0 : 1;
+}
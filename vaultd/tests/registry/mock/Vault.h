@@ -0,0 +1,49 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// Vault.h
+//
+// Copyright (c) 2014 Eric Lombrozo
+//
+// All Rights Reserved.
+//
+// Stands in for CoinDB's Vault.h so VaultRegistry can be tested without a database.
+// It only counts the instances open on each file.
+//
+
+#pragma once
+
+#include <map>
+#include <mutex>
+#include <string>
+
+namespace CoinDB {
+
+class Vault
+{
+public:
+    Vault(const std::string& filename, bool /*create*/ = false) : m_filename(filename)
+    {
+        std::lock_guard<std::mutex> lock(mutex());
+        instances()[m_filename]++;
+    }
+
+    ~Vault()
+    {
+        std::lock_guard<std::mutex> lock(mutex());
+        instances()[m_filename]--;
+    }
+
+    static int getInstanceCount(const std::string& filename)
+    {
+        std::lock_guard<std::mutex> lock(mutex());
+        return instances()[filename];
+    }
+
+private:
+    std::string m_filename;
+
+    static std::mutex& mutex() { static std::mutex m; return m; }
+    static std::map<std::string, int>& instances() { static std::map<std::string, int> i; return i; }
+};
+
+}
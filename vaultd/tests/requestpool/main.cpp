@@ -0,0 +1,148 @@
+// Runs tasks on RequestPool and checks that tasks sharing a key run one at a time and in order, that a
+// slow task does not hold up tasks on other keys, and that stop() finishes every task already posted.
+//
+// Usage: requestpool
+
+#include "RequestPool.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <iostream>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+const unsigned int WORKERS = 4;
+const unsigned int TASKS = 200;
+const chrono::seconds TIMEOUT(10);
+
+static bool g_ok = true;
+
+static void check(bool condition, const string& what)
+{
+    if (condition) return;
+    cout << "FAILED: " << what << endl;
+    g_ok = false;
+}
+
+// Set once by one thread and waited on by others.
+class Flag
+{
+public:
+    Flag() : m_bSet(false) { }
+
+    void set()
+    {
+        { lock_guard<mutex> lock(m_mutex); m_bSet = true; }
+        m_cond.notify_all();
+    }
+
+    bool wait()
+    {
+        unique_lock<mutex> lock(m_mutex);
+        return m_cond.wait_for(lock, TIMEOUT, [this]() { return m_bSet; });
+    }
+
+private:
+    mutex m_mutex;
+    condition_variable m_cond;
+    bool m_bSet;
+};
+
+int main()
+{
+    // Tasks on one key, interleaved with tasks on another, from a pool with several workers.
+    {
+        RequestPool pool(WORKERS);
+        pool.start();
+
+        mutex orderMutex;
+        vector<unsigned int> order[2];
+        atomic<int> running[2];
+        atomic<int> peak[2];
+        for (int k = 0; k < 2; k++) { running[k] = 0; peak[k] = 0; }
+
+        for (unsigned int i = 0; i < TASKS; i++)
+        {
+            int k = i % 2;
+            pool.post(RequestPool::keys_t(1, k ? "b.db" : "a.db"), [&, i, k]()
+            {
+                int now = ++running[k];
+                if (now > peak[k]) peak[k] = now;
+                this_thread::sleep_for(chrono::microseconds(50));
+                { lock_guard<mutex> lock(orderMutex); order[k].push_back(i); }
+                --running[k];
+            });
+        }
+        pool.stop();
+
+        bool bInOrder = true;
+        for (int k = 0; k < 2; k++)
+        {
+            if (order[k].size() != TASKS / 2) bInOrder = false;
+            for (unsigned int j = 0; j < order[k].size(); j++) { if (order[k][j] != j * 2 + k) bInOrder = false; }
+        }
+        check(bInOrder, "tasks on one key run in the order posted");
+        check(peak[0] == 1 && peak[1] == 1, "tasks on one key never run at the same time");
+    }
+
+    // A task that does not finish until a task on another key has run.
+    {
+        RequestPool pool(WORKERS);
+        pool.start();
+
+        Flag otherRan;
+        atomic<bool> bSlowFinished(false);
+        atomic<bool> bSlowSawOther(false);
+        pool.post(RequestPool::keys_t(1, "slow.db"), [&]() { bSlowSawOther = otherRan.wait(); bSlowFinished = true; });
+        pool.post(RequestPool::keys_t(1, "fast.db"), [&]() { otherRan.set(); });
+        pool.stop();
+
+        check(bSlowFinished && bSlowSawOther, "a slow task does not hold up tasks on other keys");
+    }
+
+    // A batch holds the keys of every vault it touches.
+    {
+        RequestPool pool(WORKERS);
+        pool.start();
+
+        Flag batchStarted;
+        Flag release;
+        atomic<bool> bBatchDone(false);
+        atomic<bool> bWaitedForBatch(true);
+        vector<string> batchKeys = { "a.db", "b.db" };
+        pool.post(batchKeys, [&]() { batchStarted.set(); release.wait(); bBatchDone = true; });
+        batchStarted.wait();
+        pool.post(RequestPool::keys_t(1, "b.db"), [&]() { if (!bBatchDone) bWaitedForBatch = false; });
+        pool.post(RequestPool::keys_t(), [&]() { release.set(); });
+        pool.stop();
+
+        check(bBatchDone && bWaitedForBatch, "a task waits for a running batch holding its key");
+    }
+
+    // Tasks posted before stop() all run, those posted after are dropped, and a throwing task does not take a worker down.
+    {
+        RequestPool pool(2);
+        pool.start();
+
+        atomic<unsigned int> ran(0);
+        pool.post(RequestPool::keys_t(1, "a.db"), []() { throw runtime_error("task failed"); });
+        for (unsigned int i = 0; i < TASKS; i++)
+        {
+            pool.post(RequestPool::keys_t(1, i % 3 ? "a.db" : "c.db"), [&]() { this_thread::sleep_for(chrono::microseconds(20)); ran++; });
+        }
+        pool.stop();
+        check(ran == TASKS, "stop runs every task already posted");
+        check(pool.getQueued() == 0, "nothing is left queued after stop");
+
+        pool.post(RequestPool::keys_t(), [&]() { ran++; });
+        check(ran == TASKS && pool.getQueued() == 0, "tasks posted after stop are dropped");
+    }
+
+    cout << (g_ok ? "All request pool checks passed." : "Some request pool checks failed.") << endl;
+    return g_ok ? 0 : 1;
+}